@@ -0,0 +1,41 @@
+#pragma once
+
+#include <inttypes.h>
+
+// Each analog channel gets a single config byte
+// [Unused] [Filter Shift] [Filter Shift] [Filter Shift] [Unused] [Oversample Bits] [Oversample Bits] [Oversample Bits]
+//     7          6              5              4            3            2                  1                0
+static constexpr uint8_t kMaxOversampleBits = 3; // 4^3 = 64 samples, 13 bits of effective resolution
+static constexpr uint8_t kMaxFilterShift = 7;
+
+// Published values are 10.6 fixed point ADC counts (i.e. 1023 << 6 is full scale)
+static constexpr uint8_t kAnalogFractionalBits = 6;
+
+class AnalogFilter {
+  public:
+    void configure(uint8_t config);
+    void reset();
+
+    // Accumulate a raw 10-bit ADC sample. Returns true if this sample
+    // completed a decimation window and a new value is available
+    bool addSample(uint16_t sample);
+
+    // Filtered value in 10.6 fixed point
+    uint16_t value() const;
+
+    // Filtered value rounded back down to 10-bit ADC counts
+    uint16_t rawValue() const;
+
+  private:
+    uint8_t _config = 0;
+    uint8_t _oversampleBits = 0;
+    uint8_t _filterShift = 0;
+
+    uint8_t _numSamples = 0;
+    uint32_t _accumulator = 0;
+
+    // IIR filter state, with 8 extra fractional bits to avoid stalling
+    // short of the input value on large shifts
+    int32_t _filterState = 0;
+    bool _hasValue = false;
+};
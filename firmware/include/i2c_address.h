@@ -0,0 +1,25 @@
+#pragma once
+
+#include <inttypes.h>
+
+// Base I2C address of the board. Boards sharing a bus each need their
+// own address, which can be set at build time, e.g. with
+// -D ROMI_I2C_ADDRESS=0x15 in build_flags
+#ifndef ROMI_I2C_ADDRESS
+#define ROMI_I2C_ADDRESS 0x14
+#endif
+
+// The address can also be moved up from the base without rebuilding, by
+// an offset stored in EEPROM. Holding button C at power up steps to the
+// next offset, wrapping back round to the base address
+static constexpr uint8_t kMaxI2CAddressOffset = 3;
+
+class I2CAddress {
+  public:
+    // Work out the address to use, first stepping to the next offset
+    // (and storing it) if requested
+    static uint8_t begin(bool advance);
+
+    static uint8_t address();
+    static uint8_t offset();
+};
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <inttypes.h>
+
+// Commands written to the motionCommand register
+static constexpr uint8_t kMotionCommandNone = 0;
+static constexpr uint8_t kMotionCommandDrive = 1;
+static constexpr uint8_t kMotionCommandTurn = 2;
+static constexpr uint8_t kMotionCommandCancel = 3;
+
+// Reported in the motionState register
+static constexpr uint8_t kMotionStateIdle = 0;
+static constexpr uint8_t kMotionStateRunning = 1;
+static constexpr uint8_t kMotionStateComplete = 2;
+static constexpr uint8_t kMotionStateAborted = 3;
+
+// How often the profile setpoint and tracking loop are updated
+static constexpr unsigned long kMotionProfilePeriodUs = 10000;
+
+// Tracking gains. Feedforward is roughly 400 / (max no-load speed in ticks/s)
+static constexpr float kMotionKv = 0.11f;   // motor units per tick/s
+static constexpr float kMotionKp = 2.0f;    // motor units per tick of error
+
+// The move is complete once both wheels are within tolerance at the end
+// of the profile, or the settle timeout runs out
+static constexpr int16_t kMotionToleranceTicks = 10;
+static constexpr unsigned long kMotionSettleTimeoutMs = 500;
+
+// Generates a trapezoidal velocity profile and tracks it against the
+// wheel encoders. Drives move both wheels the same direction, turns move
+// them in opposite directions (left wheel positive for a clockwise turn)
+class MotionProfile {
+  public:
+    void start(uint8_t command, int16_t distanceTicks, uint16_t maxVelocity, uint16_t maxAccel,
+               int16_t leftCounts, int16_t rightCounts);
+    void cancel();
+    void abort();
+
+    // Call when an encoder gets reset, with the count it had beforehand
+    void onLeftEncoderReset(int16_t countsBeforeReset);
+    void onRightEncoderReset(int16_t countsBeforeReset);
+
+    // Advance the profile. Returns true if the motor outputs should be applied
+    bool update(unsigned long nowMs, int16_t leftCounts, int16_t rightCounts);
+
+    bool isRunning() const;
+    uint8_t state() const;
+
+    // Distance travelled along the profile, in ticks
+    int16_t progress() const;
+
+    int16_t leftOutput() const;
+    int16_t rightOutput() const;
+
+  private:
+    void setpointAt(float t, float& position, float& velocity) const;
+    int16_t track(float position, float velocity, int16_t actual) const;
+
+    uint8_t _state = kMotionStateIdle;
+
+    int8_t _leftDirection = 1;
+    int8_t _rightDirection = 1;
+    int8_t _sign = 1;
+
+    int16_t _leftStart = 0;
+    int16_t _rightStart = 0;
+
+    float _distance = 0;
+    float _accel = 0;
+    float _peakVelocity = 0;
+    float _accelTime = 0;
+    float _cruiseTime = 0;
+    float _totalTime = 0;
+
+    unsigned long _startMs = 0;
+    int16_t _progress = 0;
+
+    int16_t _leftOutput = 0;
+    int16_t _rightOutput = 0;
+};
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <inttypes.h>
+
+// How often the motor ramps are stepped. Host updates come in at
+// ~20ms intervals, so this gives us plenty of interpolation points
+static constexpr unsigned long kMotorRampPeriodUs = 1000;
+
+// Longest gap we'll step over in one go (e.g. if loop() stalls)
+static constexpr unsigned long kMotorRampMaxStepUs = 50000;
+
+class MotorRamp {
+  public:
+    // Max change in motor speed (in -400 to 400 units) per second.
+    // A rate of 0 disables limiting and applies new targets immediately
+    void setRate(uint16_t unitsPerSecond);
+    void setTarget(int16_t target);
+
+    // Jump straight to a value, bypassing the ramp
+    void reset(int16_t value);
+
+    // Move the output towards the target, given the elapsed time
+    void update(unsigned long elapsedUs);
+
+    int16_t output() const;
+
+  private:
+    uint16_t _rate = 0;
+    int16_t _target = 0;
+
+    // Output in thousandths of a motor speed unit, so that slow ramps
+    // still make progress every period
+    int32_t _output = 0;
+};
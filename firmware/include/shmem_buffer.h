@@ -1,27 +1,52 @@
 // AUTOGENERATED FILE. DO NOT MODIFY.
 // Generated via `npm run gen-shmem`
 
-// Instance: b716f7f0-1c8e-4af6-8271-386c9c6c1276
+// Instance: f03b1fd3-75be-44cb-a802-6b3206767913
 
 #pragma once
 #include <stdint.h>
 
-#define FIRMWARE_IDENT 118
+#define FIRMWARE_IDENT 19
 
 struct Data {
   uint16_t ioConfig;
   uint8_t firmwareIdent;
   uint8_t status;
   bool heartbeat;
+  uint8_t resetCause;
+  uint16_t heartbeatTimeoutMs;
   uint8_t builtinConfig;
   bool builtinDioValues[4];
-  int16_t extIoValues[5];
-  uint16_t analog[2];
+  int16_t extIoSafeValues[5];
+  uint8_t analogConfig[5];
+  uint16_t motorSlewRate;
+  bool resetLeftEncoder;
+  bool resetRightEncoder;
+  uint8_t motionCommand;
+  int16_t motionDistance;
+  uint16_t motionMaxVelocity;
+  uint16_t motionMaxAccel;
+  uint8_t commandSeq;
+  uint8_t commandFlags;
   int16_t leftMotor;
   int16_t rightMotor;
+  int16_t extIoOutputs[5];
+  uint8_t commandCrc;
+  int16_t extIoValues[5];
+  uint8_t builtinDioInputs;
+  uint16_t analog[5];
   uint16_t batteryMillivolts;
-  bool resetLeftEncoder;
-  bool resetRightEncoder;
   int16_t leftEncoder;
   int16_t rightEncoder;
-};
+  uint8_t motionState;
+  int16_t motionProgress;
+  uint8_t commandAck;
+  uint8_t commandCrcErrors;
+  uint8_t telemetryCrc;
+} __attribute__((packed));
+
+#define COMMAND_CRC_START 39
+#define COMMAND_CRC_LENGTH 16
+
+#define TELEMETRY_CRC_START 56
+#define TELEMETRY_CRC_LENGTH 32
@@ -0,0 +1,7 @@
+#pragma once
+
+#include <inttypes.h>
+
+// CRC-8 (polynomial 0x07, initial value 0) over a range of the shared
+// memory buffer. The host computes the same CRC (see src/utils/crc8.ts)
+uint8_t shmemCrc8(const void* buffer, uint8_t start, uint8_t length);
@@ -0,0 +1,31 @@
+#pragma once
+
+#include <inttypes.h>
+
+static constexpr uint16_t kDefaultHeartbeatTimeoutMs = 1000;
+static constexpr uint16_t kMinHeartbeatTimeoutMs = 20;
+
+// Reset cause register bits
+static constexpr uint8_t kResetCausePowerOn = 0x01;
+static constexpr uint8_t kResetCauseExternal = 0x02;
+static constexpr uint8_t kResetCauseBrownOut = 0x04;
+static constexpr uint8_t kResetCauseWatchdog = 0x08;
+
+// Special safe values for external outputs. Anything else is written
+// out as-is (0/1 for digital outputs, -400 to 400 for PWM)
+static constexpr int16_t kSafeValueHold = 0x7FFF; // Keep the last commanded value
+
+class WatchdogSupervisor {
+  public:
+    // Capture the reset cause and start the hardware watchdog
+    static void begin();
+
+    // Must be called every loop() iteration
+    static void feed();
+
+    static void heartbeat();
+    static void setHeartbeatTimeout(uint16_t timeoutMs);
+    static bool isHeartbeatLost();
+
+    static uint8_t resetCause();
+};
@@ -0,0 +1,56 @@
+#pragma once
+
+// Arduino core API, backed by the simulated hardware in sim_hal.h
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdio.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+
+#define HIGH 1
+#define LOW 0
+
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+
+// ATmega32U4 analog pin numbers
+#define A0 18
+#define A1 19
+#define A2 20
+#define A3 21
+#define A4 22
+#define A5 23
+#define A6 24
+
+typedef uint8_t byte;
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t value);
+int digitalRead(uint8_t pin);
+int analogRead(uint8_t pin);
+
+long map(long x, long inMin, long inMax, long outMin, long outMax);
+
+template<class T> T constrain(T x, T low, T high) {
+  return x < low ? low : (x > high ? high : x);
+}
+
+// Serial output goes to stderr, since stdout carries the host protocol
+class SimSerial {
+  public:
+    void begin(long baud) {}
+    void print(const char* s) { fputs(s, stderr); }
+    void print(int value) { fprintf(stderr, "%d", value); }
+    void println(const char* s) { fprintf(stderr, "%s\n", s); }
+};
+
+extern SimSerial Serial;
@@ -0,0 +1,29 @@
+#pragma once
+
+// Stand-in for the PololuRPiSlave library, with the bus master on the
+// other side of the simulator's host protocol
+
+#include <stdint.h>
+#include <string.h>
+#include "sim_hal.h"
+
+// Like the real library, the master reads and writes a staging copy of
+// the buffer. updateBuffer() brings in whatever the master has written
+// since the last call, and finalizeWrites() publishes everything else
+template<class BufferType, unsigned int piDelayUs> class PololuRPiSlave {
+  public:
+    BufferType buffer;
+
+    void init(uint8_t address) {
+      memset(&buffer, 0, sizeof(BufferType));
+      simI2CAttach(reinterpret_cast<uint8_t*>(&buffer), sizeof(BufferType));
+    }
+
+    void updateBuffer() {
+      simI2CUpdateBuffer();
+    }
+
+    void finalizeWrites() {
+      simI2CFinalizeWrites();
+    }
+};
@@ -0,0 +1,44 @@
+#pragma once
+
+// Romi 32U4 board API, backed by the simulated hardware in sim_hal.h
+
+#include <Arduino.h>
+#include "Romi32U4Buzzer.h"
+
+class Romi32U4Motors {
+  public:
+    static void flipLeftMotor(bool flip) {}
+    static void flipRightMotor(bool flip);
+    static void setLeftSpeed(int16_t speed);
+    static void setRightSpeed(int16_t speed);
+    static void setSpeeds(int16_t leftSpeed, int16_t rightSpeed);
+};
+
+class Romi32U4Encoders {
+  public:
+    static int16_t getCountsLeft();
+    static int16_t getCountsRight();
+    static int16_t getCountsAndResetLeft();
+    static int16_t getCountsAndResetRight();
+};
+
+class Romi32U4ButtonA {
+  public:
+    bool isPressed();
+};
+
+class Romi32U4ButtonB {
+  public:
+    bool isPressed();
+};
+
+class Romi32U4ButtonC {
+  public:
+    bool isPressed();
+};
+
+void ledYellow(bool on);
+void ledGreen(bool on);
+void ledRed(bool on);
+
+uint16_t readBatteryMillivolts();
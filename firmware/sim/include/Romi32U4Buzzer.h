@@ -0,0 +1,19 @@
+#pragma once
+
+#include <stdint.h>
+#include <avr/pgmspace.h>
+
+#define PLAY_AUTOMATIC 0
+#define PLAY_CHECK 1
+
+// Tunes finish as soon as they start, so the init tunes don't hold up
+// setup()
+class Romi32U4Buzzer {
+  public:
+    static void play(const char* notes) {}
+    static void playFromProgramSpace(const char* notes) {}
+    static void playMode(uint8_t mode) {}
+    static bool playCheck() { return false; }
+    static bool isPlaying() { return false; }
+    static void stopPlaying() {}
+};
@@ -0,0 +1,21 @@
+#pragma once
+
+// Servo API, backed by the simulated hardware in sim_hal.h
+
+#include <stdint.h>
+
+class Servo {
+  public:
+    Servo();
+
+    uint8_t attach(int pin);
+    void detach();
+    bool attached();
+
+    void write(int value);
+    void writeMicroseconds(int value);
+
+  private:
+    uint8_t _index;
+    int _pin;
+};
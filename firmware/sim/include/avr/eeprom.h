@@ -0,0 +1,28 @@
+#pragma once
+
+// The simulated EEPROM starts out erased on every run, like a fresh board
+
+#include <stdint.h>
+#include <string.h>
+
+#define E2END 0x3FF
+
+static inline uint8_t* simEepromCell(const uint8_t* addr) {
+  static uint8_t cells[E2END + 1];
+  static bool erased = false;
+
+  if (!erased) {
+    memset(cells, 0xFF, sizeof(cells));
+    erased = true;
+  }
+
+  return &cells[(uintptr_t)addr & E2END];
+}
+
+static inline uint8_t eeprom_read_byte(const uint8_t* addr) {
+  return *simEepromCell(addr);
+}
+
+static inline void eeprom_update_byte(uint8_t* addr, uint8_t value) {
+  *simEepromCell(addr) = value;
+}
@@ -0,0 +1,12 @@
+#pragma once
+
+#include <avr/io.h>
+
+// There are no interrupts in the simulator. Handlers are compiled as
+// plain functions, and never called
+#define ISR(vector) extern "C" void vector(void)
+
+static inline void cli() {}
+static inline void sei() {}
+static inline void noInterrupts() {}
+static inline void interrupts() {}
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <stdint.h>
+
+// Just the reset and watchdog registers the firmware touches
+
+extern volatile uint8_t MCUSR;
+extern volatile uint8_t WDTCSR;
+
+#define PORF 0
+#define EXTRF 1
+#define BORF 2
+#define WDRF 3
+#define WDE 3
+#define WDIE 6
+
+#define _BV(bit) (1 << (bit))
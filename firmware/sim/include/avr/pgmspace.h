@@ -0,0 +1,4 @@
+#pragma once
+
+// Flash and RAM share one address space here
+#define PROGMEM
@@ -0,0 +1,17 @@
+#pragma once
+
+// The watchdog never fires in the simulator, since loop() can't stall in
+// simulated time
+
+#define WDTO_15MS 0
+#define WDTO_30MS 1
+#define WDTO_60MS 2
+#define WDTO_120MS 3
+#define WDTO_250MS 4
+#define WDTO_500MS 5
+#define WDTO_1S 6
+#define WDTO_2S 7
+
+static inline void wdt_enable(uint8_t timeout) {}
+static inline void wdt_reset() {}
+static inline void wdt_disable() {}
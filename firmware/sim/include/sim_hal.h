@@ -0,0 +1,50 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+// Simulated Romi 32U4 hardware, for running the firmware natively
+//
+// The Arduino and Pololu APIs in this directory are implemented on top of
+// this state. Time only moves when the host advances the simulated clock
+// (see sim_main.cpp), so a run is fully repeatable
+
+static constexpr uint8_t kSimNumPins = 32;
+static constexpr uint8_t kSimNumServos = 5;
+
+struct SimHardware {
+  uint64_t micros;
+
+  uint16_t batteryMillivolts;
+  int16_t leftEncoder;
+  int16_t rightEncoder;
+  bool buttonA;
+  bool buttonB;
+  bool buttonC;
+
+  int16_t leftMotor;
+  int16_t rightMotor;
+  bool rightMotorFlipped;
+  bool ledYellow;
+  bool ledGreen;
+  bool ledRed;
+
+  uint8_t pinModes[kSimNumPins];
+  bool pinOutputs[kSimNumPins];
+  bool pinInputs[kSimNumPins];
+  uint16_t analogInputs[kSimNumPins];
+
+  // Latest servo write (in degrees), or -1 if detached
+  int16_t servos[kSimNumServos];
+};
+
+extern SimHardware simHardware;
+
+void simHardwareReset();
+
+// The I2C shared buffer, as seen by the bus master (see PololuRPiSlave.h)
+void simI2CAttach(uint8_t* buffer, size_t size);
+void simI2CUpdateBuffer();
+void simI2CFinalizeWrites();
+bool simI2CRead(uint8_t offset, uint8_t length, uint8_t* out);
+bool simI2CWrite(uint8_t offset, uint8_t length, const uint8_t* data);
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <stdint.h>
+
+// Same as the avr-libc version
+static inline uint8_t _crc8_ccitt_update(uint8_t crc, uint8_t data) {
+  uint8_t value = crc ^ data;
+  for (uint8_t i = 0; i < 8; i++) {
+    value = (value & 0x80) ? ((value << 1) ^ 0x07) : (value << 1);
+  }
+
+  return value;
+}
@@ -0,0 +1,247 @@
+#include <Arduino.h>
+#include <Romi32U4.h>
+#include <ServoT3.h>
+#include <avr/io.h>
+
+#include "sim_hal.h"
+
+// The real motor driver tops out at 300
+static constexpr int16_t kMaxMotorSpeed = 300;
+
+SimHardware simHardware;
+SimSerial Serial;
+
+// captureMcusr() never runs in the simulator (there's no .init3), so the
+// reported reset cause is always 0
+volatile uint8_t MCUSR = 0;
+volatile uint8_t WDTCSR = 0;
+
+void simHardwareReset() {
+  memset(&simHardware, 0, sizeof(simHardware));
+  simHardware.batteryMillivolts = 7400;
+
+  for (uint8_t pin = 0; pin < kSimNumPins; pin++) {
+    // Unconnected inputs float high with the pullups on
+    simHardware.pinInputs[pin] = true;
+  }
+
+  for (uint8_t i = 0; i < kSimNumServos; i++) {
+    simHardware.servos[i] = -1;
+  }
+}
+
+// I2C shared buffer
+// ------------------------------------------------------------------------
+// The master sees the staging copy. Bytes it writes are held there (and
+// masked off from finalizeWrites()) until the firmware picks them up
+
+static constexpr size_t kMaxBufferSize = 256;
+
+static uint8_t* linkBuffer = nullptr;
+static size_t linkBufferSize = 0;
+static uint8_t staging[kMaxBufferSize];
+static bool pendingWrite[kMaxBufferSize];
+
+void simI2CAttach(uint8_t* buffer, size_t size) {
+  linkBuffer = buffer;
+  linkBufferSize = size < kMaxBufferSize ? size : kMaxBufferSize;
+  memset(staging, 0, sizeof(staging));
+  memset(pendingWrite, 0, sizeof(pendingWrite));
+}
+
+void simI2CUpdateBuffer() {
+  for (size_t i = 0; i < linkBufferSize; i++) {
+    if (pendingWrite[i]) {
+      linkBuffer[i] = staging[i];
+      pendingWrite[i] = false;
+    }
+  }
+}
+
+void simI2CFinalizeWrites() {
+  for (size_t i = 0; i < linkBufferSize; i++) {
+    if (!pendingWrite[i]) {
+      staging[i] = linkBuffer[i];
+    }
+  }
+}
+
+bool simI2CRead(uint8_t offset, uint8_t length, uint8_t* out) {
+  if (offset + length > linkBufferSize) {
+    return false;
+  }
+
+  memcpy(out, &staging[offset], length);
+  return true;
+}
+
+bool simI2CWrite(uint8_t offset, uint8_t length, const uint8_t* data) {
+  if (offset + length > linkBufferSize) {
+    return false;
+  }
+
+  memcpy(&staging[offset], data, length);
+  memset(&pendingWrite[offset], 1, length);
+  return true;
+}
+
+// Arduino core
+// ------------------------------------------------------------------------
+
+unsigned long millis() {
+  return (unsigned long)(simHardware.micros / 1000);
+}
+
+unsigned long micros() {
+  return (unsigned long)simHardware.micros;
+}
+
+void delay(unsigned long ms) {
+  simHardware.micros += (uint64_t)ms * 1000;
+}
+
+void delayMicroseconds(unsigned int us) {
+  simHardware.micros += us;
+}
+
+void pinMode(uint8_t pin, uint8_t mode) {
+  if (pin < kSimNumPins) {
+    simHardware.pinModes[pin] = mode;
+  }
+}
+
+void digitalWrite(uint8_t pin, uint8_t value) {
+  if (pin < kSimNumPins) {
+    simHardware.pinOutputs[pin] = value != LOW;
+  }
+}
+
+int digitalRead(uint8_t pin) {
+  if (pin >= kSimNumPins) {
+    return LOW;
+  }
+
+  if (simHardware.pinModes[pin] == OUTPUT) {
+    return simHardware.pinOutputs[pin] ? HIGH : LOW;
+  }
+
+  return simHardware.pinInputs[pin] ? HIGH : LOW;
+}
+
+int analogRead(uint8_t pin) {
+  return pin < kSimNumPins ? simHardware.analogInputs[pin] : 0;
+}
+
+long map(long x, long inMin, long inMax, long outMin, long outMax) {
+  return (x - inMin) * (outMax - outMin) / (inMax - inMin) + outMin;
+}
+
+// Romi 32U4
+// ------------------------------------------------------------------------
+
+static int16_t clampSpeed(int16_t speed) {
+  return constrain<int16_t>(speed, -kMaxMotorSpeed, kMaxMotorSpeed);
+}
+
+void Romi32U4Motors::flipRightMotor(bool flip) {
+  simHardware.rightMotorFlipped = flip;
+}
+
+void Romi32U4Motors::setLeftSpeed(int16_t speed) {
+  simHardware.leftMotor = clampSpeed(speed);
+}
+
+void Romi32U4Motors::setRightSpeed(int16_t speed) {
+  simHardware.rightMotor = clampSpeed(speed);
+}
+
+void Romi32U4Motors::setSpeeds(int16_t leftSpeed, int16_t rightSpeed) {
+  setLeftSpeed(leftSpeed);
+  setRightSpeed(rightSpeed);
+}
+
+int16_t Romi32U4Encoders::getCountsLeft() {
+  return simHardware.leftEncoder;
+}
+
+int16_t Romi32U4Encoders::getCountsRight() {
+  return simHardware.rightEncoder;
+}
+
+int16_t Romi32U4Encoders::getCountsAndResetLeft() {
+  int16_t counts = simHardware.leftEncoder;
+  simHardware.leftEncoder = 0;
+  return counts;
+}
+
+int16_t Romi32U4Encoders::getCountsAndResetRight() {
+  int16_t counts = simHardware.rightEncoder;
+  simHardware.rightEncoder = 0;
+  return counts;
+}
+
+bool Romi32U4ButtonA::isPressed() {
+  return simHardware.buttonA;
+}
+
+bool Romi32U4ButtonB::isPressed() {
+  return simHardware.buttonB;
+}
+
+bool Romi32U4ButtonC::isPressed() {
+  return simHardware.buttonC;
+}
+
+void ledYellow(bool on) {
+  simHardware.ledYellow = on;
+}
+
+void ledGreen(bool on) {
+  simHardware.ledGreen = on;
+}
+
+void ledRed(bool on) {
+  simHardware.ledRed = on;
+}
+
+uint16_t readBatteryMillivolts() {
+  return simHardware.batteryMillivolts;
+}
+
+// Servos
+// ------------------------------------------------------------------------
+// Servos are numbered in the order they're constructed, which matches
+// the IO channel order of the pwms array in main.cpp
+
+static uint8_t servoCount = 0;
+
+Servo::Servo() : _index(servoCount++), _pin(-1) {}
+
+uint8_t Servo::attach(int pin) {
+  _pin = pin;
+  if (_index < kSimNumServos) {
+    simHardware.servos[_index] = 90;
+  }
+  return _index;
+}
+
+void Servo::detach() {
+  _pin = -1;
+  if (_index < kSimNumServos) {
+    simHardware.servos[_index] = -1;
+  }
+}
+
+bool Servo::attached() {
+  return _pin >= 0;
+}
+
+void Servo::write(int value) {
+  if (attached() && _index < kSimNumServos) {
+    simHardware.servos[_index] = constrain(value, 0, 180);
+  }
+}
+
+void Servo::writeMicroseconds(int value) {
+  write(map(value, 544, 2400, 0, 180));
+}
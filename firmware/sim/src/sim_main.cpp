@@ -0,0 +1,231 @@
+#include <Arduino.h>
+#include <stdio.h>
+
+#include "sim_hal.h"
+#include "shmem_buffer.h"
+
+// The host addresses the buffer by the offsets in sharedmem.json
+static_assert(offsetof(Data, telemetryCrc) == TELEMETRY_CRC_START + TELEMETRY_CRC_LENGTH,
+              "Shared buffer layout doesn't match sharedmem.json");
+
+// Host protocol
+// ------------------------------------------------------------------------
+// The host drives the simulator over stdin/stdout with binary requests.
+// Every request gets a status byte back (0 on success), followed by any
+// response data. All values are little endian
+//
+//   'R' offset:u8 length:u8             -> status, data[length]
+//   'W' offset:u8 length:u8 data[length] -> status
+//   'A' us:u32                           -> status
+//       Advance the simulated clock, running loop() once per loop period
+//   'I' id:u8 value:i32                  -> status
+//       Set a simulated input (see SimInput)
+//   'O'                                  -> status, outputs
+//       leftMotor:i16 rightMotor:i16 leds:u8 (yellow, green, red bits)
+//       servos:i16[5] (-1 if detached) pinLevels:u32 millis:u32
+//   'L' us:u32                           -> status
+//       Set the loop period
+
+enum SimInput : uint8_t {
+  kSimInputBatteryMillivolts = 0,
+  // Encoder inputs are added to the current counts
+  kSimInputLeftEncoderTicks = 1,
+  kSimInputRightEncoderTicks = 2,
+  kSimInputButtonA = 3,
+  kSimInputButtonB = 4,
+  kSimInputButtonC = 5,
+  // Per pin, with the pin number added
+  kSimInputAnalogPin = 0x20,
+  kSimInputDigitalPin = 0x40
+};
+
+static constexpr uint8_t kStatusOk = 0;
+static constexpr uint8_t kStatusError = 1;
+
+// The real loop() takes a few hundred microseconds, mostly waiting on
+// the I2C buffer and the analog reads
+static uint32_t loopPeriodUs = 500;
+static uint64_t nextLoopUs = 0;
+
+void setup();
+void loop();
+
+static bool readBytes(uint8_t* data, size_t length) {
+  return fread(data, 1, length, stdin) == length;
+}
+
+static bool readU32(uint32_t* value) {
+  uint8_t data[4];
+  if (!readBytes(data, sizeof(data))) {
+    return false;
+  }
+
+  *value = (uint32_t)data[0] | ((uint32_t)data[1] << 8) |
+           ((uint32_t)data[2] << 16) | ((uint32_t)data[3] << 24);
+  return true;
+}
+
+static void putU16(uint8_t* out, uint16_t value) {
+  out[0] = value & 0xFF;
+  out[1] = (value >> 8) & 0xFF;
+}
+
+static void putU32(uint8_t* out, uint32_t value) {
+  putU16(out, value & 0xFFFF);
+  putU16(out + 2, (value >> 16) & 0xFFFF);
+}
+
+static void respond(uint8_t status, const uint8_t* data = nullptr, size_t length = 0) {
+  fwrite(&status, 1, 1, stdout);
+  if (status == kStatusOk && length > 0) {
+    fwrite(data, 1, length, stdout);
+  }
+  fflush(stdout);
+}
+
+static void advance(uint32_t us) {
+  uint64_t endUs = simHardware.micros + us;
+  while (nextLoopUs <= endUs) {
+    simHardware.micros = nextLoopUs;
+    loop();
+    nextLoopUs += loopPeriodUs;
+  }
+
+  simHardware.micros = endUs;
+}
+
+static bool setInput(uint8_t id, int32_t value) {
+  if (id >= kSimInputDigitalPin && id < kSimInputDigitalPin + kSimNumPins) {
+    simHardware.pinInputs[id - kSimInputDigitalPin] = value != 0;
+    return true;
+  }
+
+  if (id >= kSimInputAnalogPin && id < kSimInputAnalogPin + kSimNumPins) {
+    simHardware.analogInputs[id - kSimInputAnalogPin] = constrain<int32_t>(value, 0, 1023);
+    return true;
+  }
+
+  switch (id) {
+    case kSimInputBatteryMillivolts:
+      simHardware.batteryMillivolts = constrain<int32_t>(value, 0, 0xFFFF);
+      return true;
+    case kSimInputLeftEncoderTicks:
+      simHardware.leftEncoder = (int16_t)(uint16_t)(simHardware.leftEncoder + value);
+      return true;
+    case kSimInputRightEncoderTicks:
+      simHardware.rightEncoder = (int16_t)(uint16_t)(simHardware.rightEncoder + value);
+      return true;
+    case kSimInputButtonA:
+      simHardware.buttonA = value != 0;
+      return true;
+    case kSimInputButtonB:
+      simHardware.buttonB = value != 0;
+      return true;
+    case kSimInputButtonC:
+      simHardware.buttonC = value != 0;
+      return true;
+  }
+
+  return false;
+}
+
+static void sendOutputs() {
+  uint8_t out[2 + 2 + 1 + (2 * kSimNumServos) + 4 + 4];
+  uint8_t* pos = out;
+
+  putU16(pos, simHardware.leftMotor);
+  pos += 2;
+  putU16(pos, simHardware.rightMotor);
+  pos += 2;
+
+  *pos++ = (simHardware.ledYellow ? 0x01 : 0) |
+           (simHardware.ledGreen ? 0x02 : 0) |
+           (simHardware.ledRed ? 0x04 : 0);
+
+  for (uint8_t i = 0; i < kSimNumServos; i++) {
+    putU16(pos, simHardware.servos[i]);
+    pos += 2;
+  }
+
+  uint32_t pinLevels = 0;
+  for (uint8_t pin = 0; pin < kSimNumPins; pin++) {
+    if (digitalRead(pin)) {
+      pinLevels |= (1UL << pin);
+    }
+  }
+  putU32(pos, pinLevels);
+  pos += 4;
+
+  putU32(pos, millis());
+
+  respond(kStatusOk, out, sizeof(out));
+}
+
+int main() {
+  simHardwareReset();
+  setup();
+
+  // setup() may have moved the clock on (delay()), so start looping from
+  // wherever it left off
+  nextLoopUs = simHardware.micros;
+
+  int request;
+  while ((request = fgetc(stdin)) != EOF) {
+    switch (request) {
+      case 'R': {
+        uint8_t header[2];
+        uint8_t data[256];
+        if (!readBytes(header, sizeof(header))) {
+          return 0;
+        }
+        bool ok = simI2CRead(header[0], header[1], data);
+        respond(ok ? kStatusOk : kStatusError, data, header[1]);
+      } break;
+      case 'W': {
+        uint8_t header[2];
+        uint8_t data[256];
+        if (!readBytes(header, sizeof(header)) || !readBytes(data, header[1])) {
+          return 0;
+        }
+        respond(simI2CWrite(header[0], header[1], data) ? kStatusOk : kStatusError);
+      } break;
+      case 'A': {
+        uint32_t us;
+        if (!readU32(&us)) {
+          return 0;
+        }
+        advance(us);
+        respond(kStatusOk);
+      } break;
+      case 'I': {
+        uint8_t id;
+        uint32_t value;
+        if (!readBytes(&id, 1) || !readU32(&value)) {
+          return 0;
+        }
+        respond(setInput(id, (int32_t)value) ? kStatusOk : kStatusError);
+      } break;
+      case 'O': {
+        sendOutputs();
+      } break;
+      case 'L': {
+        uint32_t us;
+        if (!readU32(&us)) {
+          return 0;
+        }
+        if (us == 0) {
+          respond(kStatusError);
+          break;
+        }
+        loopPeriodUs = us;
+        respond(kStatusOk);
+      } break;
+      default:
+        // Out of sync with the host, and no way to recover
+        fprintf(stderr, "sim: unknown request 0x%02X\n", request);
+        return 1;
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,64 @@
+#include "analog_filter.h"
+
+void AnalogFilter::configure(uint8_t config) {
+  if (config == _config) {
+    return;
+  }
+
+  _config = config;
+
+  _oversampleBits = config & 0x7;
+  if (_oversampleBits > kMaxOversampleBits) {
+    _oversampleBits = kMaxOversampleBits;
+  }
+
+  _filterShift = (config >> 4) & 0x7;
+
+  reset();
+}
+
+void AnalogFilter::reset() {
+  _numSamples = 0;
+  _accumulator = 0;
+  _filterState = 0;
+  _hasValue = false;
+}
+
+bool AnalogFilter::addSample(uint16_t sample) {
+  _accumulator += sample;
+  _numSamples++;
+
+  // Decimate once we have 4^n samples
+  if (_numSamples < (1 << (2 * _oversampleBits))) {
+    return false;
+  }
+
+  // Summing 4^n samples and shifting right by n yields 10+n bits of
+  // resolution. Shifting that left by (6-n) lines it up with the
+  // 10.6 output format, so the two shifts collapse into one
+  uint32_t decimated = _accumulator << (kAnalogFractionalBits - (2 * _oversampleBits));
+
+  _accumulator = 0;
+  _numSamples = 0;
+
+  int32_t input = (int32_t)decimated << 8;
+  if (!_hasValue || _filterShift == 0) {
+    // Prime the filter with the first value so it doesn't ramp up from 0
+    _filterState = input;
+    _hasValue = true;
+  }
+  else {
+    _filterState += (input - _filterState) >> _filterShift;
+  }
+
+  return true;
+}
+
+uint16_t AnalogFilter::value() const {
+  return (uint16_t)(_filterState >> 8);
+}
+
+uint16_t AnalogFilter::rawValue() const {
+  // Round to the nearest ADC count
+  return (uint16_t)((_filterState + ((int32_t)1 << (7 + kAnalogFractionalBits))) >> (8 + kAnalogFractionalBits));
+}
@@ -0,0 +1,35 @@
+#include "i2c_address.h"
+#include <avr/eeprom.h>
+
+// The offset is stored alongside its complement, so that an erased
+// EEPROM (all 0xFF) or a half finished write reads back as no offset
+static uint8_t* const kEepromOffset = (uint8_t*)0;
+static uint8_t* const kEepromOffsetCheck = (uint8_t*)1;
+
+static uint8_t currentOffset = 0;
+
+uint8_t I2CAddress::begin(bool advance) {
+  uint8_t stored = eeprom_read_byte(kEepromOffset);
+  uint8_t check = eeprom_read_byte(kEepromOffsetCheck);
+
+  currentOffset = 0;
+  if ((uint8_t)~stored == check && stored <= kMaxI2CAddressOffset) {
+    currentOffset = stored;
+  }
+
+  if (advance) {
+    currentOffset = (currentOffset + 1) % (kMaxI2CAddressOffset + 1);
+    eeprom_update_byte(kEepromOffset, currentOffset);
+    eeprom_update_byte(kEepromOffsetCheck, ~currentOffset);
+  }
+
+  return address();
+}
+
+uint8_t I2CAddress::address() {
+  return ROMI_I2C_ADDRESS + currentOffset;
+}
+
+uint8_t I2CAddress::offset() {
+  return currentOffset;
+}
@@ -6,6 +6,12 @@
 
 #include "shmem_buffer.h"
 #include "low_voltage_helper.h"
+#include "analog_filter.h"
+#include "motor_ramp.h"
+#include "watchdog_supervisor.h"
+#include "motion_profile.h"
+#include "shmem_crc.h"
+#include "i2c_address.h"
 
 static constexpr int kModeDigitalOut = 0;
 static constexpr int kModeDigitalIn = 1;
@@ -24,10 +30,18 @@ static constexpr int kModePwm = 3;
 
 static constexpr int kMaxBuiltInDIO = 8;
 
+// commandFlags bits
+// The host sets this when the robot is enabled, so that applying the
+// block also refreshes the heartbeat
+static constexpr uint8_t kCommandFlagHeartbeat = 0x01;
+
 // Set up the servos
 Servo pwms[5];
 
 Romi32U4Motors motors;
+MotorRamp leftMotorRamp;
+MotorRamp rightMotorRamp;
+MotionProfile motionProfile;
 Romi32U4Encoders encoders;
 Romi32U4ButtonA buttonA;
 Romi32U4ButtonB buttonB;
@@ -45,12 +59,30 @@ uint8_t ioChannelModes[5] = {kModeDigitalOut, kModeDigitalOut, kModeDigitalOut,
 uint8_t ioDioPins[5] = {11, 4, 20, 21, 22};
 uint8_t ioAinPins[5] = {0, A6, A2, A3, A4};
 
+AnalogFilter analogFilters[5];
+
+// Outputs from the last command block that passed its CRC check
+int16_t leftMotorCommand = 0;
+int16_t rightMotorCommand = 0;
+int16_t extIoOutputs[5] = {0, 0, 0, 0, 0};
+uint8_t lastRejectedCommandSeq = 0;
+
 LowVoltageHelper lvHelper;
 
 bool isTestMode = false;
 bool isConfigured = false;
 
-unsigned long lastHeartbeat = 0;
+unsigned long lastMotorRampUpdate = 0;
+unsigned long lastMotionProfileUpdate = 0;
+
+// Played at power up when the I2C address changes, one beep per step
+// above the base address
+static const char* const kAddressTunes[kMaxI2CAddressOffset + 1] = {
+  "!L16 v10 c",
+  "!L16 v10 crc",
+  "!L16 v10 crcrc",
+  "!L16 v10 crcrcrc"
+};
 
 bool testModeLedFlag = false;
 unsigned long lastSwitchTime = 0;
@@ -129,6 +161,7 @@ void configureIO(uint16_t config) {
           digitalWrite(ioAinPins[ioChannel], LOW);
           pinMode(ioAinPins[ioChannel], INPUT);
         }
+        analogFilters[ioChannel].reset();
         break;
     }
   }
@@ -141,6 +174,34 @@ void configureIO(uint16_t config) {
   rPiLink.buffer.ioConfig = 0;
 }
 
+// Apply a new command block from the host, if there is one. Blocks that
+// fail the CRC check are ignored (and counted once per sequence number)
+// until the host sends a valid one. Returns true if a block was applied
+bool processCommandBlock() {
+  uint8_t seq = rPiLink.buffer.commandSeq;
+  if (seq == rPiLink.buffer.commandAck) {
+    return false;
+  }
+
+  uint8_t crc = shmemCrc8(&rPiLink.buffer, COMMAND_CRC_START, COMMAND_CRC_LENGTH);
+  if (crc != rPiLink.buffer.commandCrc) {
+    if (seq != lastRejectedCommandSeq) {
+      lastRejectedCommandSeq = seq;
+      rPiLink.buffer.commandCrcErrors++;
+    }
+    return false;
+  }
+
+  leftMotorCommand = rPiLink.buffer.leftMotor;
+  rightMotorCommand = rPiLink.buffer.rightMotor;
+  for (uint8_t i = 0; i < 5; i++) {
+    extIoOutputs[i] = rPiLink.buffer.extIoOutputs[i];
+  }
+
+  rPiLink.buffer.commandAck = seq;
+  return true;
+}
+
 // Initialization routines for test mode
 void testModeInit() {
   buzzer.play("!L16 v10 cdefgab>c");
@@ -227,20 +288,31 @@ void normalModeLoop() {
   // Play the LV alert tune if we're in a low voltage state
   lvHelper.lowVoltageAlertCheck();
 
+  // A valid command block sent while enabled doubles as a heartbeat, so
+  // the host only needs separate heartbeat writes when it's idle
+  if (processCommandBlock() && (rPiLink.buffer.commandFlags & kCommandFlagHeartbeat)) {
+    WatchdogSupervisor::heartbeat();
+  }
+
   // Shutdown motors if in low voltage mode
+  bool motorsDisabled = false;
   if (lvHelper.isLowVoltage()) {
-    rPiLink.buffer.leftMotor = 0;
-    rPiLink.buffer.rightMotor = 0;
+    leftMotorCommand = 0;
+    rightMotorCommand = 0;
+    motorsDisabled = true;
   }
 
   // Check heartbeat and shutdown motors if necessary
-  if (millis() - lastHeartbeat > 1000) {
-    rPiLink.buffer.leftMotor = 0;
-    rPiLink.buffer.rightMotor = 0;
+  WatchdogSupervisor::setHeartbeatTimeout(rPiLink.buffer.heartbeatTimeoutMs);
+  bool heartbeatLost = WatchdogSupervisor::isHeartbeatLost();
+  if (heartbeatLost) {
+    leftMotorCommand = 0;
+    rightMotorCommand = 0;
+    motorsDisabled = true;
   }
 
   if (rPiLink.buffer.heartbeat) {
-    lastHeartbeat = millis();
+    WatchdogSupervisor::heartbeat();
     rPiLink.buffer.heartbeat = false;
   }
 
@@ -272,25 +344,52 @@ void normalModeLoop() {
     ledRed(rPiLink.buffer.builtinDioValues[2]);
   }
 
+  // Report the built-ins as a bitmask in the telemetry block, so the host
+  // picks them up with everything else instead of reading each one
+  uint8_t builtinDioInputs = 0;
+  for (uint8_t i = 0; i < 4; i++) {
+    if (rPiLink.buffer.builtinDioValues[i]) {
+      builtinDioInputs |= (1 << i);
+    }
+  }
+  rPiLink.buffer.builtinDioInputs = builtinDioInputs;
+
   // Loop through all available IO pins
   for (uint8_t i = 0; i < 5; i++) {
+    // Outputs switch over to their safe values (if set) when the heartbeat
+    // is lost. This doesn't touch the last command, so it is picked up
+    // again once the heartbeat returns
+    int16_t outputValue = extIoOutputs[i];
+    if (heartbeatLost && rPiLink.buffer.extIoSafeValues[i] != kSafeValueHold) {
+      outputValue = rPiLink.buffer.extIoSafeValues[i];
+    }
+
     switch (ioChannelModes[i]) {
       case kModeDigitalOut: {
-        digitalWrite(ioDioPins[i], rPiLink.buffer.extIoValues[i] ? HIGH : LOW);
+        digitalWrite(ioDioPins[i], outputValue ? HIGH : LOW);
+        rPiLink.buffer.extIoValues[i] = outputValue;
       } break;
       case kModeDigitalIn: {
         rPiLink.buffer.extIoValues[i] = digitalRead(ioDioPins[i]);
       } break;
       case kModeAnalogIn: {
         if (ioAinPins[i] != 0) {
-          rPiLink.buffer.extIoValues[i] = analogRead(ioAinPins[i]);
+          // Sample every loop and let the filter decimate down to the
+          // requested resolution. extIoValues keeps reporting plain
+          // 10-bit counts, while analog has the full 10.6 value
+          analogFilters[i].configure(rPiLink.buffer.analogConfig[i]);
+          if (analogFilters[i].addSample(analogRead(ioAinPins[i]))) {
+            rPiLink.buffer.extIoValues[i] = analogFilters[i].rawValue();
+            rPiLink.buffer.analog[i] = analogFilters[i].value();
+          }
         }
       } break;
       case kModePwm: {
         // Only allow writes to PWM if we're not currently locked out due to low voltage
         if (pwms[i].attached()) {
+          rPiLink.buffer.extIoValues[i] = outputValue;
           if (!lvHelper.isLowVoltage()) {
-            pwms[i].write(map(rPiLink.buffer.extIoValues[i], -400, 400, 0, 180));
+            pwms[i].write(map(outputValue, -400, 400, 0, 180));
           }
           else {
             // Attempt to zero out servo-motors in a low voltage mode
@@ -301,28 +400,112 @@ void normalModeLoop() {
     }
   }
 
-  // Motors
-  motors.setSpeeds(rPiLink.buffer.leftMotor, rPiLink.buffer.rightMotor);
-
   // Encoders
+  // Encoder resets are folded into the motion profile's start positions
+  // so that a reset during a move doesn't throw it off
   if (rPiLink.buffer.resetLeftEncoder) {
     rPiLink.buffer.resetLeftEncoder = false;
-    encoders.getCountsAndResetLeft();
+    motionProfile.onLeftEncoderReset(encoders.getCountsAndResetLeft());
   }
 
   if (rPiLink.buffer.resetRightEncoder) {
     rPiLink.buffer.resetRightEncoder = false;
-    encoders.getCountsAndResetRight();
+    motionProfile.onRightEncoderReset(encoders.getCountsAndResetRight());
+  }
+
+  int16_t leftCounts = encoders.getCountsLeft();
+  int16_t rightCounts = encoders.getCountsRight();
+
+  // Motion profiles
+  uint8_t motionCommand = rPiLink.buffer.motionCommand;
+  if (motionCommand != kMotionCommandNone) {
+    rPiLink.buffer.motionCommand = kMotionCommandNone;
+
+    if (motionCommand == kMotionCommandCancel) {
+      motionProfile.cancel();
+    }
+    else if (motionCommand == kMotionCommandDrive || motionCommand == kMotionCommandTurn) {
+      motionProfile.start(motionCommand,
+                          rPiLink.buffer.motionDistance,
+                          rPiLink.buffer.motionMaxVelocity,
+                          rPiLink.buffer.motionMaxAccel,
+                          leftCounts, rightCounts);
+      lastMotionProfileUpdate = micros() - kMotionProfilePeriodUs;
+    }
+  }
+
+  // The same safety shutdowns that stop the motors also abort a move
+  if (motorsDisabled && motionProfile.isRunning()) {
+    motionProfile.abort();
+  }
+
+  bool motionProfileActive = motionProfile.isRunning();
+  if (motionProfileActive && micros() - lastMotionProfileUpdate >= kMotionProfilePeriodUs) {
+    lastMotionProfileUpdate += kMotionProfilePeriodUs;
+    motionProfile.update(millis(), leftCounts, rightCounts);
+  }
+
+  rPiLink.buffer.motionState = motionProfile.state();
+  rPiLink.buffer.motionProgress = motionProfile.progress();
+
+  // Motors
+  // Safety shutdowns skip the ramp and stop immediately. Otherwise, slew
+  // towards the latest host setpoint on a fixed period so that steps
+  // between host updates get spread out. A running motion profile owns
+  // the motors and limits its own acceleration, so it bypasses the ramp
+  leftMotorRamp.setRate(rPiLink.buffer.motorSlewRate);
+  rightMotorRamp.setRate(rPiLink.buffer.motorSlewRate);
+
+  if (motorsDisabled) {
+    leftMotorRamp.reset(0);
+    rightMotorRamp.reset(0);
+  }
+  else if (motionProfileActive) {
+    // Host motor commands are dropped for the duration of the move, and
+    // the motors are left stopped once it finishes
+    leftMotorCommand = 0;
+    rightMotorCommand = 0;
+    // Like the WPILib Romi drivetrain, the right motor runs inverted
+    // relative to its encoder
+    leftMotorRamp.reset(motionProfile.leftOutput());
+    rightMotorRamp.reset(-motionProfile.rightOutput());
+  }
+  else {
+    leftMotorRamp.setTarget(leftMotorCommand);
+    rightMotorRamp.setTarget(rightMotorCommand);
   }
 
-  rPiLink.buffer.leftEncoder = encoders.getCountsLeft();
-  rPiLink.buffer.rightEncoder = encoders.getCountsRight();
+  unsigned long now = micros();
+  unsigned long elapsedUs = now - lastMotorRampUpdate;
+  if (elapsedUs >= kMotorRampPeriodUs) {
+    // Only advance by whole periods so the ramp rate stays exact
+    unsigned long numPeriods = elapsedUs / kMotorRampPeriodUs;
+    lastMotorRampUpdate += numPeriods * kMotorRampPeriodUs;
+
+    leftMotorRamp.update(numPeriods * kMotorRampPeriodUs);
+    rightMotorRamp.update(numPeriods * kMotorRampPeriodUs);
+  }
+
+  motors.setSpeeds(leftMotorRamp.output(), rightMotorRamp.output());
+
+  rPiLink.buffer.leftEncoder = leftCounts;
+  rPiLink.buffer.rightEncoder = rightCounts;
 
   rPiLink.buffer.batteryMillivolts = battMV;
 }
 
 void setup() {
-  rPiLink.init(20);
+  // Holding button C (on its own) at power up moves the board to its
+  // next I2C address, so that several boards can share one bus
+  bool advanceAddress = buttonC.isPressed() && !buttonA.isPressed() && !buttonB.isPressed();
+  rPiLink.init(I2CAddress::begin(advanceAddress));
+
+  if (advanceAddress) {
+    buzzer.play(kAddressTunes[I2CAddress::offset()]);
+    while(buzzer.playCheck()) {
+      // no-op to let the address sound finish
+    }
+  }
 
   // Set up the buzzer in playcheck mode
   buzzer.playMode(PLAY_CHECK);
@@ -342,14 +525,27 @@ void setup() {
   else {
     normalModeInit();
   }
+
+  // Outputs hold their last value on heartbeat loss until the host
+  // tells us otherwise
+  for (uint8_t i = 0; i < 5; i++) {
+    rPiLink.buffer.extIoSafeValues[i] = kSafeValueHold;
+  }
+  rPiLink.finalizeWrites();
+
+  // Start the watchdog last, since the init tunes block for a while
+  WatchdogSupervisor::begin();
 }
 
 void loop() {
+  WatchdogSupervisor::feed();
+
   // Get the latest data including recent i2c master writes
   rPiLink.updateBuffer();
 
-  // Constantly write the firmware ident
+  // Constantly write the firmware ident and reset cause
   rPiLink.buffer.firmwareIdent = FIRMWARE_IDENT;
+  rPiLink.buffer.resetCause = WatchdogSupervisor::resetCause();
 
   if (isConfigured) {
     rPiLink.buffer.status = 1;
@@ -362,5 +558,8 @@ void loop() {
     normalModeLoop();
   }
 
+  // Protect the telemetry block so the host can detect corrupted reads
+  rPiLink.buffer.telemetryCrc = shmemCrc8(&rPiLink.buffer, TELEMETRY_CRC_START, TELEMETRY_CRC_LENGTH);
+
   rPiLink.finalizeWrites();
 }
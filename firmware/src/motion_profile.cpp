@@ -0,0 +1,156 @@
+#include "motion_profile.h"
+#include <math.h>
+
+static constexpr int16_t kMaxMotorOutput = 400;
+
+void MotionProfile::start(uint8_t command, int16_t distanceTicks, uint16_t maxVelocity, uint16_t maxAccel,
+                          int16_t leftCounts, int16_t rightCounts) {
+  if (maxVelocity == 0 || maxAccel == 0) {
+    abort();
+    return;
+  }
+
+  _leftDirection = 1;
+  _rightDirection = (command == kMotionCommandTurn) ? -1 : 1;
+  _sign = (distanceTicks < 0) ? -1 : 1;
+
+  _leftStart = leftCounts;
+  _rightStart = rightCounts;
+
+  _distance = fabs((float)distanceTicks);
+  _accel = maxAccel;
+
+  // Trapezoidal if we can reach max velocity, triangular otherwise
+  _accelTime = (float)maxVelocity / _accel;
+  float accelDistance = 0.5f * _accel * _accelTime * _accelTime;
+
+  if (2 * accelDistance > _distance) {
+    _accelTime = sqrt(_distance / _accel);
+    accelDistance = _distance / 2;
+  }
+
+  _peakVelocity = _accel * _accelTime;
+  _cruiseTime = (_distance - (2 * accelDistance)) / _peakVelocity;
+  _totalTime = (2 * _accelTime) + _cruiseTime;
+
+  _startMs = 0;
+  _progress = 0;
+  _leftOutput = 0;
+  _rightOutput = 0;
+  _state = kMotionStateRunning;
+}
+
+void MotionProfile::cancel() {
+  if (_state == kMotionStateRunning) {
+    _state = kMotionStateAborted;
+  }
+  _leftOutput = 0;
+  _rightOutput = 0;
+}
+
+void MotionProfile::abort() {
+  cancel();
+  _state = kMotionStateAborted;
+}
+
+void MotionProfile::onLeftEncoderReset(int16_t countsBeforeReset) {
+  _leftStart -= countsBeforeReset;
+}
+
+void MotionProfile::onRightEncoderReset(int16_t countsBeforeReset) {
+  _rightStart -= countsBeforeReset;
+}
+
+bool MotionProfile::update(unsigned long nowMs, int16_t leftCounts, int16_t rightCounts) {
+  if (_state != kMotionStateRunning) {
+    return false;
+  }
+
+  if (_startMs == 0) {
+    _startMs = nowMs;
+  }
+
+  float t = (nowMs - _startMs) / 1000.0f;
+  float position, velocity;
+  setpointAt(t, position, velocity);
+
+  // Position of each wheel along the direction of travel. Differences are
+  // taken as int16_t so they survive the counters wrapping
+  int16_t left = (int16_t)(leftCounts - _leftStart) * _leftDirection * _sign;
+  int16_t right = (int16_t)(rightCounts - _rightStart) * _rightDirection * _sign;
+
+  _progress = (int16_t)(((int32_t)left + right) / 2) * _sign;
+
+  if (t >= _totalTime) {
+    bool inTolerance = abs(left - (int16_t)_distance) <= kMotionToleranceTicks &&
+                       abs(right - (int16_t)_distance) <= kMotionToleranceTicks;
+    if (inTolerance || (nowMs - _startMs) > (unsigned long)(_totalTime * 1000) + kMotionSettleTimeoutMs) {
+      _state = kMotionStateComplete;
+      _leftOutput = 0;
+      _rightOutput = 0;
+      return true;
+    }
+  }
+
+  _leftOutput = track(position, velocity, left) * _leftDirection * _sign;
+  _rightOutput = track(position, velocity, right) * _rightDirection * _sign;
+
+  return true;
+}
+
+void MotionProfile::setpointAt(float t, float& position, float& velocity) const {
+  if (t <= 0) {
+    position = 0;
+    velocity = 0;
+  }
+  else if (t < _accelTime) {
+    position = 0.5f * _accel * t * t;
+    velocity = _accel * t;
+  }
+  else if (t < _accelTime + _cruiseTime) {
+    position = (0.5f * _peakVelocity * _accelTime) + (_peakVelocity * (t - _accelTime));
+    velocity = _peakVelocity;
+  }
+  else if (t < _totalTime) {
+    float remaining = _totalTime - t;
+    position = _distance - (0.5f * _accel * remaining * remaining);
+    velocity = _accel * remaining;
+  }
+  else {
+    position = _distance;
+    velocity = 0;
+  }
+}
+
+int16_t MotionProfile::track(float position, float velocity, int16_t actual) const {
+  float output = (kMotionKv * velocity) + (kMotionKp * (position - actual));
+
+  if (output > kMaxMotorOutput) {
+    output = kMaxMotorOutput;
+  }
+  else if (output < -kMaxMotorOutput) {
+    output = -kMaxMotorOutput;
+  }
+
+  return (int16_t)output;
+}
+
+bool MotionProfile::isRunning() const {
+  return _state == kMotionStateRunning;
+}
+
+uint8_t MotionProfile::state() const {
+  return _state;
+}
+
+int16_t MotionProfile::progress() const {
+  return _progress;
+}
+
+int16_t MotionProfile::leftOutput() const {
+  return _leftOutput;
+}
+
+int16_t MotionProfile::rightOutput() const {
+  return _rightOutput;
+}
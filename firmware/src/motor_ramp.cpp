@@ -0,0 +1,45 @@
+#include "motor_ramp.h"
+
+void MotorRamp::setRate(uint16_t unitsPerSecond) {
+  _rate = unitsPerSecond;
+}
+
+void MotorRamp::setTarget(int16_t target) {
+  _target = target;
+
+  if (_rate == 0) {
+    _output = (int32_t)target * 1000;
+  }
+}
+
+void MotorRamp::reset(int16_t value) {
+  _target = value;
+  _output = (int32_t)value * 1000;
+}
+
+void MotorRamp::update(unsigned long elapsedUs) {
+  int32_t target = (int32_t)_target * 1000;
+
+  if (_rate == 0) {
+    _output = target;
+    return;
+  }
+
+  if (elapsedUs > kMotorRampMaxStepUs) {
+    elapsedUs = kMotorRampMaxStepUs;
+  }
+
+  // units/s * us / 1000 = thousandths of a unit
+  int32_t maxStep = (int32_t)(((uint32_t)_rate * elapsedUs) / 1000);
+
+  if (target > _output) {
+    _output = (target - _output > maxStep) ? _output + maxStep : target;
+  }
+  else if (target < _output) {
+    _output = (_output - target > maxStep) ? _output - maxStep : target;
+  }
+}
+
+int16_t MotorRamp::output() const {
+  return (int16_t)(_output / 1000);
+}
@@ -0,0 +1,13 @@
+#include "shmem_crc.h"
+#include <util/crc16.h>
+
+uint8_t shmemCrc8(const void* buffer, uint8_t start, uint8_t length) {
+  const uint8_t* bytes = static_cast<const uint8_t*>(buffer) + start;
+
+  uint8_t crc = 0;
+  for (uint8_t i = 0; i < length; i++) {
+    crc = _crc8_ccitt_update(crc, bytes[i]);
+  }
+
+  return crc;
+}
@@ -0,0 +1,86 @@
+#include "watchdog_supervisor.h"
+#include <Arduino.h>
+#include <avr/wdt.h>
+
+// The hardware watchdog first fires an interrupt (where we note that it
+// happened) and then resets the board on the following timeout. With
+// a 120ms period, a stalled loop() is reset after ~240ms
+static constexpr uint8_t kWatchdogPeriod = WDTO_120MS;
+
+static constexpr uint16_t kWatchdogMagic = 0xD06E;
+
+// These survive a reset. MCUSR is captured before main() runs, since
+// the bootloader may clear it. The watchdog marker covers the case where
+// the bootloader cleared MCUSR before we got a chance to read it
+static uint8_t mcusrMirror __attribute__((section(".noinit")));
+static volatile uint16_t watchdogMarker __attribute__((section(".noinit")));
+
+static uint8_t cause = 0;
+
+static uint16_t heartbeatTimeoutMs = kDefaultHeartbeatTimeoutMs;
+static unsigned long lastHeartbeat = 0;
+
+void captureMcusr(void) __attribute__((naked, used, section(".init3")));
+void captureMcusr(void) {
+  mcusrMirror = MCUSR;
+  MCUSR = 0;
+  wdt_disable();
+}
+
+ISR(WDT_vect) {
+  watchdogMarker = kWatchdogMagic;
+}
+
+void WatchdogSupervisor::begin() {
+  if (mcusrMirror & _BV(PORF)) {
+    cause |= kResetCausePowerOn;
+  }
+  if (mcusrMirror & _BV(EXTRF)) {
+    cause |= kResetCauseExternal;
+  }
+  if (mcusrMirror & _BV(BORF)) {
+    cause |= kResetCauseBrownOut;
+  }
+
+  // The marker is garbage after a power-on reset, so only trust it otherwise
+  if ((mcusrMirror & _BV(WDRF)) ||
+      (!(cause & kResetCausePowerOn) && watchdogMarker == kWatchdogMagic)) {
+    cause |= kResetCauseWatchdog;
+  }
+  watchdogMarker = 0;
+
+  wdt_enable(kWatchdogPeriod);
+
+  // Interrupt first, then reset
+  WDTCSR |= _BV(WDIE);
+}
+
+void WatchdogSupervisor::feed() {
+  wdt_reset();
+
+  // The interrupt enable is cleared by hardware whenever the interrupt fires
+  WDTCSR |= _BV(WDIE);
+}
+
+void WatchdogSupervisor::heartbeat() {
+  lastHeartbeat = millis();
+}
+
+void WatchdogSupervisor::setHeartbeatTimeout(uint16_t timeoutMs) {
+  if (timeoutMs == 0) {
+    timeoutMs = kDefaultHeartbeatTimeoutMs;
+  }
+  else if (timeoutMs < kMinHeartbeatTimeoutMs) {
+    timeoutMs = kMinHeartbeatTimeoutMs;
+  }
+
+  heartbeatTimeoutMs = timeoutMs;
+}
+
+bool WatchdogSupervisor::isHeartbeatLost() {
+  return millis() - lastHeartbeat > heartbeatTimeoutMs;
+}
+
+uint8_t WatchdogSupervisor::resetCause() {
+  return cause;
+}
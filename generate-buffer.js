@@ -17,6 +17,51 @@ const fileHeading =
 "// Generated via `npm run gen-shmem`\n\n" +
 "// Instance: " + generatedUuid + "\n\n";
 
+function dataSizeForType(type) {
+    switch (type) {
+        case "bool":
+        case "uint8_t":
+        case "int8_t":
+            return 1;
+        case "uint16_t":
+        case "int16_t":
+            return 2;
+        default:
+            return 1;
+    }
+}
+
+// Work out the offset of each field up front, since CRC fields need
+// to know where their protected range starts
+const fieldOffsets = {};
+let layoutOffset = 0;
+SharedMemLayout.forEach(field => {
+    fieldOffsets[field.name] = layoutOffset;
+    layoutOffset += dataSizeForType(field.type) * (field.arraySize !== undefined ? field.arraySize : 1);
+});
+
+// CRC fields cover every byte from their crcStart field up to (but not
+// including) the CRC byte itself
+function crcRangeForField(field) {
+    if (field.crcStart === undefined) {
+        return undefined;
+    }
+
+    if (fieldOffsets[field.crcStart] === undefined || fieldOffsets[field.crcStart] >= fieldOffsets[field.name]) {
+        throw new Error(`Invalid crcStart "${field.crcStart}" for field "${field.name}"`);
+    }
+
+    return {
+        start: fieldOffsets[field.crcStart],
+        length: fieldOffsets[field.name] - fieldOffsets[field.crcStart]
+    };
+}
+
+// e.g. commandCrc -> COMMAND_CRC
+function toMacroName(name) {
+    return name.replace(/([a-z0-9])([A-Z])/g, "$1_$2").toUpperCase();
+}
+
 let cppOutput = fileHeading +
 "#pragma once\n" +
 "#include <stdint.h>\n\n" +
@@ -34,21 +79,19 @@ SharedMemLayout.forEach(field => {
     cppOutput += line;
 });
 
-cppOutput += "};\n";
+// Packed, since the host works from the offsets above no matter what
+// the compiler would otherwise do with alignment (e.g. in the native
+// firmware simulator build)
+cppOutput += "} __attribute__((packed));\n";
 
-function dataSizeForType(type) {
-    switch (type) {
-        case "bool":
-        case "uint8_t":
-        case "int8_t":
-            return 1;
-        case "uint16_t":
-        case "int16_t":
-            return 2;
-        default:
-            return 1;
+SharedMemLayout.forEach(field => {
+    const crcRange = crcRangeForField(field);
+    if (crcRange !== undefined) {
+        const macroName = toMacroName(field.name);
+        cppOutput += `\n#define ${macroName}_START ${crcRange.start}\n`;
+        cppOutput += `#define ${macroName}_LENGTH ${crcRange.length}\n`;
     }
-}
+});
 
 
 let tsOutput = fileHeading +
@@ -64,6 +107,8 @@ let tsOutput = fileHeading +
 "    offset: number;\n" +
 "    type: ShmemDataType;\n" +
 "    arraySize?: number;\n" +
+"    crcStart?: number;\n" +
+"    crcLength?: number;\n" +
 "}\n\n" +
 "const shmemBuffer: {[key: string]: ShmemElementDefinition} = {\n";
 
@@ -95,6 +140,11 @@ SharedMemLayout.forEach(field => {
         line += `, arraySize: ${field.arraySize}`
     }
 
+    const crcRange = crcRangeForField(field);
+    if (crcRange !== undefined) {
+        line += `, crcStart: ${crcRange.start}, crcLength: ${crcRange.length}`;
+    }
+
     line += "},\n";
     tsOutput += line;
     currOffset += dataSize;
@@ -1,5 +1,6 @@
 import LSM6 from "../robot/devices/core/lsm6/lsm6";
 import I2CPromisifiedBus from "../device-interfaces/i2c/i2c-connection";
+import QueuedI2CBus from "../device-interfaces/i2c/queued-i2c-bus";
 import { FIFOModeSelection, OutputDataRate } from "../robot/devices/core/lsm6/lsm6-settings";
 
 async function main() {
@@ -15,7 +16,7 @@ async function main() {
         process.exit(1);
     }
 
-    const lsm6 = new LSM6(i2cBus, 0x6B);
+    const lsm6 = new LSM6(new QueuedI2CBus(i2cBus), 0x6B);
 
     await lsm6.init();
 
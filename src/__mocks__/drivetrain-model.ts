@@ -0,0 +1,341 @@
+import { Vector3 } from "../robot/devices/core/lsm6/lsm6";
+
+const GRAVITY: number = 9.81;
+
+// The model is integrated in steps no longer than this, however large the
+// step it is asked to take. Wheel slip makes it stiff
+const MAX_SUBSTEP_S: number = 0.00025;
+
+// Friction forces are smoothed out over this much speed around zero, so
+// things come to rest without chattering back and forth
+const FRICTION_SMOOTHING_RAD_PER_SEC: number = 50; // At the motor shaft
+const FRICTION_SMOOTHING_MPS: number = 0.005;
+
+/**
+ * Brushed DC motor, described by its ratings (like a datasheet), all at
+ * the motor shaft. Winding inductance is ignored
+ */
+export interface DCMotorParams {
+    nominalVoltage: number;
+    stallTorqueNm: number;
+    stallCurrentA: number;
+    freeSpeedRadPerSec: number;
+    freeCurrentA: number;
+    rotorInertiaKgM2: number;
+}
+
+export interface GearboxParams {
+    ratio: number; // Motor turns per wheel turn
+    efficiency: number;
+}
+
+/**
+ * Battery pack, modelled as an open circuit voltage that drops linearly
+ * as it discharges, behind an internal resistance
+ */
+export interface BatteryParams {
+    fullVolts: number;
+    emptyVolts: number;
+    capacityAh: number;
+    internalResistanceOhms: number;
+
+    // Drawn all the time, by everything other than the motors
+    baseLoadA: number;
+}
+
+export interface DrivetrainParams {
+    motor: DCMotorParams;
+    gearbox: GearboxParams;
+    battery: BatteryParams;
+
+    wheelRadiusM: number;
+    trackWidthM: number;
+    wheelInertiaKgM2: number;
+    encoderCountsPerRev: number; // Per wheel turn
+
+    massKg: number;
+    yawInertiaKgM2: number;
+
+    // Share of the weight on the drive wheels (the rest is on the casters)
+    driveWheelLoadFraction: number;
+
+    // Traction force tops out at frictionCoefficient times the load on a
+    // wheel, and reaches most of that by slipVelocityMps of wheel slip
+    frictionCoefficient: number;
+    slipVelocityMps: number;
+
+    rollingResistance: number;
+}
+
+/**
+ * Romi chassis with its 120:1 mini plastic gearmotors (4.5V ratings from
+ * Pololu, moved over to the motor shaft) running off 6 NiMH AA cells
+ */
+export const ROMI_DRIVETRAIN_PARAMS: DrivetrainParams = {
+    motor: {
+        nominalVoltage: 4.5,
+        // 25 oz-in at the wheel, before gearbox losses
+        stallTorqueNm: 0.1765 / (120 * 0.8),
+        stallCurrentA: 1.25,
+        // 150 RPM at the wheel
+        freeSpeedRadPerSec: 150 * 120 * (2 * Math.PI) / 60,
+        freeCurrentA: 0.13,
+        rotorInertiaKgM2: 1.0e-8
+    },
+    gearbox: {
+        ratio: 120,
+        efficiency: 0.8
+    },
+    battery: {
+        fullVolts: 8.0,
+        emptyVolts: 6.6,
+        capacityAh: 2.0,
+        internalResistanceOhms: 0.3,
+        baseLoadA: 0.6
+    },
+
+    wheelRadiusM: 0.035,
+    trackWidthM: 0.141,
+    wheelInertiaKgM2: 1.2e-5,
+    encoderCountsPerRev: 1440,
+
+    massKg: 0.6,
+    yawInertiaKgM2: 0.004,
+
+    driveWheelLoadFraction: 0.9,
+    frictionCoefficient: 0.9,
+    slipVelocityMps: 0.02,
+
+    rollingResistance: 0.03
+};
+
+interface WheelState {
+    // Wheel (not motor) speed and how far it has turned
+    angularVelocity: number; // rad/s
+    angle: number; // rad
+
+    currentA: number;
+    slipMps: number;
+    tractionN: number;
+}
+
+export interface WheelOutputs {
+    encoderCounts: number;
+    angularVelocity: number; // rad/s
+    currentA: number;
+    slipMps: number;
+}
+
+export interface Pose2d {
+    x: number; // m
+    y: number; // m
+    heading: number; // rad, counter clockwise
+}
+
+/**
+ * Differential drive robot, driven through a gearbox by a DC motor on each
+ * side, off a battery whose voltage sags with the load on it
+ *
+ * Motor voltage is the duty cycle times the battery's terminal voltage, so
+ * the motors slow down as the battery runs down or sags. Wheels push the
+ * robot along through a traction force that builds up with wheel slip,
+ * and the robot is assumed not to slide sideways. The robot frame is X
+ * forwards, Y to the left and Z up
+ */
+export default class DrivetrainModel {
+    private _params: DrivetrainParams;
+
+    // Derived motor constants
+    private _resistanceOhms: number;
+    private _kt: number; // Nm/A
+    private _kv: number; // rad/s per V
+    private _frictionTorqueNm: number;
+    private _wheelInertia: number; // Including the motor, seen at the wheel
+    private _wheelLoadN: number;
+
+    private _left: WheelState = { angularVelocity: 0, angle: 0, currentA: 0, slipMps: 0, tractionN: 0 };
+    private _right: WheelState = { angularVelocity: 0, angle: 0, currentA: 0, slipMps: 0, tractionN: 0 };
+
+    private _pose: Pose2d = { x: 0, y: 0, heading: 0 };
+    private _velocity: number = 0; // m/s
+    private _yawRate: number = 0; // rad/s
+    private _acceleration: number = 0; // m/s^2
+
+    private _batteryCurrentA: number = 0;
+    private _dischargedAh: number = 0;
+    private _timeS: number = 0;
+
+    constructor(params: DrivetrainParams = ROMI_DRIVETRAIN_PARAMS) {
+        this._params = params;
+
+        const motor = params.motor;
+        const gearbox = params.gearbox;
+        this._resistanceOhms = motor.nominalVoltage / motor.stallCurrentA;
+        this._kt = motor.stallTorqueNm / motor.stallCurrentA;
+        this._kv = motor.freeSpeedRadPerSec / (motor.nominalVoltage - (this._resistanceOhms * motor.freeCurrentA));
+        // Whatever holds the motor back from going any faster than its free speed
+        this._frictionTorqueNm = this._kt * motor.freeCurrentA;
+
+        this._wheelInertia = params.wheelInertiaKgM2 + (motor.rotorInertiaKgM2 * gearbox.ratio * gearbox.ratio);
+        this._wheelLoadN = params.massKg * GRAVITY * params.driveWheelLoadFraction / 2;
+    }
+
+    public get params(): DrivetrainParams {
+        return this._params;
+    }
+
+    public get timeS(): number {
+        return this._timeS;
+    }
+
+    public get pose(): Pose2d {
+        return { ...this._pose };
+    }
+
+    public get velocityMps(): number {
+        return this._velocity;
+    }
+
+    public get yawRateRadPerSec(): number {
+        return this._yawRate;
+    }
+
+    public get left(): WheelOutputs {
+        return this._wheelOutputs(this._left);
+    }
+
+    public get right(): WheelOutputs {
+        return this._wheelOutputs(this._right);
+    }
+
+    /**
+     * Voltage at the battery terminals, under the current load
+     */
+    public get batteryVolts(): number {
+        const battery = this._params.battery;
+        const charge = Math.max(0, 1 - (this._dischargedAh / battery.capacityAh));
+        const openCircuitVolts = battery.emptyVolts + ((battery.fullVolts - battery.emptyVolts) * charge);
+
+        return openCircuitVolts - (this._batteryCurrentA * battery.internalResistanceOhms);
+    }
+
+    public get batteryCurrentA(): number {
+        return this._batteryCurrentA;
+    }
+
+    /**
+     * Angular rate, in DPS, as a gyro on the robot would see it
+     */
+    public get gyroDPS(): Vector3 {
+        return { x: 0, y: 0, z: this._yawRate * 180 / Math.PI };
+    }
+
+    /**
+     * Acceleration, in G, as an accelerometer on the robot would see it
+     * (so it reads +1G in Z at rest)
+     */
+    public get accelG(): Vector3 {
+        return {
+            x: this._acceleration / GRAVITY,
+            y: (this._velocity * this._yawRate) / GRAVITY,
+            z: 1
+        };
+    }
+
+    /**
+     * Run the model forward
+     * @param dtS Time step, in seconds
+     * @param leftDuty Left motor duty cycle (-1 to 1, positive drives forwards)
+     * @param rightDuty Right motor duty cycle (-1 to 1, positive drives forwards)
+     */
+    public step(dtS: number, leftDuty: number, rightDuty: number): void {
+        leftDuty = Math.max(-1, Math.min(1, leftDuty));
+        rightDuty = Math.max(-1, Math.min(1, rightDuty));
+
+        let remainingS = dtS;
+        while (remainingS > 0) {
+            const substepS = Math.min(remainingS, MAX_SUBSTEP_S);
+            this._substep(substepS, leftDuty, rightDuty);
+            remainingS -= substepS;
+        }
+    }
+
+    /**
+     * Put the robot back at the origin, at rest
+     */
+    public resetPose(): void {
+        this._pose = { x: 0, y: 0, heading: 0 };
+    }
+
+    private _substep(dtS: number, leftDuty: number, rightDuty: number): void {
+        const params = this._params;
+        const halfTrack = params.trackWidthM / 2;
+
+        // The battery voltage comes from the current drawn on the last
+        // step, which is close enough at this step size
+        const batteryVolts = this.batteryVolts;
+
+        const leftSurfaceMps = this._velocity - (this._yawRate * halfTrack);
+        const rightSurfaceMps = this._velocity + (this._yawRate * halfTrack);
+
+        this._stepWheel(this._left, dtS, leftDuty * batteryVolts, leftSurfaceMps);
+        this._stepWheel(this._right, dtS, rightDuty * batteryVolts, rightSurfaceMps);
+
+        // Rolling resistance (mostly from the casters) on the whole robot
+        const rollingN = params.rollingResistance * params.massKg * GRAVITY *
+                         Math.tanh(this._velocity / FRICTION_SMOOTHING_MPS);
+
+        const forceN = this._left.tractionN + this._right.tractionN - rollingN;
+        const torqueNm = (this._right.tractionN - this._left.tractionN) * halfTrack;
+
+        this._acceleration = forceN / params.massKg;
+        const yawAccel = torqueNm / params.yawInertiaKgM2;
+
+        // Move along the average heading over the step
+        const heading = this._pose.heading + (this._yawRate * dtS / 2);
+        this._pose.x += this._velocity * Math.cos(heading) * dtS;
+        this._pose.y += this._velocity * Math.sin(heading) * dtS;
+        this._pose.heading += this._yawRate * dtS;
+
+        this._velocity += this._acceleration * dtS;
+        this._yawRate += yawAccel * dtS;
+
+        // The motor driver draws from the battery for the part of each
+        // PWM cycle that the motor is switched on
+        this._batteryCurrentA = params.battery.baseLoadA +
+                                (leftDuty * this._left.currentA) +
+                                (rightDuty * this._right.currentA);
+        this._dischargedAh += Math.max(0, this._batteryCurrentA) * dtS / 3600;
+
+        this._timeS += dtS;
+    }
+
+    private _stepWheel(wheel: WheelState, dtS: number, motorVolts: number, surfaceMps: number): void {
+        const params = this._params;
+        const gearbox = params.gearbox;
+
+        const motorSpeed = wheel.angularVelocity * gearbox.ratio;
+        wheel.currentA = (motorVolts - (motorSpeed / this._kv)) / this._resistanceOhms;
+
+        const motorTorqueNm = (this._kt * wheel.currentA) -
+                              (this._frictionTorqueNm * Math.tanh(motorSpeed / FRICTION_SMOOTHING_RAD_PER_SEC));
+        const wheelTorqueNm = motorTorqueNm * gearbox.ratio * gearbox.efficiency;
+
+        wheel.slipMps = (wheel.angularVelocity * params.wheelRadiusM) - surfaceMps;
+        wheel.tractionN = params.frictionCoefficient * this._wheelLoadN *
+                          Math.tanh(wheel.slipMps / params.slipVelocityMps);
+
+        const wheelAccel = (wheelTorqueNm - (wheel.tractionN * params.wheelRadiusM)) / this._wheelInertia;
+        wheel.angle += wheel.angularVelocity * dtS;
+        wheel.angularVelocity += wheelAccel * dtS;
+    }
+
+    private _wheelOutputs(wheel: WheelState): WheelOutputs {
+        return {
+            encoderCounts: Math.round(wheel.angle / (2 * Math.PI) * this._params.encoderCountsPerRev),
+            angularVelocity: wheel.angularVelocity,
+            currentA: wheel.currentA,
+            slipMps: wheel.slipMps
+        };
+    }
+}
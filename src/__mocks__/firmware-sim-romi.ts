@@ -0,0 +1,272 @@
+import path from "path";
+import { spawn, ChildProcess } from "child_process";
+import { performance } from "perf_hooks";
+import MockI2CDevice from "../device-interfaces/i2c/mock-i2c-device";
+
+/**
+ * Where `pio run -e native` (in firmware/) puts the simulator
+ */
+export const DEFAULT_FIRMWARE_SIM_PROGRAM: string = path.resolve(__dirname, "../../firmware/.pio/build/native/program");
+
+/**
+ * Simulated inputs, as numbered by the simulator (firmware/sim/src/sim_main.cpp)
+ */
+export enum FirmwareSimInput {
+    BATTERY_MV = 0,
+    // Added to the current encoder counts
+    LEFT_ENCODER_TICKS = 1,
+    RIGHT_ENCODER_TICKS = 2,
+    BUTTON_A = 3,
+    BUTTON_B = 4,
+    BUTTON_C = 5
+}
+
+const ANALOG_PIN_INPUT: number = 0x20;
+const DIGITAL_PIN_INPUT: number = 0x40;
+
+const OUTPUTS_LENGTH: number = 23;
+const NUM_SERVOS: number = 5;
+
+const STATUS_OK: number = 0;
+
+export interface FirmwareSimOutputs {
+    leftMotor: number;
+    rightMotor: number;
+    ledYellow: boolean;
+    ledGreen: boolean;
+    ledRed: boolean;
+    // Degrees, or -1 if the servo is detached
+    servos: number[];
+    // Bit n is the level of Arduino pin n
+    pinLevels: number;
+    millis: number;
+}
+
+interface PendingResponse {
+    length: number;
+    resolve: (data: Buffer) => void;
+    reject: (err: Error) => void;
+}
+
+/**
+ * Mock Romi backed by the real firmware, compiled natively
+ *
+ * The firmware runs in a separate process (built from the `native`
+ * PlatformIO environment) against a simulated board, and this device
+ * forwards bus transfers into its shared buffer. Nothing happens in the
+ * firmware until its clock is advanced, either explicitly with advance()
+ * or by following the wall clock with startRealTimeClock()
+ */
+export default class FirmwareSimRomiI2C extends MockI2CDevice {
+    private _process: ChildProcess;
+    private _pending: PendingResponse[] = [];
+    private _received: Buffer = Buffer.alloc(0);
+    private _exited: boolean = false;
+
+    // For sendByte()/receiveByte()
+    private _registerPtr: number = 0;
+
+    private _clockTimer: NodeJS.Timeout | undefined;
+    private _lastClockTime: number = 0;
+    private _clockP: Promise<void> = Promise.resolve();
+
+    constructor(address: number, program: string = DEFAULT_FIRMWARE_SIM_PROGRAM) {
+        super(address);
+
+        this._process = spawn(program, [], { stdio: ["pipe", "pipe", "inherit"] });
+        this._process.stdout.on("data", (data: Buffer) => {
+            this._received = Buffer.concat([this._received, data]);
+            this._processResponses();
+        });
+
+        const onExit = (err?: Error) => {
+            this._exited = true;
+            this.stopRealTimeClock();
+            this._process.stdin.destroy();
+            this._process.stdout.destroy();
+
+            const pending = this._pending;
+            this._pending = [];
+            pending.forEach(response => {
+                response.reject(err || new Error("Firmware simulator exited"));
+            });
+        };
+
+        this._process.on("error", onExit);
+        this._process.on("exit", () => onExit());
+    }
+
+    /**
+     * Run the firmware for the given time (in simulated ms)
+     */
+    public advance(ms: number): Promise<void> {
+        const request = Buffer.alloc(5);
+        request.write("A", 0, "ascii");
+        request.writeUInt32LE(Math.max(0, Math.round(ms * 1000)), 1);
+
+        return this._request(request, 0).then(() => {});
+    }
+
+    /**
+     * Set how often loop() runs, in simulated microseconds
+     */
+    public setLoopPeriod(us: number): Promise<void> {
+        const request = Buffer.alloc(5);
+        request.write("L", 0, "ascii");
+        request.writeUInt32LE(us, 1);
+
+        return this._request(request, 0).then(() => {});
+    }
+
+    public setInput(input: FirmwareSimInput, value: number): Promise<void> {
+        return this._setInput(input, value);
+    }
+
+    public setAnalogPin(pin: number, value: number): Promise<void> {
+        return this._setInput(ANALOG_PIN_INPUT + pin, value);
+    }
+
+    public setDigitalPin(pin: number, value: boolean): Promise<void> {
+        return this._setInput(DIGITAL_PIN_INPUT + pin, value ? 1 : 0);
+    }
+
+    public getOutputs(): Promise<FirmwareSimOutputs> {
+        return this._request(Buffer.from("O", "ascii"), OUTPUTS_LENGTH)
+        .then(data => {
+            const servos: number[] = [];
+            for (let i = 0; i < NUM_SERVOS; i++) {
+                servos.push(data.readInt16LE(5 + (2 * i)));
+            }
+
+            return {
+                leftMotor: data.readInt16LE(0),
+                rightMotor: data.readInt16LE(2),
+                ledYellow: !!(data[4] & 0x01),
+                ledGreen: !!(data[4] & 0x02),
+                ledRed: !!(data[4] & 0x04),
+                servos,
+                pinLevels: data.readUInt32LE(15),
+                millis: data.readUInt32LE(19)
+            };
+        });
+    }
+
+    /**
+     * Keep the simulated clock in step with the wall clock, advancing it
+     * every periodMs
+     */
+    public startRealTimeClock(periodMs: number = 5): void {
+        this.stopRealTimeClock();
+
+        this._lastClockTime = performance.now();
+        this._clockTimer = setInterval(() => {
+            const now = performance.now();
+            const elapsedMs = now - this._lastClockTime;
+            this._lastClockTime = now;
+
+            // Don't let advances pile up if the simulator falls behind
+            this._clockP = this._clockP.then(() => this.advance(elapsedMs)).catch(() => {});
+        }, periodMs);
+    }
+
+    public stopRealTimeClock(): void {
+        if (this._clockTimer !== undefined) {
+            clearInterval(this._clockTimer);
+            this._clockTimer = undefined;
+        }
+    }
+
+    public close(): void {
+        this.stopRealTimeClock();
+        if (!this._exited) {
+            this._process.stdin.end();
+        }
+    }
+
+    public readByte(cmd: number): Promise<number> {
+        return this._read(cmd, 1).then(data => data[0]);
+    }
+
+    public readWord(cmd: number): Promise<number> {
+        return this._read(cmd, 2).then(data => data.readUInt16LE(0));
+    }
+
+    public writeByte(cmd: number, byte: number): Promise<void> {
+        return this._write(cmd, Buffer.from([byte & 0xFF]));
+    }
+
+    public writeWord(cmd: number, word: number): Promise<void> {
+        const data = Buffer.alloc(2);
+        data.writeUInt16LE(word & 0xFFFF, 0);
+        return this._write(cmd, data);
+    }
+
+    public sendByte(cmd: number): Promise<void> {
+        this._registerPtr = cmd;
+        return Promise.resolve();
+    }
+
+    public receiveByte(): Promise<number> {
+        return this.readByte(this._registerPtr++);
+    }
+
+    public readBlock(cmd: number, length: number): Promise<Buffer> {
+        return this._read(cmd, length);
+    }
+
+    public writeBlock(cmd: number, data: Buffer): Promise<void> {
+        return this._write(cmd, data);
+    }
+
+    private _read(cmd: number, length: number): Promise<Buffer> {
+        return this._request(Buffer.from([0x52 /* R */, cmd & 0xFF, length & 0xFF]), length);
+    }
+
+    private _write(cmd: number, data: Buffer): Promise<void> {
+        const request = Buffer.concat([Buffer.from([0x57 /* W */, cmd & 0xFF, data.length & 0xFF]), data]);
+        return this._request(request, 0).then(() => {});
+    }
+
+    private _setInput(id: number, value: number): Promise<void> {
+        const request = Buffer.alloc(6);
+        request.write("I", 0, "ascii");
+        request.writeUInt8(id, 1);
+        request.writeInt32LE(value, 2);
+
+        return this._request(request, 0).then(() => {});
+    }
+
+    private _request(request: Buffer, responseLength: number): Promise<Buffer> {
+        if (this._exited) {
+            return Promise.reject(new Error("Firmware simulator exited"));
+        }
+
+        return new Promise<Buffer>((resolve, reject) => {
+            this._pending.push({ length: responseLength, resolve, reject });
+            this._process.stdin.write(request);
+        });
+    }
+
+    // Responses come back in request order: a status byte, then the data
+    // (only if the request succeeded)
+    private _processResponses(): void {
+        while (this._pending.length > 0 && this._received.length > 0) {
+            const response = this._pending[0];
+            if (this._received[0] !== STATUS_OK) {
+                this._pending.shift();
+                this._received = this._received.slice(1);
+                response.reject(new Error("IO Error"));
+                continue;
+            }
+
+            if (this._received.length < 1 + response.length) {
+                return;
+            }
+
+            this._pending.shift();
+            const data = this._received.slice(1, 1 + response.length);
+            this._received = this._received.slice(1 + response.length);
+            response.resolve(data);
+        }
+    }
+}
@@ -0,0 +1,161 @@
+import { performance } from "perf_hooks";
+import MockI2CDevice from "../device-interfaces/i2c/mock-i2c-device";
+
+// Just the APDS-9151 (REV Color Sensor V3) registers the driver uses
+const PART_ID: number = 0x06;
+const MAIN_STATUS: number = 0x07;
+const PROX_DATA: number = 0x08;
+const DATA_INFRARED: number = 0x0A;
+const DATA_GREEN: number = 0x0D;
+const DATA_BLUE: number = 0x10;
+const DATA_RED: number = 0x13;
+
+const PART_IDENT: number = 0xC2;
+
+// MAIN_STATUS flags. These are cleared when MAIN_STATUS is read
+const PROX_DATA_READY: number = 0x01;
+const LIGHT_DATA_READY: number = 0x08;
+const POWER_ON: number = 0x20;
+
+const DEFAULT_MEASUREMENT_PERIOD_MS: number = 100;
+
+export interface ColorMeasurement {
+    red: number;
+    green: number;
+    blue: number;
+    ir: number;
+    proximity: number;
+}
+
+/**
+ * Mock REV Color Sensor V3
+ *
+ * The sensor takes a new measurement (always of the values last set)
+ * every measurement period. Each one sets the data ready flags in
+ * MAIN_STATUS, which are cleared when it's read, like the real sensor.
+ * Reads and writes count towards transfer totals, so tests and benchmarks
+ * can see what the driver is costing the bus
+ */
+export default class MockColorSensor extends MockI2CDevice {
+    private _registers: Buffer = Buffer.alloc(0x20);
+
+    private _measurementPeriodMs: number;
+    private _clock: () => number;
+    private _startTime: number;
+    private _measurements: number = 0;
+
+    private _statusReads: number = 0;
+    private _dataReads: number = 0;
+
+    /**
+     * @param clock Current time in ms. Defaults to real time
+     */
+    constructor(address: number, measurementPeriodMs: number = DEFAULT_MEASUREMENT_PERIOD_MS, clock: () => number = () => performance.now()) {
+        super(address);
+
+        this._measurementPeriodMs = measurementPeriodMs;
+        this._clock = clock;
+        this._startTime = clock();
+
+        this._registers[PART_ID] = PART_IDENT;
+        this._registers[MAIN_STATUS] = POWER_ON;
+    }
+
+    /**
+     * Times MAIN_STATUS has been read
+     */
+    public get statusReads(): number {
+        return this._statusReads;
+    }
+
+    /**
+     * Reads of the data registers, counting each transfer once
+     */
+    public get dataReads(): number {
+        return this._dataReads;
+    }
+
+    /**
+     * Set what the sensor will see, from its next measurement
+     */
+    public setMeasurement(measurement: ColorMeasurement): void {
+        this._registers.writeUInt16LE(measurement.proximity & 0x7FF, PROX_DATA);
+        this._writeUInt24LE(measurement.ir, DATA_INFRARED);
+        this._writeUInt24LE(measurement.green, DATA_GREEN);
+        this._writeUInt24LE(measurement.blue, DATA_BLUE);
+        this._writeUInt24LE(measurement.red, DATA_RED);
+    }
+
+    public readByte(cmd: number): Promise<number> {
+        if (cmd === MAIN_STATUS) {
+            return Promise.resolve(this._readStatus());
+        }
+
+        if (cmd >= PROX_DATA && cmd <= DATA_RED + 2) {
+            this._dataReads++;
+        }
+
+        return Promise.resolve(cmd < this._registers.length ? this._registers[cmd] : 0);
+    }
+
+    public readWord(cmd: number): Promise<number> {
+        return Promise.all([this.readByte(cmd), this.readByte(cmd + 1)])
+        .then(([low, high]) => low | (high << 8));
+    }
+
+    public writeByte(cmd: number, byte: number): Promise<void> {
+        if (cmd < this._registers.length && cmd !== PART_ID && cmd !== MAIN_STATUS) {
+            this._registers[cmd] = byte;
+        }
+
+        return Promise.resolve();
+    }
+
+    public writeWord(cmd: number, word: number): Promise<void> {
+        return this.writeByte(cmd, word & 0xFF)
+        .then(() => this.writeByte(cmd + 1, (word >> 8) & 0xFF));
+    }
+
+    public sendByte(cmd: number): Promise<void> {
+        return Promise.resolve();
+    }
+
+    public receiveByte(): Promise<number> {
+        return Promise.resolve(0);
+    }
+
+    public readBlock(cmd: number, length: number): Promise<Buffer> {
+        // The register address auto increments, all in one transfer
+        const data = Buffer.alloc(length);
+        for (let i = 0; i < length; i++) {
+            const reg = cmd + i;
+            data[i] = reg === MAIN_STATUS ? this._readStatus() : (reg < this._registers.length ? this._registers[reg] : 0);
+        }
+
+        if (cmd + length > PROX_DATA && cmd <= DATA_RED + 2) {
+            this._dataReads++;
+        }
+
+        return Promise.resolve(data);
+    }
+
+    private _readStatus(): number {
+        this._statusReads++;
+
+        const measurements = Math.floor((this._clock() - this._startTime) / this._measurementPeriodMs);
+        if (measurements > this._measurements) {
+            this._measurements = measurements;
+            this._registers[MAIN_STATUS] |= PROX_DATA_READY | LIGHT_DATA_READY;
+        }
+
+        const status = this._registers[MAIN_STATUS];
+        this._registers[MAIN_STATUS] = 0;
+        return status;
+    }
+
+    private _writeUInt24LE(value: number, offset: number): void {
+        this._registers[offset] = value & 0xFF;
+        this._registers[offset + 1] = (value >> 8) & 0xFF;
+        this._registers[offset + 2] = (value >> 16) & 0xFF;
+    }
+}
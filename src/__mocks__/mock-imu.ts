@@ -1,24 +1,17 @@
-import MockI2CDevice from "../device-interfaces/i2c/mock-i2c-device";
+import { Vector3 } from "../robot/devices/core/lsm6/lsm6";
+import MockLSM6 from "./mock-lsm6";
 
-export default class MockRomiImu extends MockI2CDevice {
-    public readByte(cmd: number): Promise<number> {
-        return Promise.resolve(0);
-    }
-    public readWord(cmd: number): Promise<number> {
-        return Promise.resolve(0);
-    }
-    public writeByte(cmd: number, byte: number): Promise<void> {
-        return Promise.resolve();
-    }
-    public writeWord(cmd: number, word: number): Promise<void> {
-        return Promise.resolve();
-    }
-
-    public sendByte(cmd: number): Promise<void> {
-        return Promise.resolve();
-    }
-
-    public receiveByte(): Promise<number> {
-        return Promise.resolve(0);
+/**
+ * Mock LSM6DS33
+ *
+ * Nothing goes into the FIFO on its own. Frames are pushed in by whatever
+ * is simulating the robot's motion
+ */
+export default class MockRomiImu extends MockLSM6 {
+    /**
+     * Add a frame to the FIFO
+     */
+    public pushFrame(gyroDPS: Vector3, accelG: Vector3): void {
+        this._pushFrame(gyroDPS.x, gyroDPS.y, gyroDPS.z, accelG.x, accelG.y, accelG.z);
     }
 }
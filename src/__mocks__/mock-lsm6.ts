@@ -0,0 +1,202 @@
+import MockI2CDevice from "../device-interfaces/i2c/mock-i2c-device";
+
+// Just the LSM6DS33 registers the driver uses
+const WHO_AM_I: number = 0x0F;
+const CTRL1_XL: number = 0x10;
+const CTRL2_G: number = 0x11;
+const CTRL3_C: number = 0x12;
+const FIFO_STATUS1: number = 0x3A;
+const FIFO_STATUS2: number = 0x3B;
+const FIFO_STATUS3: number = 0x3C;
+const FIFO_STATUS4: number = 0x3D;
+const FIFO_DATA_OUT_L: number = 0x3E;
+
+const DS33_WHO_ID: number = 0x69;
+const SW_RESET: number = 0x01;
+
+// The FIFO holds 4096 words, but the unread count is only 12 bits
+const MAX_FIFO_WORDS: number = 0xFFF;
+
+// FIFO_STATUS2 flags
+const FIFO_OVER_RUN: number = 0x40;
+
+const FRAME_VALUES: number = 6;
+export const MAX_FIFO_FRAMES: number = Math.floor(MAX_FIFO_WORDS / FRAME_VALUES);
+
+// Sensitivity (mg/LSB) for each CTRL1_XL FS_XL setting
+const ACCEL_SENSITIVITY: number[] = [0.061, 0.488, 0.122, 0.244];
+
+// Sensitivity (mdps/LSB) for each CTRL2_G FS_G setting
+const GYRO_SENSITIVITY: number[] = [8.75, 17.5, 35, 70];
+const GYRO_SENSITIVITY_125_DPS: number = 4.375;
+
+/**
+ * Mock LSM6DS33 registers and FIFO
+ *
+ * Frames come out of the FIFO as raw 16 bit values, scaled for whatever
+ * full scale ranges the driver has configured. Where the frames come from
+ * is up to the subclass: it pushes them in with _pushFrame(), either as
+ * they happen or from _fillFIFO(), which runs before every read. When the
+ * FIFO is full, the oldest frames are dropped
+ */
+export default abstract class MockLSM6 extends MockI2CDevice {
+    private _registers: Uint8Array = new Uint8Array(0x80);
+
+    // Ring of frames, each gyro X/Y/Z (DPS) then accel X/Y/Z (G). Frames
+    // pushed and taken out are counted, and positions in the ring are
+    // these counts modulo MAX_FIFO_FRAMES
+    private _frames: Float64Array = new Float64Array(MAX_FIFO_FRAMES * FRAME_VALUES);
+    private _writeCount: number = 0;
+    private _readCount: number = 0;
+
+    // Values of the oldest frame that have already been read out
+    private _frameWordsRead: number = 0;
+    private _framesRead: number = 0;
+    private _overrun: boolean = false;
+
+    constructor(address: number) {
+        super(address);
+        this._registers[WHO_AM_I] = DS33_WHO_ID;
+    }
+
+    /**
+     * Frames in the FIFO that haven't been completely read out
+     */
+    public get pendingFrames(): number {
+        return this._writeCount - this._readCount;
+    }
+
+    public get framesRead(): number {
+        return this._framesRead;
+    }
+
+    public readByte(cmd: number): Promise<number> {
+        this._fillFIFO();
+        return Promise.resolve(this._register(cmd));
+    }
+
+    public readWord(cmd: number): Promise<number> {
+        return Promise.all([this.readByte(cmd), this.readByte(cmd + 1)])
+        .then(([low, high]) => low | (high << 8));
+    }
+
+    public writeByte(cmd: number, byte: number): Promise<void> {
+        if (cmd < this._registers.length && cmd !== WHO_AM_I) {
+            // Resets finish straight away
+            this._registers[cmd] = (cmd === CTRL3_C) ? (byte & ~SW_RESET) : byte;
+        }
+
+        return Promise.resolve();
+    }
+
+    public writeWord(cmd: number, word: number): Promise<void> {
+        return this.writeByte(cmd, word & 0xFF)
+        .then(() => this.writeByte(cmd + 1, (word >> 8) & 0xFF));
+    }
+
+    public sendByte(cmd: number): Promise<void> {
+        return Promise.resolve();
+    }
+
+    public receiveByte(): Promise<number> {
+        return Promise.resolve(0);
+    }
+
+    public readBlock(cmd: number, length: number): Promise<Buffer> {
+        this._fillFIFO();
+
+        // Status registers are read in one go, so they all agree
+        if (cmd !== FIFO_DATA_OUT_L) {
+            const registers = Buffer.alloc(length);
+            for (let i = 0; i < length; i++) {
+                registers[i] = this._register(cmd + i);
+            }
+
+            return Promise.resolve(registers);
+        }
+
+        // Reads wrap around FIFO_DATA_OUT_L/H, pulling one word at a time.
+        // Reading an empty FIFO just returns zeros
+        const data = Buffer.alloc(length);
+        for (let offset = 0; offset + 1 < length; offset += 2) {
+            if (this._readCount === this._writeCount) {
+                break;
+            }
+
+            const frameOffset = (this._readCount % MAX_FIFO_FRAMES) * FRAME_VALUES;
+            data.writeInt16LE(this._rawValue(this._frames[frameOffset + this._frameWordsRead], this._frameWordsRead), offset);
+            this._frameWordsRead++;
+
+            if (this._frameWordsRead === FRAME_VALUES) {
+                this._readCount++;
+                this._frameWordsRead = 0;
+                this._framesRead++;
+            }
+        }
+
+        this._overrun = false;
+        return Promise.resolve(data);
+    }
+
+    /**
+     * Push any frames that are due into the FIFO. Called before every
+     * register read
+     */
+    protected _fillFIFO(): void {
+        // Frames are pushed in as they happen by default
+    }
+
+    /**
+     * Add a frame to the FIFO
+     */
+    protected _pushFrame(gyroX: number, gyroY: number, gyroZ: number, accelX: number, accelY: number, accelZ: number): void {
+        if (this.pendingFrames === MAX_FIFO_FRAMES) {
+            this._readCount++;
+            this._frameWordsRead = 0;
+            this._overrun = true;
+        }
+
+        const offset = (this._writeCount % MAX_FIFO_FRAMES) * FRAME_VALUES;
+        this._frames[offset] = gyroX;
+        this._frames[offset + 1] = gyroY;
+        this._frames[offset + 2] = gyroZ;
+        this._frames[offset + 3] = accelX;
+        this._frames[offset + 4] = accelY;
+        this._frames[offset + 5] = accelZ;
+
+        this._writeCount++;
+    }
+
+    private _register(cmd: number): number {
+        const unreadWords = (this.pendingFrames * FRAME_VALUES) - this._frameWordsRead;
+        const pattern = this._frameWordsRead;
+
+        switch (cmd) {
+            case FIFO_STATUS1:
+                return unreadWords & 0xFF;
+            case FIFO_STATUS2:
+                return ((unreadWords >> 8) & 0x0F) | (this._overrun ? FIFO_OVER_RUN : 0);
+            case FIFO_STATUS3:
+                return pattern & 0xFF;
+            case FIFO_STATUS4:
+                return (pattern >> 8) & 0x03;
+            default:
+                return cmd < this._registers.length ? this._registers[cmd] : 0;
+        }
+    }
+
+    private _rawValue(value: number, valueIdx: number): number {
+        // Gyro values come first, in DPS, then accel, in G
+        let scale: number;
+        if (valueIdx < 3) {
+            const ctrl = this._registers[CTRL2_G];
+            scale = ((ctrl & 0x02) ? GYRO_SENSITIVITY_125_DPS : GYRO_SENSITIVITY[(ctrl >> 2) & 0x3]) / 1000;
+        }
+        else {
+            scale = ACCEL_SENSITIVITY[(this._registers[CTRL1_XL] >> 2) & 0x3] / 1000;
+        }
+
+        const raw = Math.round(value / scale);
+        return Math.max(-32768, Math.min(32767, raw));
+    }
+}
@@ -120,6 +120,40 @@ export default class MockRomiI2C extends MockI2CDevice {
         this._actualBuffer[RomiShmemBuffer.firmwareIdent.offset] = ident & 0xFF;
     }
 
+    /**
+     * Copy bytes straight into the buffer that the bus reads from, as if
+     * the firmware had just written them
+     */
+    public setBufferBytes(offset: number, data: Uint8Array) {
+        for (let i = 0; i < data.length && offset + i < this._actualBuffer.length; i++) {
+            this._actualBuffer[offset + i] = data[i];
+        }
+    }
+
+    /**
+     * Bytes from the buffer that the bus reads from
+     */
+    public getBufferBytes(offset: number, length: number): Buffer {
+        return Buffer.from(this._actualBuffer.slice(offset, offset + length).map(byte => byte || 0));
+    }
+
+    /**
+     * Bytes that have been written to the Romi from the bus
+     */
+    public getIncomingBytes(offset: number, length: number): Buffer {
+        return Buffer.from(this._incomingBuffer.slice(offset, offset + length).map(byte => byte || 0));
+    }
+
+    /**
+     * Overwrite bytes that came in from the bus, as if the firmware had
+     * consumed them (e.g. clearing a flag)
+     */
+    public setIncomingBytes(offset: number, data: Uint8Array) {
+        for (let i = 0; i < data.length && offset + i < this._incomingBuffer.length; i++) {
+            this._incomingBuffer[offset + i] = data[i];
+        }
+    }
+
     public resetRomi() {
         // Simulates a reset
         const shmemElements: ShmemElementDefinition[] = [];
@@ -0,0 +1,231 @@
+import { performance } from "perf_hooks";
+import RomiDataBuffer, { FIRMWARE_IDENT } from "../robot/romi-shmem-buffer";
+import {
+    COMMAND_BLOCK_LENGTH,
+    COMMAND_BLOCK_START,
+    COMMAND_FLAG_HEARTBEAT,
+    DEFAULT_HEARTBEAT_TIMEOUT_MS,
+    MIN_HEARTBEAT_TIMEOUT_MS,
+    MOTOR_FULL_SCALE,
+    TELEMETRY_BLOCK_LENGTH,
+    TELEMETRY_BLOCK_START
+} from "../robot/romi-shmem-protocol";
+import { crc8 } from "../utils/crc8";
+import MockRomiI2C from "./mock-romi";
+import MockRomiImu from "./mock-imu";
+import DrivetrainModel, { DrivetrainParams, ROMI_DRIVETRAIN_PARAMS } from "./drivetrain-model";
+
+const DEFAULT_STEP_RATE_HZ: number = 1000;
+// What the robot sets the LSM6 to
+const DEFAULT_IMU_ODR_HZ: number = 104;
+
+export interface PhysicsRomiConfig {
+    // How often the model runs, and the firmware picks up commands and
+    // updates telemetry
+    stepRateHz?: number;
+
+    // How often a frame goes into the IMU FIFO
+    imuOdrHz?: number;
+
+    params?: DrivetrainParams;
+}
+
+/**
+ * Stands in for the Romi firmware behind a MockRomiI2C, driving a
+ * drivetrain model with the motor commands it's sent
+ *
+ * Each step, new command blocks are picked up (and acknowledged) and the
+ * model is run forward. The encoder counts and battery voltage then go
+ * into the telemetry block, and at the IMU's output data rate, the gyro
+ * and accelerometer readings go into the IMU FIFO, so all of them stay
+ * consistent with each other. Like the firmware, the motors stop if the
+ * heartbeat is lost, and the right motor is flipped.
+ *
+ * Time is simulated: it only moves on with step()/advance(), or by
+ * following the wall clock with startRealTimeClock()
+ */
+export default class PhysicsRomiSim {
+    private _romi: MockRomiI2C;
+    private _imu: MockRomiImu;
+    private _model: DrivetrainModel;
+
+    private _stepMs: number;
+    private _imuPeriodMs: number;
+
+    private _timeMs: number = 0;
+    private _nextImuFrameMs: number = 0;
+
+    // Firmware state
+    private _leftMotorCommand: number = 0;
+    private _rightMotorCommand: number = 0;
+    private _commandAck: number = 0;
+    private _commandCrcErrors: number = 0;
+    private _lastRejectedSeq: number = -1;
+    private _lastHeartbeatMs: number = 0;
+    private _leftEncoderBase: number = 0;
+    private _rightEncoderBase: number = 0;
+
+    private _clockTimer: NodeJS.Timeout | undefined;
+    private _lastClockTime: number = 0;
+    private _pendingMs: number = 0;
+
+    constructor(romi: MockRomiI2C, imu: MockRomiImu, config: PhysicsRomiConfig = {}) {
+        this._romi = romi;
+        this._imu = imu;
+        this._model = new DrivetrainModel(config.params || ROMI_DRIVETRAIN_PARAMS);
+
+        this._stepMs = 1000 / (config.stepRateHz || DEFAULT_STEP_RATE_HZ);
+        this._imuPeriodMs = 1000 / (config.imuOdrHz || DEFAULT_IMU_ODR_HZ);
+
+        this._romi.setFirmwareIdent(FIRMWARE_IDENT);
+        this._updateTelemetry();
+    }
+
+    public get model(): DrivetrainModel {
+        return this._model;
+    }
+
+    /**
+     * Simulated time, in ms
+     */
+    public get timeMs(): number {
+        return this._timeMs;
+    }
+
+    /**
+     * Motor outputs (-400 to 400), as the firmware would set them
+     */
+    public get leftMotor(): number {
+        return this._heartbeatLost ? 0 : this._leftMotorCommand;
+    }
+
+    public get rightMotor(): number {
+        return this._heartbeatLost ? 0 : this._rightMotorCommand;
+    }
+
+    /**
+     * Run a single step
+     */
+    public step(): void {
+        this._processCommands();
+
+        // The right motor is flipped, so that (as on the robot) positive
+        // commands turn it backwards
+        this._model.step(this._stepMs / 1000,
+                         this.leftMotor / MOTOR_FULL_SCALE,
+                         -this.rightMotor / MOTOR_FULL_SCALE);
+        this._timeMs += this._stepMs;
+
+        this._updateTelemetry();
+
+        while (this._nextImuFrameMs <= this._timeMs) {
+            this._imu.pushFrame(this._model.gyroDPS, this._model.accelG);
+            this._nextImuFrameMs += this._imuPeriodMs;
+        }
+    }
+
+    /**
+     * Run for the given time (in simulated ms), in whole steps. Any time
+     * left over is carried into the next call
+     */
+    public advance(ms: number): void {
+        this._pendingMs += ms;
+        while (this._pendingMs >= this._stepMs) {
+            this.step();
+            this._pendingMs -= this._stepMs;
+        }
+    }
+
+    /**
+     * Keep the simulated time in step with the wall clock, catching up
+     * every periodMs
+     */
+    public startRealTimeClock(periodMs: number = 5): void {
+        this.stopRealTimeClock();
+
+        this._lastClockTime = performance.now();
+        this._clockTimer = setInterval(() => {
+            const now = performance.now();
+            this.advance(now - this._lastClockTime);
+            this._lastClockTime = now;
+        }, periodMs);
+    }
+
+    public stopRealTimeClock(): void {
+        if (this._clockTimer !== undefined) {
+            clearInterval(this._clockTimer);
+            this._clockTimer = undefined;
+        }
+    }
+
+    private get _heartbeatLost(): boolean {
+        let timeoutMs = this._romi.getIncomingBytes(RomiDataBuffer.heartbeatTimeoutMs.offset, 2).readUInt16LE(0);
+        if (timeoutMs === 0) {
+            timeoutMs = DEFAULT_HEARTBEAT_TIMEOUT_MS;
+        }
+
+        return this._timeMs - this._lastHeartbeatMs > Math.max(timeoutMs, MIN_HEARTBEAT_TIMEOUT_MS);
+    }
+
+    // What the firmware does with the shared buffer on each loop
+    private _processCommands(): void {
+        const block = this._romi.getIncomingBytes(COMMAND_BLOCK_START, COMMAND_BLOCK_LENGTH);
+        const seq = block[RomiDataBuffer.commandSeq.offset - COMMAND_BLOCK_START];
+
+        if (seq !== this._commandAck) {
+            if (crc8(block, 0, COMMAND_BLOCK_LENGTH - 1) !== block[COMMAND_BLOCK_LENGTH - 1]) {
+                if (seq !== this._lastRejectedSeq) {
+                    this._lastRejectedSeq = seq;
+                    this._commandCrcErrors = (this._commandCrcErrors + 1) & 0xFF;
+                }
+            }
+            else {
+                this._leftMotorCommand = block.readInt16LE(RomiDataBuffer.leftMotor.offset - COMMAND_BLOCK_START);
+                this._rightMotorCommand = block.readInt16LE(RomiDataBuffer.rightMotor.offset - COMMAND_BLOCK_START);
+                this._commandAck = seq;
+
+                if (block[RomiDataBuffer.commandFlags.offset - COMMAND_BLOCK_START] & COMMAND_FLAG_HEARTBEAT) {
+                    this._lastHeartbeatMs = this._timeMs;
+                }
+            }
+        }
+
+        if (this._consumeFlag(RomiDataBuffer.heartbeat.offset)) {
+            this._lastHeartbeatMs = this._timeMs;
+        }
+
+        if (this._consumeFlag(RomiDataBuffer.resetLeftEncoder.offset)) {
+            this._leftEncoderBase = this._model.left.encoderCounts;
+        }
+
+        if (this._consumeFlag(RomiDataBuffer.resetRightEncoder.offset)) {
+            this._rightEncoderBase = this._model.right.encoderCounts;
+        }
+    }
+
+    private _consumeFlag(offset: number): boolean {
+        if (this._romi.getIncomingBytes(offset, 1)[0] === 0) {
+            return false;
+        }
+
+        this._romi.setIncomingBytes(offset, Buffer.from([0]));
+        return true;
+    }
+
+    private _updateTelemetry(): void {
+        const block = this._romi.getBufferBytes(TELEMETRY_BLOCK_START, TELEMETRY_BLOCK_LENGTH);
+
+        // Encoder counts are 16 bits, and wrap
+        block.writeUInt16LE((this._model.left.encoderCounts - this._leftEncoderBase) & 0xFFFF,
+                            RomiDataBuffer.leftEncoder.offset - TELEMETRY_BLOCK_START);
+        block.writeUInt16LE((this._model.right.encoderCounts - this._rightEncoderBase) & 0xFFFF,
+                            RomiDataBuffer.rightEncoder.offset - TELEMETRY_BLOCK_START);
+        block.writeUInt16LE(Math.max(0, Math.round(this._model.batteryVolts * 1000)),
+                            RomiDataBuffer.batteryMillivolts.offset - TELEMETRY_BLOCK_START);
+        block[RomiDataBuffer.commandAck.offset - TELEMETRY_BLOCK_START] = this._commandAck;
+        block[RomiDataBuffer.commandCrcErrors.offset - TELEMETRY_BLOCK_START] = this._commandCrcErrors;
+
+        block[TELEMETRY_BLOCK_LENGTH - 1] = crc8(block, 0, TELEMETRY_BLOCK_LENGTH - 1);
+        this._romi.setBufferBytes(TELEMETRY_BLOCK_START, block);
+    }
+}
@@ -0,0 +1,34 @@
+import RecordedSession from "../services/replay/recorded-session";
+import MockLSM6 from "./mock-lsm6";
+
+/**
+ * Mock LSM6DS33 that plays back the IMU frames of a recorded session
+ *
+ * Frames show up in the FIFO once the replay reaches the time they were
+ * recorded at. Recorded frames already have the gyro offset applied, so
+ * the replaying robot should run with a zero offset
+ */
+export default class ReplayRomiImu extends MockLSM6 {
+    private _session: RecordedSession;
+
+    // Next recorded frame to go into the FIFO
+    private _nextFrame: number = 0;
+
+    constructor(address: number, session: RecordedSession) {
+        super(address);
+        this._session = session;
+    }
+
+    /**
+     * Move the replay on to timeMs (ms since the session started)
+     */
+    public setTime(timeMs: number): void {
+        const session = this._session;
+        while (this._nextFrame < session.imuFrameCount &&
+               session.imuFrameTimes[this._nextFrame] <= timeMs) {
+            const frame = this._nextFrame++;
+            this._pushFrame(session.imuValue(frame, 0), session.imuValue(frame, 1), session.imuValue(frame, 2),
+                            session.imuValue(frame, 3), session.imuValue(frame, 4), session.imuValue(frame, 5));
+        }
+    }
+}
@@ -0,0 +1,135 @@
+import MockRomiI2C from "./mock-romi";
+import RomiShmemBuffer from "../robot/romi-shmem-buffer";
+import RecordedSession, { TELEMETRY_EVENT_BLOCK } from "../services/replay/recorded-session";
+import { I2CErrorKind } from "../services/recorder/log-format";
+import { crc8 } from "../utils/crc8";
+
+export type ReplayCommandListener = (block: Uint8Array, timeMs: number) => void;
+
+/**
+ * Mock Romi that serves the telemetry of a recorded session
+ *
+ * The telemetry block follows the recording: whatever was last recorded
+ * at or before the current replay time is what the bus reads back.
+ * Telemetry reads that failed in the recording fail again (or come back
+ * with a bad CRC) at the same point. Command blocks written by the robot
+ * are acknowledged as the firmware would, and handed to listeners
+ */
+export default class ReplayRomiI2C extends MockRomiI2C {
+    private _session: RecordedSession;
+    private _telemetryStart: number;
+    private _commandStart: number;
+
+    private _telemetryIdx: number = -1;
+    private _servedBlock: Buffer;
+    private _lastGoodIdx: number = -1;
+    private _commandAck: number = 0;
+
+    private _commandListeners: ReplayCommandListener[] = [];
+    private _timeMs: number = 0;
+
+    constructor(address: number, session: RecordedSession) {
+        super(address);
+
+        this._session = session;
+        this._telemetryStart = session.schema.telemetryBlock.start;
+        this._commandStart = session.schema.commandBlock.start;
+        this._servedBlock = Buffer.alloc(session.schema.telemetryBlock.length);
+
+        // Start from a booted, idle Romi
+        this.setBufferBytes(0, new Uint8Array(this._telemetryStart + this._servedBlock.length));
+        this.setBufferBytes(RomiShmemBuffer.status.offset, new Uint8Array([1]));
+        this.setFirmwareIdent(session.schema.firmwareIdent);
+    }
+
+    /**
+     * Index of the telemetry event currently being served (-1 before the
+     * first one)
+     */
+    public get telemetryIndex(): number {
+        return this._telemetryIdx;
+    }
+
+    public addCommandListener(listener: ReplayCommandListener): void {
+        this._commandListeners.push(listener);
+    }
+
+    /**
+     * Move the replay on to timeMs (ms since the session started)
+     * @returns true if a new telemetry event became current
+     */
+    public setTime(timeMs: number): boolean {
+        this._timeMs = timeMs;
+
+        let idx = this._telemetryIdx;
+        while (idx + 1 < this._session.telemetryCount && this._session.telemetryTimes[idx + 1] <= timeMs) {
+            idx++;
+        }
+
+        if (idx === this._telemetryIdx) {
+            return false;
+        }
+
+        this._telemetryIdx = idx;
+        if (this._session.telemetryEvents[idx] === TELEMETRY_EVENT_BLOCK) {
+            this._lastGoodIdx = idx;
+        }
+        this._updateServedBlock();
+        return true;
+    }
+
+    public readBlock(cmd: number, length: number): Promise<Buffer> {
+        if (cmd === this._telemetryStart && length === this._servedBlock.length) {
+            if (this._telemetryIdx >= 0 &&
+                this._session.telemetryEvents[this._telemetryIdx] === I2CErrorKind.TELEMETRY_SNAPSHOT) {
+                return Promise.reject("IO Error");
+            }
+
+            return Promise.resolve(Buffer.from(this._servedBlock));
+        }
+
+        return super.readBlock(cmd, length);
+    }
+
+    public async writeBlock(cmd: number, data: Buffer): Promise<void> {
+        await super.writeBlock(cmd, data);
+
+        if (cmd !== this._commandStart || data.length !== this._session.schema.commandBlock.length) {
+            return;
+        }
+
+        // Like the firmware, only apply (and acknowledge) intact blocks
+        if (crc8(data, 0, data.length - 1) !== data[data.length - 1]) {
+            return;
+        }
+
+        this._commandAck = data[RomiShmemBuffer.commandSeq.offset - this._commandStart];
+        this._updateServedBlock();
+
+        this._commandListeners.forEach(listener => {
+            listener(data, this._timeMs);
+        });
+    }
+
+    /**
+     * Rebuild the block the bus reads back. Command acks come from this
+     * replay rather than the recording, since the robot's sequence numbers
+     * won't line up with the recorded ones
+     */
+    private _updateServedBlock(): void {
+        if (this._lastGoodIdx >= 0) {
+            this._servedBlock.set(this._session.telemetryBlock(this._lastGoodIdx));
+        }
+
+        const length = this._servedBlock.length;
+        this._servedBlock[RomiShmemBuffer.commandAck.offset - this._telemetryStart] = this._commandAck;
+        this._servedBlock[length - 1] = crc8(this._servedBlock, 0, length - 1);
+
+        if (this._telemetryIdx >= 0 &&
+            this._session.telemetryEvents[this._telemetryIdx] === I2CErrorKind.TELEMETRY_CRC) {
+            this._servedBlock[length - 1] ^= 0xFF;
+        }
+
+        this.setBufferBytes(this._telemetryStart, this._servedBlock);
+    }
+}
@@ -0,0 +1,48 @@
+import { performance } from "perf_hooks";
+import { Vector3 } from "../robot/devices/core/lsm6/lsm6";
+import MockLSM6, { MAX_FIFO_FRAMES } from "./mock-lsm6";
+
+/**
+ * Mock LSM6DS33 whose FIFO fills up in real time
+ *
+ * Frames arrive at a fixed output data rate (which doesn't have to be
+ * one the robot configures), all with the same gyro and accelerometer
+ * values
+ */
+export default class StreamingRomiImu extends MockLSM6 {
+    private _odrHz: number;
+    private _startTime: number = performance.now();
+    private _producedFrames: number = 0;
+
+    private _gyroDPS: Vector3 = { x: 0, y: 0, z: 0 };
+    private _accelG: Vector3 = { x: 0, y: 0, z: 1 };
+
+    /**
+     * @param odrHz Frames per second into the FIFO (0 leaves it empty)
+     */
+    constructor(address: number, odrHz: number) {
+        super(address);
+        this._odrHz = odrHz;
+    }
+
+    /**
+     * Values for all frames from now on
+     */
+    public setFrame(gyroDPS: Vector3, accelG: Vector3): void {
+        this._gyroDPS = { ...gyroDPS };
+        this._accelG = { ...accelG };
+    }
+
+    protected _fillFIFO(): void {
+        const dueFrames = Math.floor(((performance.now() - this._startTime) * this._odrHz) / 1000);
+
+        // Frames from more than a full FIFO ago would only be overwritten.
+        // One more than fits still goes in, so the overrun is flagged
+        this._producedFrames = Math.max(this._producedFrames, dueFrames - MAX_FIFO_FRAMES - 1);
+
+        for (; this._producedFrames < dueFrames; this._producedFrames++) {
+            this._pushFrame(this._gyroDPS.x, this._gyroDPS.y, this._gyroDPS.z,
+                            this._accelG.x, this._accelG.y, this._accelG.z);
+        }
+    }
+}
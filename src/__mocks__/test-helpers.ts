@@ -0,0 +1,69 @@
+import RomiDataBuffer from "../robot/romi-shmem-buffer";
+import { COMMAND_BLOCK_LENGTH, COMMAND_BLOCK_START, TELEMETRY_BLOCK_LENGTH, TELEMETRY_BLOCK_START } from "../robot/romi-shmem-protocol";
+import { crc8 } from "../utils/crc8";
+import MockRomiI2C from "./mock-romi";
+
+// Fixtures shared between the tests. This lives outside __tests__ so
+// that jest doesn't try to run it as a test suite
+
+/**
+ * Build a command block, with its CRC, as the host would write it
+ */
+export function commandBlock(seq: number, leftMotor: number, rightMotor: number, flags: number): Buffer {
+    const block = Buffer.alloc(COMMAND_BLOCK_LENGTH);
+    block[RomiDataBuffer.commandSeq.offset - COMMAND_BLOCK_START] = seq;
+    block[RomiDataBuffer.commandFlags.offset - COMMAND_BLOCK_START] = flags;
+    block.writeInt16LE(leftMotor, RomiDataBuffer.leftMotor.offset - COMMAND_BLOCK_START);
+    block.writeInt16LE(rightMotor, RomiDataBuffer.rightMotor.offset - COMMAND_BLOCK_START);
+    block[COMMAND_BLOCK_LENGTH - 1] = crc8(block, 0, COMMAND_BLOCK_LENGTH - 1);
+
+    return block;
+}
+
+/**
+ * Set the encoder counts in a mock Romi's telemetry block, keeping its
+ * CRC valid
+ */
+export function setEncoderCounts(romi: MockRomiI2C, left: number, right: number): void {
+    const block = romi.getBufferBytes(TELEMETRY_BLOCK_START, TELEMETRY_BLOCK_LENGTH);
+    block.writeInt16LE(left, RomiDataBuffer.leftEncoder.offset - TELEMETRY_BLOCK_START);
+    block.writeInt16LE(right, RomiDataBuffer.rightEncoder.offset - TELEMETRY_BLOCK_START);
+    block[TELEMETRY_BLOCK_LENGTH - 1] = crc8(block, 0, TELEMETRY_BLOCK_LENGTH - 1);
+    romi.setBufferBytes(TELEMETRY_BLOCK_START, block);
+}
+
+/**
+ * Set the motion profile state and progress (in encoder ticks) in a mock
+ * Romi's telemetry block, keeping its CRC valid
+ */
+export function setMotionStatus(romi: MockRomiI2C, state: number, progressTicks: number): void {
+    const block = romi.getBufferBytes(TELEMETRY_BLOCK_START, TELEMETRY_BLOCK_LENGTH);
+    block[RomiDataBuffer.motionState.offset - TELEMETRY_BLOCK_START] = state;
+    block.writeInt16LE(progressTicks, RomiDataBuffer.motionProgress.offset - TELEMETRY_BLOCK_START);
+    block[TELEMETRY_BLOCK_LENGTH - 1] = crc8(block, 0, TELEMETRY_BLOCK_LENGTH - 1);
+    romi.setBufferBytes(TELEMETRY_BLOCK_START, block);
+}
+
+/**
+ * Let queued I2C operations reach the bus
+ */
+export function settle(ms: number = 10): Promise<void> {
+    return new Promise(resolve => setTimeout(resolve, ms));
+}
+
+/**
+ * Deterministic noise in [-0.5, 0.5), so that tests come out the same on
+ * every run
+ */
+export class NoiseGenerator {
+    private _seed: number;
+
+    constructor(seed: number = 1234) {
+        this._seed = seed;
+    }
+
+    public next(): number {
+        this._seed = (this._seed * 1103515245 + 12345) & 0x7FFFFFFF;
+        return (this._seed / 0x7FFFFFFF) - 0.5;
+    }
+}
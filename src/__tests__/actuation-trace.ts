@@ -0,0 +1,86 @@
+import ActuationTrace from "../benchmarks/actuation-trace";
+
+describe("Actuation Trace", () => {
+    it("should time each stage of a sample", () => {
+        const trace = new ActuationTrace();
+
+        trace.sent(0);
+        trace.received(1);
+        trace.queued(5, 3);
+        trace.written(5, 6);
+        trace.applied(5, 10);
+
+        const result = trace.result();
+        expect(result.sent).toBe(1);
+        expect(result.applied).toBe(1);
+        expect(result.lost).toBe(0);
+        expect(result.total.maxMs).toBe(10);
+        expect(result.stages.received.p50Ms).toBe(1);
+        expect(result.stages.queued.p50Ms).toBe(2);
+        expect(result.stages.written.p50Ms).toBe(3);
+        expect(result.stages.applied.p50Ms).toBe(4);
+    });
+
+    it("should match coalesced samples to the block that carried them", () => {
+        const trace = new ActuationTrace();
+
+        trace.sent(0);
+        trace.sent(1);
+        trace.received(2);
+        trace.received(3);
+        trace.queued(7, 4);
+        trace.written(7, 5);
+        trace.applied(7, 6);
+
+        const result = trace.result();
+        expect(result.applied).toBe(2);
+        expect(result.total.p50Ms).toBe(5);
+        expect(result.total.maxMs).toBe(6);
+    });
+
+    it("should count samples on blocks the firmware skipped as superseded", () => {
+        const trace = new ActuationTrace();
+
+        trace.sent(0);
+        trace.received(1);
+        trace.queued(1, 2);
+
+        trace.sent(3);
+        trace.received(4);
+        trace.queued(2, 5);
+
+        // Only the second block gets through
+        trace.written(2, 6);
+        trace.applied(2, 7);
+
+        // Still outstanding at the end
+        trace.sent(8);
+        trace.received(9);
+
+        const result = trace.result();
+        expect(result.sent).toBe(3);
+        expect(result.applied).toBe(1);
+        expect(result.superseded).toBe(1);
+        expect(result.lost).toBe(1);
+        expect(result.total.maxMs).toBe(4);
+    });
+
+    it("should follow samples onto resent blocks", () => {
+        const trace = new ActuationTrace();
+
+        trace.sent(0);
+        trace.received(1);
+        trace.queued(3, 2);
+
+        // Resent with a new sequence number, and only that one applied
+        trace.queued(4, 12);
+        trace.written(4, 13);
+        trace.applied(4, 14);
+
+        const result = trace.result();
+        expect(result.resends).toBe(1);
+        expect(result.applied).toBe(1);
+        expect(result.superseded).toBe(0);
+        expect(result.total.maxMs).toBe(14);
+    });
+});
@@ -0,0 +1,28 @@
+import { crc8 } from "../utils/crc8";
+
+describe("CRC-8", () => {
+    it("should match the standard check value", () => {
+        // CRC-8 (poly 0x07, init 0) of "123456789" is 0xF4
+        expect(crc8(Buffer.from("123456789"))).toBe(0xF4);
+    });
+
+    it("should be 0 for an all-zero buffer", () => {
+        expect(crc8(Buffer.alloc(16))).toBe(0);
+    });
+
+    it("should only cover the requested range", () => {
+        const buf = Buffer.from("xx123456789yy");
+        expect(crc8(buf, 2, buf.length - 2)).toBe(0xF4);
+    });
+
+    it("should detect a single bit flip", () => {
+        const buf = Buffer.from([0x12, 0x34, 0x56, 0x78]);
+        const original = crc8(buf);
+
+        for (let i = 0; i < buf.length * 8; i++) {
+            const corrupted = Buffer.from(buf);
+            corrupted[i >> 3] ^= (1 << (i & 7));
+            expect(crc8(corrupted)).not.toBe(original);
+        }
+    });
+});
@@ -0,0 +1,162 @@
+import MockI2C from "../device-interfaces/i2c/mock-i2c";
+import MockI2CDevice from "../device-interfaces/i2c/mock-i2c-device";
+import QueuedI2CBus, { QueuedI2CHandle } from "../device-interfaces/i2c/queued-i2c-bus";
+import CustomDevice, { IOInterfaces, RobotHardwareInterfaces } from "../robot/devices/custom/custom-device";
+import CustomDeviceScheduler from "../robot/devices/custom/custom-device-scheduler";
+import { estimateTransferUs } from "../robot/polling-rates";
+
+class RegisterBank extends MockI2CDevice {
+    public readByte(cmd: number): Promise<number> {
+        return Promise.resolve(cmd);
+    }
+
+    public readWord(cmd: number): Promise<number> {
+        return Promise.resolve(cmd);
+    }
+
+    public writeByte(cmd: number, byte: number): Promise<void> {
+        return Promise.resolve();
+    }
+
+    public writeWord(cmd: number, word: number): Promise<void> {
+        return Promise.resolve();
+    }
+
+    public sendByte(cmd: number): Promise<void> {
+        return Promise.resolve();
+    }
+
+    public receiveByte(): Promise<number> {
+        return Promise.resolve(0);
+    }
+}
+
+// Reads a block of registers on each update
+class BlockReadDevice extends CustomDevice {
+    public updates: number = 0;
+
+    private _handle: QueuedI2CHandle;
+    private _blockLength: number;
+    private _rateHz: number | undefined;
+
+    constructor(name: string, robotHW: RobotHardwareInterfaces, address: number, blockLength: number, rateHz?: number) {
+        super(name, false, robotHW);
+
+        this._handle = this.getI2CHandle(address);
+        this._blockLength = blockLength;
+        this._rateHz = rateHz;
+    }
+
+    public get ioInterfaces(): IOInterfaces {
+        return {};
+    }
+
+    public get updateRateHz(): number | undefined {
+        return this._rateHz;
+    }
+
+    public async update(): Promise<void> {
+        await this._handle.readBlock(0, this._blockLength);
+        this.updates++;
+    }
+}
+
+// Stands in for control loop devices such as another Romi board
+class EssentialBlockReadDevice extends BlockReadDevice {
+    public get isEssential(): boolean {
+        return true;
+    }
+}
+
+describe("Custom Device Scheduler", () => {
+    let robotHW: RobotHardwareInterfaces;
+
+    beforeEach(() => {
+        const bus = new MockI2C(1);
+        bus.addDeviceToBus(new RegisterBank(0x40));
+        bus.addDeviceToBus(new RegisterBank(0x41));
+        robotHW = { i2cBus: new QueuedI2CBus(bus) };
+    });
+
+    it("should use configured, then declared, then default rates", () => {
+        const scheduler = new CustomDeviceScheduler(1, () => 20);
+        const declared = new BlockReadDevice("declared", robotHW, 0x40, 4, 10);
+        const configured = new BlockReadDevice("configured", robotHW, 0x40, 4, 10);
+        const undeclared = new BlockReadDevice("undeclared", robotHW, 0x41, 4);
+
+        scheduler.addDevice(declared);
+        scheduler.addDevice(configured, 25);
+        scheduler.addDevice(undeclared);
+
+        expect(scheduler.periodMs(declared)).toBeCloseTo(100);
+        expect(scheduler.periodMs(configured)).toBeCloseTo(40);
+        expect(scheduler.periodMs(undeclared)).toBeCloseTo(20);
+    });
+
+    it("should account for the bus time of each update", async () => {
+        const scheduler = new CustomDeviceScheduler();
+        const device = new BlockReadDevice("device", robotHW, 0x40, 16, 10);
+        scheduler.addDevice(device);
+
+        await scheduler.runUpdate(device);
+        await scheduler.runUpdate(device);
+
+        const stats = scheduler.stats.devices[0];
+        expect(stats.updates).toBe(2);
+        expect(stats.busTimeUs).toBeCloseTo(estimateTransferUs(1, 16));
+        expect(device.busTimeUs).toBeCloseTo(2 * estimateTransferUs(1, 16));
+    });
+
+    it("should slow every device down by the same factor to fit the budget", async () => {
+        const scheduler = new CustomDeviceScheduler(0.01, () => 20);
+        const chatty = new BlockReadDevice("chatty", robotHW, 0x40, 32, 100);
+        const quiet = new BlockReadDevice("quiet", robotHW, 0x41, 2);
+        scheduler.addDevice(chatty);
+        scheduler.addDevice(quiet);
+
+        await scheduler.runUpdate(chatty);
+        await scheduler.runUpdate(quiet);
+        scheduler.update(0);
+
+        const demand = (estimateTransferUs(1, 32) / 10000) + (estimateTransferUs(1, 2) / 20000);
+        const scale = demand / 0.01;
+        expect(scheduler.stats.budgetScale).toBeCloseTo(scale);
+        expect(scheduler.stats.busUtilization).toBeCloseTo(0.01);
+        expect(scheduler.periodMs(chatty)).toBeCloseTo(10 * scale);
+        expect(scheduler.periodMs(quiet)).toBeCloseTo(20 * scale);
+    });
+
+    it("should leave essential devices out of the budget", async () => {
+        const scheduler = new CustomDeviceScheduler(0.01, () => 20);
+        const chatty = new BlockReadDevice("chatty", robotHW, 0x40, 32, 100);
+        const essential = new EssentialBlockReadDevice("essential", robotHW, 0x41, 32, 100);
+        scheduler.addDevice(chatty);
+        scheduler.addDevice(essential);
+
+        await scheduler.runUpdate(chatty);
+        await scheduler.runUpdate(essential);
+        scheduler.update(0);
+
+        const scale = (estimateTransferUs(1, 32) / 10000) / 0.01;
+        expect(scheduler.stats.budgetScale).toBeCloseTo(scale);
+        expect(scheduler.periodMs(chatty)).toBeCloseTo(10 * scale);
+        expect(scheduler.periodMs(essential)).toBeCloseTo(10);
+    });
+
+    it("should report the achieved update rates", async () => {
+        const scheduler = new CustomDeviceScheduler();
+        const device = new BlockReadDevice("device", robotHW, 0x40, 4, 50);
+        scheduler.addDevice(device);
+
+        scheduler.update(0);
+        for (let i = 0; i < 10; i++) {
+            await scheduler.runUpdate(device);
+        }
+        scheduler.update(500);
+
+        const stats = scheduler.stats.devices[0];
+        expect(stats.rateHz).toBeCloseTo(20);
+        expect(stats.targetRateHz).toBeCloseTo(50);
+        expect(stats.busUtilization).toBeCloseTo(10 * estimateTransferUs(1, 4) / 500000);
+    });
+});
@@ -0,0 +1,122 @@
+import I2CBusTimingModel, { I2CClockSpeed } from "../../device-interfaces/i2c/bus-timing";
+import MockI2C from "../../device-interfaces/i2c/mock-i2c";
+import MockI2CDevice from "../../device-interfaces/i2c/mock-i2c-device";
+import { I2CBatchOpType } from "../../device-interfaces/i2c/i2c-batch";
+import QueuedI2CBus from "../../device-interfaces/i2c/queued-i2c-bus";
+import { BusBenchmarkConfig, runBusBenchmark } from "../../benchmarks/bus-benchmark";
+
+class RegisterDevice extends MockI2CDevice {
+    public readByte(cmd: number): Promise<number> {
+        return Promise.resolve(cmd);
+    }
+    public readWord(cmd: number): Promise<number> {
+        return Promise.resolve(cmd);
+    }
+    public writeByte(cmd: number, byte: number): Promise<void> {
+        return Promise.resolve();
+    }
+    public writeWord(cmd: number, word: number): Promise<void> {
+        return Promise.resolve();
+    }
+    public sendByte(cmd: number): Promise<void> {
+        return Promise.resolve();
+    }
+    public receiveByte(): Promise<number> {
+        return Promise.resolve(0);
+    }
+}
+
+describe("I2C Bus Timing", () => {
+    it("should time transactions from the bus clock", () => {
+        // 10us bits: START + address + 2 bytes + STOP
+        const standard = new I2CBusTimingModel({ clockHz: I2CClockSpeed.STANDARD });
+        expect(standard.transactionUs({ bytes: 2, starts: 1 })).toBeCloseTo(10 + 90 + 180 + 10);
+
+        const fast = new I2CBusTimingModel({ clockHz: I2CClockSpeed.FAST, transactionOverheadUs: 20 });
+        expect(fast.transactionUs({ bytes: 2, starts: 1 })).toBeCloseTo(20 + ((10 + 90 + 180 + 10) / 4));
+    });
+
+    it("should accumulate bus time and utilization", async () => {
+        const bus = new MockI2C(1, false, { clockHz: I2CClockSpeed.STANDARD });
+        bus.addDeviceToBus(new RegisterDevice(0x14));
+        const model = bus.timingModel;
+
+        await bus.writeByte(0x14, 1, 2);
+        expect(model.nowUs).toBeCloseTo(290);
+
+        // Romi reads pause between the register write and the read
+        await bus.readByte(0x14, 1, true);
+        expect(bus.timingStats.busTimeUs).toBeCloseTo(290 + 200 + model.romiTurnaroundUs + 200);
+        expect(bus.timingStats.utilization).toBeCloseTo(1);
+
+        model.advanceTo(bus.timingStats.busTimeUs * 2);
+        expect(bus.timingStats.utilization).toBeCloseTo(0.5);
+    });
+
+    it("should charge post-operation holds in batches", async () => {
+        const bus = new MockI2C(1, false, { clockHz: I2CClockSpeed.FAST });
+        bus.addDeviceToBus(new RegisterDevice(0x14));
+        const model = bus.timingModel;
+
+        await bus.executeBatch([{ type: I2CBatchOpType.WRITE_BYTE, addr: 0x14, cmd: 1, value: 2, delayUs: 50000 }]);
+
+        // The hold moves the virtual clock on, with the bus busy throughout
+        const writeUs = model.transactionUs({ bytes: 2, starts: 1 });
+        expect(model.nowUs).toBeCloseTo(writeUs + 50000);
+        expect(bus.timingStats.busTimeUs).toBeCloseTo(writeUs + 50000);
+        expect(bus.timingStats.utilization).toBeCloseTo(1);
+    });
+
+    it("should inject NACKs repeatably", async () => {
+        const runTransfers = async () => {
+            const bus = new MockI2C(1, false, { clockHz: I2CClockSpeed.FAST, nackRate: 0.2, seed: 42 });
+            bus.addDeviceToBus(new RegisterDevice(0x14));
+
+            const failures: number[] = [];
+            for (let i = 0; i < 200; i++) {
+                await bus.readByte(0x14, 0).catch(() => failures.push(i));
+            }
+
+            expect(bus.timingStats.nacks).toBe(failures.length);
+            return failures;
+        };
+
+        const first = await runTransfers();
+        expect(first.length).toBeGreaterThan(20);
+        expect(first.length).toBeLessThan(60);
+        expect(await runTransfers()).toEqual(first);
+    });
+
+    it("should take fewer transactions when merging reads", async () => {
+        const countTransactions = async (mergeReads: boolean) => {
+            const bus = new MockI2C(1, false, { clockHz: I2CClockSpeed.FAST });
+            bus.addDeviceToBus(new RegisterDevice(0x14));
+            const queue = new QueuedI2CBus(bus, { mergeReads });
+
+            await Promise.all([0, 2, 4, 6].map(cmd => queue.readWord(0x14, cmd, true)));
+            return bus.timingStats.transactions;
+        };
+
+        expect(await countTransactions(true)).toBeLessThan(await countTransactions(false));
+    });
+
+    it("should report achievable poll rates", async () => {
+        const config: BusBenchmarkConfig = {
+            name: "test",
+            timing: { clockHz: I2CClockSpeed.FAST },
+            telemetryHz: 1000, imuHz: 104, actuationHz: 50,
+            durationMs: 500
+        };
+
+        const fast = await runBusBenchmark(config);
+        const standard = await runBusBenchmark({ ...config, timing: { clockHz: I2CClockSpeed.STANDARD } });
+
+        expect(standard.telemetry.achievedHz).toBeLessThan(fast.telemetry.achievedHz);
+        expect(fast.imu.achievedHz).toBeCloseTo(104, -1);
+        expect(fast.actuation.achievedHz).toBeCloseTo(50, -1);
+
+        // Actuation goes first, so it waits at most for the batch in flight
+        expect(fast.actuation.maxLatencyMs).toBeLessThan(fast.telemetry.maxLatencyMs + 1);
+        expect(fast.bus.utilization).toBeLessThanOrEqual(1);
+    });
+});
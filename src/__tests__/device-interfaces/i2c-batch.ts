@@ -0,0 +1,116 @@
+import { executeI2CBatch, I2CBatchOpType, SyncI2CBus } from "../../device-interfaces/i2c/i2c-batch";
+
+// Register based device that records every transfer made on it
+class SyncTestBus implements SyncI2CBus {
+    public registers: Buffer = Buffer.alloc(256);
+    public transfers: string[] = [];
+    public transferTimes: [number, number][] = [];
+
+    private _readPointer: number = 0;
+
+    private _record(transfer: string): void {
+        this.transfers.push(transfer);
+        this.transferTimes.push(process.hrtime());
+    }
+
+    public readByteSync(addr: number, cmd: number): number {
+        this._record(`readByte ${cmd}`);
+        return this.registers[cmd];
+    }
+    public readWordSync(addr: number, cmd: number): number {
+        this._record(`readWord ${cmd}`);
+        return this.registers.readUInt16LE(cmd);
+    }
+    public readI2cBlockSync(addr: number, cmd: number, length: number, buffer: Buffer): number {
+        this._record(`readI2cBlock ${cmd} ${length}`);
+        return this.registers.copy(buffer, 0, cmd, cmd + length);
+    }
+    public writeByteSync(addr: number, cmd: number, byte: number): void {
+        this._record(`writeByte ${cmd}`);
+        this.registers[cmd] = byte;
+    }
+    public writeWordSync(addr: number, cmd: number, word: number): void {
+        this._record(`writeWord ${cmd}`);
+        this.registers.writeUInt16LE(word, cmd);
+    }
+    public sendByteSync(addr: number, byte: number): void {
+        this._record(`sendByte ${byte}`);
+        this._readPointer = byte;
+    }
+    public receiveByteSync(addr: number): number {
+        this._record("receiveByte");
+        return this.registers[this._readPointer++];
+    }
+    public i2cReadSync(addr: number, length: number, buffer: Buffer): number {
+        if (addr !== 0x14) {
+            throw new Error("Remote I/O error");
+        }
+
+        this._record(`i2cRead ${length}`);
+        const bytesRead = this.registers.copy(buffer, 0, this._readPointer, this._readPointer + length);
+        this._readPointer += length;
+        return bytesRead;
+    }
+    public i2cWriteSync(addr: number, length: number, buffer: Buffer): number {
+        this._record(`i2cWrite ${length}`);
+        buffer.copy(this.registers, buffer[0], 1, length);
+        return length;
+    }
+}
+
+describe("I2C Batch Executor", () => {
+    it("should read from a romi with a single transfer after the address", () => {
+        const bus = new SyncTestBus();
+        bus.registers.writeUInt16LE(0xBEEF, 0x10);
+        bus.registers[0x20] = 0x12;
+        bus.registers[0x21] = 0x34;
+
+        const results = executeI2CBatch(bus, [
+            { type: I2CBatchOpType.READ_WORD, addr: 0x14, cmd: 0x10, romiMode: true },
+            { type: I2CBatchOpType.READ_BLOCK, addr: 0x14, cmd: 0x20, length: 2, romiMode: true }
+        ], 0);
+
+        expect(results[0].value).toEqual(0xBEEF);
+        expect(Array.from(results[1].data)).toEqual([0x12, 0x34]);
+        expect(bus.transfers).toEqual(["sendByte 16", "i2cRead 2", "sendByte 32", "i2cRead 2"]);
+    });
+
+    it("should use SMBus transfers for other devices", () => {
+        const bus = new SyncTestBus();
+
+        const results = executeI2CBatch(bus, [
+            { type: I2CBatchOpType.WRITE_BYTE, addr: 0x6B, cmd: 0x1, value: 0xAA },
+            { type: I2CBatchOpType.WRITE_BLOCK, addr: 0x6B, cmd: 0x2, data: new Uint8Array([0xBB, 0xCC]) },
+            { type: I2CBatchOpType.READ_BLOCK, addr: 0x6B, cmd: 0x1, length: 3 }
+        ]);
+
+        expect(Array.from(results[2].data)).toEqual([0xAA, 0xBB, 0xCC]);
+        expect(bus.transfers).toEqual(["writeByte 1", "i2cWrite 3", "readI2cBlock 1 3"]);
+    });
+
+    it("should wait between the address write and the read", () => {
+        const bus = new SyncTestBus();
+
+        executeI2CBatch(bus, [
+            { type: I2CBatchOpType.READ_BYTE, addr: 0x14, cmd: 0x0, romiMode: true }
+        ], 500);
+
+        const [start, end] = bus.transferTimes;
+        const elapsedUs = ((end[0] - start[0]) * 1e6) + ((end[1] - start[1]) / 1000);
+        expect(elapsedUs).toBeGreaterThanOrEqual(500);
+    });
+
+    it("should keep going after a failed operation", () => {
+        const bus = new SyncTestBus();
+        bus.registers[0x5] = 0x55;
+
+        const results = executeI2CBatch(bus, [
+            { type: I2CBatchOpType.READ_BYTE, addr: 0x15, cmd: 0x0, romiMode: true },
+            { type: I2CBatchOpType.READ_BYTE, addr: 0x14, cmd: 0x5, romiMode: true }
+        ], 0);
+
+        expect(results[0].error).toEqual("Remote I/O error");
+        expect(results[1].error).toBeUndefined();
+        expect(results[1].value).toEqual(0x55);
+    });
+});
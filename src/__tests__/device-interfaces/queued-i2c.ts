@@ -1,6 +1,6 @@
 import MockI2CDevice from "../../device-interfaces/i2c/mock-i2c-device";
 import MockI2C, { MockI2CBusEvent, MockI2CBusEventType } from "../../device-interfaces/i2c/mock-i2c";
-import QueuedI2CBus from "../../device-interfaces/i2c/queued-i2c-bus";
+import QueuedI2CBus, { I2CPriority } from "../../device-interfaces/i2c/queued-i2c-bus";
 
 enum DataSize {
     BYTE,
@@ -90,6 +90,31 @@ class TestDevice extends MockI2CDevice {
     }
 }
 
+class RegisterDevice extends MockI2CDevice {
+    public registers: Buffer = Buffer.alloc(256);
+
+    public readByte(cmd: number): Promise<number> {
+        return Promise.resolve(this.registers[cmd]);
+    }
+    public readWord(cmd: number): Promise<number> {
+        return Promise.resolve(this.registers.readUInt16LE(cmd));
+    }
+    public writeByte(cmd: number, byte: number): Promise<void> {
+        this.registers[cmd] = byte;
+        return Promise.resolve();
+    }
+    public writeWord(cmd: number, word: number): Promise<void> {
+        this.registers.writeUInt16LE(word, cmd);
+        return Promise.resolve();
+    }
+    public sendByte(cmd: number): Promise<void> {
+        return Promise.resolve();
+    }
+    public receiveByte(): Promise<number> {
+        return Promise.resolve(0);
+    }
+}
+
 describe("Queued I2C Bus", () => {
     let mockBus: MockI2C;
     let queuedBus: QueuedI2CBus;
@@ -210,4 +235,117 @@ describe("Queued I2C Bus", () => {
 
         done();
     });
+
+    it("should run higher priority operations first", async (done) => {
+        const addr = 0x10;
+
+        const testDevice: RegisterDevice = new RegisterDevice(addr);
+        mockBus.addDeviceToBus(testDevice);
+
+        const events: MockI2CBusEvent[] = [];
+        mockBus.addListener(evt => {
+            events.push(evt);
+        });
+
+        // The first operation goes straight out, everything else waits
+        await Promise.all([
+            queuedBus.readByte(addr, 0x1, false, I2CPriority.TELEMETRY),
+            queuedBus.readByte(addr, 0x2, false, I2CPriority.CUSTOM_DEVICE),
+            queuedBus.readByte(addr, 0x3, false, I2CPriority.TELEMETRY),
+            queuedBus.writeByte(addr, 0x4, 0xAA, 0, I2CPriority.ACTUATION)
+        ]);
+
+        expect(events.map(evt => evt.cmd)).toEqual([0x1, 0x4, 0x3, 0x2]);
+        expect(queuedBus.stats.ACTUATION.completed).toEqual(1);
+        expect(queuedBus.stats.TELEMETRY.completed).toEqual(2);
+        expect(queuedBus.stats.CUSTOM_DEVICE.completed).toEqual(1);
+
+        done();
+    });
+
+    it("should take turns between devices at the same priority", async (done) => {
+        const firstDevice: RegisterDevice = new RegisterDevice(0x14);
+        const secondDevice: RegisterDevice = new RegisterDevice(0x15);
+        mockBus.addDeviceToBus(firstDevice);
+        mockBus.addDeviceToBus(secondDevice);
+
+        const events: MockI2CBusEvent[] = [];
+        mockBus.addListener(evt => {
+            events.push(evt);
+        });
+
+        // The first device queues up all of its reads before the second
+        // device gets a look in, but they still alternate on the bus
+        await Promise.all([
+            queuedBus.readByte(0x14, 0x1),
+            queuedBus.readByte(0x14, 0x2),
+            queuedBus.readByte(0x14, 0x3),
+            queuedBus.readByte(0x15, 0x1),
+            queuedBus.readByte(0x15, 0x2)
+        ]);
+
+        expect(events.map(evt => [evt.address, evt.cmd])).toEqual([
+            [0x14, 0x1], [0x15, 0x1], [0x14, 0x2], [0x15, 0x2], [0x14, 0x3]
+        ]);
+
+        done();
+    });
+
+    it("should collapse repeated writes to the same register", async (done) => {
+        const addr = 0x10;
+
+        const testDevice: RegisterDevice = new RegisterDevice(addr);
+        mockBus.addDeviceToBus(testDevice);
+
+        const writes: number[] = [];
+        mockBus.addListener(evt => {
+            if (evt.eventType === MockI2CBusEventType.WRITE_WORD) {
+                writes.push(evt.data);
+            }
+        });
+
+        await Promise.all([
+            queuedBus.readByte(addr, 0x0),
+            queuedBus.writeWord(addr, 0x2, 0x1111),
+            queuedBus.writeWord(addr, 0x2, 0x2222),
+            queuedBus.writeWord(addr, 0x2, 0x3333)
+        ]);
+
+        expect(writes).toEqual([0x3333]);
+        expect(testDevice.registers.readUInt16LE(0x2)).toEqual(0x3333);
+        expect(queuedBus.stats.TELEMETRY.collapsedWrites).toEqual(2);
+
+        done();
+    });
+
+    it("should merge adjacent reads on a romi", async (done) => {
+        const addr = 0x14;
+
+        const testDevice: RegisterDevice = new RegisterDevice(addr);
+        testDevice.registers[0x10] = 0x12;
+        testDevice.registers.writeUInt16LE(0xBEEF, 0x11);
+        testDevice.registers[0x13] = 0x34;
+        mockBus.addDeviceToBus(testDevice);
+
+        const events: MockI2CBusEvent[] = [];
+        mockBus.addListener(evt => {
+            events.push(evt);
+        });
+
+        const results = await Promise.all([
+            queuedBus.readByte(addr, 0x0, true),
+            queuedBus.readByte(addr, 0x10, true),
+            queuedBus.readWord(addr, 0x11, true),
+            queuedBus.readByte(addr, 0x13, true)
+        ]);
+
+        expect(results).toEqual([0x0, 0x12, 0xBEEF, 0x34]);
+        expect(events.length).toEqual(2);
+        expect(events[1].eventType).toEqual(MockI2CBusEventType.READ_BLOCK);
+        expect(events[1].cmd).toEqual(0x10);
+        expect(events[1].data).toEqual(4);
+        expect(queuedBus.stats.TELEMETRY.mergedReads).toEqual(2);
+
+        done();
+    });
 });
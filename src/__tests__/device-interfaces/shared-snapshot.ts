@@ -0,0 +1,48 @@
+import SharedSnapshot from "../../device-interfaces/i2c/shared-snapshot";
+
+describe("Shared Snapshot", () => {
+    it("should return the latest sample", () => {
+        const snapshot = new SharedSnapshot(4);
+        const target = new Uint8Array(4);
+
+        snapshot.write(new Uint8Array([1, 2, 3, 4]));
+        snapshot.write(new Uint8Array([5, 6, 7, 8]));
+
+        const info = snapshot.read(target);
+        expect(info).toEqual({ sampleCount: 2, error: false });
+        expect(Array.from(target)).toEqual([5, 6, 7, 8]);
+    });
+
+    it("should keep the last good data after a failed sample", () => {
+        const snapshot = new SharedSnapshot(2);
+        const target = new Uint8Array(2);
+
+        snapshot.write(new Uint8Array([1, 2]));
+        snapshot.write(null);
+
+        const info = snapshot.read(target);
+        expect(info).toEqual({ sampleCount: 2, error: true });
+        expect(Array.from(target)).toEqual([1, 2]);
+    });
+
+    it("should share data with a snapshot attached to the same buffer", () => {
+        const writer = new SharedSnapshot(2);
+        const reader = new SharedSnapshot(writer.buffer);
+        const target = new Uint8Array(2);
+
+        writer.write(new Uint8Array([0xDE, 0xAD]));
+
+        expect(reader.read(target).sampleCount).toEqual(1);
+        expect(Array.from(target)).toEqual([0xDE, 0xAD]);
+    });
+
+    it("should not return data while a write is in progress", () => {
+        const snapshot = new SharedSnapshot(2);
+        const target = new Uint8Array(2);
+
+        // Leave the sequence number odd, as if the writer stopped part way
+        Atomics.add(new Int32Array(snapshot.buffer, 0, 1), 0, 1);
+
+        expect(snapshot.read(target)).toBeNull();
+    });
+});
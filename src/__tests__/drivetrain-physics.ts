@@ -0,0 +1,135 @@
+import DrivetrainModel, { ROMI_DRIVETRAIN_PARAMS } from "../__mocks__/drivetrain-model";
+import PhysicsRomiSim from "../__mocks__/physics-romi";
+import MockRomiI2C from "../__mocks__/mock-romi";
+import MockRomiImu from "../__mocks__/mock-imu";
+import { commandBlock } from "../__mocks__/test-helpers";
+import RomiDataBuffer from "../robot/romi-shmem-buffer";
+import {
+    COMMAND_BLOCK_LENGTH,
+    COMMAND_BLOCK_START,
+    COMMAND_FLAG_HEARTBEAT,
+    TELEMETRY_BLOCK_LENGTH,
+    TELEMETRY_BLOCK_START
+} from "../robot/romi-shmem-protocol";
+import { crc8 } from "../utils/crc8";
+
+describe("Drivetrain Model", () => {
+    it("should drive straight, and sag the battery, at full power", () => {
+        const model = new DrivetrainModel();
+        const restVolts = model.batteryVolts;
+
+        model.step(0.05, 1, 1);
+        expect(model.batteryVolts).toBeLessThan(restVolts - 0.5);
+
+        model.step(1.95, 1, 1);
+        expect(model.velocityMps).toBeGreaterThan(0.5);
+        expect(model.velocityMps).toBeLessThan(1.5);
+        expect(model.pose.y).toBeCloseTo(0, 6);
+        expect(model.left.encoderCounts).toBe(model.right.encoderCounts);
+
+        // Encoder distance matches the distance travelled, give or take slip
+        const wheelCircumference = 2 * Math.PI * ROMI_DRIVETRAIN_PARAMS.wheelRadiusM;
+        const encoderDistance = model.left.encoderCounts / ROMI_DRIVETRAIN_PARAMS.encoderCountsPerRev * wheelCircumference;
+        expect(Math.abs(encoderDistance - model.pose.x)).toBeLessThan(0.05);
+    });
+
+    it("should slip the wheels when accelerating hard", () => {
+        const model = new DrivetrainModel();
+
+        model.step(0.005, 1, 1);
+        expect(model.left.slipMps).toBeGreaterThan(0.01);
+        // Traction limited
+        expect(model.accelG.x).toBeLessThanOrEqual(ROMI_DRIVETRAIN_PARAMS.frictionCoefficient);
+    });
+
+    it("should turn in place with the gyro following the heading", () => {
+        const model = new DrivetrainModel();
+
+        model.step(1, -0.5, 0.5);
+        expect(model.gyroDPS.z).toBeGreaterThan(0);
+        expect(model.pose.heading).toBeGreaterThan(0);
+        expect(Math.abs(model.pose.x)).toBeLessThan(0.001);
+        expect(model.left.encoderCounts).toBe(-model.right.encoderCounts);
+    });
+
+    it("should come to rest with the motors off", () => {
+        const model = new DrivetrainModel();
+
+        model.step(1, 1, 1);
+        model.step(2, 0, 0);
+        expect(Math.abs(model.velocityMps)).toBeLessThan(0.001);
+        expect(model.accelG.z).toBe(1);
+    });
+});
+
+describe("Physics Romi Sim", () => {
+    it("should apply command blocks, and report encoder counts and battery voltage", async () => {
+        const romi = new MockRomiI2C(0x14);
+        const imu = new MockRomiImu(0x6B);
+        const sim = new PhysicsRomiSim(romi, imu, { stepRateHz: 1000, imuOdrHz: 100 });
+
+        // Right motor is flipped on the Romi
+        await romi.writeBlock(COMMAND_BLOCK_START, commandBlock(1, 200, -200, COMMAND_FLAG_HEARTBEAT));
+        sim.advance(500);
+
+        const telemetry = romi.getBufferBytes(TELEMETRY_BLOCK_START, TELEMETRY_BLOCK_LENGTH);
+        expect(crc8(telemetry, 0, TELEMETRY_BLOCK_LENGTH - 1)).toBe(telemetry[TELEMETRY_BLOCK_LENGTH - 1]);
+        expect(telemetry[RomiDataBuffer.commandAck.offset - TELEMETRY_BLOCK_START]).toBe(1);
+
+        const leftCounts = telemetry.readInt16LE(RomiDataBuffer.leftEncoder.offset - TELEMETRY_BLOCK_START);
+        const rightCounts = telemetry.readInt16LE(RomiDataBuffer.rightEncoder.offset - TELEMETRY_BLOCK_START);
+        expect(leftCounts).toBeGreaterThan(0);
+        expect(rightCounts).toBe(leftCounts);
+
+        const batteryMV = telemetry.readUInt16LE(RomiDataBuffer.batteryMillivolts.offset - TELEMETRY_BLOCK_START);
+        expect(batteryMV).toBe(Math.round(sim.model.batteryVolts * 1000));
+
+        // One IMU frame every 10ms (including one at the start)
+        expect(imu.pendingFrames).toBe(51);
+    });
+
+    it("should stop the motors without a heartbeat", async () => {
+        const romi = new MockRomiI2C(0x14);
+        const sim = new PhysicsRomiSim(romi, new MockRomiImu(0x6B));
+
+        await romi.writeBlock(COMMAND_BLOCK_START, commandBlock(1, 200, -200, COMMAND_FLAG_HEARTBEAT));
+        sim.advance(100);
+        expect(sim.leftMotor).toBe(200);
+
+        // Default timeout is 1s
+        sim.advance(1000);
+        expect(sim.leftMotor).toBe(0);
+
+        await romi.writeByte(RomiDataBuffer.heartbeat.offset, 1);
+        sim.advance(10);
+        expect(sim.leftMotor).toBe(200);
+    });
+
+    it("should ignore command blocks that fail the CRC check", async () => {
+        const romi = new MockRomiI2C(0x14);
+        const sim = new PhysicsRomiSim(romi, new MockRomiImu(0x6B));
+
+        const block = commandBlock(1, 200, -200, COMMAND_FLAG_HEARTBEAT);
+        block[COMMAND_BLOCK_LENGTH - 1] ^= 0xFF;
+        await romi.writeBlock(COMMAND_BLOCK_START, block);
+        sim.advance(10);
+
+        expect(sim.leftMotor).toBe(0);
+        expect(romi.getBufferBytes(RomiDataBuffer.commandCrcErrors.offset, 1)[0]).toBe(1);
+    });
+
+    it("should reset the encoders when asked", async () => {
+        const romi = new MockRomiI2C(0x14);
+        const sim = new PhysicsRomiSim(romi, new MockRomiImu(0x6B));
+
+        await romi.writeBlock(COMMAND_BLOCK_START, commandBlock(1, 200, -200, COMMAND_FLAG_HEARTBEAT));
+        sim.advance(200);
+        await romi.writeByte(RomiDataBuffer.resetLeftEncoder.offset, 1);
+        sim.advance(1);
+
+        const leftCounts = romi.getBufferBytes(RomiDataBuffer.leftEncoder.offset, 2).readInt16LE(0);
+        const rightCounts = romi.getBufferBytes(RomiDataBuffer.rightEncoder.offset, 2).readInt16LE(0);
+        expect(leftCounts).toBeLessThan(rightCounts);
+        expect(romi.getIncomingBytes(RomiDataBuffer.resetLeftEncoder.offset, 1)[0]).toBe(0);
+    });
+});
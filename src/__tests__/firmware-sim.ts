@@ -0,0 +1,93 @@
+import fs from "fs";
+import FirmwareSimRomiI2C, { DEFAULT_FIRMWARE_SIM_PROGRAM, FirmwareSimInput } from "../__mocks__/firmware-sim-romi";
+import MockRomiImu from "../__mocks__/mock-imu";
+import ReplayI2C from "../device-interfaces/i2c/replay-i2c";
+import QueuedI2CBus from "../device-interfaces/i2c/queued-i2c-bus";
+import RomiRobot from "../robot/romi-robot";
+import RomiDataBuffer, { FIRMWARE_IDENT } from "../robot/romi-shmem-buffer";
+import { COMMAND_BLOCK_LENGTH, COMMAND_BLOCK_START, COMMAND_FLAG_HEARTBEAT } from "../robot/romi-shmem-protocol";
+import { commandBlock } from "../__mocks__/test-helpers";
+
+// Needs the native firmware build (`pio run -e native` in firmware/)
+const describeSim = fs.existsSync(DEFAULT_FIRMWARE_SIM_PROGRAM) ? describe : describe.skip;
+
+describeSim("Firmware Simulator", () => {
+    let sim: FirmwareSimRomiI2C;
+
+    beforeEach(async () => {
+        sim = new FirmwareSimRomiI2C(0x14);
+        await sim.advance(10);
+    });
+
+    afterEach(() => {
+        sim.close();
+    });
+
+    it("should report the firmware identifier", async () => {
+        expect(await sim.readByte(RomiDataBuffer.firmwareIdent.offset)).toBe(FIRMWARE_IDENT);
+    });
+
+    it("should apply and acknowledge valid command blocks", async () => {
+        await sim.writeBlock(COMMAND_BLOCK_START, commandBlock(1, 200, -100, COMMAND_FLAG_HEARTBEAT));
+        await sim.advance(5);
+
+        expect(await sim.readByte(RomiDataBuffer.commandAck.offset)).toBe(1);
+        const outputs = await sim.getOutputs();
+        expect(outputs.leftMotor).toBe(200);
+        expect(outputs.rightMotor).toBe(-100);
+    });
+
+    it("should reject command blocks with a bad CRC", async () => {
+        const block = commandBlock(1, 200, 200, COMMAND_FLAG_HEARTBEAT);
+        block[COMMAND_BLOCK_LENGTH - 1] ^= 0xFF;
+        await sim.writeBlock(COMMAND_BLOCK_START, block);
+        await sim.advance(5);
+
+        expect(await sim.readByte(RomiDataBuffer.commandAck.offset)).toBe(0);
+        expect(await sim.readByte(RomiDataBuffer.commandCrcErrors.offset)).toBe(1);
+        expect((await sim.getOutputs()).leftMotor).toBe(0);
+    });
+
+    it("should stop the motors when the heartbeat is lost", async () => {
+        await sim.writeWord(RomiDataBuffer.heartbeatTimeoutMs.offset, 100);
+        await sim.writeBlock(COMMAND_BLOCK_START, commandBlock(1, 150, 150, COMMAND_FLAG_HEARTBEAT));
+        await sim.advance(50);
+        expect((await sim.getOutputs()).leftMotor).toBe(150);
+
+        await sim.advance(100);
+        expect((await sim.getOutputs()).leftMotor).toBe(0);
+    });
+
+    it("should report and reset the encoders", async () => {
+        await sim.setInput(FirmwareSimInput.LEFT_ENCODER_TICKS, 1234);
+        await sim.setInput(FirmwareSimInput.RIGHT_ENCODER_TICKS, -20);
+        await sim.advance(5);
+
+        expect(await sim.readWord(RomiDataBuffer.leftEncoder.offset)).toBe(1234);
+        expect(await sim.readWord(RomiDataBuffer.rightEncoder.offset)).toBe(0xFFEC);
+
+        await sim.writeByte(RomiDataBuffer.resetLeftEncoder.offset, 1);
+        await sim.advance(5);
+
+        expect(await sim.readWord(RomiDataBuffer.leftEncoder.offset)).toBe(0);
+        expect(await sim.readByte(RomiDataBuffer.resetLeftEncoder.offset)).toBe(0);
+    });
+
+    it("should bring up a RomiRobot", async () => {
+        // Telemetry polling doesn't run off a timer on this bus, so
+        // nothing is left running once the test is done
+        const bus = new ReplayI2C(1);
+        bus.addDeviceToBus(sim);
+        bus.addDeviceToBus(new MockRomiImu(0x6B));
+        sim.startRealTimeClock();
+
+        const robot = new RomiRobot(new QueuedI2CBus(bus), 0x14);
+        await robot.readyP();
+
+        robot.scheduler.stop();
+        robot.getIMU().fifoStop();
+
+        expect(robot.firmwareIdent).toBe(FIRMWARE_IDENT);
+        expect(await sim.readByte(RomiDataBuffer.status.offset)).toBe(1);
+    });
+});
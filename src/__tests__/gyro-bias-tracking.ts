@@ -0,0 +1,158 @@
+import MockI2C from "../device-interfaces/i2c/mock-i2c";
+import QueuedI2CBus from "../device-interfaces/i2c/queued-i2c-bus";
+import RunningStats from "../utils/running-stats";
+import StreamingGyroCalibration from "../services/gyro-calibration/streaming-gyro-calibration";
+import FIFOFrameBuffer from "../robot/devices/core/lsm6/lsm6-fifo-buffer";
+import LSM6, { Vector3 } from "../robot/devices/core/lsm6/lsm6";
+import MockRomiImu from "../__mocks__/mock-imu";
+import { NoiseGenerator } from "../__mocks__/test-helpers";
+
+const ODR_HZ: number = 1660;
+const PERIOD: number = 1 / ODR_HZ;
+const FRAMES_PER_DRAIN: number = 17;
+
+const noise = new NoiseGenerator();
+
+/**
+ * Stand in for the LSM6, with a fixed gyro bias and a runtime offset that
+ * the calibration adjusts
+ */
+class SimulatedIMU {
+    public runtimeOffset: Vector3 = { x: 0, y: 0, z: 0 };
+    public gyroNoise: number = 0.2;
+    public accelZ: number = 1.0;
+
+    private _fifo: FIFOFrameBuffer = new FIFOFrameBuffer();
+
+    constructor(public bias: Vector3) {}
+
+    public run(calibration: StreamingGyroCalibration, seconds: number, wheelsMoving: boolean = false): void {
+        const numDrains = Math.ceil((seconds * ODR_HZ) / FRAMES_PER_DRAIN);
+        for (let drain = 0; drain < numDrains; drain++) {
+            for (let i = 0; i < FRAMES_PER_DRAIN; i++) {
+                this._fifo.push(this.bias.x + this.runtimeOffset.x + (this.gyroNoise * noise.next()),
+                                this.bias.y + this.runtimeOffset.y + (this.gyroNoise * noise.next()),
+                                this.bias.z + this.runtimeOffset.z + (this.gyroNoise * noise.next()),
+                                0.001 * noise.next(),
+                                0.001 * noise.next(),
+                                this.accelZ + (0.001 * noise.next()));
+            }
+
+            if (calibration.processFrames(this._fifo.takeNewFrames(), PERIOD, wheelsMoving)) {
+                this.runtimeOffset.x += calibration.correction.x;
+                this.runtimeOffset.y += calibration.correction.y;
+                this.runtimeOffset.z += calibration.correction.z;
+            }
+        }
+    }
+
+    public get residual(): Vector3 {
+        return {
+            x: this.bias.x + this.runtimeOffset.x,
+            y: this.bias.y + this.runtimeOffset.y,
+            z: this.bias.z + this.runtimeOffset.z
+        };
+    }
+}
+
+describe("Gyro Bias Tracking", () => {
+    it("should match a two pass mean and variance", () => {
+        const values: number[] = [];
+        for (let i = 0; i < 1000; i++) {
+            values.push(1e6 + noise.next());
+        }
+
+        const stats = new RunningStats();
+        values.forEach(value => stats.add(value));
+
+        const mean = values.reduce((sum, value) => sum + value, 0) / values.length;
+        const variance = values.reduce((sum, value) => sum + ((value - mean) ** 2), 0) / (values.length - 1);
+
+        expect(stats.count).toBe(1000);
+        expect(stats.mean).toBeCloseTo(mean, 6);
+        expect(stats.variance).toBeCloseTo(variance, 6);
+
+        stats.reset();
+        expect(stats.variance).toBe(0);
+    });
+
+    it("should cancel the bias while the robot sits still", () => {
+        const calibration = new StreamingGyroCalibration();
+        const imu = new SimulatedIMU({ x: 1.2, y: -0.8, z: 2.5 });
+
+        imu.run(calibration, 5);
+
+        const residual = imu.residual;
+        expect(calibration.updates).toBeGreaterThan(0);
+        expect(calibration.isStationary).toBe(true);
+        expect(Math.abs(residual.x)).toBeLessThan(0.02);
+        expect(Math.abs(residual.y)).toBeLessThan(0.02);
+        expect(Math.abs(residual.z)).toBeLessThan(0.02);
+    });
+
+    it("should follow a bias that drifts", () => {
+        const calibration = new StreamingGyroCalibration();
+        const imu = new SimulatedIMU({ x: 0, y: 0, z: 1.0 });
+
+        imu.run(calibration, 2);
+        imu.bias.z = 1.5;
+        imu.run(calibration, 20);
+
+        expect(Math.abs(imu.residual.z)).toBeLessThan(0.02);
+    });
+
+    it("should leave the offset alone while the wheels turn", () => {
+        const calibration = new StreamingGyroCalibration();
+        const imu = new SimulatedIMU({ x: 0, y: 0, z: 2.5 });
+
+        imu.run(calibration, 5, true);
+
+        expect(calibration.updates).toBe(0);
+        expect(imu.runtimeOffset.z).toBe(0);
+    });
+
+    it("should ignore frames that aren't just gravity", () => {
+        const calibration = new StreamingGyroCalibration();
+        const imu = new SimulatedIMU({ x: 0, y: 0, z: 2.5 });
+        imu.accelZ = 1.3;
+
+        imu.run(calibration, 5);
+
+        expect(calibration.updates).toBe(0);
+        expect(calibration.isStationary).toBe(false);
+    });
+
+    it("should reject windows with too much gyro noise", () => {
+        const calibration = new StreamingGyroCalibration();
+        const imu = new SimulatedIMU({ x: 0, y: 0, z: 2.5 });
+        imu.gyroNoise = 8;
+
+        imu.run(calibration, 5);
+
+        expect(calibration.updates).toBe(0);
+        expect(calibration.stats.rejectedWindows).toBeGreaterThan(0);
+    });
+
+    it("should apply an offset change to frames already read off the IMU", async () => {
+        const bus = new MockI2C(1);
+        const imu = new MockRomiImu(0x6B);
+        bus.addDeviceToBus(imu);
+        const lsm6 = new LSM6(new QueuedI2CBus(bus), 0x6B);
+        await lsm6.init();
+        await lsm6.begin();
+
+        for (let i = 0; i < FRAMES_PER_DRAIN; i++) {
+            imu.pushFrame({ x: 0, y: 0, z: 2 }, { x: 0, y: 0, z: 1 });
+        }
+        await lsm6.pollFIFO();
+
+        // A correction made while these frames wait in the buffer
+        lsm6.adjustRuntimeOffset({ x: 0, y: 0, z: -2 });
+
+        const frames = lsm6.getNewFIFOData();
+        expect(frames.length).toBe(FRAMES_PER_DRAIN);
+        for (let i = 0; i < frames.length; i++) {
+            expect(frames.gyroZ(i)).toBeCloseTo(0, 1);
+        }
+    });
+});
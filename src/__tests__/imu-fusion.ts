@@ -0,0 +1,112 @@
+import MadgwickAHRS from "../utils/fusion/madgwick-ahrs";
+import RomiIMUFusion from "../robot/romi-imu-fusion";
+import FIFOFrameBuffer from "../robot/devices/core/lsm6/lsm6-fifo-buffer";
+
+const ODR_HZ: number = 1660;
+const DT: number = 1 / ODR_HZ;
+const DEG_TO_RAD: number = Math.PI / 180;
+
+describe("IMU Fusion", () => {
+    it("should start level with zero heading", () => {
+        const ahrs = new MadgwickAHRS();
+        for (let i = 0; i < 100; i++) {
+            ahrs.update(0, 0, 0, 0, 0, 1, DT);
+        }
+
+        expect(ahrs.yaw).toBeCloseTo(0, 6);
+        expect(ahrs.pitch).toBeCloseTo(0, 6);
+        expect(ahrs.roll).toBeCloseTo(0, 6);
+    });
+
+    it("should pick up the initial tilt from gravity", () => {
+        const ahrs = new MadgwickAHRS();
+        const roll = 20 * DEG_TO_RAD;
+        ahrs.update(0, 0, 0, 0, Math.sin(roll), Math.cos(roll), DT);
+
+        expect(ahrs.roll).toBeCloseTo(20, 2);
+        expect(ahrs.pitch).toBeCloseTo(0, 2);
+    });
+
+    it("should integrate heading from the gyro", () => {
+        const ahrs = new MadgwickAHRS();
+
+        // 90 degrees over one second
+        for (let i = 0; i < ODR_HZ; i++) {
+            ahrs.update(0, 0, 90 * DEG_TO_RAD, 0, 0, 1, DT);
+        }
+
+        expect(ahrs.yaw).toBeCloseTo(90, 1);
+        expect(ahrs.roll).toBeCloseTo(0, 4);
+    });
+
+    it("should pull a wrong tilt back towards gravity", () => {
+        const ahrs = new MadgwickAHRS(0.5);
+        ahrs.update(0, 0, 0, 0, 0, 1, DT);
+
+        // Gyro drift suggests a roll that gravity says isn't there
+        for (let i = 0; i < ODR_HZ; i++) {
+            ahrs.update(5 * DEG_TO_RAD, 0, 0, 0, 0, 1, DT);
+        }
+
+        expect(Math.abs(ahrs.roll)).toBeLessThan(1);
+    });
+
+    it("should zero the heading and keep the tilt", () => {
+        const ahrs = new MadgwickAHRS();
+        const pitch = 10 * DEG_TO_RAD;
+        ahrs.update(0, 0, 0, -Math.sin(pitch), 0, Math.cos(pitch), DT);
+        for (let i = 0; i < ODR_HZ / 2; i++) {
+            ahrs.update(0, 0, 60 * DEG_TO_RAD, -Math.sin(pitch), 0, Math.cos(pitch), DT);
+        }
+        const pitchBefore = ahrs.pitch;
+        const rollBefore = ahrs.roll;
+        expect(Math.abs(ahrs.yaw)).toBeGreaterThan(20);
+
+        ahrs.resetYaw();
+
+        expect(ahrs.yaw).toBeCloseTo(0, 6);
+        expect(ahrs.pitch).toBeCloseTo(pitchBefore, 6);
+        expect(ahrs.roll).toBeCloseTo(rollBefore, 6);
+    });
+
+    it("should report clockwise heading as positive, like RomiGyro", () => {
+        const fusion = new RomiIMUFusion();
+        const fifo = new FIFOFrameBuffer();
+
+        // RomiGyro negates the sensor's Z rate, so a negative raw rate is
+        // a clockwise turn
+        for (let i = 0; i < 100; i++) {
+            fifo.push(0, 0, -45, 0, 0, 1);
+        }
+        fusion.updateFromFrames(fifo.takeNewFrames(), 0.01);
+
+        expect(fusion.yaw).toBeCloseTo(45, 1);
+    });
+
+    it("should come out the same however the frames are drained", () => {
+        const fifo = new FIFOFrameBuffer();
+        const push = (t: number) => {
+            fifo.push(Math.sin(t / 100), Math.cos(t / 150), 30, 0.01 * Math.sin(t), 0.02, 0.99);
+        };
+
+        // One big drain, and drains of 17 frames (1.66kHz polled at 100Hz)
+        const whole = new RomiIMUFusion();
+        for (let t = 0; t < 340; t++) {
+            push(t);
+        }
+        whole.processFrames(fifo.takeNewFrames(), DT);
+
+        const drained = new RomiIMUFusion();
+        for (let t = 0; t < 340; t++) {
+            push(t);
+            if ((t + 1) % 17 === 0) {
+                drained.processFrames(fifo.takeNewFrames(), DT);
+            }
+        }
+
+        expect(drained.yaw).toBeCloseTo(whole.yaw, 9);
+        expect(drained.pitch).toBeCloseTo(whole.pitch, 9);
+        expect(drained.roll).toBeCloseTo(whole.roll, 9);
+        expect(Math.abs(whole.yaw)).toBeGreaterThan(1);
+    });
+});
@@ -0,0 +1,62 @@
+import ReplayI2C from "../device-interfaces/i2c/replay-i2c";
+import QueuedI2CBus from "../device-interfaces/i2c/queued-i2c-bus";
+import RomiRobot from "../robot/romi-robot";
+import { FIRMWARE_IDENT } from "../robot/romi-shmem-buffer";
+import MockRomiI2C from "../__mocks__/mock-romi";
+import MockRomiImu from "../__mocks__/mock-imu";
+import { setMotionStatus } from "../__mocks__/test-helpers";
+
+// Values of the firmware motionState register
+const MOTION_STATE_IDLE: number = 0;
+const MOTION_STATE_RUNNING: number = 1;
+const MOTION_STATE_COMPLETE: number = 2;
+
+describe("Motion Profiles", () => {
+    let bus: ReplayI2C;
+    let romi: MockRomiI2C;
+    let robot: RomiRobot;
+    let now: number;
+
+    // Periodic reads are only sampled on request on this bus
+    const poll = async () => {
+        await bus.samplePeriodicReads();
+        now += 1000;
+        robot.scheduler.tick(now);
+    };
+
+    beforeEach(async () => {
+        bus = new ReplayI2C(1);
+        romi = new MockRomiI2C(0x14);
+        romi.setFirmwareIdent(FIRMWARE_IDENT);
+        bus.addDeviceToBus(romi);
+        bus.addDeviceToBus(new MockRomiImu(0x6B));
+
+        robot = new RomiRobot(new QueuedI2CBus(bus), 0x14);
+        await robot.readyP();
+        robot.scheduler.stop();
+        robot.getIMU().fifoStop();
+        now = performance.now();
+    });
+
+    it("should wait for the firmware to pick up a move before reporting it", async () => {
+        setMotionStatus(romi, MOTION_STATE_IDLE, 0);
+        await poll();
+
+        await robot.startDriveProfile(0.5, 0.2, 0.5);
+
+        // The firmware hasn't started the move by the first sample
+        await poll();
+        expect(robot.motionState).toBe("IDLE");
+
+        setMotionStatus(romi, MOTION_STATE_RUNNING, 100);
+        await poll();
+        expect(robot.motionState).toBe("RUNNING");
+        const runningProgress = robot.motionProgress;
+        expect(runningProgress).toBeGreaterThan(0);
+
+        setMotionStatus(romi, MOTION_STATE_COMPLETE, 200);
+        await poll();
+        expect(robot.motionState).toBe("COMPLETE");
+        expect(robot.motionProgress).toBeCloseTo(runningProgress * 2);
+    });
+});
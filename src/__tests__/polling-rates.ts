@@ -0,0 +1,45 @@
+import PollingRateController, { DEFAULT_POLLING_RATES_HZ, TelemetryClass } from "../robot/polling-rates";
+
+describe("Polling Rate Controller", () => {
+    it("should use the configured rates", () => {
+        const controller = new PollingRateController({ ...DEFAULT_POLLING_RATES_HZ, encoders: 200 });
+
+        expect(controller.periodMs(TelemetryClass.ENCODERS)).toBeCloseTo(5);
+        expect(controller.periodMs(TelemetryClass.DIO)).toBeCloseTo(50);
+        expect(controller.sharedPeriodMs([TelemetryClass.ENCODERS, TelemetryClass.DIO])).toBeCloseTo(5);
+    });
+
+    it("should back off classes that aren't being read in adaptive mode", () => {
+        const controller = new PollingRateController({ ...DEFAULT_POLLING_RATES_HZ, encoders: 200, dio: 20 }, true);
+
+        controller.markAccessed(TelemetryClass.ENCODERS, 1000);
+        controller.update(1500);
+
+        expect(controller.stats.classes.encoders.active).toBe(true);
+        expect(controller.periodMs(TelemetryClass.ENCODERS)).toBeCloseTo(5);
+        expect(controller.stats.classes.dio.active).toBe(false);
+        expect(controller.periodMs(TelemetryClass.DIO)).toBeCloseTo(200);
+
+        // Encoders go idle if they stop being read
+        controller.update(10000);
+        expect(controller.periodMs(TelemetryClass.ENCODERS)).toBeCloseTo(20);
+
+        // Reads without a time count from the next update
+        controller.markAccessed(TelemetryClass.DIO);
+        controller.update(10100);
+        expect(controller.stats.classes.dio.active).toBe(true);
+        controller.update(15000);
+        expect(controller.stats.classes.dio.active).toBe(false);
+    });
+
+    it("should slow everything down to fit the bus budget", () => {
+        const controller = new PollingRateController({ ...DEFAULT_POLLING_RATES_HZ, encoders: 100 }, false, 0.1);
+
+        // 2ms every 10ms is 20% of the bus, twice the budget
+        controller.addTransfer([TelemetryClass.ENCODERS], 2000);
+
+        expect(controller.stats.budgetScale).toBeCloseTo(2);
+        expect(controller.stats.busUtilization).toBeCloseTo(0.1);
+        expect(controller.periodMs(TelemetryClass.ENCODERS)).toBeCloseTo(20);
+    });
+});
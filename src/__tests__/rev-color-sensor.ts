@@ -0,0 +1,66 @@
+import MockI2C from "../device-interfaces/i2c/mock-i2c";
+import QueuedI2CBus from "../device-interfaces/i2c/queued-i2c-bus";
+import MockColorSensor from "../__mocks__/mock-color-sensor";
+import { settle } from "../__mocks__/test-helpers";
+import RevColorSensorV3 from "../robot/devices/custom/rev-color-sensor-v3";
+import { estimateTransferUs } from "../robot/polling-rates";
+
+const COLOR_SENSOR_ADDRESS: number = 0x52;
+
+describe("REV Color Sensor V3", () => {
+    let now: number;
+    let mockSensor: MockColorSensor;
+    let sensor: RevColorSensorV3;
+
+    beforeEach(async () => {
+        now = 0;
+        mockSensor = new MockColorSensor(COLOR_SENSOR_ADDRESS, 100, () => now);
+
+        const bus = new MockI2C(1);
+        bus.addDeviceToBus(mockSensor);
+        sensor = new RevColorSensorV3({ i2cBus: new QueuedI2CBus(bus) }, {});
+
+        // Let the ID check and setup finish
+        await settle();
+    });
+
+    it("should read all of the data registers in one block on a new measurement", async () => {
+        mockSensor.setMeasurement({ red: 0x12345, green: 0x23456, blue: 0x01234, ir: 300, proximity: 0x7FF });
+        now = 100;
+
+        await sensor.update();
+
+        expect(mockSensor.dataReads).toBe(1);
+        expect(sensor.getRed()).toBe(0x12345 & 0x03FFFF);
+        expect(sensor.getGreen()).toBe(0x23456 & 0x03FFFF);
+        expect(sensor.getBlue()).toBe(0x01234);
+        expect(sensor.getIR()).toBe(300);
+        expect(sensor.getProximity()).toBe(0x7FF);
+    });
+
+    it("should only check the status until there's a new measurement", async () => {
+        now = 100;
+        await sensor.update();
+        const dataReads = mockSensor.dataReads;
+        const statusReads = mockSensor.statusReads;
+
+        now = 150;
+        await sensor.update();
+        expect(mockSensor.dataReads).toBe(dataReads);
+        expect(mockSensor.statusReads).toBe(statusReads + 1);
+
+        now = 200;
+        await sensor.update();
+        expect(mockSensor.dataReads).toBe(dataReads + 1);
+    });
+
+    it("should take a fraction of the bus time of reading each register", async () => {
+        now = 100;
+        const startBusTimeUs = sensor.busTimeUs;
+        await sensor.update();
+
+        // 4 color registers of 3 bytes, and 2 bytes of proximity, a byte at a time
+        const byteReadsUs = 14 * estimateTransferUs(1, 1);
+        expect(sensor.busTimeUs - startBusTimeUs).toBeLessThan(byteReadsUs / 2);
+    });
+});
@@ -0,0 +1,183 @@
+import MockI2C from "../device-interfaces/i2c/mock-i2c";
+import QueuedI2CBus from "../device-interfaces/i2c/queued-i2c-bus";
+import ReplayI2C from "../device-interfaces/i2c/replay-i2c";
+import MockRomiI2C from "../__mocks__/mock-romi";
+import MockRomiImu from "../__mocks__/mock-imu";
+import PhysicsRomiSim from "../__mocks__/physics-romi";
+import { settle } from "../__mocks__/test-helpers";
+import RomiBoard from "../robot/devices/custom/romi-board";
+import RomiRobot from "../robot/romi-robot";
+import RomiConfiguration from "../robot/romi-config";
+import RomiDataBuffer, { FIRMWARE_IDENT } from "../robot/romi-shmem-buffer";
+
+const ROMI_ADDRESS: number = 0x14;
+const BOARD_ADDRESS: number = 0x15;
+
+describe("Romi Board", () => {
+    let romi: MockRomiI2C;
+    let sim: PhysicsRomiSim;
+    let queuedBus: QueuedI2CBus;
+    let board: RomiBoard;
+
+    beforeEach(async () => {
+        romi = new MockRomiI2C(BOARD_ADDRESS);
+        sim = new PhysicsRomiSim(romi, new MockRomiImu(0x6B));
+
+        const bus = new MockI2C(1);
+        bus.addDeviceToBus(romi);
+        queuedBus = new QueuedI2CBus(bus);
+        board = new RomiBoard({ i2cBus: queuedBus }, { address: BOARD_ADDRESS });
+        await board.ready;
+    });
+
+    it("should drive its motors with command blocks", async () => {
+        board.setPWMValue(0, 255);
+        board.setPWMValue(1, 0);
+        await settle();
+        sim.advance(10);
+
+        expect(sim.leftMotor).toBe(400);
+        expect(sim.rightMotor).toBe(-400);
+    });
+
+    it("should read its encoders from the telemetry block", async () => {
+        board.setPWMValue(0, 255);
+        await settle();
+        sim.advance(500);
+        await board.update();
+
+        const left = board.getEncoder(4, 5);
+        expect(left).toEqual({ index: 0, reversed: false });
+        expect(board.getEncoderCount(left.index)).toBeGreaterThan(0);
+        expect(board.telemetryCrcErrors).toBe(0);
+    });
+
+    it("should only keep the motors running with a heartbeat", async () => {
+        board.setPWMValue(0, 255);
+        await settle();
+        sim.advance(1100);
+        expect(sim.leftMotor).toBe(0);
+
+        board.heartbeat();
+        await settle();
+        sim.advance(10);
+        expect(sim.leftMotor).toBe(400);
+    });
+
+    it("should reset its encoders at actuation priority", async () => {
+        board.setPWMValue(0, 255);
+        await settle();
+        sim.advance(500);
+        await board.update();
+        const countBefore = board.getEncoderCount(0);
+        expect(countBefore).toBeGreaterThan(0);
+
+        queuedBus.resetStats();
+        board.resetEncoder(0);
+        await settle();
+        sim.advance(10);
+        await board.update();
+
+        expect(queuedBus.stats.ACTUATION.completed).toBe(1);
+        expect(board.getEncoderCount(0)).toBeLessThan(countBefore / 10);
+    });
+
+    it("should report a reset encoder as 0 until the firmware has applied the reset", async () => {
+        board.setPWMValue(0, 255);
+        await settle();
+        sim.advance(500);
+        await board.update();
+        const countBefore = board.getEncoderCount(0);
+        expect(countBefore).toBeGreaterThan(0);
+
+        // The firmware hasn't run since the reset was written, so the
+        // next sample still has the old count
+        board.resetEncoder(0);
+        await settle();
+        await board.update();
+        expect(board.getEncoderCount(0)).toBe(0);
+
+        sim.advance(10);
+        await board.update();
+        expect(board.getEncoderCount(0)).toBeLessThan(countBefore / 10);
+    });
+
+    it("should count failed reads and writes", async () => {
+        expect(board.readErrors).toBe(0);
+        expect(board.writeErrors).toBe(0);
+
+        // The first update also checks the status byte
+        romi.setI2CBusError(true);
+        await board.update();
+        board.heartbeat();
+        await settle();
+
+        expect(board.readErrors).toBe(2);
+        expect(board.writeErrors).toBe(1);
+        expect(board.isErrorState).toBe(false);
+
+        romi.setI2CBusError(false);
+        await board.update();
+        expect(board.readErrors).toBe(2);
+    });
+
+    it("should rewrite its configuration after a brown out", async () => {
+        board.setPWMValue(0, 255);
+        await settle();
+
+        // Nothing is written while the board is still configured
+        romi.setBufferBytes(RomiDataBuffer.status.offset, new Uint8Array([1]));
+        romi.setIncomingBytes(RomiDataBuffer.heartbeatTimeoutMs.offset, new Uint8Array([0, 0]));
+        await board.checkStatus();
+        expect(romi.getIncomingBytes(RomiDataBuffer.heartbeatTimeoutMs.offset, 2).readUInt16LE(0)).toBe(0);
+
+        // The firmware comes back up with a cleared buffer
+        romi.resetRomi();
+        romi.setBufferBytes(RomiDataBuffer.status.offset, new Uint8Array([0]));
+        await board.checkStatus();
+        await settle();
+
+        expect(romi.getIncomingBytes(RomiDataBuffer.ioConfig.offset, 2).readUInt16LE(0)).not.toBe(0);
+        expect(romi.getIncomingBytes(RomiDataBuffer.heartbeatTimeoutMs.offset, 2).readUInt16LE(0)).toBe(1000);
+        expect(romi.getIncomingBytes(RomiDataBuffer.leftMotor.offset, 2).readInt16LE(0)).toBe(400);
+    });
+
+    it("should add a second board's channels after the main board's", async () => {
+        // Telemetry polling doesn't run off a timer on this bus, so
+        // nothing is left running once the test is done
+        const bus = new ReplayI2C(1);
+        const mainRomi = new MockRomiI2C(ROMI_ADDRESS);
+        mainRomi.setFirmwareIdent(FIRMWARE_IDENT);
+        bus.addDeviceToBus(mainRomi);
+        bus.addDeviceToBus(new MockRomiImu(0x6B));
+
+        const boardRomi = new MockRomiI2C(BOARD_ADDRESS);
+        const boardSim = new PhysicsRomiSim(boardRomi, new MockRomiImu(0x6B));
+        bus.addDeviceToBus(boardRomi);
+
+        const config = new RomiConfiguration();
+        config.customDevices = [{ type: "romi-board", config: { address: BOARD_ADDRESS } }];
+
+        const robot = new RomiRobot(new QueuedI2CBus(bus), ROMI_ADDRESS, config);
+        await robot.readyP();
+        robot.scheduler.stop();
+        robot.getIMU().fifoStop();
+
+        // The main board has 2 motors and 2 external PWM pins, and 8
+        // built in DIO and 1 external DIO pin with the default IO config
+        robot.setPWMValue(4, 255);
+        robot.registerEncoder(0, 9 + 4, 9 + 5);
+        await settle();
+        boardSim.advance(500);
+
+        // Tasks pick up their first slot on the first tick, then read the
+        // board, then pass on what it read
+        for (let i = 1; i <= 3; i++) {
+            robot.scheduler.tick(performance.now() + i * 1000);
+            await settle();
+        }
+
+        expect(boardRomi.getIncomingBytes(RomiDataBuffer.leftMotor.offset, 2).readInt16LE(0)).toBe(400);
+        expect(robot.getEncoderCount(0)).toBeGreaterThan(0);
+    });
+});
@@ -0,0 +1,158 @@
+import fs from "fs";
+import os from "os";
+import path from "path";
+import TelemetryRecorder from "../services/recorder/telemetry-recorder";
+import RecordedSession from "../services/replay/recorded-session";
+import SessionReplay from "../services/replay/session-replay";
+import { fieldsForSchema, I2CErrorKind, LogSchema } from "../services/recorder/log-format";
+import RomiDataBuffer, { FIRMWARE_IDENT, ShmemDataType } from "../robot/romi-shmem-buffer";
+import FIFOFrameBuffer from "../robot/devices/core/lsm6/lsm6-fifo-buffer";
+import { crc8 } from "../utils/crc8";
+
+const TELEMETRY_START: number = RomiDataBuffer.telemetryCrc.crcStart;
+const TELEMETRY_LENGTH: number = RomiDataBuffer.telemetryCrc.crcLength + 1;
+const COMMAND_START: number = RomiDataBuffer.commandCrc.crcStart;
+const COMMAND_LENGTH: number = RomiDataBuffer.commandCrc.crcLength + 1;
+
+const IMU_PERIOD: number = 1 / 104;
+
+const SCHEMA: LogSchema = {
+    firmwareIdent: FIRMWARE_IDENT,
+    telemetryBlock: { start: TELEMETRY_START, length: TELEMETRY_LENGTH },
+    commandBlock: { start: COMMAND_START, length: COMMAND_LENGTH },
+    imuFramePeriod: IMU_PERIOD,
+    fields: fieldsForSchema(RomiDataBuffer, ShmemDataType)
+};
+
+// Motor outputs the "robot program" changed to, and when
+const MOTOR_CHANGES: [number, number, number][] = [
+    [200, 100, 100],
+    [450, 300, -300],
+    [700, 0, 0]
+];
+
+/**
+ * Write a one second session: telemetry every 20ms (with one corrupted
+ * read), IMU frames at 104Hz, and a few changes in motor output
+ */
+async function recordSession(): Promise<string> {
+    const logPath = path.join(fs.mkdtempSync(path.join(os.tmpdir(), "romi-replay-")), "session.rlog");
+    const recorder = new TelemetryRecorder(logPath, SCHEMA, 0);
+
+    const telemetry = Buffer.alloc(TELEMETRY_LENGTH);
+    const command = Buffer.alloc(COMMAND_LENGTH);
+    const fifo = new FIFOFrameBuffer();
+    let changeIdx = 0;
+    let numFrames = 0;
+
+    for (let timeMs = 0; timeMs <= 1000; timeMs += 20) {
+        while (numFrames * IMU_PERIOD * 1000 <= timeMs) {
+            fifo.push(0, 0, 10, 0, 0, 1);
+            numFrames++;
+        }
+        recorder.recordIMUFrames(fifo.takeNewFrames(), timeMs, IMU_PERIOD);
+
+        if (timeMs === 500) {
+            recorder.recordI2CError(I2CErrorKind.TELEMETRY_CRC, 0x14, TELEMETRY_START, 0, timeMs);
+        }
+        else {
+            telemetry.writeUInt16LE(7000 + timeMs, RomiDataBuffer.batteryMillivolts.offset - TELEMETRY_START);
+            telemetry.writeInt16LE(timeMs * 2, RomiDataBuffer.leftEncoder.offset - TELEMETRY_START);
+            telemetry.writeInt16LE(-timeMs, RomiDataBuffer.rightEncoder.offset - TELEMETRY_START);
+            telemetry[RomiDataBuffer.builtinDioInputs.offset - TELEMETRY_START] = (timeMs >= 300 && timeMs < 600) ? 1 : 0;
+            telemetry.writeUInt16LE(timeMs * 64, RomiDataBuffer.analog.offset - TELEMETRY_START + 2);
+            telemetry[TELEMETRY_LENGTH - 1] = crc8(telemetry, 0, TELEMETRY_LENGTH - 1);
+            recorder.recordTelemetry(telemetry, timeMs);
+        }
+
+        if (changeIdx < MOTOR_CHANGES.length && MOTOR_CHANGES[changeIdx][0] <= timeMs) {
+            command.writeInt16LE(MOTOR_CHANGES[changeIdx][1], RomiDataBuffer.leftMotor.offset - COMMAND_START);
+            command.writeInt16LE(MOTOR_CHANGES[changeIdx][2], RomiDataBuffer.rightMotor.offset - COMMAND_START);
+            recorder.recordCommand(command, timeMs + 1);
+            changeIdx++;
+        }
+    }
+
+    await recorder.close();
+    return logPath;
+}
+
+describe("Session Replay", () => {
+    let session: RecordedSession;
+
+    beforeAll(async () => {
+        session = RecordedSession.load(await recordSession());
+    });
+
+    it("should load every record", () => {
+        expect(session.telemetryCount).toBe(51);
+        expect(session.commandCount).toBe(MOTOR_CHANGES.length);
+        expect(session.imuFrameCount).toBe(105);
+        expect(session.durationMs).toBe(1000);
+        expect(session.commandField(1, "rightMotor")).toBe(-300);
+        expect(session.telemetryField(1, "batteryMillivolts")).toBe(7020);
+        expect(session.telemetryField(1, "leftEncoder")).toBe(40);
+    });
+
+    it("should reproduce the recorded session", async () => {
+        const replay = new SessionReplay(session);
+        const report = await replay.run();
+
+        expect(report.mismatches).toEqual([]);
+        expect(report.telemetryEvents).toBe(session.telemetryCount);
+        expect(report.imuFrames).toBe(session.imuFrameCount);
+        expect(report.commands.recorded).toBe(MOTOR_CHANGES.length);
+        expect(report.commands.replayed).toBe(MOTOR_CHANGES.length);
+        expect(report.commands.maxLagMs).toBeLessThan(10);
+
+        // The corrupted read is caught again
+        expect(replay.robot.shmemStats.telemetry.crcErrors).toBe(1);
+
+        // Inputs from the last block
+        expect(replay.robot.getEncoderCount(0)).toBe(2000);
+        expect(replay.robot.getEncoderCount(1)).toBe(-1000);
+        expect(replay.robot.getAnalogInVoltage(0)).toBeCloseTo((1000 * 64 / (1023 * 64)) * 5);
+    });
+
+    it("should report inputs the robot reads differently", async () => {
+        // Zeroing the count makes the robot fall behind the recording
+        // until the reset would have landed
+        const replay = new SessionReplay(session);
+        const report = await replay.run({
+            onStep: (timeMs, robot) => {
+                if (timeMs === 600) {
+                    robot.resetEncoder(0);
+                }
+            }
+        });
+
+        expect(report.mismatchCount).toBeGreaterThan(0);
+        expect(report.mismatches[0].field).toBe("leftEncoder");
+        expect(report.mismatches[0].actual).toBe(0);
+    });
+
+    it("should play out the same way every time", async () => {
+        const first = await new SessionReplay(session).run();
+        const second = await new SessionReplay(session).run();
+
+        expect(second.ticks).toBe(first.ticks);
+        expect(second.commands).toEqual(first.commands);
+    });
+
+    it("should keep to the recorded timing when asked", async () => {
+        const replay = new SessionReplay(session);
+        const report = await replay.run({ speed: 4 });
+
+        expect(report.mismatchCount).toBe(0);
+        expect(report.wallTimeMs).toBeGreaterThanOrEqual((session.durationMs / 4) - 10);
+    });
+
+    it("should reject sessions with a different layout", () => {
+        const oldSession = Object.create(session);
+        Object.defineProperty(oldSession, "schema", {
+            value: { ...SCHEMA, telemetryBlock: { start: TELEMETRY_START + 1, length: TELEMETRY_LENGTH } }
+        });
+
+        expect(() => new SessionReplay(oldSession)).toThrow();
+    });
+});
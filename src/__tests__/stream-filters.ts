@@ -0,0 +1,158 @@
+import MockI2C from "../device-interfaces/i2c/mock-i2c";
+import QueuedI2CBus from "../device-interfaces/i2c/queued-i2c-bus";
+import StreamFilter from "../utils/filters/stream-filter";
+import SimpleMovingAverage from "../utils/filters/simple-moving-average";
+import ExponentialMovingAverage from "../utils/filters/exponential-moving-average";
+import MedianFilter from "../utils/filters/median-filter";
+import BiquadLowPass from "../utils/filters/biquad-low-pass";
+import KalmanFilter1D from "../utils/filters/kalman-filter-1d";
+import LSM6 from "../robot/devices/core/lsm6/lsm6";
+import FIFOFrameBuffer from "../robot/devices/core/lsm6/lsm6-fifo-buffer";
+import RomiGyro from "../robot/romi-gyro";
+import { NoiseGenerator } from "../__mocks__/test-helpers";
+
+const IMU_ADDRESS: number = 0x6B;
+const IMU_RATE_HZ: number = 833;
+
+// Frames drained per read, with the IMU polled at 100Hz
+const FRAMES_PER_DRAIN: number = 9;
+
+const FILTER_FACTORIES: [string, () => StreamFilter][] = [
+    ["SMA", () => new SimpleMovingAverage(5)],
+    ["EMA", () => new ExponentialMovingAverage(0.3)],
+    ["Median", () => new MedianFilter(5)],
+    ["Biquad", () => new BiquadLowPass(50, IMU_RATE_HZ)],
+    ["Kalman", () => new KalmanFilter1D(0.01, 1)]
+];
+
+// Deterministic noisy signal
+function generateStream(length: number): number[] {
+    const noise = new NoiseGenerator();
+    const stream: number[] = [];
+    for (let i = 0; i < length; i++) {
+        stream.push(10 * Math.sin(i / 20) + noise.next());
+    }
+
+    return stream;
+}
+
+describe("Stream Filters", () => {
+    FILTER_FACTORIES.forEach(([name, createFilter]) => {
+        it(`${name}: batched and per-value filtering should match`, () => {
+            const stream = generateStream(100);
+
+            const single = createFilter();
+            const expected = stream.map(value => single.getValue(value));
+
+            // Feed the same stream through in uneven chunks
+            const batched = createFilter();
+            const actual: number[] = [];
+            const chunk = new Float64Array(16);
+            let idx = 0;
+            for (let chunkSize = 1; idx < stream.length; chunkSize = (chunkSize % 13) + 1) {
+                const length = Math.min(chunkSize, stream.length - idx);
+                for (let i = 0; i < length; i++) {
+                    chunk[i] = stream[idx + i];
+                }
+                batched.processFrames(chunk, length);
+                for (let i = 0; i < length; i++) {
+                    actual.push(chunk[i]);
+                }
+                idx += length;
+            }
+
+            actual.forEach((value, i) => {
+                expect(value).toBeCloseTo(expected[i], 9);
+            });
+        });
+
+        it(`${name}: should start over after a reset`, () => {
+            const filter = createFilter();
+            const first = generateStream(20).map(value => filter.getValue(value));
+
+            filter.reset();
+            const second = generateStream(20).map(value => filter.getValue(value));
+
+            expect(second).toEqual(first);
+        });
+    });
+
+    it("should track the median of the window", () => {
+        const stream = generateStream(50);
+        const filter = new MedianFilter(4);
+
+        stream.forEach((value, idx) => {
+            const window = stream.slice(Math.max(0, idx - 3), idx + 1).sort((a, b) => a - b);
+            const mid = window.length >> 1;
+            const expected = (window.length & 1) ? window[mid] : (window[mid - 1] + window[mid]) / 2;
+
+            expect(filter.getValue(value)).toBeCloseTo(expected, 9);
+        });
+    });
+
+    it("should pass DC and attenuate noise with the biquad low pass", () => {
+        const filter = new BiquadLowPass(20, IMU_RATE_HZ);
+
+        // Starts settled at the first value
+        expect(filter.getValue(5)).toBeCloseTo(5, 9);
+
+        // A signal at the Nyquist frequency is almost entirely removed
+        let maxOutput = 0;
+        for (let i = 0; i < 500; i++) {
+            const output = filter.getValue(5 + ((i & 1) ? 1 : -1));
+            if (i > 100) {
+                maxOutput = Math.max(maxOutput, Math.abs(output - 5));
+            }
+        }
+        expect(maxOutput).toBeLessThan(0.01);
+    });
+
+    it("should converge on a constant with the Kalman filter", () => {
+        const filter = new KalmanFilter1D(0.0001, 1);
+        const stream = generateStream(2000).map((value, i) => value - (10 * Math.sin(i / 20)) + 3);
+
+        let estimate = 0;
+        stream.forEach(value => {
+            estimate = filter.getValue(value);
+        });
+
+        expect(estimate).toBeCloseTo(3, 1);
+        expect(filter.errorCovariance).toBeLessThan(0.02);
+    });
+
+    it("should smooth and integrate gyro rates in RomiGyro", () => {
+        const gyro = new RomiGyro(new LSM6(new QueuedI2CBus(new MockI2C(1)), IMU_ADDRESS), 5);
+        const fifo = new FIFOFrameBuffer();
+        const dt = 1 / IMU_RATE_HZ;
+
+        // A steady turn, with +/-1 deg/s of alternating noise on Z
+        const drain = () => {
+            for (let i = 0; i < FRAMES_PER_DRAIN; i++) {
+                fifo.push(1, 2, 3 + ((i % 2) ? 1 : -1), 0, 0, 1);
+            }
+            gyro.updateFromFrames(fifo.takeNewFrames(), dt);
+        };
+
+        // Fill the filter window
+        drain();
+        const startAngleX = gyro.angleX;
+        const startAngleY = gyro.angleY;
+
+        drain();
+
+        // Y and Z are flipped to match the robot's frame. The window
+        // averages all but 1/5 of the noise away
+        expect(gyro.rateX).toBeCloseTo(1, 6);
+        expect(gyro.rateY).toBeCloseTo(-2, 6);
+        expect(Math.abs(gyro.rateZ + 3)).toBeLessThanOrEqual(0.2 + 1e-6);
+
+        // Every frame in the drain is integrated, not just the last one
+        expect(gyro.angleX - startAngleX).toBeCloseTo(FRAMES_PER_DRAIN * dt, 6);
+        expect(gyro.angleY - startAngleY).toBeCloseTo(-2 * FRAMES_PER_DRAIN * dt, 6);
+        expect(gyro.angleZ).toBeLessThan(0);
+
+        gyro.reset();
+        drain();
+        expect(gyro.angleX).toBeCloseTo(FRAMES_PER_DRAIN * dt, 6);
+    });
+});
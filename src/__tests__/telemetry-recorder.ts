@@ -0,0 +1,135 @@
+import fs from "fs";
+import os from "os";
+import path from "path";
+import TelemetryRecorder from "../services/recorder/telemetry-recorder";
+import TelemetryLogReader from "../services/recorder/telemetry-log-reader";
+import { fieldsForSchema, I2CErrorKind, LogRecordType, LogSchema } from "../services/recorder/log-format";
+import RomiDataBuffer, { FIRMWARE_IDENT, ShmemDataType } from "../robot/romi-shmem-buffer";
+import FIFOFrameBuffer from "../robot/devices/core/lsm6/lsm6-fifo-buffer";
+
+const TELEMETRY_START: number = RomiDataBuffer.telemetryCrc.crcStart;
+const TELEMETRY_LENGTH: number = RomiDataBuffer.telemetryCrc.crcLength + 1;
+const COMMAND_START: number = RomiDataBuffer.commandCrc.crcStart;
+const COMMAND_LENGTH: number = RomiDataBuffer.commandCrc.crcLength + 1;
+
+const SCHEMA: LogSchema = {
+    firmwareIdent: FIRMWARE_IDENT,
+    telemetryBlock: { start: TELEMETRY_START, length: TELEMETRY_LENGTH },
+    commandBlock: { start: COMMAND_START, length: COMMAND_LENGTH },
+    imuFramePeriod: 1 / 104,
+    fields: fieldsForSchema(RomiDataBuffer, ShmemDataType)
+};
+
+function tempLogPath(): string {
+    return path.join(fs.mkdtempSync(path.join(os.tmpdir(), "romi-log-")), "test.rlog");
+}
+
+describe("Telemetry Recorder", () => {
+    it("should read back what was recorded", async () => {
+        const logPath = tempLogPath();
+        const recorder = new TelemetryRecorder(logPath, SCHEMA, 1000);
+
+        const telemetry = Buffer.alloc(TELEMETRY_LENGTH);
+        telemetry.writeInt16LE(-1234, RomiDataBuffer.leftEncoder.offset - TELEMETRY_START);
+        telemetry.writeUInt16LE(7400, RomiDataBuffer.batteryMillivolts.offset - TELEMETRY_START);
+        recorder.recordTelemetry(telemetry, 1010);
+
+        const command = Buffer.alloc(COMMAND_LENGTH);
+        command.writeInt16LE(200, RomiDataBuffer.leftMotor.offset - COMMAND_START);
+        recorder.recordCommand(command, 1012.5);
+
+        const fifo = new FIFOFrameBuffer();
+        fifo.push(1, 2, 3, 0.25, 0.5, 1);
+        fifo.push(4, 5, 6, 0, 0, 1);
+        recorder.recordIMUFrames(fifo.takeNewFrames(), 1030, 0.01);
+
+        recorder.recordI2CError(I2CErrorKind.WRITE, 0x14, COMMAND_START, 0, 1040);
+
+        // Long enough that the gap needs a sync record
+        recorder.recordTelemetry(telemetry, 1000 + (5000 * 1000));
+
+        await recorder.close();
+        expect(recorder.stats.records).toBe(7);
+        expect(recorder.stats.droppedRecords).toBe(0);
+
+        const reader = new TelemetryLogReader(logPath);
+        expect(reader.schema.firmwareIdent).toBe(FIRMWARE_IDENT);
+
+        const seen: string[] = [];
+        reader.scan(record => {
+            switch (record.type) {
+                case LogRecordType.TELEMETRY:
+                    expect(record.getField("leftEncoder")).toBe(-1234);
+                    expect(record.getField("batteryMillivolts")).toBe(7400);
+                    expect(() => record.getField("leftMotor")).toThrow();
+                    break;
+                case LogRecordType.COMMAND:
+                    expect(record.getField("leftMotor")).toBe(200);
+                    break;
+                case LogRecordType.IMU_FRAME:
+                    expect(record.imuValue(3)).toBeCloseTo(seen.length === 2 ? 0.25 : 0, 6);
+                    break;
+                case LogRecordType.I2C_ERROR:
+                    expect(record.i2cErrorKind).toBe(I2CErrorKind.WRITE);
+                    expect(record.i2cAddress).toBe(0x14);
+                    expect(record.i2cRegister).toBe(COMMAND_START);
+                    break;
+            }
+            seen.push(`${LogRecordType[record.type]}@${record.timeMs}`);
+        });
+        reader.close();
+
+        expect(seen).toEqual([
+            "TELEMETRY@10",
+            "COMMAND@12.5",
+            "IMU_FRAME@20",
+            "IMU_FRAME@30",
+            "I2C_ERROR@40",
+            "TELEMETRY@5000000"
+        ]);
+    });
+
+    it("should drop records instead of growing when the disk falls behind", async () => {
+        const logPath = tempLogPath();
+        const recorder = new TelemetryRecorder(logPath, SCHEMA, 0, { chunkBytes: 1024, numChunks: 2 });
+        const telemetry = Buffer.alloc(TELEMETRY_LENGTH);
+
+        // Nothing gets written until we yield, so only two chunks fit
+        for (let i = 0; i < 1000; i++) {
+            recorder.recordTelemetry(telemetry, i);
+        }
+
+        await recorder.close();
+
+        const stats = recorder.stats;
+        expect(stats.droppedRecords).toBeGreaterThan(0);
+
+        const reader = new TelemetryLogReader(logPath);
+        expect(reader.recordCount).toBe(stats.records);
+        expect(reader.scan(() => {})).toBe(stats.records);
+        reader.close();
+    });
+
+    it("should ignore a record cut short at the end of the file", async () => {
+        const logPath = tempLogPath();
+        const recorder = new TelemetryRecorder(logPath, SCHEMA, 0);
+        const telemetry = Buffer.alloc(TELEMETRY_LENGTH);
+        recorder.recordTelemetry(telemetry, 1);
+        recorder.recordTelemetry(telemetry, 2);
+        await recorder.close();
+
+        fs.truncateSync(logPath, fs.statSync(logPath).size - 3);
+
+        const reader = new TelemetryLogReader(logPath);
+        expect(reader.recordCount).toBe(1);
+        expect(reader.scan(() => {})).toBe(1);
+        reader.close();
+    });
+
+    it("should reject files that aren't logs", () => {
+        const logPath = tempLogPath();
+        fs.writeFileSync(logPath, "{\"not\": \"a log\"}");
+
+        expect(() => new TelemetryLogReader(logPath)).toThrow();
+    });
+});
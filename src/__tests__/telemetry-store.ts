@@ -0,0 +1,279 @@
+import { DigitalChannelMode } from "@wpilib/wpilib-ws-robot";
+import TelemetryStore from "../robot/telemetry-store";
+import RomiRobot from "../robot/romi-robot";
+import RomiDataBuffer, { FIRMWARE_IDENT } from "../robot/romi-shmem-buffer";
+import { TELEMETRY_BLOCK_LENGTH, TELEMETRY_BLOCK_START } from "../robot/romi-shmem-protocol";
+import MockI2C from "../device-interfaces/i2c/mock-i2c";
+import ReplayI2C from "../device-interfaces/i2c/replay-i2c";
+import QueuedI2CBus from "../device-interfaces/i2c/queued-i2c-bus";
+import { I2CBatchOp } from "../device-interfaces/i2c/i2c-batch";
+import SharedSnapshot from "../device-interfaces/i2c/shared-snapshot";
+import MockRomiI2C from "../__mocks__/mock-romi";
+import MockRomiImu from "../__mocks__/mock-imu";
+import { setEncoderCounts, settle } from "../__mocks__/test-helpers";
+import { crc8 } from "../utils/crc8";
+import TickScheduler from "../utils/tick-scheduler";
+
+const WARMUP_CYCLES: number = 20000;
+const MEASURED_CYCLES: number = 20000;
+const MEASUREMENT_ATTEMPTS: number = 5;
+
+// Runs that saw a garbage collection are retried, up to this many in all
+const MAX_MEASUREMENT_RUNS: number = 50;
+
+/**
+ * MockI2C that hands the telemetry snapshot to the test, rather than
+ * sampling it off a timer, so that the test decides what each sample holds
+ */
+class SnapshotCaptureI2C extends MockI2C {
+    public telemetrySnapshot: SharedSnapshot;
+
+    public startPeriodicRead(op: I2CBatchOp, snapshot: SharedSnapshot): void {
+        this.telemetrySnapshot = snapshot;
+    }
+}
+
+/**
+ * Heap growth per call of cycle(), once it has warmed up
+ *
+ * This takes the best of several runs, since the JIT may still be
+ * optimizing (and allocating) during the first ones. Runs that saw a
+ * garbage collection part way through are run again, as any allocation
+ * would have been hidden
+ */
+function bytesAllocatedPerCycle(cycle: () => void): number {
+    for (let i = 0; i < WARMUP_CYCLES; i++) {
+        cycle();
+    }
+
+    let best = Infinity;
+    let attempts = 0;
+    for (let run = 0; run < MAX_MEASUREMENT_RUNS && attempts < MEASUREMENT_ATTEMPTS; run++) {
+        const before = process.memoryUsage().heapUsed;
+        for (let i = 0; i < MEASURED_CYCLES; i++) {
+            cycle();
+        }
+        const after = process.memoryUsage().heapUsed;
+
+        if (after >= before) {
+            best = Math.min(best, (after - before) / MEASURED_CYCLES);
+            attempts++;
+        }
+    }
+
+    if (attempts === 0) {
+        throw new Error(`Every one of ${MAX_MEASUREMENT_RUNS} runs saw a garbage collection`);
+    }
+
+    return best;
+}
+
+describe("Telemetry Store", () => {
+    it("should only report values for active channels", () => {
+        const store = new TelemetryStore();
+
+        store.setDIO(2, true);
+        expect(store.getDIO(2)).toBe(false);
+
+        store.setDIOActive(2, true);
+        store.setDIO(2, true);
+        expect(store.getDIO(2)).toBe(true);
+
+        store.setDIOActive(2, false);
+        expect(store.getDIO(2)).toBe(false);
+
+        store.setAnalog(1, 2.5);
+        expect(store.getAnalog(1)).toBe(2.5);
+
+        // Out of range channels are ignored
+        store.setDIOActive(100, true);
+        store.setDIO(100, true);
+        expect(store.getDIO(100)).toBe(false);
+        expect(store.getAnalog(-1)).toBe(0);
+        expect(store.getEncoderPeriod(50)).toBe(Number.MAX_VALUE);
+    });
+
+    it("should accumulate encoder counts and periods", () => {
+        const store = new TelemetryStore();
+        store.addEncoder(0, false);
+        store.addEncoder(1, true);
+
+        store.updateEncoder(0, 100, 1000);
+        store.updateEncoder(1, 100, 1000);
+        expect(store.getEncoderCount(0)).toBe(100);
+        expect(store.getEncoderCount(1)).toBe(-100);
+        expect(store.getEncoderPeriod(0)).toBe(Number.MAX_VALUE);
+
+        store.updateEncoder(0, 150, 1050);
+        expect(store.getEncoderCount(0)).toBe(150);
+        expect(store.getEncoderPeriod(0)).toBeCloseTo(0.001);
+
+        // After a reset on the Romi, counting carries on from the last value
+        store.resetEncoder(0, true);
+        store.updateEncoder(0, 10, 1100);
+        expect(store.getEncoderCount(0)).toBe(160);
+
+        store.setEncoderSoftwareReversed(0, true);
+        store.updateEncoder(0, 20, 1150);
+        expect(store.getEncoderCount(0)).toBe(150);
+
+        store.resetEncoder(0);
+        expect(store.getEncoderCount(0)).toBe(0);
+    });
+
+    it("should start over from the next count after a resync", () => {
+        const store = new TelemetryStore();
+        store.addEncoder(0, false);
+
+        store.updateEncoder(0, 100, 1000);
+        store.resyncEncoder(0);
+        store.updateEncoder(0, 5000, 1050);
+        expect(store.getEncoderCount(0)).toBe(100);
+
+        store.updateEncoder(0, 5010, 1100);
+        expect(store.getEncoderCount(0)).toBe(110);
+    });
+
+    it("should be able to detect allocations", () => {
+        const objects: object[] = new Array(16);
+        let idx = 0;
+
+        expect(bytesAllocatedPerCycle(() => {
+            objects[idx++ & 15] = { value: idx };
+        })).toBeGreaterThan(8);
+    });
+
+    it("should not allocate during a steady state poll cycle", async () => {
+        const bus = new SnapshotCaptureI2C(1);
+        const romi = new MockRomiI2C(0x14);
+        romi.setFirmwareIdent(FIRMWARE_IDENT);
+        bus.addDeviceToBus(romi);
+        bus.addDeviceToBus(new MockRomiImu(0x6B));
+
+        const robot = new RomiRobot(new QueuedI2CBus(bus), 0x14);
+        await robot.readyP();
+        robot.scheduler.stop();
+        robot.getIMU().fifoStop();
+
+        // Only the telemetry task is measured. The rest talk to the bus,
+        // which allocates
+        robot.scheduler.tasks
+        .filter(task => task.name !== "Telemetry")
+        .forEach(task => robot.scheduler.removeTask(task));
+
+        robot.registerEncoder(0, 4, 5);
+        robot.registerEncoder(1, 6, 7);
+        robot.setDigitalChannelMode(8, DigitalChannelMode.INPUT);
+        await settle();
+
+        // Stand in for the bus, with an encoder count that keeps changing,
+        // and acknowledging the robot's last command block
+        const commandSeq = romi.getIncomingBytes(RomiDataBuffer.commandSeq.offset, 1)[0];
+        const sample = Buffer.alloc(TELEMETRY_BLOCK_LENGTH);
+        // Whole milliseconds, which V8 keeps as small integers rather than
+        // allocating a heap number every time this changes
+        let now = Math.ceil(performance.now());
+        const writeSample = () => {
+            const counts = now & 0xFF;
+            sample.writeInt16LE(counts, RomiDataBuffer.leftEncoder.offset - TELEMETRY_BLOCK_START);
+            sample.writeInt16LE(-counts, RomiDataBuffer.rightEncoder.offset - TELEMETRY_BLOCK_START);
+            sample.writeUInt16LE(counts << 6, RomiDataBuffer.analog.offset - TELEMETRY_BLOCK_START);
+            sample.writeInt16LE(counts & 0x01, RomiDataBuffer.extIoValues.offset - TELEMETRY_BLOCK_START);
+            sample[RomiDataBuffer.commandAck.offset - TELEMETRY_BLOCK_START] = commandSeq;
+            sample[TELEMETRY_BLOCK_LENGTH - 1] = crc8(sample, 0, TELEMETRY_BLOCK_LENGTH - 1);
+            bus.telemetrySnapshot.write(sample);
+        };
+
+        // One cycle is a fresh sample, a scheduler tick running the
+        // telemetry task, and the robot program reading some values back.
+        // Analog voltages are left out, as returning a fractional number
+        // from a call V8 doesn't inline allocates a heap number, wherever
+        // the number came from
+        const telemetryTask = robot.scheduler.tasks[0];
+        const stepMs = Math.ceil(telemetryTask.periodMs);
+        const cycle = () => {
+            now += stepMs;
+            writeSample();
+            robot.scheduler.tick(now);
+
+            robot.getEncoderCount(0);
+            robot.getDIOValue(8);
+        };
+
+        // Every clock read allocates a heap number, and the scheduler reads
+        // the clock to time each run, so a scheduler with a task that does
+        // nothing gives the baseline to compare against. Both warm up
+        // before either is measured, so they run the same compiled
+        // scheduler code
+        const baseline = new TickScheduler(robot.scheduler.tickMs);
+        baseline.addTask("Baseline", stepMs, () => {});
+        let baselineNow = now;
+        const baselineCycle = () => {
+            baselineNow += stepMs;
+            writeSample();
+            baseline.tick(baselineNow);
+        };
+
+        for (let i = 0; i < WARMUP_CYCLES; i++) {
+            cycle();
+            baselineCycle();
+        }
+
+        const bytesPerCycle = bytesAllocatedPerCycle(cycle);
+        const baselineBytesPerCycle = bytesAllocatedPerCycle(baselineCycle);
+
+        expect(telemetryTask.stats.runs).toBeGreaterThan(WARMUP_CYCLES);
+        expect(robot.getEncoderCount(0)).not.toBe(0);
+        expect(bytesPerCycle - baselineBytesPerCycle).toBeLessThan(1);
+    });
+
+    it("should ignore telemetry sampled before an encoder reset", async () => {
+        // Periodic reads are only sampled on request on this bus
+        const bus = new ReplayI2C(1);
+        const romi = new MockRomiI2C(0x14);
+        romi.setFirmwareIdent(FIRMWARE_IDENT);
+        bus.addDeviceToBus(romi);
+        bus.addDeviceToBus(new MockRomiImu(0x6B));
+
+        const queuedBus = new QueuedI2CBus(bus);
+        const robot = new RomiRobot(queuedBus, 0x14);
+        await robot.readyP();
+        robot.scheduler.stop();
+        robot.getIMU().fifoStop();
+        robot.registerEncoder(0, 4, 5);
+
+        let now = performance.now();
+        const poll = async () => {
+            await bus.samplePeriodicReads();
+            now += 1000;
+            robot.scheduler.tick(now);
+        };
+
+        setEncoderCounts(romi, 1000, 0);
+        await poll();
+        await poll();
+        expect(robot.getEncoderCount(0)).toBe(1000);
+
+        // A sample taken just before the reset is still waiting to be read
+        setEncoderCounts(romi, 1200, 0);
+        await bus.samplePeriodicReads();
+        queuedBus.resetStats();
+        robot.resetEncoder(0);
+        setEncoderCounts(romi, 0, 0);
+        now += 1000;
+        robot.scheduler.tick(now);
+        expect(robot.getEncoderCount(0)).toBe(0);
+
+        // The first sample read after the reset write is still from before
+        // the firmware applied it
+        await settle();
+        expect(queuedBus.stats.ACTUATION.completed).toBe(1);
+        setEncoderCounts(romi, 1250, 0);
+        await poll();
+        expect(robot.getEncoderCount(0)).toBe(0);
+
+        setEncoderCounts(romi, 10, 0);
+        await poll();
+        expect(robot.getEncoderCount(0)).toBe(10);
+    });
+});
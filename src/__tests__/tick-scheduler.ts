@@ -0,0 +1,67 @@
+import TickScheduler from "../utils/tick-scheduler";
+
+describe("Tick Scheduler", () => {
+    it("should run tasks at their period and phase", () => {
+        const scheduler = new TickScheduler(5);
+        const runTimes: number[] = [];
+
+        scheduler.addTask("test", 20, () => {
+            runTimes.push(now);
+        }, 10);
+
+        let now = 0;
+        for (; now <= 60; now += 5) {
+            scheduler.tick(now);
+        }
+
+        expect(runTimes).toEqual([10, 30, 50]);
+    });
+
+    it("should spread tasks with the same period across ticks", () => {
+        const scheduler = new TickScheduler(5);
+
+        scheduler.addTask("first", 20, () => {});
+        scheduler.addTask("second", 20, () => {});
+        scheduler.addTask("third", 20, () => {});
+
+        expect(scheduler.stats.tasks.map(task => task.phaseMs)).toEqual([0, 5, 10]);
+    });
+
+    it("should count missed periods as overruns", () => {
+        const scheduler = new TickScheduler(5);
+        let runs = 0;
+
+        scheduler.addTask("test", 10, () => {
+            runs++;
+        }, 0);
+
+        scheduler.tick(0);
+        // Event loop stalled for 35ms. The 10ms and 20ms runs are
+        // missed, and the 30ms run happens late
+        scheduler.tick(35);
+
+        expect(runs).toEqual(2);
+        expect(scheduler.stats.tasks[0].overruns).toEqual(2);
+    });
+
+    it("should pick up period changes", () => {
+        const scheduler = new TickScheduler(5);
+        let periodMs = 10;
+        let runs = 0;
+
+        scheduler.addTask("test", () => periodMs, () => {
+            runs++;
+        }, 0);
+
+        for (let now = 0; now < 100; now += 5) {
+            if (now === 50) {
+                periodMs = 25;
+            }
+            scheduler.tick(now);
+        }
+
+        // 0, 10, 20, 30, 40, then 50 and 75 after the change
+        expect(runs).toEqual(7);
+        expect(scheduler.stats.tasks[0].periodMs).toEqual(25);
+    });
+});
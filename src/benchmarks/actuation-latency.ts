@@ -0,0 +1,484 @@
+import { performance } from "perf_hooks";
+import program from "commander";
+import { WPILibWSRobotEndpoint, WPILibWSServerConfig } from "@wpilib/wpilib-ws-robot";
+import WPILibWSRomiRobot from "../robot/romi-robot";
+import RomiConfiguration, { IOPinMode } from "../robot/romi-config";
+import RomiDataBuffer, { FIRMWARE_IDENT } from "../robot/romi-shmem-buffer";
+import { DEFAULT_POLLING_RATES_HZ, PollingRates } from "../robot/polling-rates";
+import MockI2C from "../device-interfaces/i2c/mock-i2c";
+import MockI2CDevice from "../device-interfaces/i2c/mock-i2c-device";
+import QueuedI2CBus, { I2CPriority, I2CSchedulerStats } from "../device-interfaces/i2c/queued-i2c-bus";
+import { I2CBusTiming, I2CBusTimingStats, I2CClockSpeed } from "../device-interfaces/i2c/bus-timing";
+import MockRomiI2C from "../__mocks__/mock-romi";
+import StreamingRomiImu from "../__mocks__/streaming-imu";
+import MockColorSensor from "../__mocks__/mock-color-sensor";
+import FirmwareSimRomiI2C, { DEFAULT_FIRMWARE_SIM_PROGRAM } from "../__mocks__/firmware-sim-romi";
+import ActuationTrace, { ActuationLatencyStats, ActuationTraceResult } from "./actuation-trace";
+import HALSimWSClient, { HALSimMessage } from "./halsim-ws-client";
+
+const ROMI_ADDRESS: number = 0x14;
+const IMU_ADDRESS: number = 0x6B;
+const COLOR_SENSOR_ADDRESS: number = 0x52;
+
+const COMMAND_START: number = RomiDataBuffer.commandCrc.crcStart;
+const COMMAND_SEQ_OFFSET: number = RomiDataBuffer.commandSeq.offset - COMMAND_START;
+
+// Left motor. The right motor gets the same commands, untraced
+const TRACED_PWM_CHANNEL: number = 0;
+const PWM_CHANNELS: number[] = [0, 1];
+
+// Onboard DIO 0-7, plus the 5 external pins (all set up as DIO here)
+const MAX_DIO_INPUTS: number = 13;
+
+// Consecutive samples always differ, so none get dropped as unchanged
+const SAMPLE_SPEEDS: number[] = [0.1, 0.2, 0.3, 0.4, 0.5, 0.4, 0.3, 0.2];
+
+const DEFAULT_LOOP_PERIOD_MS: number = 20;
+const DEFAULT_DURATION_MS: number = 5000;
+const DEFAULT_IMU_ODR_HZ: number = 104;
+export const DEFAULT_BENCHMARK_PORT: number = 3399;
+const BENCHMARK_URI: string = "/wpilibws";
+
+// Time for the robot to come up and see the program enabled before
+// samples start, and for the last samples to make it through after
+const WARMUP_MS: number = 500;
+const DRAIN_MS: number = 250;
+
+// How often the firmware simulator's clock catches up with the wall
+// clock, which is also how precisely applied commands are timed
+const FIRMWARE_CLOCK_PERIOD_MS: number = 1;
+
+/**
+ * An actuation latency run: which firmware, and what else the robot is
+ * busy with
+ */
+export interface ActuationLatencyConfig {
+    name: string;
+
+    // Bus timing, always in real time here. Defaults to 400kHz
+    timing?: I2CBusTiming;
+
+    // Run the natively built firmware as the Romi. Without it, a mock Romi
+    // stands in, and commands count as applied once they're written
+    firmwareSimProgram?: string;
+
+    // Background load
+    // Frames per second into the IMU FIFO
+    imuOdrHz?: number;
+    pollingRates?: Partial<PollingRates>;
+    // A REV color sensor on the bus, updated at this rate
+    colorSensorRateHz?: number;
+    // DIO channels the robot program sets up as inputs
+    dioInputs?: number;
+
+    // Period of the robot program's main loop, which sends one sample
+    loopPeriodMs?: number;
+    durationMs?: number;
+    port?: number;
+}
+
+export interface ActuationLatencyResult {
+    name: string;
+    durationMs: number;
+    firmwareSim: boolean;
+    latency: ActuationTraceResult;
+    bus: I2CBusTimingStats;
+    i2cScheduler: I2CSchedulerStats;
+    maxEventLoopLagMs: number;
+    wsMessagesReceived: number;
+}
+
+/**
+ * Stamps PWM updates on the traced channel as they arrive from the endpoint
+ */
+class TracedRomiRobot extends WPILibWSRomiRobot {
+    private _trace: ActuationTrace;
+
+    constructor(bus: QueuedI2CBus, address: number, romiConfig: RomiConfiguration, trace: ActuationTrace) {
+        super(bus, address, romiConfig);
+        this._trace = trace;
+    }
+
+    public setPWMValue(channel: number, value: number): void {
+        if (channel === TRACED_PWM_CHANNEL) {
+            this._trace.received(performance.now());
+        }
+
+        super.setPWMValue(channel, value);
+    }
+}
+
+/**
+ * Stamps command blocks as they go into the queue
+ */
+class TracedQueuedI2CBus extends QueuedI2CBus {
+    private _trace: ActuationTrace;
+
+    constructor(bus: MockI2C, trace: ActuationTrace) {
+        super(bus);
+        this._trace = trace;
+    }
+
+    public writeBlock(addr: number, cmd: number, data: Buffer, delayMs: number = 0, priority: I2CPriority = I2CPriority.TELEMETRY): Promise<void> {
+        if (addr === ROMI_ADDRESS && cmd === COMMAND_START) {
+            this._trace.queued(data[COMMAND_SEQ_OFFSET], performance.now());
+        }
+
+        return super.writeBlock(addr, cmd, data, delayMs, priority);
+    }
+}
+
+/**
+ * Sits in front of the Romi on the bus, and stamps command blocks as
+ * they land in its buffer
+ */
+class TracedRomiDevice extends MockI2CDevice {
+    private _device: MockI2CDevice;
+    private _trace: ActuationTrace;
+    private _appliesOnWrite: boolean;
+
+    constructor(device: MockI2CDevice, trace: ActuationTrace, appliesOnWrite: boolean) {
+        super(device.address);
+        this._device = device;
+        this._trace = trace;
+        this._appliesOnWrite = appliesOnWrite;
+    }
+
+    public readByte(cmd: number): Promise<number> {
+        return this._device.readByte(cmd);
+    }
+
+    public readWord(cmd: number): Promise<number> {
+        return this._device.readWord(cmd);
+    }
+
+    public writeByte(cmd: number, byte: number): Promise<void> {
+        return this._device.writeByte(cmd, byte);
+    }
+
+    public writeWord(cmd: number, word: number): Promise<void> {
+        return this._device.writeWord(cmd, word);
+    }
+
+    public sendByte(cmd: number): Promise<void> {
+        return this._device.sendByte(cmd);
+    }
+
+    public receiveByte(): Promise<number> {
+        return this._device.receiveByte();
+    }
+
+    public readBlock(cmd: number, length: number): Promise<Buffer> {
+        return this._device.readBlock(cmd, length);
+    }
+
+    public writeBlock(cmd: number, data: Buffer): Promise<void> {
+        return this._device.writeBlock(cmd, data)
+        .then(() => {
+            if (cmd === COMMAND_START) {
+                const seq = data[COMMAND_SEQ_OFFSET];
+                const now = performance.now();
+                this._trace.written(seq, now);
+
+                if (this._appliesOnWrite) {
+                    this._trace.applied(seq, now);
+                }
+            }
+        });
+    }
+}
+
+/**
+ * Keeps the firmware simulator in step with the wall clock, and watches
+ * for it acknowledging command blocks. The firmware acknowledges a block
+ * in the same loop that it sets the motor speeds from it
+ */
+class FirmwareSimClock {
+    private _sim: FirmwareSimRomiI2C;
+    private _trace: ActuationTrace;
+
+    private _timer: NodeJS.Timeout | undefined;
+    private _lastTime: number = 0;
+    private _lastAck: number = -1;
+    private _busy: boolean = false;
+
+    constructor(sim: FirmwareSimRomiI2C, trace: ActuationTrace) {
+        this._sim = sim;
+        this._trace = trace;
+    }
+
+    public start(): void {
+        this._lastTime = performance.now();
+        this._timer = setInterval(() => this._tick(), FIRMWARE_CLOCK_PERIOD_MS);
+    }
+
+    public stop(): void {
+        if (this._timer !== undefined) {
+            clearInterval(this._timer);
+            this._timer = undefined;
+        }
+    }
+
+    // Ticks that come round while the simulator is still busy are
+    // skipped. The next one catches up on the time
+    private _tick(): void {
+        if (this._busy) {
+            return;
+        }
+        this._busy = true;
+
+        const now = performance.now();
+        const elapsedMs = now - this._lastTime;
+        this._lastTime = now;
+
+        this._sim.advance(elapsedMs)
+        .then(() => this._sim.readByte(RomiDataBuffer.commandAck.offset))
+        .then(ack => {
+            if (ack !== this._lastAck) {
+                this._lastAck = ack;
+                this._trace.applied(ack, performance.now());
+            }
+        })
+        .catch(() => {})
+        .then(() => {
+            this._busy = false;
+        });
+    }
+}
+
+function wait(ms: number): Promise<void> {
+    return new Promise(resolve => setTimeout(resolve, ms));
+}
+
+/**
+ * Run the real WebSocket endpoint and RomiRobot against a scripted robot
+ * program, and time each PWM update on its way to the motors
+ *
+ * The robot program sends a new left/right motor speed every loop (along
+ * with a DS packet to keep the robot enabled), while the robot polls its
+ * sensors over a mock bus with realistic timing. Results are in wall
+ * clock time, so they include event loop delays on the host
+ */
+export async function runActuationLatencyBenchmark(config: ActuationLatencyConfig): Promise<ActuationLatencyResult> {
+    const durationMs = config.durationMs !== undefined ? config.durationMs : DEFAULT_DURATION_MS;
+    const loopPeriodMs = config.loopPeriodMs !== undefined ? config.loopPeriodMs : DEFAULT_LOOP_PERIOD_MS;
+    const port = config.port !== undefined ? config.port : DEFAULT_BENCHMARK_PORT;
+    const imuOdrHz = config.imuOdrHz !== undefined ? config.imuOdrHz : DEFAULT_IMU_ODR_HZ;
+    const dioInputs = Math.min(config.dioInputs || 0, MAX_DIO_INPUTS);
+
+    const trace = new ActuationTrace();
+
+    // Set up the bus
+    const timing: I2CBusTiming = config.timing || { clockHz: I2CClockSpeed.FAST };
+    const bus = new MockI2C(1, false, { ...timing, realTime: true });
+
+    let sim: FirmwareSimRomiI2C | undefined;
+    let simClock: FirmwareSimClock | undefined;
+    let romiDevice: MockI2CDevice;
+
+    if (config.firmwareSimProgram !== undefined) {
+        sim = new FirmwareSimRomiI2C(ROMI_ADDRESS, config.firmwareSimProgram);
+        simClock = new FirmwareSimClock(sim, trace);
+        simClock.start();
+        romiDevice = new TracedRomiDevice(sim, trace, false);
+    }
+    else {
+        const mockRomi = new MockRomiI2C(ROMI_ADDRESS);
+        mockRomi.setFirmwareIdent(FIRMWARE_IDENT);
+        romiDevice = new TracedRomiDevice(mockRomi, trace, true);
+    }
+
+    bus.addDeviceToBus(romiDevice);
+    bus.addDeviceToBus(new StreamingRomiImu(IMU_ADDRESS, imuOdrHz));
+
+    // Set up the robot
+    const romiConfig = new RomiConfiguration();
+    romiConfig.externalIOConfig = [
+        { mode: IOPinMode.DIO },
+        { mode: IOPinMode.DIO },
+        { mode: IOPinMode.DIO },
+        { mode: IOPinMode.DIO },
+        { mode: IOPinMode.DIO }
+    ];
+    romiConfig.pollingRates = { ...DEFAULT_POLLING_RATES_HZ, ...config.pollingRates };
+
+    if (config.colorSensorRateHz !== undefined) {
+        bus.addDeviceToBus(new MockColorSensor(COLOR_SENSOR_ADDRESS));
+        romiConfig.customDevices = [{ type: "rev-color-sensor", config: {}, rateHz: config.colorSensorRateHz }];
+    }
+
+    const queuedBus = new TracedQueuedI2CBus(bus, trace);
+    const robot = new TracedRomiRobot(queuedBus, ROMI_ADDRESS, romiConfig, trace);
+    await robot.readyP();
+
+    const serverSettings: WPILibWSServerConfig = {
+        port,
+        uri: BENCHMARK_URI
+    };
+    const endpoint = WPILibWSRobotEndpoint.createServerEndpoint(robot, serverSettings);
+    await endpoint.startP();
+
+    // Bring up the robot program
+    const client = new HALSimWSClient();
+    await client.connect("localhost", port, BENCHMARK_URI);
+
+    PWM_CHANNELS.forEach(channel => {
+        client.send(pwmMessage(channel, { "<init": true }));
+    });
+
+    for (let channel = 0; channel < dioInputs; channel++) {
+        client.send({ type: "DIO", device: `${channel}`, data: { "<init": true, "<input": true } });
+    }
+
+    const dsMessage: HALSimMessage = {
+        type: "DriverStation",
+        device: "",
+        data: { ">enabled": true, ">new_data": true }
+    };
+
+    let sampling = false;
+    let sampleIdx = 0;
+    const loopTimer = setInterval(() => {
+        client.send(dsMessage);
+
+        if (!sampling) {
+            return;
+        }
+
+        const speed = SAMPLE_SPEEDS[sampleIdx % SAMPLE_SPEEDS.length];
+        sampleIdx++;
+
+        PWM_CHANNELS.forEach(channel => {
+            const sentTime = client.send(pwmMessage(channel, { "<speed": speed }));
+            if (channel === TRACED_PWM_CHANNEL) {
+                trace.sent(sentTime);
+            }
+        });
+    }, loopPeriodMs);
+
+    await wait(WARMUP_MS);
+
+    // Only count bus time from here on
+    bus.timingModel.resetStats();
+    queuedBus.resetStats();
+
+    sampling = true;
+    await wait(durationMs);
+    sampling = false;
+    await wait(DRAIN_MS);
+
+    clearInterval(loopTimer);
+
+    const result: ActuationLatencyResult = {
+        name: config.name,
+        durationMs,
+        firmwareSim: sim !== undefined,
+        latency: trace.result(),
+        bus: bus.timingStats,
+        i2cScheduler: queuedBus.stats,
+        maxEventLoopLagMs: robot.schedulerStats.maxLagMs,
+        wsMessagesReceived: client.messagesReceived
+    };
+
+    // Shut everything down. The telemetry sampling on the mock bus keeps
+    // going regardless, so callers that are done should exit
+    client.close();
+    await endpoint.stopP();
+    robot.scheduler.stop();
+    robot.getIMU().fifoStop();
+
+    if (sim) {
+        simClock.stop();
+        sim.close();
+    }
+
+    return result;
+}
+
+function pwmMessage(channel: number, data: { [key: string]: any }): HALSimMessage {
+    return { type: "PWM", device: `${channel}`, data };
+}
+
+const FAST_TELEMETRY_RATES: Partial<PollingRates> = {
+    encoders: 500,
+    dio: 500,
+    analog: 500,
+    battery: 500
+};
+
+/**
+ * The standard set of runs: the default setup, then each kind of
+ * background load on its own, then all of them together
+ */
+export const ACTUATION_LATENCY_SUITE: ActuationLatencyConfig[] = [
+    {
+        name: "Default rates"
+    },
+    {
+        name: "IMU at 1.66kHz ODR, polled at 500Hz",
+        imuOdrHz: 1660,
+        pollingRates: { imu: 500 }
+    },
+    {
+        name: "Color sensor at 100Hz",
+        colorSensorRateHz: 100
+    },
+    {
+        name: "13 DIO inputs, telemetry at 500Hz",
+        dioInputs: MAX_DIO_INPUTS,
+        pollingRates: FAST_TELEMETRY_RATES
+    },
+    {
+        name: "All of the above",
+        imuOdrHz: 1660,
+        colorSensorRateHz: 100,
+        dioInputs: MAX_DIO_INPUTS,
+        pollingRates: { ...FAST_TELEMETRY_RATES, imu: 500 }
+    }
+];
+
+function formatStats(stats: ActuationLatencyStats): string {
+    return `p50 ${stats.p50Ms.toFixed(2)}ms, p99 ${stats.p99Ms.toFixed(2)}ms, max ${stats.maxMs.toFixed(2)}ms`;
+}
+
+if (require.main === module) {
+    program
+        .name("actuation-latency")
+        .option("-f, --firmware-sim [program]", "use the natively built firmware as the Romi")
+        .option("-d, --duration <ms>", "sampling time per run", `${DEFAULT_DURATION_MS}`)
+        .option("-p, --port <port>", "port for the WebSocket endpoint", `${DEFAULT_BENCHMARK_PORT}`)
+        .parse(process.argv);
+
+    let firmwareSimProgram: string | undefined;
+    if (program.firmwareSim !== undefined) {
+        firmwareSimProgram = (typeof program.firmwareSim === "string") ? program.firmwareSim : DEFAULT_FIRMWARE_SIM_PROGRAM;
+    }
+
+    (async () => {
+        for (const config of ACTUATION_LATENCY_SUITE) {
+            const result = await runActuationLatencyBenchmark({
+                ...config,
+                firmwareSimProgram,
+                durationMs: parseInt(program.duration, 10),
+                port: parseInt(program.port, 10)
+            });
+
+            const latency = result.latency;
+            console.log(`${result.name} (${result.firmwareSim ? "firmware simulator" : "mock Romi"})`);
+            console.log(`  total:              ${formatStats(latency.total)} ` +
+                        `(${latency.applied}/${latency.sent} applied, ${latency.superseded} superseded, ${latency.lost} lost)`);
+            console.log(`  WS -> robot:        ${formatStats(latency.stages.received)}`);
+            console.log(`  robot -> queue:     ${formatStats(latency.stages.queued)}`);
+            console.log(`  queue -> Romi:      ${formatStats(latency.stages.written)}`);
+            console.log(`  Romi -> motors:     ${formatStats(latency.stages.applied)}`);
+            console.log(`  bus: ${(result.bus.utilization * 100).toFixed(1)}% busy, ` +
+                        `max event loop lag ${result.maxEventLoopLagMs.toFixed(2)}ms`);
+        }
+
+        process.exit(0);
+    })()
+    .catch(err => {
+        console.error(err);
+        process.exit(1);
+    });
+}
@@ -0,0 +1,202 @@
+/**
+ * Points on the way from a robot program's PWM message to the motors
+ */
+export enum ActuationStage {
+    // Handed to the WebSocket by the robot program
+    SENT,
+
+    // Passed to RomiRobot.setPWMValue() by the endpoint
+    RECEIVED,
+
+    // Command block handed to the I2C queue
+    QUEUED,
+
+    // Command block written into the Romi's shared buffer
+    WRITTEN,
+
+    // Command block applied by the firmware (and acknowledged)
+    APPLIED
+}
+
+const NUM_STAGES: number = ActuationStage.APPLIED + 1;
+
+export interface ActuationLatencyStats {
+    count: number;
+    p50Ms: number;
+    p99Ms: number;
+    maxMs: number;
+}
+
+export interface ActuationStageStats {
+    received: ActuationLatencyStats;
+    queued: ActuationLatencyStats;
+    written: ActuationLatencyStats;
+    applied: ActuationLatencyStats;
+}
+
+export interface ActuationTraceResult {
+    sent: number;
+    applied: number;
+
+    // Overwritten by a newer command before the firmware picked them up
+    superseded: number;
+
+    // Never made it to the firmware at all
+    lost: number;
+
+    // Command blocks that went out again carrying traced samples
+    resends: number;
+
+    // From SENT to APPLIED
+    total: ActuationLatencyStats;
+
+    // Time spent getting to each stage from the one before it
+    stages: ActuationStageStats;
+}
+
+interface ActuationSample {
+    // performance.now() at each stage, NaN until it gets there
+    times: number[];
+
+    // Sequence number of the command block carrying it, -1 until queued
+    seq: number;
+
+    superseded: boolean;
+}
+
+/**
+ * Follows samples (PWM updates on one channel) through each stage
+ *
+ * Samples reach the robot in the order they were sent. From there, every
+ * sample still waiting when a command block is queued rides on that block,
+ * and is matched up by the block's sequence number from then on. The
+ * firmware only acknowledges the latest block it has, so samples on older
+ * blocks that are still outstanding at that point count as superseded
+ */
+export default class ActuationTrace {
+    private _samples: ActuationSample[] = [];
+
+    private _awaitingReceive: ActuationSample[] = [];
+    private _awaitingQueue: ActuationSample[] = [];
+
+    // Queued but not yet applied, oldest first
+    private _inFlight: ActuationSample[] = [];
+
+    private _resends: number = 0;
+
+    public get sentCount(): number {
+        return this._samples.length;
+    }
+
+    public sent(time: number): void {
+        const sample: ActuationSample = {
+            times: new Array(NUM_STAGES).fill(NaN),
+            seq: -1,
+            superseded: false
+        };
+        sample.times[ActuationStage.SENT] = time;
+
+        this._samples.push(sample);
+        this._awaitingReceive.push(sample);
+    }
+
+    public received(time: number): void {
+        const sample = this._awaitingReceive.shift();
+        if (sample) {
+            sample.times[ActuationStage.RECEIVED] = time;
+            this._awaitingQueue.push(sample);
+        }
+    }
+
+    public queued(seq: number, time: number): void {
+        if (this._awaitingQueue.length > 0) {
+            this._awaitingQueue.forEach(sample => {
+                sample.seq = seq;
+                sample.times[ActuationStage.QUEUED] = time;
+                this._inFlight.push(sample);
+            });
+            this._awaitingQueue = [];
+            return;
+        }
+
+        // Nothing new, so this is the robot sending the latest command
+        // again. The samples on the latest block move over to this one
+        if (this._inFlight.length > 0) {
+            const lastSeq = this._inFlight[this._inFlight.length - 1].seq;
+            this._inFlight.forEach(sample => {
+                if (sample.seq === lastSeq) {
+                    sample.seq = seq;
+                }
+            });
+            this._resends++;
+        }
+    }
+
+    public written(seq: number, time: number): void {
+        this._inFlight.forEach(sample => {
+            if (sample.seq === seq && isNaN(sample.times[ActuationStage.WRITTEN])) {
+                sample.times[ActuationStage.WRITTEN] = time;
+            }
+        });
+    }
+
+    public applied(seq: number, time: number): void {
+        let lastIdx = -1;
+        for (let i = this._inFlight.length - 1; i >= 0; i--) {
+            if (this._inFlight[i].seq === seq) {
+                lastIdx = i;
+                break;
+            }
+        }
+
+        if (lastIdx < 0) {
+            return;
+        }
+
+        for (let i = 0; i <= lastIdx; i++) {
+            const sample = this._inFlight[i];
+            if (sample.seq === seq) {
+                sample.times[ActuationStage.APPLIED] = time;
+            }
+            else {
+                sample.superseded = true;
+            }
+        }
+
+        this._inFlight = this._inFlight.slice(lastIdx + 1);
+    }
+
+    public result(): ActuationTraceResult {
+        const applied = this._samples.filter(sample => !isNaN(sample.times[ActuationStage.APPLIED]));
+        const superseded = this._samples.filter(sample => sample.superseded).length;
+
+        return {
+            sent: this._samples.length,
+            applied: applied.length,
+            superseded,
+            lost: this._samples.length - applied.length - superseded,
+            resends: this._resends,
+            total: latencyStats(applied, ActuationStage.SENT, ActuationStage.APPLIED),
+            stages: {
+                received: latencyStats(applied, ActuationStage.SENT, ActuationStage.RECEIVED),
+                queued: latencyStats(applied, ActuationStage.RECEIVED, ActuationStage.QUEUED),
+                written: latencyStats(applied, ActuationStage.QUEUED, ActuationStage.WRITTEN),
+                applied: latencyStats(applied, ActuationStage.WRITTEN, ActuationStage.APPLIED)
+            }
+        };
+    }
+}
+
+function latencyStats(samples: ActuationSample[], from: ActuationStage, to: ActuationStage): ActuationLatencyStats {
+    const latencies = samples.map(sample => sample.times[to] - sample.times[from])
+                             .filter(latency => !isNaN(latency))
+                             .sort((a, b) => a - b);
+    const count = latencies.length;
+
+    return {
+        count,
+        p50Ms: count > 0 ? latencies[Math.floor((count - 1) * 0.5)] : 0,
+        p99Ms: count > 0 ? latencies[Math.min(count - 1, Math.floor(count * 0.99))] : 0,
+        maxMs: count > 0 ? latencies[count - 1] : 0
+    };
+}
@@ -0,0 +1,393 @@
+import MockI2C from "../device-interfaces/i2c/mock-i2c";
+import MockI2CDevice from "../device-interfaces/i2c/mock-i2c-device";
+import QueuedI2CBus, { I2CPriority, QueuedI2CBusOptions } from "../device-interfaces/i2c/queued-i2c-bus";
+import { I2CBatchOp, I2CBatchResult } from "../device-interfaces/i2c/i2c-batch";
+import I2CBusTimingModel, { I2CBusTiming, I2CBusTimingStats, I2CClockSpeed } from "../device-interfaces/i2c/bus-timing";
+import RomiDataBuffer from "../robot/romi-shmem-buffer";
+
+const ROMI_ADDRESS: number = 0x14;
+const IMU_ADDRESS: number = 0x6B;
+const CUSTOM_DEVICE_BASE_ADDRESS: number = 0x40;
+
+const TELEMETRY_START: number = RomiDataBuffer.telemetryCrc.crcStart;
+const TELEMETRY_LENGTH: number = RomiDataBuffer.telemetryCrc.crcLength + 1;
+const COMMAND_START: number = RomiDataBuffer.commandCrc.crcStart;
+const COMMAND_LENGTH: number = RomiDataBuffer.commandCrc.crcLength + 1;
+
+// LSM6DS33 FIFO status and output registers, and the size of one
+// gyro + accel frame
+const IMU_FIFO_STATUS1: number = 0x3A;
+const IMU_FIFO_DATA_OUT_L: number = 0x3E;
+const IMU_FRAME_BYTES: number = 12;
+
+export enum TelemetryReadMode {
+    // The whole telemetry block in one read, as the robot does today
+    BLOCK = "block",
+
+    // Each IO register read on its own (leaving merging to the queue)
+    PER_REGISTER = "per-register"
+}
+
+/**
+ * A bus workload, and how the queue and bus are set up to serve it
+ */
+export interface BusBenchmarkConfig {
+    name: string;
+
+    timing: I2CBusTiming;
+    queue?: QueuedI2CBusOptions;
+
+    // Requested rates, in Hz (0 to leave a stream out)
+    telemetryHz: number;
+    imuHz: number;
+    actuationHz: number;
+    customDeviceHz?: number;
+
+    telemetryReadMode?: TelemetryReadMode;
+
+    // Frames read per IMU poll
+    imuFramesPerRead?: number;
+
+    // Word reads per custom device poll, one device each
+    customDevices?: number;
+
+    durationMs?: number;
+}
+
+export interface BusBenchmarkStreamResult {
+    requestedHz: number;
+    achievedHz: number;
+
+    // Polls that were due while the previous one was still in flight
+    skipped: number;
+    failed: number;
+
+    // From when a poll was due until it completed
+    avgLatencyMs: number;
+    maxLatencyMs: number;
+    p99LatencyMs: number;
+}
+
+export interface BusBenchmarkResult {
+    name: string;
+    durationMs: number;
+    telemetry: BusBenchmarkStreamResult;
+    imu: BusBenchmarkStreamResult;
+    actuation: BusBenchmarkStreamResult;
+    customDevices: BusBenchmarkStreamResult;
+    bus: I2CBusTimingStats;
+}
+
+const DEFAULT_DURATION_MS: number = 2000;
+
+/**
+ * Device with a plain register file, for anything whose contents the
+ * benchmark doesn't care about
+ */
+class RegisterDevice extends MockI2CDevice {
+    private _registers: Buffer = Buffer.alloc(256);
+    private _registerPtr: number = 0;
+
+    public readByte(cmd: number): Promise<number> {
+        return Promise.resolve(this._registers[cmd & 0xFF]);
+    }
+
+    public readWord(cmd: number): Promise<number> {
+        return Promise.resolve(this._registers.readUInt16LE(cmd & 0xFE));
+    }
+
+    public writeByte(cmd: number, byte: number): Promise<void> {
+        this._registers[cmd & 0xFF] = byte;
+        return Promise.resolve();
+    }
+
+    public writeWord(cmd: number, word: number): Promise<void> {
+        this._registers.writeUInt16LE(word & 0xFFFF, cmd & 0xFE);
+        return Promise.resolve();
+    }
+
+    public sendByte(cmd: number): Promise<void> {
+        this._registerPtr = cmd;
+        return Promise.resolve();
+    }
+
+    public receiveByte(): Promise<number> {
+        return this.readByte(this._registerPtr++);
+    }
+}
+
+/**
+ * Hands out work at the end of every batch, at the (virtual) time the bus
+ * frees up. Work that fell due during the batch is queued by the time the
+ * next batch is put together, just as if it had arrived while the bus
+ * was busy
+ */
+class BenchmarkI2C extends MockI2C {
+    public onBatchDone: () => void = () => {};
+
+    public executeBatch(ops: I2CBatchOp[]): Promise<I2CBatchResult[]> {
+        return super.executeBatch(ops)
+        .then(results => {
+            this.onBatchDone();
+            return results;
+        });
+    }
+}
+
+class Stream {
+    public requestedHz: number;
+    public nextDueUs: number = 0;
+    public inFlight: boolean = false;
+
+    public completed: number = 0;
+    public skipped: number = 0;
+    public failed: number = 0;
+    public latenciesUs: number[] = [];
+
+    private _periodUs: number;
+    private _run: () => Promise<any>;
+
+    constructor(requestedHz: number, run: () => Promise<any>) {
+        this.requestedHz = requestedHz;
+        this._periodUs = requestedHz > 0 ? 1e6 / requestedHz : Infinity;
+        this._run = run;
+
+        if (requestedHz <= 0) {
+            this.nextDueUs = Infinity;
+        }
+    }
+
+    /**
+     * Start a poll if one is due. Returns a promise for it, if one started
+     */
+    public poll(model: I2CBusTimingModel): Promise<void> | undefined {
+        const nowUs = model.nowUs;
+        if (this.nextDueUs > nowUs) {
+            return undefined;
+        }
+
+        const dueUs = this.nextDueUs;
+
+        // Polls that fell due while this stream was still in flight (or
+        // the bus was busy) are dropped, like a timer that fires late
+        const missed = Math.floor((nowUs - dueUs) / this._periodUs);
+        this.nextDueUs += (missed + 1) * this._periodUs;
+
+        if (this.inFlight) {
+            this.skipped += missed + 1;
+            return undefined;
+        }
+
+        this.skipped += missed;
+        this.inFlight = true;
+        return this._run()
+        .then(() => {
+            const latencyUs = model.nowUs - dueUs;
+            this.completed++;
+            this.latenciesUs.push(latencyUs);
+        })
+        .catch(() => {
+            this.failed++;
+        })
+        .then(() => {
+            this.inFlight = false;
+        });
+    }
+
+    public result(durationMs: number): BusBenchmarkStreamResult {
+        const sorted = this.latenciesUs.slice().sort((a, b) => a - b);
+        const count = sorted.length;
+        const totalUs = sorted.reduce((total, latencyUs) => total + latencyUs, 0);
+
+        return {
+            requestedHz: this.requestedHz,
+            achievedHz: this.completed / (durationMs / 1000),
+            skipped: this.skipped,
+            failed: this.failed,
+            avgLatencyMs: count > 0 ? (totalUs / count) / 1000 : 0,
+            maxLatencyMs: count > 0 ? sorted[count - 1] / 1000 : 0,
+            p99LatencyMs: count > 0 ? sorted[Math.min(count - 1, Math.floor(count * 0.99))] / 1000 : 0
+        };
+    }
+}
+
+/**
+ * Run a bus workload in virtual time, and report the rates each stream
+ * achieved and how long its transfers waited
+ */
+export async function runBusBenchmark(config: BusBenchmarkConfig): Promise<BusBenchmarkResult> {
+    const durationMs = config.durationMs !== undefined ? config.durationMs : DEFAULT_DURATION_MS;
+    const durationUs = durationMs * 1000;
+
+    // Always virtual time, so results don't depend on the host
+    const bus = new BenchmarkI2C(1, false, { ...config.timing, realTime: false });
+    const model = bus.timingModel;
+    const queue = new QueuedI2CBus(bus, config.queue);
+
+    bus.addDeviceToBus(new RegisterDevice(ROMI_ADDRESS));
+    bus.addDeviceToBus(new RegisterDevice(IMU_ADDRESS));
+
+    const numCustomDevices = config.customDevices || 0;
+    for (let i = 0; i < numCustomDevices; i++) {
+        bus.addDeviceToBus(new RegisterDevice(CUSTOM_DEVICE_BASE_ADDRESS + i));
+    }
+
+    const telemetryReads = telemetryReadsFor(config.telemetryReadMode || TelemetryReadMode.BLOCK);
+    const imuReadLength = (config.imuFramesPerRead || 1) * IMU_FRAME_BYTES;
+    const commandBlock = Buffer.alloc(COMMAND_LENGTH);
+
+    const streams = {
+        telemetry: new Stream(config.telemetryHz, () => {
+            return Promise.all(telemetryReads.map(([cmd, length]) => {
+                return queue.readBlock(ROMI_ADDRESS, cmd, length, true, I2CPriority.TELEMETRY);
+            }));
+        }),
+        imu: new Stream(config.imuHz, () => {
+            return queue.readWord(IMU_ADDRESS, IMU_FIFO_STATUS1, false, I2CPriority.TELEMETRY)
+            .then(() => queue.readBlock(IMU_ADDRESS, IMU_FIFO_DATA_OUT_L, imuReadLength, false, I2CPriority.TELEMETRY));
+        }),
+        actuation: new Stream(config.actuationHz, () => {
+            return queue.writeBlock(ROMI_ADDRESS, COMMAND_START, commandBlock, 0, I2CPriority.ACTUATION);
+        }),
+        customDevices: new Stream(numCustomDevices > 0 ? (config.customDeviceHz || 0) : 0, () => {
+            const reads: Promise<number>[] = [];
+            for (let i = 0; i < numCustomDevices; i++) {
+                reads.push(queue.readWord(CUSTOM_DEVICE_BASE_ADDRESS + i, 0, false, I2CPriority.CUSTOM_DEVICE));
+            }
+            return Promise.all(reads);
+        })
+    };
+    const allStreams: Stream[] = [streams.actuation, streams.telemetry, streams.imu, streams.customDevices];
+
+    let outstanding: Promise<void>[] = [];
+    const pollStreams = () => {
+        if (model.nowUs >= durationUs) {
+            return;
+        }
+
+        allStreams.forEach(stream => {
+            const pollP = stream.poll(model);
+            if (pollP) {
+                outstanding.push(pollP);
+            }
+        });
+    };
+
+    bus.onBatchDone = pollStreams;
+
+    while (model.nowUs < durationUs) {
+        pollStreams();
+
+        // Let the bus work through everything (including work that comes
+        // due along the way), then skip ahead over the idle time
+        while (outstanding.length > 0) {
+            const waiting = outstanding;
+            outstanding = [];
+            await Promise.all(waiting);
+        }
+
+        const nextDueUs = Math.min(...allStreams.map(stream => stream.nextDueUs));
+        model.advanceTo(Math.min(nextDueUs, durationUs));
+    }
+
+    return {
+        name: config.name,
+        durationMs,
+        telemetry: streams.telemetry.result(durationMs),
+        imu: streams.imu.result(durationMs),
+        actuation: streams.actuation.result(durationMs),
+        customDevices: streams.customDevices.result(durationMs),
+        bus: model.stats
+    };
+}
+
+// [cmd, length] of each read that makes up one telemetry poll
+function telemetryReadsFor(mode: TelemetryReadMode): [number, number][] {
+    if (mode === TelemetryReadMode.BLOCK) {
+        return [[TELEMETRY_START, TELEMETRY_LENGTH]];
+    }
+
+    const reads: [number, number][] = [];
+    const fields = ["extIoValues", "builtinDioInputs", "analog", "batteryMillivolts", "leftEncoder", "rightEncoder"];
+    fields.forEach(name => {
+        const field = RomiDataBuffer[name];
+        const size = (field.arraySize !== undefined ? field.arraySize : 1);
+        const elementSize = (name === "builtinDioInputs") ? 1 : 2;
+        for (let i = 0; i < size; i++) {
+            reads.push([field.offset + (i * elementSize), elementSize]);
+        }
+    });
+
+    return reads;
+}
+
+/**
+ * The standard set of comparisons: bus speed, queue strategy, how the
+ * telemetry is read, and extra load from the IMU and custom devices
+ */
+export const BUS_BENCHMARK_SUITE: BusBenchmarkConfig[] = [
+    {
+        name: "400kHz, default queue",
+        timing: { clockHz: I2CClockSpeed.FAST },
+        telemetryHz: 1000, imuHz: 104, actuationHz: 50
+    },
+    {
+        name: "100kHz, default queue",
+        timing: { clockHz: I2CClockSpeed.STANDARD },
+        telemetryHz: 1000, imuHz: 104, actuationHz: 50
+    },
+    {
+        name: "400kHz, per-register reads",
+        timing: { clockHz: I2CClockSpeed.FAST },
+        telemetryHz: 1000, imuHz: 104, actuationHz: 50,
+        telemetryReadMode: TelemetryReadMode.PER_REGISTER
+    },
+    {
+        name: "400kHz, per-register reads, no merging",
+        timing: { clockHz: I2CClockSpeed.FAST },
+        queue: { mergeReads: false },
+        telemetryHz: 1000, imuHz: 104, actuationHz: 50,
+        telemetryReadMode: TelemetryReadMode.PER_REGISTER
+    },
+    {
+        name: "400kHz, unbatched",
+        timing: { clockHz: I2CClockSpeed.FAST },
+        queue: { maxBatchSize: 1 },
+        telemetryHz: 1000, imuHz: 104, actuationHz: 50
+    },
+    {
+        name: "400kHz, IMU at full rate + 4 custom devices",
+        timing: { clockHz: I2CClockSpeed.FAST },
+        telemetryHz: 1000, imuHz: 1660, actuationHz: 50,
+        customDevices: 4, customDeviceHz: 100
+    },
+    {
+        name: "400kHz, 1% NACKs",
+        timing: { clockHz: I2CClockSpeed.FAST, nackRate: 0.01 },
+        telemetryHz: 1000, imuHz: 104, actuationHz: 50
+    }
+];
+
+function formatStream(stream: BusBenchmarkStreamResult): string {
+    if (stream.requestedHz === 0) {
+        return "-";
+    }
+
+    return `${stream.achievedHz.toFixed(0)}/${stream.requestedHz}Hz ` +
+           `(avg ${stream.avgLatencyMs.toFixed(2)}ms, p99 ${stream.p99LatencyMs.toFixed(2)}ms)`;
+}
+
+if (require.main === module) {
+    (async () => {
+        for (const config of BUS_BENCHMARK_SUITE) {
+            const result = await runBusBenchmark(config);
+            console.log(result.name);
+            console.log(`  telemetry: ${formatStream(result.telemetry)}`);
+            console.log(`  imu:       ${formatStream(result.imu)}`);
+            console.log(`  actuation: ${formatStream(result.actuation)}`);
+            console.log(`  custom:    ${formatStream(result.customDevices)}`);
+            console.log(`  bus:       ${(result.bus.utilization * 100).toFixed(1)}% busy, ` +
+                        `${result.bus.nacks} NACKs, ${result.bus.errors} errors`);
+        }
+    })();
+}
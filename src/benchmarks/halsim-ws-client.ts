@@ -0,0 +1,222 @@
+import http from "http";
+import crypto from "crypto";
+import { Socket } from "net";
+import { EventEmitter } from "events";
+import { performance } from "perf_hooks";
+
+/**
+ * A message in the WPILib HALSim WebSocket protocol
+ */
+export interface HALSimMessage {
+    type: string;
+    device: string;
+    data: { [key: string]: any };
+}
+
+// See RFC 6455
+const WS_GUID: string = "258EAFA5-E914-47DA-95CA-C5AB0DC85B11";
+
+const OPCODE_CONTINUATION: number = 0x0;
+const OPCODE_TEXT: number = 0x1;
+const OPCODE_CLOSE: number = 0x8;
+const OPCODE_PING: number = 0x9;
+const OPCODE_PONG: number = 0xA;
+
+const FIN_BIT: number = 0x80;
+const MASK_BIT: number = 0x80;
+
+/**
+ * Just enough of a WebSocket client to stand in for a robot program
+ *
+ * Messages go out as single masked text frames, on a socket with Nagle
+ * turned off, so nothing is held back on the way to the robot. Messages
+ * from the robot are parsed and emitted as "message" events
+ */
+export default class HALSimWSClient extends EventEmitter {
+    private _socket: Socket | null = null;
+    private _received: Buffer = Buffer.alloc(0);
+    private _fragments: Buffer[] = [];
+    private _messagesReceived: number = 0;
+
+    public get connected(): boolean {
+        return this._socket !== null;
+    }
+
+    public get messagesReceived(): number {
+        return this._messagesReceived;
+    }
+
+    public connect(host: string, port: number, uri: string): Promise<void> {
+        const key = crypto.randomBytes(16).toString("base64");
+        const expectedAccept = crypto.createHash("sha1").update(key + WS_GUID).digest("base64");
+
+        return new Promise<void>((resolve, reject) => {
+            const req = http.request({
+                host,
+                port,
+                path: uri,
+                headers: {
+                    "Connection": "Upgrade",
+                    "Upgrade": "websocket",
+                    "Sec-WebSocket-Key": key,
+                    "Sec-WebSocket-Version": "13"
+                }
+            });
+
+            req.on("upgrade", (res: http.IncomingMessage, socket: Socket, head: Buffer) => {
+                if (res.headers["sec-websocket-accept"] !== expectedAccept) {
+                    socket.destroy();
+                    reject(new Error("Invalid WebSocket handshake response"));
+                    return;
+                }
+
+                socket.setNoDelay(true);
+                socket.on("data", (data: Buffer) => this._onData(data));
+                socket.on("close", () => {
+                    this._socket = null;
+                    this.emit("close");
+                });
+                // Once we've closed the socket, the server hanging up
+                // on it isn't an error
+                socket.on("error", (err: Error) => {
+                    if (this._socket === socket) {
+                        this.emit("error", err);
+                    }
+                });
+
+                this._socket = socket;
+                if (head.length > 0) {
+                    this._onData(head);
+                }
+
+                resolve();
+            });
+
+            req.on("response", (res: http.IncomingMessage) => {
+                res.resume();
+                reject(new Error(`WebSocket upgrade refused (HTTP ${res.statusCode})`));
+            });
+
+            req.on("error", reject);
+            req.end();
+        });
+    }
+
+    /**
+     * Send a message
+     * @returns Time (performance.now()) the message was handed to the socket
+     */
+    public send(message: HALSimMessage): number {
+        const sentTime = performance.now();
+        this._sendFrame(OPCODE_TEXT, Buffer.from(JSON.stringify(message)));
+        return sentTime;
+    }
+
+    public close(): void {
+        if (this._socket) {
+            this._sendFrame(OPCODE_CLOSE, Buffer.alloc(0));
+            this._socket.end();
+            this._socket = null;
+        }
+    }
+
+    // Client frames always have to be masked
+    private _sendFrame(opcode: number, payload: Buffer): void {
+        if (!this._socket) {
+            throw new Error("WebSocket is not connected");
+        }
+
+        let header: Buffer;
+        if (payload.length < 126) {
+            header = Buffer.alloc(2);
+            header[1] = MASK_BIT | payload.length;
+        }
+        else if (payload.length < 0x10000) {
+            header = Buffer.alloc(4);
+            header[1] = MASK_BIT | 126;
+            header.writeUInt16BE(payload.length, 2);
+        }
+        else {
+            header = Buffer.alloc(10);
+            header[1] = MASK_BIT | 127;
+            header.writeUInt32BE(0, 2);
+            header.writeUInt32BE(payload.length, 6);
+        }
+        header[0] = FIN_BIT | opcode;
+
+        const mask = crypto.randomBytes(4);
+        const masked = Buffer.alloc(payload.length);
+        for (let i = 0; i < payload.length; i++) {
+            masked[i] = payload[i] ^ mask[i & 0x3];
+        }
+
+        this._socket.write(Buffer.concat([header, mask, masked]));
+    }
+
+    // Server frames are never masked
+    private _onData(data: Buffer): void {
+        this._received = Buffer.concat([this._received, data]);
+
+        while (this._received.length >= 2) {
+            const fin = (this._received[0] & FIN_BIT) !== 0;
+            const opcode = this._received[0] & 0x0F;
+            let length = this._received[1] & 0x7F;
+            let headerLength = 2;
+
+            if (length === 126) {
+                if (this._received.length < 4) {
+                    return;
+                }
+                length = this._received.readUInt16BE(2);
+                headerLength = 4;
+            }
+            else if (length === 127) {
+                if (this._received.length < 10) {
+                    return;
+                }
+                length = this._received.readUInt32BE(6);
+                headerLength = 10;
+            }
+
+            if (this._received.length < headerLength + length) {
+                return;
+            }
+
+            const payload = this._received.slice(headerLength, headerLength + length);
+            this._received = this._received.slice(headerLength + length);
+            this._onFrame(fin, opcode, payload);
+        }
+    }
+
+    private _onFrame(fin: boolean, opcode: number, payload: Buffer): void {
+        switch (opcode) {
+            case OPCODE_TEXT:
+            case OPCODE_CONTINUATION:
+                this._fragments.push(payload);
+                if (fin) {
+                    const text = Buffer.concat(this._fragments).toString();
+                    this._fragments = [];
+                    this._messagesReceived++;
+
+                    try {
+                        this.emit("message", JSON.parse(text));
+                    }
+                    catch (err) {
+                        // Not a HALSim message, so nothing we need
+                    }
+                }
+                break;
+            case OPCODE_PING:
+                if (this._socket) {
+                    this._sendFrame(OPCODE_PONG, payload);
+                }
+                break;
+            case OPCODE_CLOSE:
+                if (this._socket) {
+                    this._socket.end();
+                    this._socket = null;
+                }
+                break;
+        }
+    }
+}
@@ -0,0 +1,191 @@
+import program from "commander";
+import MockI2C from "../device-interfaces/i2c/mock-i2c";
+import QueuedI2CBus from "../device-interfaces/i2c/queued-i2c-bus";
+import LSM6 from "../robot/devices/core/lsm6/lsm6";
+import FIFOFrameBuffer, { FIFOFrames, FIFO_FRAME_VALUES } from "../robot/devices/core/lsm6/lsm6-fifo-buffer";
+import RomiGyro from "../robot/romi-gyro";
+import RomiIMUFusion from "../robot/romi-imu-fusion";
+import StreamFilter from "../utils/filters/stream-filter";
+import SimpleMovingAverage from "../utils/filters/simple-moving-average";
+import ExponentialMovingAverage from "../utils/filters/exponential-moving-average";
+import MedianFilter from "../utils/filters/median-filter";
+import BiquadLowPass from "../utils/filters/biquad-low-pass";
+import KalmanFilter1D from "../utils/filters/kalman-filter-1d";
+
+const IMU_ADDRESS: number = 0x6B;
+
+const DEFAULT_SIMULATED_SECONDS: number = 10;
+
+// Drains every 10ms (the default IMU polling rate) at each ODR
+const FRAMES_PER_DRAIN_833HZ: number = 9;
+const FRAMES_PER_DRAIN_1660HZ: number = 17;
+
+/**
+ * Work done with each FIFO drain. Called with the frames taken from the
+ * ring, and the time between frames in seconds
+ */
+export type IMUFrameProcessor = (frames: FIFOFrames, dt: number) => void;
+
+/**
+ * One way of processing IMU frames, at a given data rate
+ */
+export interface IMUBenchmarkConfig {
+    name: string;
+
+    // IMU output data rate in Hz
+    odrHz: number;
+
+    // Frames taken from the ring per drain
+    framesPerDrain: number;
+
+    createProcessor: () => IMUFrameProcessor;
+}
+
+export interface IMUBenchmarkResult {
+    name: string;
+    odrHz: number;
+
+    // CPU time (user + system) spent per second of IMU data
+    cpuMsPerSecond: number;
+
+    // Frames processed per second of CPU time
+    framesPerCpuSecond: number;
+
+    // Share of one core needed to keep up with the IMU
+    coreUtilization: number;
+}
+
+function filterAllAxes(createFilter: () => StreamFilter): IMUFrameProcessor {
+    const filters: StreamFilter[] = [];
+    for (let axis = 0; axis < FIFO_FRAME_VALUES; axis++) {
+        filters.push(createFilter());
+    }
+
+    const values = new Float64Array(32);
+    return (frames: FIFOFrames) => {
+        for (let axis = 0; axis < FIFO_FRAME_VALUES; axis++) {
+            frames.copyValues(axis, values);
+            filters[axis].processFrames(values, frames.length);
+        }
+    };
+}
+
+/**
+ * Feed a second of synthetic frames per simulated second through the
+ * processor, a drain at a time, and measure the CPU time it takes.
+ * Pushing the frames into the ring (which LSM6 does as it decodes a
+ * FIFO read) is counted as well
+ */
+export function runIMUBenchmark(config: IMUBenchmarkConfig, simulatedSeconds: number = DEFAULT_SIMULATED_SECONDS): IMUBenchmarkResult {
+    const processor = config.createProcessor();
+    const fifo = new FIFOFrameBuffer();
+    const dt = 1 / config.odrHz;
+    const drainsPerSecond = Math.ceil(config.odrHz / config.framesPerDrain);
+
+    let t = 0;
+    const drain = () => {
+        for (let i = 0; i < config.framesPerDrain; i++, t++) {
+            fifo.push(Math.sin(t / 100), Math.cos(t / 150), 30 + Math.sin(t / 7),
+                      0.01 * Math.sin(t), 0.02, 0.99);
+        }
+        processor(fifo.takeNewFrames(), dt);
+    };
+
+    // Warm up, so the JIT has settled before timing starts
+    for (let i = 0; i < drainsPerSecond; i++) {
+        drain();
+    }
+
+    const numDrains = drainsPerSecond * simulatedSeconds;
+    const start = process.cpuUsage();
+    for (let i = 0; i < numDrains; i++) {
+        drain();
+    }
+    const usage = process.cpuUsage(start);
+
+    const cpuMs = (usage.user + usage.system) / 1000;
+    const numFrames = numDrains * config.framesPerDrain;
+
+    return {
+        name: config.name,
+        odrHz: config.odrHz,
+        cpuMsPerSecond: cpuMs / simulatedSeconds,
+        framesPerCpuSecond: (cpuMs > 0) ? numFrames / (cpuMs / 1000) : Infinity,
+        coreUtilization: cpuMs / (simulatedSeconds * 1000)
+    };
+}
+
+export const IMU_BENCHMARK_SUITE: IMUBenchmarkConfig[] = [
+    // Each filter on all 6 axes, as a choice of filter for RomiGyro would
+    // need for the gyro and the accelerometer
+    {
+        name: "SMA(5) x 6 axes",
+        odrHz: 833,
+        framesPerDrain: FRAMES_PER_DRAIN_833HZ,
+        createProcessor: () => filterAllAxes(() => new SimpleMovingAverage(5))
+    },
+    {
+        name: "EMA(0.3) x 6 axes",
+        odrHz: 833,
+        framesPerDrain: FRAMES_PER_DRAIN_833HZ,
+        createProcessor: () => filterAllAxes(() => new ExponentialMovingAverage(0.3))
+    },
+    {
+        name: "Median(5) x 6 axes",
+        odrHz: 833,
+        framesPerDrain: FRAMES_PER_DRAIN_833HZ,
+        createProcessor: () => filterAllAxes(() => new MedianFilter(5))
+    },
+    {
+        name: "Biquad(50Hz) x 6 axes",
+        odrHz: 833,
+        framesPerDrain: FRAMES_PER_DRAIN_833HZ,
+        createProcessor: () => filterAllAxes(() => new BiquadLowPass(50, 833))
+    },
+    {
+        name: "Kalman x 6 axes",
+        odrHz: 833,
+        framesPerDrain: FRAMES_PER_DRAIN_833HZ,
+        createProcessor: () => filterAllAxes(() => new KalmanFilter1D(0.01, 1))
+    },
+
+    // What the robot actually runs on each drain
+    {
+        name: "RomiGyro",
+        odrHz: 1660,
+        framesPerDrain: FRAMES_PER_DRAIN_1660HZ,
+        createProcessor: () => {
+            const gyro = new RomiGyro(new LSM6(new QueuedI2CBus(new MockI2C(1)), IMU_ADDRESS));
+            return (frames, dt) => gyro.updateFromFrames(frames, dt);
+        }
+    },
+    {
+        name: "RomiIMUFusion",
+        odrHz: 1660,
+        framesPerDrain: FRAMES_PER_DRAIN_1660HZ,
+        createProcessor: () => {
+            const fusion = new RomiIMUFusion();
+            return (frames, dt) => fusion.processFrames(frames, dt);
+        }
+    }
+];
+
+function formatResult(result: IMUBenchmarkResult): string {
+    return `${result.cpuMsPerSecond.toFixed(3)}ms CPU per second at ${result.odrHz}Hz ` +
+           `(${(result.coreUtilization * 100).toFixed(2)}% of a core), ` +
+           `${(result.framesPerCpuSecond / 1e6).toFixed(2)}M frames/s`;
+}
+
+if (require.main === module) {
+    program
+        .name("imu-processing")
+        .option("-s, --seconds <seconds>", "seconds of IMU data per run", `${DEFAULT_SIMULATED_SECONDS}`)
+        .parse(process.argv);
+
+    const seconds = parseInt(program.seconds, 10);
+    for (const config of IMU_BENCHMARK_SUITE) {
+        const result = runIMUBenchmark(config, seconds);
+        console.log(result.name);
+        console.log(`  ${formatResult(result)}`);
+    }
+}
@@ -0,0 +1,258 @@
+import { performance } from "perf_hooks";
+import { DEFAULT_POST_WRITE_DELAY_US } from "./i2c-batch";
+
+export enum I2CClockSpeed {
+    STANDARD = 100000,
+    FAST = 400000
+}
+
+/**
+ * How long transfers take on a simulated bus, and how often they fail
+ */
+export interface I2CBusTiming {
+    clockHz: I2CClockSpeed | number;
+
+    // START (or repeated START) and STOP conditions. Default to one bit
+    // period each
+    startUs?: number;
+    stopUs?: number;
+
+    // Extra time per byte on top of its 9 clocks, e.g. for clock stretching
+    byteGapUs?: number;
+
+    // Fixed cost per transaction, e.g. for the kernel driver
+    transactionOverheadUs?: number;
+
+    // Pause between the register write and the read, for Romi mode reads
+    romiTurnaroundUs?: number;
+
+    // Chance (0-1) of each transaction having its address NACKed, or
+    // failing part way through
+    nackRate?: number;
+    errorRate?: number;
+
+    // Seed for the error injection, so runs are repeatable
+    seed?: number;
+
+    // By default, bus time is virtual and transfers complete straight
+    // away. With realTime set, transfers also take that long on the wall
+    // clock (to within a millisecond or so)
+    realTime?: boolean;
+}
+
+export const DEFAULT_I2C_BUS_TIMING: I2CBusTiming = {
+    clockHz: I2CClockSpeed.FAST
+};
+
+/**
+ * Shape of a single transaction on the wire
+ */
+export interface I2CTransaction {
+    // Bytes sent or received after the address byte(s)
+    bytes: number;
+
+    // Address phases, i.e. START or repeated START conditions
+    starts: number;
+
+    // Time the bus is held idle within the transaction
+    holdUs?: number;
+}
+
+export enum I2CTransferFault {
+    NONE,
+    NACK,
+    ERROR
+}
+
+export interface I2CBusTimingStats {
+    transactions: number;
+    bytes: number;
+    nacks: number;
+    errors: number;
+
+    // Time the bus was busy, and the time covered so far
+    busTimeUs: number;
+    elapsedUs: number;
+    utilization: number;
+}
+
+// 8 data bits plus the ACK
+const CLOCKS_PER_BYTE: number = 9;
+
+/**
+ * Bus time for a series of transactions (for use in a MockI2C)
+ *
+ * The bus is a single resource, so each transaction starts once both the
+ * host asks for it and the previous transaction has finished. In virtual
+ * mode, time only moves forward with bus activity (or advanceTo()), so a
+ * saturated bus sees exactly the bus time it would on hardware
+ */
+export default class I2CBusTimingModel {
+    private _timing: I2CBusTiming;
+
+    private _bitUs: number;
+    private _byteUs: number;
+    private _startUs: number;
+    private _stopUs: number;
+    private _transactionOverheadUs: number;
+    private _romiTurnaroundUs: number;
+
+    private _seed: number;
+
+    private _startTime: number = performance.now();
+    private _virtualNowUs: number = 0;
+    private _busFreeAtUs: number = 0;
+
+    private _stats: I2CBusTimingStats = {
+        transactions: 0,
+        bytes: 0,
+        nacks: 0,
+        errors: 0,
+        busTimeUs: 0,
+        elapsedUs: 0,
+        utilization: 0
+    };
+
+    constructor(timing: I2CBusTiming = DEFAULT_I2C_BUS_TIMING) {
+        this._timing = { ...timing };
+
+        this._bitUs = 1e6 / timing.clockHz;
+        this._byteUs = (CLOCKS_PER_BYTE * this._bitUs) + (timing.byteGapUs || 0);
+        this._startUs = timing.startUs !== undefined ? timing.startUs : this._bitUs;
+        this._stopUs = timing.stopUs !== undefined ? timing.stopUs : this._bitUs;
+        this._transactionOverheadUs = timing.transactionOverheadUs || 0;
+        this._romiTurnaroundUs = timing.romiTurnaroundUs !== undefined ? timing.romiTurnaroundUs : DEFAULT_POST_WRITE_DELAY_US;
+
+        this._seed = (timing.seed !== undefined ? timing.seed : 1) & 0x7FFFFFFF;
+    }
+
+    public get timing(): I2CBusTiming {
+        return { ...this._timing };
+    }
+
+    public get romiTurnaroundUs(): number {
+        return this._romiTurnaroundUs;
+    }
+
+    /**
+     * Current time on the model's clock, in us since it was created
+     */
+    public get nowUs(): number {
+        if (this._timing.realTime) {
+            return (performance.now() - this._startTime) * 1000;
+        }
+
+        return this._virtualNowUs;
+    }
+
+    public get stats(): I2CBusTimingStats {
+        const elapsedUs = Math.max(this.nowUs, this._busFreeAtUs);
+        return {
+            ...this._stats,
+            elapsedUs,
+            utilization: elapsedUs > 0 ? this._stats.busTimeUs / elapsedUs : 0
+        };
+    }
+
+    public resetStats(): void {
+        this._startTime = performance.now();
+        this._virtualNowUs = 0;
+        this._busFreeAtUs = 0;
+        this._stats.transactions = 0;
+        this._stats.bytes = 0;
+        this._stats.nacks = 0;
+        this._stats.errors = 0;
+        this._stats.busTimeUs = 0;
+    }
+
+    /**
+     * Let the (virtual) clock run on to timeUs with the bus idle
+     */
+    public advanceTo(timeUs: number): void {
+        if (!this._timing.realTime) {
+            this._virtualNowUs = Math.max(this._virtualNowUs, timeUs);
+        }
+    }
+
+    /**
+     * Time a transaction takes on the wire
+     */
+    public transactionUs(transaction: I2CTransaction): number {
+        // Each address phase sends one address byte
+        return this._transactionOverheadUs +
+               (transaction.starts * (this._startUs + this._byteUs)) +
+               (transaction.bytes * this._byteUs) +
+               (transaction.holdUs || 0) +
+               this._stopUs;
+    }
+
+    /**
+     * Run a transaction (or hold the bus, for a transaction with no bytes
+     * and no starts), and work out whether it failed
+     */
+    public transfer(transaction: I2CTransaction): I2CTransferFault {
+        let fault: I2CTransferFault = I2CTransferFault.NONE;
+        let durationUs: number;
+
+        if (transaction.starts === 0) {
+            durationUs = transaction.holdUs || 0;
+        }
+        else {
+            this._stats.transactions++;
+
+            if (this._chance(this._timing.nackRate)) {
+                // Gives up after the address byte
+                fault = I2CTransferFault.NACK;
+                this._stats.nacks++;
+                durationUs = this._transactionOverheadUs + this._startUs + this._byteUs + this._stopUs;
+            }
+            else {
+                if (this._chance(this._timing.errorRate)) {
+                    fault = I2CTransferFault.ERROR;
+                    this._stats.errors++;
+                }
+
+                this._stats.bytes += transaction.bytes;
+                durationUs = this.transactionUs(transaction);
+            }
+        }
+
+        const startUs = Math.max(this.nowUs, this._busFreeAtUs);
+        this._busFreeAtUs = startUs + durationUs;
+        this._stats.busTimeUs += durationUs;
+
+        if (!this._timing.realTime) {
+            this._virtualNowUs = this._busFreeAtUs;
+        }
+
+        return fault;
+    }
+
+    /**
+     * In real time mode, wait until the bus is free. Waits shorter than a
+     * timer tick are left to build up
+     */
+    public settle(): Promise<void> {
+        if (!this._timing.realTime) {
+            return Promise.resolve();
+        }
+
+        const aheadMs = Math.floor((this._busFreeAtUs - this.nowUs) / 1000);
+        if (aheadMs < 1) {
+            return Promise.resolve();
+        }
+
+        return new Promise(resolve => {
+            setTimeout(resolve, aheadMs);
+        });
+    }
+
+    private _chance(rate: number | undefined): boolean {
+        if (!rate) {
+            return false;
+        }
+
+        this._seed = (this._seed * 1103515245 + 12345) & 0x7FFFFFFF;
+        return (this._seed / 0x7FFFFFFF) < rate;
+    }
+}
@@ -49,18 +49,17 @@ export default class HardwareI2C extends I2CPromisifiedBus {
     }
 
     public readWord(addr: number, cmd: number, romiMode?: boolean): Promise<number> {
-        const buf = Buffer.alloc(2);
-
         this._logger.silly(`readWord(addr=0x${addr.toString(16)}, cmd=0x${cmd.toString(16)}, ${romiMode ? "true": "false"})`);
         return this._i2cBusP
         .then(bus => {
             if (romiMode) {
                 return bus.sendByte(addr, cmd)
                 .then(async () => {
-                    buf[0] = await bus.receiveByte(addr);
-                    buf[1] = await bus.receiveByte(addr);
+                    // Little endian, low byte first
+                    const low = await bus.receiveByte(addr);
+                    const high = await bus.receiveByte(addr);
 
-                    return buf.readUInt16LE();
+                    return low | (high << 8);
                 });
             }
             else {
@@ -77,6 +76,53 @@ export default class HardwareI2C extends I2CPromisifiedBus {
         });
     }
 
+    public readBlock(addr: number, cmd: number, length: number, romiMode?: boolean): Promise<Buffer> {
+        const buf = Buffer.alloc(length);
+
+        this._logger.silly(`readBlock(addr=0x${addr.toString(16)}, cmd=0x${cmd.toString(16)}, length=${length}, ${romiMode ? "true": "false"})`);
+        return this._i2cBusP
+        .then(bus => {
+            if (romiMode) {
+                // Same as the single byte case, but pull the whole
+                // block in one read transaction
+                return bus.sendByte(addr, cmd)
+                .then(() => this._postWriteDelay())
+                .then(() => {
+                    return bus.i2cRead(addr, length, buf);
+                });
+            }
+            else {
+                return bus.readI2cBlock(addr, cmd, length, buf);
+            }
+        })
+        .then(result => {
+            if (result.bytesRead !== length) {
+                throw new Error(`Short read (${result.bytesRead}/${length} bytes)`);
+            }
+
+            return buf;
+        });
+    }
+
+    public writeBlock(addr: number, cmd: number, data: Buffer): Promise<void> {
+        this._logger.silly(`writeBlock(addr=0x${addr.toString(16)}, cmd=0x${cmd.toString(16)}, length=${data.length})`);
+
+        // Send the register and data as a single plain I2C write
+        const buf = Buffer.alloc(data.length + 1);
+        buf[0] = cmd;
+        data.copy(buf, 1);
+
+        return this._i2cBusP
+        .then(bus => {
+            return bus.i2cWrite(addr, buf.length, buf);
+        })
+        .then(result => {
+            if (result.bytesWritten !== buf.length) {
+                throw new Error(`Short write (${result.bytesWritten}/${buf.length} bytes)`);
+            }
+        });
+    }
+
     public sendByte(addr: number, cmd: number): Promise<void> {
         this._logger.silly(`sendByte(addr=0x${addr.toString(16)}, cmd=0x${cmd.toString(16)})`);
         return this._i2cBusP
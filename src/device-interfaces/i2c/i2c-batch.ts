@@ -0,0 +1,176 @@
+export enum I2CBatchOpType {
+    READ_BYTE = "READ_BYTE",
+    READ_WORD = "READ_WORD",
+    READ_BLOCK = "READ_BLOCK",
+    WRITE_BYTE = "WRITE_BYTE",
+    WRITE_WORD = "WRITE_WORD",
+    WRITE_BLOCK = "WRITE_BLOCK",
+    SEND_BYTE = "SEND_BYTE",
+    RECEIVE_BYTE = "RECEIVE_BYTE"
+}
+
+/**
+ * A single bus operation within a batch
+ *
+ * Everything in here needs to survive a trip through postMessage(), so
+ * block data is carried as a plain Uint8Array
+ */
+export interface I2CBatchOp {
+    type: I2CBatchOpType;
+    addr: number;
+    cmd?: number;
+
+    // Byte/word value to write, or the bytes of a block write
+    value?: number;
+    data?: Uint8Array;
+
+    // Number of bytes to read for READ_BLOCK
+    length?: number;
+
+    // See I2CPromisifiedBus
+    romiMode?: boolean;
+
+    // Time to hold the bus after this operation completes
+    delayUs?: number;
+}
+
+export interface I2CBatchResult {
+    // Result of a byte/word read
+    value?: number;
+
+    // Result of a block read
+    data?: Uint8Array;
+
+    // Set if this operation failed. Later operations in the batch still run
+    error?: string;
+}
+
+/**
+ * The subset of the synchronous i2c-bus API used to run a batch
+ */
+export interface SyncI2CBus {
+    readByteSync(addr: number, cmd: number): number;
+    readWordSync(addr: number, cmd: number): number;
+    readI2cBlockSync(addr: number, cmd: number, length: number, buffer: Buffer): number;
+    writeByteSync(addr: number, cmd: number, byte: number): void;
+    writeWordSync(addr: number, cmd: number, word: number): void;
+    sendByteSync(addr: number, byte: number): void;
+    receiveByteSync(addr: number): number;
+    i2cReadSync(addr: number, length: number, buffer: Buffer): number;
+    i2cWriteSync(addr: number, length: number, buffer: Buffer): number;
+}
+
+// The Romi firmware needs a moment after the register address is written
+// before it can serve the read
+export const DEFAULT_POST_WRITE_DELAY_US: number = 100;
+
+const sleepArray: Int32Array = new Int32Array(new SharedArrayBuffer(4));
+
+// Batches run synchronously, one at a time, so byte and word reads (whose
+// results are returned as plain numbers) can all share one buffer
+const scratchBuffer: Buffer = Buffer.alloc(2);
+
+/**
+ * Block the calling thread for the given number of microseconds
+ *
+ * Atomics.wait() has much finer resolution than a timer, but blocks the
+ * whole thread, so this should only be used off the main event loop (or
+ * for very short waits)
+ */
+export function delayMicroseconds(delayUs: number): void {
+    if (delayUs <= 0) {
+        return;
+    }
+
+    Atomics.wait(sleepArray, 0, 0, delayUs / 1000);
+}
+
+function checkTransferLength(actual: number, expected: number, description: string): void {
+    if (actual !== expected) {
+        throw new Error(`Short ${description} (${actual}/${expected} bytes)`);
+    }
+}
+
+function executeOp(bus: SyncI2CBus, op: I2CBatchOp, postWriteDelayUs: number): I2CBatchResult {
+    switch (op.type) {
+        case I2CBatchOpType.READ_BYTE:
+        case I2CBatchOpType.READ_WORD:
+        case I2CBatchOpType.READ_BLOCK: {
+            const length = op.type === I2CBatchOpType.READ_BYTE ? 1 :
+                           op.type === I2CBatchOpType.READ_WORD ? 2 : op.length;
+
+            if (!op.romiMode) {
+                if (op.type === I2CBatchOpType.READ_BYTE) {
+                    return { value: bus.readByteSync(op.addr, op.cmd) };
+                }
+                if (op.type === I2CBatchOpType.READ_WORD) {
+                    return { value: bus.readWordSync(op.addr, op.cmd) };
+                }
+
+                const buf = Buffer.alloc(length);
+                checkTransferLength(bus.readI2cBlockSync(op.addr, op.cmd, length, buf), length, "read");
+                return { data: buf };
+            }
+
+            // Romi reads are a register address write, a short pause, and
+            // then a plain read of however many bytes we want
+            const buf = op.type === I2CBatchOpType.READ_BLOCK ? Buffer.alloc(length) : scratchBuffer;
+            bus.sendByteSync(op.addr, op.cmd);
+            delayMicroseconds(postWriteDelayUs);
+            checkTransferLength(bus.i2cReadSync(op.addr, length, buf), length, "read");
+
+            if (op.type === I2CBatchOpType.READ_BYTE) {
+                return { value: buf[0] };
+            }
+            if (op.type === I2CBatchOpType.READ_WORD) {
+                return { value: buf.readUInt16LE(0) };
+            }
+            return { data: buf };
+        }
+        case I2CBatchOpType.WRITE_BYTE:
+            bus.writeByteSync(op.addr, op.cmd, op.value);
+            return {};
+        case I2CBatchOpType.WRITE_WORD:
+            bus.writeWordSync(op.addr, op.cmd, op.value);
+            return {};
+        case I2CBatchOpType.WRITE_BLOCK: {
+            // Send the register and data as a single plain I2C write
+            const buf = Buffer.alloc(op.data.length + 1);
+            buf[0] = op.cmd;
+            buf.set(op.data, 1);
+            checkTransferLength(bus.i2cWriteSync(op.addr, buf.length, buf), buf.length, "write");
+            return {};
+        }
+        case I2CBatchOpType.SEND_BYTE:
+            bus.sendByteSync(op.addr, op.cmd);
+            return {};
+        case I2CBatchOpType.RECEIVE_BYTE:
+            return { value: bus.receiveByteSync(op.addr) };
+        default:
+            throw new Error(`Unknown operation ${op.type}`);
+    }
+}
+
+/**
+ * Run a batch of operations back to back on a synchronous bus
+ *
+ * A failed operation is reported in its own result, and doesn't stop the
+ * rest of the batch
+ */
+export function executeI2CBatch(bus: SyncI2CBus, ops: I2CBatchOp[], postWriteDelayUs: number = DEFAULT_POST_WRITE_DELAY_US): I2CBatchResult[] {
+    return ops.map(op => {
+        let result: I2CBatchResult;
+        try {
+            result = executeOp(bus, op, postWriteDelayUs);
+        }
+        catch (err) {
+            result = { error: (err && err.message) ? err.message : String(err) };
+        }
+
+        if (op.delayUs > 0) {
+            delayMicroseconds(op.delayUs);
+        }
+
+        return result;
+    });
+}
@@ -1,3 +1,6 @@
+import { I2CBatchOp, I2CBatchOpType, I2CBatchResult } from "./i2c-batch";
+import SharedSnapshot from "./shared-snapshot";
+
 export default abstract class I2CPromisifiedBus {
     protected _busNumber: number;
 
@@ -14,7 +17,91 @@ export default abstract class I2CPromisifiedBus {
     public abstract readWord(addr: number, cmd: number, romiMode?: boolean): Promise<number>;
     public abstract writeByte(addr: number, cmd: number, byte: number): Promise<void>;
     public abstract writeWord(addr: number, cmd: number, word: number): Promise<void>;
+    public abstract readBlock(addr: number, cmd: number, length: number, romiMode?: boolean): Promise<Buffer>;
+    public abstract writeBlock(addr: number, cmd: number, data: Buffer): Promise<void>;
 
     public abstract sendByte(addr: number, cmd: number): Promise<void>;
     public abstract receiveByte(addr: number): Promise<number>;
+
+    /**
+     * Run a series of operations in order, with one result per operation
+     *
+     * By default this just calls the individual methods one after the
+     * other. Buses that can submit a whole batch at once should override it
+     */
+    public async executeBatch(ops: I2CBatchOp[]): Promise<I2CBatchResult[]> {
+        const results: I2CBatchResult[] = [];
+
+        for (const op of ops) {
+            const result: I2CBatchResult = {};
+            try {
+                switch (op.type) {
+                    case I2CBatchOpType.READ_BYTE:
+                        result.value = await this.readByte(op.addr, op.cmd, op.romiMode);
+                        break;
+                    case I2CBatchOpType.READ_WORD:
+                        result.value = await this.readWord(op.addr, op.cmd, op.romiMode);
+                        break;
+                    case I2CBatchOpType.READ_BLOCK:
+                        result.data = await this.readBlock(op.addr, op.cmd, op.length, op.romiMode);
+                        break;
+                    case I2CBatchOpType.WRITE_BYTE:
+                        await this.writeByte(op.addr, op.cmd, op.value);
+                        break;
+                    case I2CBatchOpType.WRITE_WORD:
+                        await this.writeWord(op.addr, op.cmd, op.value);
+                        break;
+                    case I2CBatchOpType.WRITE_BLOCK:
+                        await this.writeBlock(op.addr, op.cmd, Buffer.from(op.data));
+                        break;
+                    case I2CBatchOpType.SEND_BYTE:
+                        await this.sendByte(op.addr, op.cmd);
+                        break;
+                    case I2CBatchOpType.RECEIVE_BYTE:
+                        result.value = await this.receiveByte(op.addr);
+                        break;
+                }
+            }
+            catch (err) {
+                result.error = (err && err.message) ? err.message : String(err);
+            }
+
+            if (op.delayUs > 0) {
+                await new Promise(resolve => {
+                    setTimeout(() => {
+                        resolve();
+                    }, op.delayUs / 1000);
+                });
+            }
+
+            results.push(result);
+        }
+
+        return results;
+    }
+
+    /**
+     * Run a block read every snapshot.periodMs, publishing each result to
+     * the snapshot
+     *
+     * By default this runs off a timer on the calling thread. Buses that
+     * own a thread of their own should override it, so that sampling
+     * carries on at a steady rate however busy the main thread is
+     */
+    public startPeriodicRead(op: I2CBatchOp, snapshot: SharedSnapshot): void {
+        const runRead = () => {
+            this.executeBatch([op])
+            .then(results => {
+                snapshot.write(results[0].error === undefined ? results[0].data : null);
+            })
+            .catch(err => {
+                snapshot.write(null);
+            })
+            .then(() => {
+                setTimeout(runRead, snapshot.periodMs);
+            });
+        };
+
+        setTimeout(runRead, snapshot.periodMs);
+    }
 }
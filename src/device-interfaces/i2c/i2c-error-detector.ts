@@ -25,10 +25,6 @@ export default class I2CErrorDetector {
 
         this._logger = LogUtil.getLogger(`I2C-ERRDETECT-${label}`);
         this._logger.info(`Thresh=${errorThreshold}, Window=${windowMs}, CheckInterval=${checkInterval}`);
-
-        setInterval(() => {
-            this._checkQueue();
-        }, this._checkIntervalMs);
     }
 
     public addErrorInstance() {
@@ -56,7 +52,19 @@ export default class I2CErrorDetector {
         return this._isErrorState;
     }
 
-    private _checkQueue() {
+    /**
+     * How often check() should be called. The owner runs it on its own
+     * scheduler, rather than the detector keeping a timer of its own
+     */
+    public get checkIntervalMs(): number {
+        return this._checkIntervalMs;
+    }
+
+    /**
+     * Drop errors that have fallen out of the window, and update the
+     * error state
+     */
+    public check() {
         const currTimestamp = Date.now();
 
         // Clear out events that we don't care about
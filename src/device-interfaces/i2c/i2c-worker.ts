@@ -0,0 +1,49 @@
+import { parentPort, workerData } from "worker_threads";
+import i2c from "i2c-bus";
+import { executeI2CBatch } from "./i2c-batch";
+import { WorkerI2CRequest, WorkerI2CResponse, WorkerI2COptions, WorkerI2CPeriodicRead } from "./worker-i2c";
+import SharedSnapshot from "./shared-snapshot";
+
+// Entry point for the thread that owns the hardware bus (see WorkerI2C)
+// Everything in here uses the synchronous i2c-bus API, so a whole batch
+// runs without returning to the event loop between operations
+const options: WorkerI2COptions = workerData;
+const bus = i2c.openSync(options.busNumber);
+let closed: boolean = false;
+
+function startPeriodicRead(periodicRead: WorkerI2CPeriodicRead): void {
+    const snapshot = new SharedSnapshot(periodicRead.snapshotBuffer);
+
+    // The period is re-read every time, so the main thread can change it
+    const runRead = () => {
+        if (closed) {
+            return;
+        }
+
+        const result = executeI2CBatch(bus, [periodicRead.op], options.postWriteDelayUs)[0];
+        snapshot.write(result.error === undefined ? result.data : null);
+        setTimeout(runRead, snapshot.periodMs);
+    };
+
+    setTimeout(runRead, snapshot.periodMs);
+}
+
+parentPort.on("message", (request: WorkerI2CRequest) => {
+    const response: WorkerI2CResponse = {
+        id: request.id,
+        results: []
+    };
+
+    if (request.close) {
+        closed = true;
+        bus.closeSync();
+    }
+    else if (request.periodicRead) {
+        startPeriodicRead(request.periodicRead);
+    }
+    else {
+        response.results = executeI2CBatch(bus, request.ops, options.postWriteDelayUs);
+    }
+
+    parentPort.postMessage(response);
+});
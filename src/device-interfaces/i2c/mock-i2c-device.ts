@@ -15,4 +15,20 @@ export default abstract class MockI2CDevice {
     public abstract writeWord(cmd: number, word: number): Promise<void>;
     public abstract sendByte(cmd: number): Promise<void>;
     public abstract receiveByte(): Promise<number>;
+
+    // Block transfers default to a series of byte transfers
+    public async readBlock(cmd: number, length: number): Promise<Buffer> {
+        const buf = Buffer.alloc(length);
+        for (let i = 0; i < length; i++) {
+            buf[i] = await this.readByte(cmd + i);
+        }
+
+        return buf;
+    }
+
+    public async writeBlock(cmd: number, data: Buffer): Promise<void> {
+        for (let i = 0; i < data.length; i++) {
+            await this.writeByte(cmd + i, data[i]);
+        }
+    }
 }
@@ -2,12 +2,16 @@ import winston from "winston";
 import I2CPromisifiedBus from "./i2c-connection";
 import MockI2CDevice from "./mock-i2c-device";
 import LogUtil from "../../utils/logging/log-util";
+import { I2CBatchOp, I2CBatchResult } from "./i2c-batch";
+import I2CBusTimingModel, { I2CBusTiming, I2CBusTimingStats, I2CTransaction, I2CTransferFault } from "./bus-timing";
 
 export enum MockI2CBusEventType {
     READ_BYTE = "READ_BYTE",
     READ_WORD = "READ_WORD",
     WRITE_BYTE = "WRITE_BYTE",
     WRITE_WORD = "WRITE_WORD",
+    READ_BLOCK = "READ_BLOCK",
+    WRITE_BLOCK = "WRITE_BLOCK",
     SEND_BYTE = "SEND_BYTE",
     RECEIVE_BYTE = "RECEIVE_BYTE",
     IO_ERROR = "IO_ERROR",
@@ -33,10 +37,20 @@ export default class MockI2C extends I2CPromisifiedBus {
     private _logger: winston.Logger;
     private _logFunc: (message: string) => void;
 
-    constructor(busNum: number, shouldLog?: boolean) {
+    private _timingModel: I2CBusTimingModel | undefined;
+
+    /**
+     * @param timing If set, transfers take up (virtual) bus time, and can
+     * be made to fail at random
+     */
+    constructor(busNum: number, shouldLog?: boolean, timing?: I2CBusTiming) {
         super(busNum);
         this._shouldLog = !!shouldLog;
 
+        if (timing) {
+            this._timingModel = new I2CBusTimingModel(timing);
+        }
+
         this._logger = LogUtil.getLogger(`I2C-MOCK-${this._busNumber}`);
         this._logger.info(`MockI2C(bus=${this._busNumber})`);
 
@@ -60,6 +74,17 @@ export default class MockI2C extends I2CPromisifiedBus {
         this._devices.set(device.address, device);
     }
 
+    /**
+     * Bus timing, if this bus has a timing model
+     */
+    public get timingModel(): I2CBusTimingModel | undefined {
+        return this._timingModel;
+    }
+
+    public get timingStats(): I2CBusTimingStats | undefined {
+        return this._timingModel ? this._timingModel.stats : undefined;
+    }
+
     public clearListeners(): void {
         this._eventListeners = [];
     }
@@ -74,6 +99,28 @@ export default class MockI2C extends I2CPromisifiedBus {
         });
     }
 
+    public executeBatch(ops: I2CBatchOp[]): Promise<I2CBatchResult[]> {
+        if (!this._timingModel) {
+            return super.executeBatch(ops);
+        }
+
+        // Holds after an operation are bus time too, so they go through the
+        // timing model rather than a timer
+        const timingModel = this._timingModel;
+        return ops.reduce((resultsP, op) => {
+            return resultsP.then(results => {
+                return super.executeBatch([{ ...op, delayUs: 0 }])
+                .then(opResults => {
+                    if (op.delayUs > 0) {
+                        timingModel.transfer({ bytes: 0, starts: 0, holdUs: op.delayUs });
+                    }
+
+                    return timingModel.settle().then(() => results.concat(opResults));
+                });
+            });
+        }, Promise.resolve([] as I2CBatchResult[]));
+    }
+
     public close(): Promise<void> {
         this._notifyListeners({
             eventType: MockI2CBusEventType.BUS_CLOSE,
@@ -91,7 +138,8 @@ export default class MockI2C extends I2CPromisifiedBus {
                 address: addr,
                 cmd
             });
-            return this._devices.get(addr).readByte(cmd);
+            return this._busTransfer(addr, cmd, () => this._readTransactions(1, romiMode))
+            .then(() => this._devices.get(addr).readByte(cmd));
         }
 
         this._notifyListeners({
@@ -100,6 +148,7 @@ export default class MockI2C extends I2CPromisifiedBus {
             cmd,
             errDescription: "No Device Associated With Address"
         });
+        this._noDeviceTransfer();
         return Promise.reject(`[MOCK-I2C] IO Error - No device with address ${addr}`);
     }
 
@@ -113,7 +162,8 @@ export default class MockI2C extends I2CPromisifiedBus {
                 cmd,
                 data: byte
             });
-            return this._devices.get(addr).writeByte(cmd, byte);
+            return this._busTransfer(addr, cmd, () => [{ bytes: 2, starts: 1 }])
+            .then(() => this._devices.get(addr).writeByte(cmd, byte));
         }
 
         this._notifyListeners({
@@ -122,6 +172,7 @@ export default class MockI2C extends I2CPromisifiedBus {
             cmd,
             errDescription: "No Device Associated With Address"
         });
+        this._noDeviceTransfer();
         return Promise.reject(`[MOCK-I2C] IO Error - No device with address ${addr}`);
     }
 
@@ -134,7 +185,8 @@ export default class MockI2C extends I2CPromisifiedBus {
                 address: addr,
                 cmd
             });
-            return this._devices.get(addr).readWord(cmd);
+            return this._busTransfer(addr, cmd, () => this._readTransactions(2, romiMode))
+            .then(() => this._devices.get(addr).readWord(cmd));
         }
 
         this._notifyListeners({
@@ -143,6 +195,7 @@ export default class MockI2C extends I2CPromisifiedBus {
             cmd,
             errDescription: "No Device Associated With Address"
         });
+        this._noDeviceTransfer();
         return Promise.reject(`[MOCK-I2C] IO Error - No device with address ${addr}`);
     }
 
@@ -156,7 +209,32 @@ export default class MockI2C extends I2CPromisifiedBus {
                 cmd,
                 data: word
             });
-            return this._devices.get(addr).writeWord(cmd, word);
+            return this._busTransfer(addr, cmd, () => [{ bytes: 3, starts: 1 }])
+            .then(() => this._devices.get(addr).writeWord(cmd, word));
+        }
+
+        this._notifyListeners({
+            eventType: MockI2CBusEventType.IO_ERROR,
+            address: addr,
+            cmd,
+            errDescription: "No Device Associated With Address"
+        });
+        this._noDeviceTransfer();
+        return Promise.reject(`[MOCK-I2C] IO Error - No device with address ${addr}`);
+    }
+
+    public readBlock(addr: number, cmd: number, length: number, romiMode?: boolean): Promise<Buffer> {
+        this._logFunc(`readBlock(addr=0x${addr.toString(16)}, cmd=0x${cmd.toString(16)}, length=${length}, ${romiMode ? "true": "false"})`);
+
+        if (this._devices.has(addr)) {
+            this._notifyListeners({
+                eventType: MockI2CBusEventType.READ_BLOCK,
+                address: addr,
+                cmd,
+                data: length
+            });
+            return this._busTransfer(addr, cmd, () => this._readTransactions(length, romiMode))
+            .then(() => this._devices.get(addr).readBlock(cmd, length));
         }
 
         this._notifyListeners({
@@ -165,6 +243,31 @@ export default class MockI2C extends I2CPromisifiedBus {
             cmd,
             errDescription: "No Device Associated With Address"
         });
+        this._noDeviceTransfer();
+        return Promise.reject(`[MOCK-I2C] IO Error - No device with address ${addr}`);
+    }
+
+    public writeBlock(addr: number, cmd: number, data: Buffer): Promise<void> {
+        this._logFunc(`writeBlock(addr=0x${addr.toString(16)}, cmd=0x${cmd.toString(16)}, length=${data.length})`);
+
+        if (this._devices.has(addr)) {
+            this._notifyListeners({
+                eventType: MockI2CBusEventType.WRITE_BLOCK,
+                address: addr,
+                cmd,
+                data: data.length
+            });
+            return this._busTransfer(addr, cmd, () => [{ bytes: 1 + data.length, starts: 1 }])
+            .then(() => this._devices.get(addr).writeBlock(cmd, data));
+        }
+
+        this._notifyListeners({
+            eventType: MockI2CBusEventType.IO_ERROR,
+            address: addr,
+            cmd,
+            errDescription: "No Device Associated With Address"
+        });
+        this._noDeviceTransfer();
         return Promise.reject(`[MOCK-I2C] IO Error - No device with address ${addr}`);
     }
 
@@ -177,7 +280,8 @@ export default class MockI2C extends I2CPromisifiedBus {
                 address: addr,
                 cmd
             });
-            return this._devices.get(addr).sendByte(cmd);
+            return this._busTransfer(addr, cmd, () => [{ bytes: 1, starts: 1 }])
+            .then(() => this._devices.get(addr).sendByte(cmd));
         }
         
         this._notifyListeners({
@@ -186,6 +290,7 @@ export default class MockI2C extends I2CPromisifiedBus {
             cmd,
             errDescription: "No Device Associated With Address"
         });
+        this._noDeviceTransfer();
         return Promise.reject(`[MOCK-I2C] IO Error - No device with address ${addr}`);
     }
 
@@ -197,7 +302,8 @@ export default class MockI2C extends I2CPromisifiedBus {
                 eventType: MockI2CBusEventType.SEND_BYTE,
                 address: addr
             });
-            return this._devices.get(addr).receiveByte();
+            return this._busTransfer(addr, undefined, () => [{ bytes: 1, starts: 1 }])
+            .then(() => this._devices.get(addr).receiveByte());
         }
         
         this._notifyListeners({
@@ -205,6 +311,56 @@ export default class MockI2C extends I2CPromisifiedBus {
             address: addr,
             errDescription: "No Device Associated With Address"
         });
+        this._noDeviceTransfer();
         return Promise.reject(`[MOCK-I2C] IO Error - No device with address ${addr}`);
     }
+
+    // A register read. Romi reads are a register write, a pause, and a
+    // separate read. Otherwise it's a combined write/read transaction
+    private _readTransactions(length: number, romiMode?: boolean): I2CTransaction[] {
+        if (romiMode) {
+            return [
+                { bytes: 1, starts: 1 },
+                { bytes: 0, starts: 0, holdUs: this._timingModel.romiTurnaroundUs },
+                { bytes: length, starts: 1 }
+            ];
+        }
+
+        return [{ bytes: 1 + length, starts: 2 }];
+    }
+
+    /**
+     * Take up bus time for a transfer, failing it if the timing model
+     * says so
+     */
+    private _busTransfer(addr: number, cmd: number | undefined, transactions: () => I2CTransaction[]): Promise<void> {
+        if (!this._timingModel) {
+            return Promise.resolve();
+        }
+
+        for (const transaction of transactions()) {
+            const fault = this._timingModel.transfer(transaction);
+            if (fault !== I2CTransferFault.NONE) {
+                const description = fault === I2CTransferFault.NACK ? "NACK" : "Transfer Error";
+                this._notifyListeners({
+                    eventType: MockI2CBusEventType.IO_ERROR,
+                    address: addr,
+                    cmd,
+                    errDescription: description
+                });
+
+                return this._timingModel.settle()
+                .then(() => Promise.reject(`[MOCK-I2C] IO Error - ${description} from address ${addr}`));
+            }
+        }
+
+        return this._timingModel.settle();
+    }
+
+    // Nothing answered, so only the address went out
+    private _noDeviceTransfer(): void {
+        if (this._timingModel) {
+            this._timingModel.transfer({ bytes: 0, starts: 1 });
+        }
+    }
 }
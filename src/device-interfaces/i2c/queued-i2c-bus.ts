@@ -1,61 +1,483 @@
-import PromiseQueue from "promise-queue";
 import I2CPromisifiedBus from "./i2c-connection";
+import { I2CBatchOp, I2CBatchOpType, I2CBatchResult } from "./i2c-batch";
+import SharedSnapshot from "./shared-snapshot";
+
+/**
+ * Priority classes for bus operations. Pending operations in a higher
+ * priority class always go out before those in a lower one
+ */
+export enum I2CPriority {
+    ACTUATION = 0,
+    TELEMETRY = 1,
+    CUSTOM_DEVICE = 2
+}
+
+const NUM_PRIORITIES: number = 3;
+
+export interface I2CPriorityStats {
+    // Operations currently waiting, and the most seen at once
+    queueDepth: number;
+    maxQueueDepth: number;
+
+    // Operations completed (or failed), and the time from being queued
+    // to finishing
+    completed: number;
+    avgLatencyMs: number;
+    maxLatencyMs: number;
+
+    // Reads folded into a neighbouring read, and writes dropped because
+    // a newer write to the same register replaced them
+    mergedReads: number;
+    collapsedWrites: number;
+}
+
+export type I2CSchedulerStats = { [P in keyof typeof I2CPriority]: I2CPriorityStats };
+
+/**
+ * Called for every queued operation that fails on the bus
+ */
+export type I2CErrorListener = (addr: number, cmd: number, isWrite: boolean, priority: I2CPriority) => void;
+
+// Weight of the latest sample in the latency average
+const LATENCY_AVERAGE_WEIGHT: number = 0.1;
+
+// SMBus block transfers top out at 32 bytes
+const MAX_MERGED_READ_LENGTH: number = 32;
+
+// Most operations (after merging) to hand to the bus in one go
+const MAX_BATCH_SIZE: number = 8;
+
+/**
+ * Scheduling strategy. Everything is on by default
+ */
+export interface QueuedI2CBusOptions {
+    // Most operations (after merging) to hand to the bus in one go
+    maxBatchSize?: number;
+
+    // Combine reads of adjacent Romi registers into a single block read
+    mergeReads?: boolean;
+
+    // Drop writes that a newer write to the same register replaces
+    collapseWrites?: boolean;
+
+    // Take turns between devices within a priority class, rather than
+    // going strictly in the order operations were queued
+    roundRobinDevices?: boolean;
+}
+
+enum OpType {
+    READ_BYTE,
+    READ_WORD,
+    READ_BLOCK,
+    WRITE_BYTE,
+    WRITE_WORD,
+    WRITE_BLOCK
+}
+
+interface PendingOp {
+    type: OpType;
+    addr: number;
+    cmd: number;
+    romiMode?: boolean;
+
+    // Number of bytes read or written
+    length: number;
+    data?: number | Buffer;
+    delayMs: number;
+
+    queuedTime: number;
+    callbacks: { resolve: (value?: any) => void, reject: (reason?: any) => void }[];
+}
+
+// An operation, plus any reads that were merged into it
+interface OpGroup {
+    priority: I2CPriority;
+    ops: PendingOp[];
+}
+
+const OP_BATCH_TYPES: { [type: number]: I2CBatchOpType } = {
+    [OpType.READ_BYTE]: I2CBatchOpType.READ_BYTE,
+    [OpType.READ_WORD]: I2CBatchOpType.READ_WORD,
+    [OpType.READ_BLOCK]: I2CBatchOpType.READ_BLOCK,
+    [OpType.WRITE_BYTE]: I2CBatchOpType.WRITE_BYTE,
+    [OpType.WRITE_WORD]: I2CBatchOpType.WRITE_WORD,
+    [OpType.WRITE_BLOCK]: I2CBatchOpType.WRITE_BLOCK
+};
+
+function isRead(op: PendingOp): boolean {
+    return op.type === OpType.READ_BYTE || op.type === OpType.READ_WORD || op.type === OpType.READ_BLOCK;
+}
+
+function createStats(): I2CPriorityStats {
+    return {
+        queueDepth: 0,
+        maxQueueDepth: 0,
+        completed: 0,
+        avgLatencyMs: 0,
+        maxLatencyMs: 0,
+        mergedReads: 0,
+        collapsedWrites: 0
+    };
+}
 
 /**
  * Implementation of a sequential I2C communication channel
+ *
+ * Operations are carried out in priority order, handed to the bus in
+ * batches. Within a priority class, devices take turns (in address order)
+ * so that one device with a lot queued, like a Romi being configured,
+ * can't hold up the others, and each device's operations go out in the
+ * order they were queued. While waiting, a write that is superseded by
+ * another write to the same register is dropped, and reads of adjacent
+ * registers on a Romi are combined into a single block read. Other devices
+ * don't necessarily auto-increment the register address, so their reads
+ * are left alone
  */
 export default class QueuedI2CBus {
     private _bus: I2CPromisifiedBus;
-    private _queue: PromiseQueue = new PromiseQueue(1);
+    private _queues: PendingOp[][] = [];
+    private _stats: I2CPriorityStats[] = [];
+    private _isBusy: boolean = false;
+    private _errorListeners: I2CErrorListener[] = [];
+
+    private _maxBatchSize: number = MAX_BATCH_SIZE;
+    private _mergeReads: boolean = true;
+    private _collapseWrites: boolean = true;
+    private _roundRobinDevices: boolean = true;
 
-    constructor(bus: I2CPromisifiedBus) {
+    // Device that went last in each priority class
+    private _lastAddresses: number[] = [];
+
+    constructor(bus: I2CPromisifiedBus, options?: QueuedI2CBusOptions) {
         this._bus = bus;
+
+        if (options) {
+            if (options.maxBatchSize !== undefined) {
+                this._maxBatchSize = Math.max(1, options.maxBatchSize);
+            }
+            if (options.mergeReads !== undefined) {
+                this._mergeReads = options.mergeReads;
+            }
+            if (options.collapseWrites !== undefined) {
+                this._collapseWrites = options.collapseWrites;
+            }
+            if (options.roundRobinDevices !== undefined) {
+                this._roundRobinDevices = options.roundRobinDevices;
+            }
+        }
+
+        for (let i = 0; i < NUM_PRIORITIES; i++) {
+            this._queues.push([]);
+            this._stats.push(createStats());
+            this._lastAddresses.push(-1);
+        }
     }
 
     get rawBus(): I2CPromisifiedBus {
         return this._bus;
     }
 
-    public async readByte(addr: number, cmd: number, romiMode?: boolean): Promise<number> {
-        return this._queue.add(() => {
-            return this._bus.readByte(addr, cmd, romiMode);
-        });
+    /**
+     * Queue and latency statistics for each priority class
+     */
+    public get stats(): I2CSchedulerStats {
+        return {
+            ACTUATION: { ...this._stats[I2CPriority.ACTUATION] },
+            TELEMETRY: { ...this._stats[I2CPriority.TELEMETRY] },
+            CUSTOM_DEVICE: { ...this._stats[I2CPriority.CUSTOM_DEVICE] }
+        };
     }
 
-    public async readWord(addr: number, cmd: number, romiMode?: boolean): Promise<number> {
-        return this._queue.add(() => {
-            return this._bus.readWord(addr, cmd, romiMode);
-        });
+    public resetStats(): void {
+        for (let i = 0; i < NUM_PRIORITIES; i++) {
+            const queueDepth = this._stats[i].queueDepth;
+            this._stats[i] = createStats();
+            this._stats[i].queueDepth = queueDepth;
+            this._stats[i].maxQueueDepth = queueDepth;
+        }
     }
 
-    public async writeByte(addr: number, cmd: number, byte: number, delayMs: number = 0): Promise<void> {
-        return this._queue.add(() => {
-            return this._bus.writeByte(addr, cmd, byte)
-            .then(() => {
-                return new Promise(resolve => {
-                    setTimeout(() => {
-                        resolve();
-                    }, delayMs);
-                });
-            });
+    public addErrorListener(listener: I2CErrorListener): void {
+        this._errorListeners.push(listener);
+    }
+
+    public async readByte(addr: number, cmd: number, romiMode?: boolean, priority: I2CPriority = I2CPriority.TELEMETRY): Promise<number> {
+        return this._enqueue(priority, { type: OpType.READ_BYTE, addr, cmd, romiMode, length: 1, delayMs: 0 });
+    }
+
+    public async readWord(addr: number, cmd: number, romiMode?: boolean, priority: I2CPriority = I2CPriority.TELEMETRY): Promise<number> {
+        return this._enqueue(priority, { type: OpType.READ_WORD, addr, cmd, romiMode, length: 2, delayMs: 0 });
+    }
+
+    public async readBlock(addr: number, cmd: number, length: number, romiMode?: boolean, priority: I2CPriority = I2CPriority.TELEMETRY): Promise<Buffer> {
+        return this._enqueue(priority, { type: OpType.READ_BLOCK, addr, cmd, romiMode, length, delayMs: 0 });
+    }
+
+    public async writeByte(addr: number, cmd: number, byte: number, delayMs: number = 0, priority: I2CPriority = I2CPriority.TELEMETRY): Promise<void> {
+        return this._enqueue(priority, { type: OpType.WRITE_BYTE, addr, cmd, length: 1, data: byte, delayMs });
+    }
+
+    public async writeWord(addr: number, cmd: number, word: number, delayMs: number = 0, priority: I2CPriority = I2CPriority.TELEMETRY): Promise<void> {
+        return this._enqueue(priority, { type: OpType.WRITE_WORD, addr, cmd, length: 2, data: word, delayMs });
+    }
+
+    public async writeBlock(addr: number, cmd: number, data: Buffer, delayMs: number = 0, priority: I2CPriority = I2CPriority.TELEMETRY): Promise<void> {
+        return this._enqueue(priority, { type: OpType.WRITE_BLOCK, addr, cmd, length: data.length, data, delayMs });
+    }
+
+    /**
+     * Sample a block of registers every periodMs, independently of the
+     * queue. The latest sample is always available from the returned
+     * snapshot, without waiting on the bus. The period can be changed
+     * later through the snapshot
+     */
+    public startPeriodicRead(addr: number, cmd: number, length: number, periodMs: number, romiMode?: boolean): SharedSnapshot {
+        const snapshot = new SharedSnapshot(length);
+        snapshot.periodMs = periodMs;
+        this._bus.startPeriodicRead({ type: I2CBatchOpType.READ_BLOCK, addr, cmd, length, romiMode }, snapshot);
+        return snapshot;
+    }
+
+    public getNewAddressedHandle(addr: number, romiMode?: boolean, priority: I2CPriority = I2CPriority.TELEMETRY): QueuedI2CHandle {
+        return new QueuedI2CHandle(this, addr, romiMode, priority);
+    }
+
+    private _enqueue(priority: I2CPriority, opInfo: Omit<PendingOp, "queuedTime" | "callbacks">): Promise<any> {
+        return new Promise((resolve, reject) => {
+            const queue = this._queues[priority];
+            const stats = this._stats[priority];
+            const op: PendingOp = {
+                ...opInfo,
+                queuedTime: Date.now(),
+                callbacks: [{ resolve, reject }]
+            };
+
+            // If the last thing still waiting for this device is a write to
+            // the same register, the new value replaces it. Only looking at
+            // the last op keeps the ordering between registers intact
+            if (!isRead(op) && this._collapseWrites) {
+                const lastOp = this._lastPendingOpForAddress(queue, op.addr);
+                if (lastOp && lastOp.type === op.type && lastOp.cmd === op.cmd && lastOp.length === op.length) {
+                    lastOp.data = op.data;
+                    lastOp.delayMs = Math.max(lastOp.delayMs, op.delayMs);
+                    lastOp.callbacks.push(...op.callbacks);
+                    stats.collapsedWrites++;
+                    return;
+                }
+            }
+
+            queue.push(op);
+            stats.queueDepth++;
+            stats.maxQueueDepth = Math.max(stats.maxQueueDepth, stats.queueDepth);
+
+            this._pump();
         });
     }
 
-    public async writeWord(addr: number, cmd: number, word: number, delayMs: number = 0): Promise<void> {
-        return this._queue.add(() => {
-            return this._bus.writeWord(addr, cmd, word)
-            .then(() => {
-                return new Promise(resolve => {
-                    setTimeout(() => {
-                        resolve();
-                    }, delayMs);
-                });
+    private _lastPendingOpForAddress(queue: PendingOp[], addr: number): PendingOp | undefined {
+        for (let i = queue.length - 1; i >= 0; i--) {
+            if (queue[i].addr === addr) {
+                return queue[i];
+            }
+        }
+
+        return undefined;
+    }
+
+    /**
+     * Next device's turn in a priority class: the lowest address after
+     * the one that went last, wrapping round. Returns the index of that
+     * device's oldest queued operation
+     */
+    private _nextTurnIndex(queue: PendingOp[], lastAddr: number): number {
+        let nextIdx = -1;
+        let lowestIdx = 0;
+
+        for (let i = 0; i < queue.length; i++) {
+            const addr = queue[i].addr;
+            if (addr > lastAddr && (nextIdx < 0 || addr < queue[nextIdx].addr)) {
+                nextIdx = i;
+            }
+            if (addr < queue[lowestIdx].addr) {
+                lowestIdx = i;
+            }
+        }
+
+        return nextIdx >= 0 ? nextIdx : lowestIdx;
+    }
+
+    private _nextIndexForAddress(queue: PendingOp[], addr: number, fromIdx: number): number {
+        for (let i = fromIdx; i < queue.length; i++) {
+            if (queue[i].addr === addr) {
+                return i;
+            }
+        }
+
+        return -1;
+    }
+
+    /**
+     * Take the next operation off the queues, along with any reads that
+     * can be merged into it
+     */
+    private _takeNextGroup(): OpGroup | undefined {
+        const priority = this._queues.findIndex(queue => queue.length > 0);
+        if (priority < 0) {
+            return undefined;
+        }
+
+        const queue = this._queues[priority];
+        const firstIdx = this._roundRobinDevices ? this._nextTurnIndex(queue, this._lastAddresses[priority]) : 0;
+        const first = queue.splice(firstIdx, 1)[0];
+        const ops: PendingOp[] = [first];
+        this._lastAddresses[priority] = first.addr;
+
+        // Pull in any reads from the same device that continue on from
+        // this one. Operations for other devices in between don't matter
+        if (isRead(first) && first.romiMode && this._mergeReads) {
+            let nextCmd = first.cmd + first.length;
+            let totalLength = first.length;
+            let nextIdx = this._nextIndexForAddress(queue, first.addr, firstIdx);
+
+            while (nextIdx >= 0) {
+                const next = queue[nextIdx];
+                if (!isRead(next) || !next.romiMode ||
+                    next.cmd !== nextCmd || totalLength + next.length > MAX_MERGED_READ_LENGTH) {
+                    break;
+                }
+
+                ops.push(queue.splice(nextIdx, 1)[0]);
+                nextCmd += next.length;
+                totalLength += next.length;
+                nextIdx = this._nextIndexForAddress(queue, first.addr, nextIdx);
+            }
+        }
+
+        const stats = this._stats[priority];
+        stats.queueDepth -= ops.length;
+        stats.mergedReads += ops.length - 1;
+
+        return { priority, ops };
+    }
+
+    /**
+     * Start the next batch of operations, if the bus is free
+     *
+     * Everything that is waiting (up to maxBatchSize groups) goes out in a
+     * single batch, in priority order. Buses that can run a batch in one go
+     * save a round trip per operation
+     */
+    private _pump(): void {
+        if (this._isBusy) {
+            return;
+        }
+
+        const groups: OpGroup[] = [];
+        while (groups.length < this._maxBatchSize) {
+            const group = this._takeNextGroup();
+            if (group === undefined) {
+                break;
+            }
+
+            groups.push(group);
+        }
+
+        if (groups.length === 0) {
+            return;
+        }
+
+        this._isBusy = true;
+        this._bus.executeBatch(groups.map(group => this._toBatchOp(group.ops)))
+        .then(results => {
+            groups.forEach((group, idx) => {
+                this._completeGroup(group, results[idx]);
             });
+        })
+        .catch(err => {
+            groups.forEach(group => {
+                this._completeGroup(group, { error: (err && err.message) ? err.message : String(err) });
+            });
+        })
+        .then(() => {
+            this._isBusy = false;
+            this._pump();
         });
     }
 
-    public getNewAddressedHandle(addr: number, romiMode?: boolean): QueuedI2CHandle {
-        return new QueuedI2CHandle(this, addr, romiMode);
+    private _toBatchOp(ops: PendingOp[]): I2CBatchOp {
+        const op = ops[0];
+
+        if (ops.length > 1) {
+            return {
+                type: I2CBatchOpType.READ_BLOCK,
+                addr: op.addr,
+                cmd: op.cmd,
+                length: ops.reduce((total, readOp) => total + readOp.length, 0),
+                romiMode: op.romiMode
+            };
+        }
+
+        return {
+            type: OP_BATCH_TYPES[op.type],
+            addr: op.addr,
+            cmd: op.cmd,
+            length: op.length,
+            romiMode: op.romiMode,
+            value: typeof op.data === "number" ? op.data : undefined,
+            data: op.data instanceof Buffer ? op.data : undefined,
+            delayUs: op.delayMs * 1000
+        };
+    }
+
+    private _completeGroup(group: OpGroup, result: I2CBatchResult | undefined): void {
+        const { ops, priority } = group;
+
+        if (result === undefined || result.error !== undefined) {
+            const err = new Error(result ? result.error : "No result for I2C operation");
+            ops.forEach(op => {
+                op.callbacks.forEach(cb => cb.reject(err));
+                this._errorListeners.forEach(listener => listener(op.addr, op.cmd, !isRead(op), priority));
+            });
+        }
+        else if (ops.length > 1) {
+            // Hand each caller back its own slice of the merged read
+            const data = Buffer.from(result.data.buffer, result.data.byteOffset, result.data.length);
+            let offset = 0;
+            ops.forEach(readOp => {
+                const start = offset;
+                offset += readOp.length;
+
+                let value: number | Buffer;
+                switch (readOp.type) {
+                    case OpType.READ_BYTE:
+                        value = data[start];
+                        break;
+                    case OpType.READ_WORD:
+                        value = data.readUInt16LE(start);
+                        break;
+                    default:
+                        value = data.slice(start, start + readOp.length);
+                }
+
+                readOp.callbacks.forEach(cb => cb.resolve(value));
+            });
+        }
+        else {
+            const op = ops[0];
+            const value = op.type === OpType.READ_BLOCK ?
+                          Buffer.from(result.data.buffer, result.data.byteOffset, result.data.length) :
+                          result.value;
+            op.callbacks.forEach(cb => cb.resolve(value));
+        }
+
+        const stats = this._stats[priority];
+        const now = Date.now();
+        ops.forEach(op => {
+            const latencyMs = now - op.queuedTime;
+            stats.completed++;
+            stats.maxLatencyMs = Math.max(stats.maxLatencyMs, latencyMs);
+            stats.avgLatencyMs += (latencyMs - stats.avgLatencyMs) * LATENCY_AVERAGE_WEIGHT;
+        });
     }
 }
 
@@ -66,29 +488,47 @@ export class QueuedI2CHandle {
     private _queuedBus: QueuedI2CBus;
     private _address: number;
     private _romiMode: boolean = false;
+    private _priority: I2CPriority;
 
-    constructor(bus: QueuedI2CBus, addr: number, romiMode?: boolean) {
+    constructor(bus: QueuedI2CBus, addr: number, romiMode?: boolean, priority: I2CPriority = I2CPriority.TELEMETRY) {
         this._queuedBus = bus;
         this._address = addr;
+        this._priority = priority;
 
         if (romiMode !== undefined) {
             this._romiMode = romiMode;
         }
     }
 
+    public get address(): number {
+        return this._address;
+    }
+
+    public get priority(): I2CPriority {
+        return this._priority;
+    }
+
     public async readByte(cmd: number): Promise<number> {
-        return this._queuedBus.readByte(this._address, cmd, this._romiMode);
+        return this._queuedBus.readByte(this._address, cmd, this._romiMode, this._priority);
     }
 
     public async readWord(cmd: number): Promise<number> {
-        return this._queuedBus.readWord(this._address, cmd, this._romiMode);
+        return this._queuedBus.readWord(this._address, cmd, this._romiMode, this._priority);
     }
 
     public async writeByte(cmd: number, byte: number, delayMs: number = 0): Promise<void> {
-        return this._queuedBus.writeByte(this._address, cmd, byte, delayMs);
+        return this._queuedBus.writeByte(this._address, cmd, byte, delayMs, this._priority);
     }
 
     public async writeWord(cmd: number, word: number, delayMs: number = 0): Promise<void> {
-        return this._queuedBus.writeWord(this._address, cmd, word, delayMs);
+        return this._queuedBus.writeWord(this._address, cmd, word, delayMs, this._priority);
+    }
+
+    public async readBlock(cmd: number, length: number): Promise<Buffer> {
+        return this._queuedBus.readBlock(this._address, cmd, length, this._romiMode, this._priority);
+    }
+
+    public async writeBlock(cmd: number, data: Buffer, delayMs: number = 0): Promise<void> {
+        return this._queuedBus.writeBlock(this._address, cmd, data, delayMs, this._priority);
     }
 }
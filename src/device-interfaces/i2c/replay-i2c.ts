@@ -0,0 +1,38 @@
+import MockI2C from "./mock-i2c";
+import { I2CBatchOp, I2CBatchResult } from "./i2c-batch";
+import SharedSnapshot from "./shared-snapshot";
+
+interface PeriodicRead {
+    op: I2CBatchOp;
+    snapshot: SharedSnapshot;
+}
+
+/**
+ * MockI2C for replaying recorded sessions
+ *
+ * Nothing on this bus runs off a timer. Periodic reads only take a sample
+ * when samplePeriodicReads() is called, and post-write delays are
+ * skipped, so whoever is driving the replay decides exactly when
+ * everything happens (and it can run far faster than real time)
+ */
+export default class ReplayI2C extends MockI2C {
+    private _periodicReads: PeriodicRead[] = [];
+
+    public startPeriodicRead(op: I2CBatchOp, snapshot: SharedSnapshot): void {
+        this._periodicReads.push({ op, snapshot });
+    }
+
+    /**
+     * Take one sample for every periodic read, right now
+     */
+    public async samplePeriodicReads(): Promise<void> {
+        for (const read of this._periodicReads) {
+            const results = await this.executeBatch([read.op]);
+            read.snapshot.write(results[0].error === undefined ? results[0].data : null);
+        }
+    }
+
+    public executeBatch(ops: I2CBatchOp[]): Promise<I2CBatchResult[]> {
+        return super.executeBatch(ops.map(op => op.delayUs > 0 ? { ...op, delayUs: 0 } : op));
+    }
+}
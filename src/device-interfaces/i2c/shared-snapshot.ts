@@ -0,0 +1,132 @@
+// Header layout (Int32 words) ahead of the snapshot data
+enum HeaderWord {
+    // Seqlock counter. Odd while a write is in progress
+    SEQUENCE = 0,
+
+    // Number of samples written so far (including failed ones)
+    SAMPLE_COUNT = 1,
+
+    // Non-zero if the latest sample failed
+    ERROR = 2,
+
+    // How often the writer should take a sample. Set by the reader
+    PERIOD_MS = 3
+}
+
+const HEADER_BYTES: number = 4 * Int32Array.BYTES_PER_ELEMENT;
+
+// Readers give up after this many attempts at getting a consistent copy
+const MAX_READ_ATTEMPTS: number = 16;
+
+// Byte by byte, since trimming with subarray() would create a new view on
+// every copy
+function copyBytes(source: Uint8Array, target: Uint8Array): void {
+    const length = Math.min(source.length, target.length);
+    for (let i = 0; i < length; i++) {
+        target[i] = source[i];
+    }
+}
+
+export interface SnapshotInfo {
+    sampleCount: number;
+    error: boolean;
+}
+
+/**
+ * Latest value of a periodically sampled block of bytes, shared between
+ * threads through a SharedArrayBuffer
+ *
+ * There is a single writer, and any number of readers. Access is guarded
+ * by a sequence lock: the writer bumps the sequence number before and
+ * after updating the data, and a reader retries if the sequence number
+ * was odd, or changed while it was copying
+ */
+export default class SharedSnapshot {
+    private _buffer: SharedArrayBuffer;
+    private _header: Int32Array;
+    private _data: Uint8Array;
+
+    /**
+     * @param lengthOrBuffer Size of the data in bytes, or an existing
+     * buffer (e.g. one passed in from another thread) to attach to
+     */
+    constructor(lengthOrBuffer: number | SharedArrayBuffer) {
+        if (typeof lengthOrBuffer === "number") {
+            this._buffer = new SharedArrayBuffer(HEADER_BYTES + lengthOrBuffer);
+        }
+        else {
+            this._buffer = lengthOrBuffer;
+        }
+
+        this._header = new Int32Array(this._buffer, 0, HEADER_BYTES / Int32Array.BYTES_PER_ELEMENT);
+        this._data = new Uint8Array(this._buffer, HEADER_BYTES);
+    }
+
+    public get buffer(): SharedArrayBuffer {
+        return this._buffer;
+    }
+
+    public get length(): number {
+        return this._data.length;
+    }
+
+    /**
+     * Requested sampling period. The reader can change this at any time,
+     * and the writer picks it up before its next sample
+     */
+    public get periodMs(): number {
+        return Atomics.load(this._header, HeaderWord.PERIOD_MS);
+    }
+
+    public set periodMs(val: number) {
+        Atomics.store(this._header, HeaderWord.PERIOD_MS, Math.max(1, Math.round(val)));
+    }
+
+    public get sampleCount(): number {
+        return Atomics.load(this._header, HeaderWord.SAMPLE_COUNT);
+    }
+
+    /**
+     * Publish a new sample. Only one thread should ever write
+     * @param data New contents, or null if the sample failed (the previous
+     * contents are kept)
+     */
+    public write(data: Uint8Array | null): void {
+        Atomics.add(this._header, HeaderWord.SEQUENCE, 1);
+
+        if (data !== null) {
+            copyBytes(data, this._data);
+        }
+        Atomics.store(this._header, HeaderWord.ERROR, data === null ? 1 : 0);
+        Atomics.add(this._header, HeaderWord.SAMPLE_COUNT, 1);
+
+        Atomics.add(this._header, HeaderWord.SEQUENCE, 1);
+    }
+
+    /**
+     * Copy the latest sample into target
+     * @param info Object to fill in with information about the sample.
+     * Callers reading on every poll can pass the same one in each time,
+     * rather than having a new one created
+     * @returns info, or null if a consistent copy couldn't be made (the
+     * writer kept getting in the way)
+     */
+    public read(target: Uint8Array, info: SnapshotInfo = { sampleCount: 0, error: false }): SnapshotInfo | null {
+        for (let attempt = 0; attempt < MAX_READ_ATTEMPTS; attempt++) {
+            const seqBefore = Atomics.load(this._header, HeaderWord.SEQUENCE);
+            if (seqBefore & 1) {
+                continue;
+            }
+
+            copyBytes(this._data, target);
+            info.sampleCount = Atomics.load(this._header, HeaderWord.SAMPLE_COUNT);
+            info.error = Atomics.load(this._header, HeaderWord.ERROR) !== 0;
+
+            if (Atomics.load(this._header, HeaderWord.SEQUENCE) === seqBefore) {
+                return info;
+            }
+        }
+
+        return null;
+    }
+}
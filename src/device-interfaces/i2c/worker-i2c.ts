@@ -0,0 +1,193 @@
+import path from "path";
+import { Worker } from "worker_threads";
+import winston from "winston";
+import I2CPromisifiedBus from "./i2c-connection";
+import { DEFAULT_POST_WRITE_DELAY_US, I2CBatchOp, I2CBatchOpType, I2CBatchResult } from "./i2c-batch";
+import LogUtil from "../../utils/logging/log-util";
+import SharedSnapshot from "./shared-snapshot";
+
+export interface WorkerI2COptions {
+    busNumber: number;
+    postWriteDelayUs: number;
+}
+
+export interface WorkerI2CPeriodicRead {
+    op: I2CBatchOp;
+    snapshotBuffer: SharedArrayBuffer;
+}
+
+export interface WorkerI2CRequest {
+    id: number;
+    ops?: I2CBatchOp[];
+    periodicRead?: WorkerI2CPeriodicRead;
+    close?: boolean;
+}
+
+export interface WorkerI2CResponse {
+    id: number;
+    results: I2CBatchResult[];
+}
+
+interface PendingRequest {
+    resolve: (results: I2CBatchResult[]) => void;
+    reject: (reason?: any) => void;
+}
+
+/**
+ * Hardware I2C bus, run from a dedicated worker thread
+ *
+ * Each batch of operations is a single message to the worker, which runs
+ * them back to back with the synchronous i2c-bus API. This avoids a trip
+ * through the event loop (and a timer for the Romi post-write delay) on
+ * every transfer, so a Romi read takes a fraction of a millisecond rather
+ * than several
+ *
+ * Periodic reads are scheduled by the worker itself, and published through
+ * shared memory, so sampling isn't held up by whatever the main thread is
+ * doing
+ */
+export default class WorkerI2C extends I2CPromisifiedBus {
+    private _worker: Worker;
+    private _logger: winston.Logger;
+    private _nextRequestId: number;
+    private _pendingRequests: Map<number, PendingRequest>;
+    private _workerError: Error | null;
+
+    protected setup(): void {
+        this._logger = LogUtil.getLogger(`I2C-WORKER-${this._busNumber}`);
+        this._logger.info(`WorkerI2C(bus=${this._busNumber})`);
+
+        // Fail here, rather than in the worker, if the bus module isn't
+        // available so that callers can fall back to something else
+        require.resolve("i2c-bus");
+
+        this._nextRequestId = 0;
+        this._pendingRequests = new Map<number, PendingRequest>();
+        this._workerError = null;
+
+        const options: WorkerI2COptions = {
+            busNumber: this._busNumber,
+            postWriteDelayUs: DEFAULT_POST_WRITE_DELAY_US
+        };
+
+        this._worker = new Worker(path.resolve(__dirname, "i2c-worker.js"), { workerData: options });
+
+        this._worker.on("message", (response: WorkerI2CResponse) => {
+            const request = this._pendingRequests.get(response.id);
+            if (request) {
+                this._pendingRequests.delete(response.id);
+                request.resolve(response.results);
+            }
+        });
+
+        this._worker.on("error", err => {
+            this._logger.error(`I2C worker failed: ${err.message}`);
+            this._failPendingRequests(err);
+        });
+
+        this._worker.on("exit", code => {
+            this._failPendingRequests(new Error(`I2C worker exited (code ${code})`));
+        });
+    }
+
+    public close(): Promise<void> {
+        return this._sendRequest({ id: this._nextRequestId++, close: true })
+        .then(() => this._worker.terminate())
+        .then(() => {});
+    }
+
+    public executeBatch(ops: I2CBatchOp[]): Promise<I2CBatchResult[]> {
+        return this._sendRequest({ id: this._nextRequestId++, ops });
+    }
+
+    public startPeriodicRead(op: I2CBatchOp, snapshot: SharedSnapshot): void {
+        this._sendRequest({
+            id: this._nextRequestId++,
+            periodicRead: { op, snapshotBuffer: snapshot.buffer }
+        })
+        .catch(err => {
+            this._logger.error(`Failed to start periodic read: ${err.message}`);
+        });
+    }
+
+    public readByte(addr: number, cmd: number, romiMode?: boolean): Promise<number> {
+        this._logger.silly(`readByte(addr=0x${addr.toString(16)}, cmd=0x${cmd.toString(16)}, ${romiMode ? "true": "false"})`);
+        return this._executeSingle({ type: I2CBatchOpType.READ_BYTE, addr, cmd, romiMode })
+        .then(result => result.value);
+    }
+
+    public readWord(addr: number, cmd: number, romiMode?: boolean): Promise<number> {
+        this._logger.silly(`readWord(addr=0x${addr.toString(16)}, cmd=0x${cmd.toString(16)}, ${romiMode ? "true": "false"})`);
+        return this._executeSingle({ type: I2CBatchOpType.READ_WORD, addr, cmd, romiMode })
+        .then(result => result.value);
+    }
+
+    public writeByte(addr: number, cmd: number, byte: number): Promise<void> {
+        this._logger.silly(`writeByte(addr=0x${addr.toString(16)}, cmd=0x${cmd.toString(16)}, byte=0x${byte.toString(16)})`);
+        return this._executeSingle({ type: I2CBatchOpType.WRITE_BYTE, addr, cmd, value: byte })
+        .then(() => {});
+    }
+
+    public writeWord(addr: number, cmd: number, word: number): Promise<void> {
+        this._logger.silly(`writeWord(addr=0x${addr.toString(16)}, cmd=0x${cmd.toString(16)}, word=0x${word.toString(16)})`);
+        return this._executeSingle({ type: I2CBatchOpType.WRITE_WORD, addr, cmd, value: word })
+        .then(() => {});
+    }
+
+    public readBlock(addr: number, cmd: number, length: number, romiMode?: boolean): Promise<Buffer> {
+        this._logger.silly(`readBlock(addr=0x${addr.toString(16)}, cmd=0x${cmd.toString(16)}, length=${length}, ${romiMode ? "true": "false"})`);
+        return this._executeSingle({ type: I2CBatchOpType.READ_BLOCK, addr, cmd, length, romiMode })
+        .then(result => Buffer.from(result.data.buffer, result.data.byteOffset, result.data.length));
+    }
+
+    public writeBlock(addr: number, cmd: number, data: Buffer): Promise<void> {
+        this._logger.silly(`writeBlock(addr=0x${addr.toString(16)}, cmd=0x${cmd.toString(16)}, length=${data.length})`);
+        return this._executeSingle({ type: I2CBatchOpType.WRITE_BLOCK, addr, cmd, data })
+        .then(() => {});
+    }
+
+    public sendByte(addr: number, cmd: number): Promise<void> {
+        this._logger.silly(`sendByte(addr=0x${addr.toString(16)}, cmd=0x${cmd.toString(16)})`);
+        return this._executeSingle({ type: I2CBatchOpType.SEND_BYTE, addr, cmd })
+        .then(() => {});
+    }
+
+    public receiveByte(addr: number): Promise<number> {
+        this._logger.silly(`receiveByte(addr=0x${addr.toString(16)})`);
+        return this._executeSingle({ type: I2CBatchOpType.RECEIVE_BYTE, addr })
+        .then(result => result.value);
+    }
+
+    private _executeSingle(op: I2CBatchOp): Promise<I2CBatchResult> {
+        return this.executeBatch([op])
+        .then(results => {
+            if (results[0].error !== undefined) {
+                throw new Error(results[0].error);
+            }
+
+            return results[0];
+        });
+    }
+
+    private _sendRequest(request: WorkerI2CRequest): Promise<I2CBatchResult[]> {
+        if (this._workerError) {
+            return Promise.reject(this._workerError);
+        }
+
+        return new Promise((resolve, reject) => {
+            this._pendingRequests.set(request.id, { resolve, reject });
+            this._worker.postMessage(request);
+        });
+    }
+
+    private _failPendingRequests(err: Error): void {
+        if (!this._workerError) {
+            this._workerError = err;
+        }
+
+        this._pendingRequests.forEach(request => {
+            request.reject(err);
+        });
+        this._pendingRequests.clear();
+    }
+}
@@ -13,12 +13,17 @@ import MockRomiI2C from "./__mocks__/mock-romi";
 import { FIRMWARE_IDENT } from "./robot/romi-shmem-buffer";
 import RestInterface from "./services/rest-interface/rest-interface";
 import MockRomiImu from "./__mocks__/mock-imu";
+import PhysicsRomiSim from "./__mocks__/physics-romi";
+import FirmwareSimRomiI2C from "./__mocks__/firmware-sim-romi";
 import GyroCalibrationUtil from "./services/gyro-calibration/gyro-calibration-util";
 import DSServer from "./services/ds-interface/ds-ip-server";
 import QueuedI2CBus from "./device-interfaces/i2c/queued-i2c-bus";
 import { NetworkTableInstance } from "node-ntcore";
 import { execSync } from "child_process";
 import LogUtil, { LogLevel } from "./utils/logging/log-util";
+import TelemetryRecorder from "./services/recorder/telemetry-recorder";
+import { I2CErrorKind } from "./services/recorder/log-format";
+import { performance } from "perf_hooks";
 
 // INITIAL SETUP
 const mainLogger = LogUtil.getLogger("MAIN");
@@ -53,6 +58,9 @@ program
     .option("-p, --port <port>", "port to listen/connect to")
     .option("-h, --host <host>", "host to connect to (required for client)")
     .option("-u, --uri <uri>", "websocket URI")
+    .option("-r, --record <dir>", "record binary telemetry logs to a directory")
+    .option("-f, --firmware-sim [program]", "use the natively built firmware as the mock Romi")
+    .option("--physics", "simulate the drivetrain behind the mock Romi")
     .helpOption("--help", "display help for command");
 
 program.parse(process.argv);
@@ -82,37 +90,64 @@ catch (err) {
 
 const I2C_BUS_NUM: number = 1;
 
+function createMockI2C(): MockI2C {
+    const mockBus: MockI2C = new MockI2C(I2C_BUS_NUM);
+    const mockImu: MockRomiImu = new MockRomiImu(0x6B);
+
+    if (serviceConfig.firmwareSimProgram !== undefined) {
+        i2cLogger.info("Using firmware simulator: " + serviceConfig.firmwareSimProgram);
+        const simRomi: FirmwareSimRomiI2C = new FirmwareSimRomiI2C(romiConfig.i2cAddress, serviceConfig.firmwareSimProgram);
+        simRomi.startRealTimeClock();
+        mockBus.addDeviceToBus(simRomi);
+
+        if (serviceConfig.physicsSim) {
+            i2cLogger.warn("Drivetrain physics only runs behind the mock Romi, ignoring");
+        }
+    }
+    else {
+        const mockRomi: MockRomiI2C = new MockRomiI2C(romiConfig.i2cAddress);
+        mockRomi.setFirmwareIdent(FIRMWARE_IDENT);
+        mockBus.addDeviceToBus(mockRomi);
+
+        if (serviceConfig.physicsSim) {
+            i2cLogger.info("Simulating drivetrain physics");
+            const physicsSim: PhysicsRomiSim = new PhysicsRomiSim(mockRomi, mockImu);
+            physicsSim.startRealTimeClock();
+        }
+    }
+
+    mockBus.addDeviceToBus(mockImu);
+
+    // Any extra Romi boards get a mock of their own
+    romiConfig.customDevices.forEach(deviceSpec => {
+        if (deviceSpec.type === "romi-board" && deviceSpec.config && typeof deviceSpec.config.address === "number") {
+            const mockBoard: MockRomiI2C = new MockRomiI2C(deviceSpec.config.address);
+            mockBoard.setFirmwareIdent(FIRMWARE_IDENT);
+            mockBus.addDeviceToBus(mockBoard);
+        }
+    });
+
+    return mockBus;
+}
+
 // Set up the i2c bus out here
 let i2cBus: I2CPromisifiedBus;
 let endpoint: WPILibWSRobotEndpoint;
 
 if (!serviceConfig.forceMockI2C) {
     try {
-        const HardwareI2C = require("./device-interfaces/i2c/hw-i2c").default;
-        i2cBus = new HardwareI2C(I2C_BUS_NUM);
+        const WorkerI2C = require("./device-interfaces/i2c/worker-i2c").default;
+        i2cBus = new WorkerI2C(I2C_BUS_NUM);
     }
     catch (err) {
         i2cLogger.warn("Error creating hardware I2C: " + err.message);
         i2cLogger.warn("Falling back to MockI2C");
-        i2cBus = new MockI2C(I2C_BUS_NUM);
-
-        const mockRomi: MockRomiI2C = new MockRomiI2C(0x14);
-        mockRomi.setFirmwareIdent(FIRMWARE_IDENT);
-        (i2cBus as MockI2C).addDeviceToBus(mockRomi);
-
-        const mockImu: MockRomiImu = new MockRomiImu(0x6B);
-        (i2cBus as MockI2C).addDeviceToBus(mockImu);
+        i2cBus = createMockI2C();
     }
 }
 else {
     i2cLogger.info("Requested to use mock I2C");
-    i2cBus = new MockI2C(I2C_BUS_NUM);
-    const mockRomi: MockRomiI2C = new MockRomiI2C(0x14);
-    mockRomi.setFirmwareIdent(FIRMWARE_IDENT);
-    (i2cBus as MockI2C).addDeviceToBus(mockRomi);
-
-    const mockImu: MockRomiImu = new MockRomiImu(0x6B);
-    (i2cBus as MockI2C).addDeviceToBus(mockImu);
+    i2cBus = createMockI2C();
 }
 
 configLogger.info(`External Pins: ${romiConfig.pinConfigurationString}`);
@@ -156,13 +191,42 @@ const ioConfig: string[] = romiConfig.externalIOConfig.map(val => {
 });
 romiInfoTable.getEntry("IO Config").setStringArray(ioConfig);
 
+const robot: WPILibWSRomiRobot = new WPILibWSRomiRobot(queuedI2CBus, romiConfig.i2cAddress, romiConfig);
+
 // Periodic status updates to /Romi/Status
-setInterval(() => {
+robot.scheduler.addTask("NT Status", 1000, () => {
     romiStatusTable.getEntry("Battery Voltage").setDouble(robot.getBatteryPercentage() * 9.0);
+    romiStatusTable.getEntry("Telemetry CRC Errors").setDouble(robot.shmemStats.telemetry.crcErrors);
+    romiStatusTable.getEntry("Command CRC Errors").setDouble(robot.shmemStats.command.crcErrors);
+});
 
-}, 1000);
-
-const robot: WPILibWSRomiRobot = new WPILibWSRomiRobot(queuedI2CBus, 0x14, romiConfig);
+// Set up the telemetry recorder
+let recorder: TelemetryRecorder | undefined;
+if (serviceConfig.recordDirectory !== undefined) {
+    try {
+        fs.mkdirSync(serviceConfig.recordDirectory, { recursive: true });
+        const fileName = `romi-${new Date().toISOString().replace(/[:.]/g, "-")}.rlog`;
+        recorder = new TelemetryRecorder(path.join(serviceConfig.recordDirectory, fileName),
+                                         robot.logSchema, performance.now());
+        robot.setRecorder(recorder);
+
+        queuedI2CBus.addErrorListener((addr, cmd, isWrite, priority) => {
+            recorder.recordI2CError(isWrite ? I2CErrorKind.WRITE : I2CErrorKind.READ, addr, cmd, priority, performance.now());
+        });
+
+        robot.scheduler.addTask("Recorder Flush", 1000, () => {
+            recorder.flush();
+        });
+
+        process.on("SIGINT", () => {
+            recorder.close().then(() => process.exit());
+        });
+    }
+    catch (err) {
+        mainLogger.error("Error starting telemetry recorder: " + err.message);
+        recorder = undefined;
+    }
+}
 
 if (serviceConfig.endpointType === EndpointType.SERVER) {
     const serverSettings: WPILibWSServerConfig = {
@@ -197,10 +261,32 @@ restInterface.addStatusQuery("service-version", () => {
 
 restInterface.addStatusQuery("firmware-status", () => {
     return {
-        firmwareMatch: robot.firmwareIdent === FIRMWARE_IDENT
+        firmwareMatch: robot.firmwareIdent === FIRMWARE_IDENT,
+        resetCause: robot.resetCause,
+        shmemStats: robot.shmemStats
     };
 });
 
+restInterface.addStatusQuery("scheduler", () => {
+    return robot.schedulerStats;
+});
+
+restInterface.addStatusQuery("polling-rates", () => {
+    return robot.pollingStats;
+});
+
+restInterface.addStatusQuery("custom-devices", () => {
+    return robot.customDeviceStats;
+});
+
+restInterface.addStatusQuery("recorder", () => {
+    return recorder ? recorder.stats : { recording: false };
+});
+
+restInterface.addStatusQuery("i2c-scheduler", () => {
+    return queuedI2CBus.stats;
+});
+
 restInterface.addStatusQuery("external-io-config", () => {
     return romiConfig.externalIOConfig.map(val => {
         return val.mode;
@@ -249,6 +335,13 @@ restInterface.addIMUStatusQuery("gyro-offset", () => {
     return robot.getIMU().gyroOffset;
 });
 
+restInterface.addIMUStatusQuery("gyro-bias-tracking", () => {
+    return {
+        runtimeOffset: robot.getIMU().gyroRuntimeOffset,
+        ...robot.gyroBiasTrackingStats
+    };
+});
+
 const dsServer: DSServer = new DSServer();
 dsServer.start();
 
@@ -5,4 +5,7 @@ export default interface ProgramArguments {
     port?: string;
     host?: string;
     uri?: string;
+    record?: string;
+    firmwareSim?: string | boolean;
+    physics?: boolean;
 }
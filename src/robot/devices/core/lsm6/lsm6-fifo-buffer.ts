@@ -0,0 +1,174 @@
+// Each FIFO frame is 6 values, stored in the order they come off the FIFO
+// Gyro values are in DPS and accelerometer values are in G
+export const FIFO_FRAME_VALUES: number = 6;
+
+export enum FIFOFrameValue {
+    GYRO_X = 0,
+    GYRO_Y = 1,
+    GYRO_Z = 2,
+    ACCEL_X = 3,
+    ACCEL_Y = 4,
+    ACCEL_Z = 5
+}
+
+/**
+ * Read-only window onto a run of frames in a FIFOFrameBuffer
+ *
+ * Frames are read straight out of the ring buffer storage. The same view
+ * object is handed out on every call to FIFOFrameBuffer.takeNewFrames(),
+ * so it should be consumed before the next call
+ */
+export class FIFOFrames {
+    private _data: Float32Array;
+    private _capacity: number;
+    private _start: number = 0;
+    private _length: number = 0;
+
+    constructor(data: Float32Array, capacity: number) {
+        this._data = data;
+        this._capacity = capacity;
+    }
+
+    public get length(): number {
+        return this._length;
+    }
+
+    public get(index: number, value: FIFOFrameValue): number {
+        return this._data[(((this._start + index) % this._capacity) * FIFO_FRAME_VALUES) + value];
+    }
+
+    public gyroX(index: number): number {
+        return this.get(index, FIFOFrameValue.GYRO_X);
+    }
+
+    public gyroY(index: number): number {
+        return this.get(index, FIFOFrameValue.GYRO_Y);
+    }
+
+    public gyroZ(index: number): number {
+        return this.get(index, FIFOFrameValue.GYRO_Z);
+    }
+
+    public accelX(index: number): number {
+        return this.get(index, FIFOFrameValue.ACCEL_X);
+    }
+
+    public accelY(index: number): number {
+        return this.get(index, FIFOFrameValue.ACCEL_Y);
+    }
+
+    public accelZ(index: number): number {
+        return this.get(index, FIFOFrameValue.ACCEL_Z);
+    }
+
+    /**
+     * Copy one value out of every frame, e.g. to filter one axis of the
+     * whole run in a single pass
+     * @param target Array with room for at least length values
+     * @param scale Multiplier applied to each value (e.g. -1 to flip an axis)
+     */
+    public copyValues(value: FIFOFrameValue, target: Float64Array, scale: number = 1): void {
+        let frameIdx = this._start;
+        for (let i = 0; i < this._length; i++) {
+            target[i] = this._data[(frameIdx * FIFO_FRAME_VALUES) + value] * scale;
+
+            frameIdx++;
+            if (frameIdx === this._capacity) {
+                frameIdx = 0;
+            }
+        }
+    }
+
+    /**
+     * Point the view at a new run of frames
+     * @param start Ring index of the first frame
+     * @param length Number of frames
+     */
+    public reset(start: number, length: number): void {
+        this._start = start % this._capacity;
+        this._length = length;
+    }
+}
+
+/**
+ * Fixed size ring buffer of decoded IMU frames
+ *
+ * If frames aren't taken out fast enough, the oldest unread frames are
+ * overwritten (and counted in droppedFrames)
+ */
+export default class FIFOFrameBuffer {
+    private _data: Float32Array;
+    private _capacity: number;
+
+    // Total frames written and read. Positions in the ring are these
+    // counts modulo the capacity
+    private _writeCount: number = 0;
+    private _readCount: number = 0;
+    private _droppedFrames: number = 0;
+
+    private _view: FIFOFrames;
+
+    constructor(capacity: number = 512) {
+        this._capacity = capacity;
+        this._data = new Float32Array(capacity * FIFO_FRAME_VALUES);
+        this._view = new FIFOFrames(this._data, capacity);
+    }
+
+    public get capacity(): number {
+        return this._capacity;
+    }
+
+    public get numUnread(): number {
+        return this._writeCount - this._readCount;
+    }
+
+    public get droppedFrames(): number {
+        return this._droppedFrames;
+    }
+
+    public push(gyroX: number, gyroY: number, gyroZ: number, accelX: number, accelY: number, accelZ: number): void {
+        if (this.numUnread === this._capacity) {
+            this._readCount++;
+            this._droppedFrames++;
+        }
+
+        const offset = (this._writeCount % this._capacity) * FIFO_FRAME_VALUES;
+        this._data[offset + FIFOFrameValue.GYRO_X] = gyroX;
+        this._data[offset + FIFOFrameValue.GYRO_Y] = gyroY;
+        this._data[offset + FIFOFrameValue.GYRO_Z] = gyroZ;
+        this._data[offset + FIFOFrameValue.ACCEL_X] = accelX;
+        this._data[offset + FIFOFrameValue.ACCEL_Y] = accelY;
+        this._data[offset + FIFOFrameValue.ACCEL_Z] = accelZ;
+
+        this._writeCount++;
+    }
+
+    /**
+     * Returns a view of all unread frames, and marks them as read
+     *
+     * The gyro offsets are added to each frame as it is taken, so frames
+     * that sat in the ring while an offset changed still get the current one
+     * @param gyroOffsetX Amount to add to each gyro X value, in DPS
+     * @param gyroOffsetY Amount to add to each gyro Y value, in DPS
+     * @param gyroOffsetZ Amount to add to each gyro Z value, in DPS
+     */
+    public takeNewFrames(gyroOffsetX: number = 0, gyroOffsetY: number = 0, gyroOffsetZ: number = 0): FIFOFrames {
+        if (gyroOffsetX !== 0 || gyroOffsetY !== 0 || gyroOffsetZ !== 0) {
+            for (let count = this._readCount; count < this._writeCount; count++) {
+                const offset = (count % this._capacity) * FIFO_FRAME_VALUES;
+                this._data[offset + FIFOFrameValue.GYRO_X] += gyroOffsetX;
+                this._data[offset + FIFOFrameValue.GYRO_Y] += gyroOffsetY;
+                this._data[offset + FIFOFrameValue.GYRO_Z] += gyroOffsetZ;
+            }
+        }
+
+        this._view.reset(this._readCount, this.numUnread);
+        this._readCount = this._writeCount;
+
+        return this._view;
+    }
+
+    public clear(): void {
+        this._readCount = this._writeCount;
+    }
+}
@@ -1,6 +1,7 @@
 import LogUtil from "../../../../utils/logging/log-util";
-import I2CPromisifiedBus from "../../../../device-interfaces/i2c/i2c-connection";
+import QueuedI2CBus, { I2CPriority, QueuedI2CHandle } from "../../../../device-interfaces/i2c/queued-i2c-bus";
 import LSM6Settings, { AccelerometerScale, FIFOModeSelection, GyroScale, OutputDataRate } from "./lsm6-settings";
+import FIFOFrameBuffer, { FIFOFrames, FIFO_FRAME_VALUES } from "./lsm6-fifo-buffer";
 
 // LSM6DS33 Datasheet: https://www.st.com/resource/en/datasheet/lsm6ds33.pdf
 
@@ -89,14 +90,14 @@ enum CTRL3_C_OPTIONS {
     SW_RESET = 1
 }
 
-export interface FIFOFrame {
-    gyroX: number;
-    gyroY: number;
-    gyroZ: number;
-    accelX: number;
-    accelY: number;
-    accelZ: number;
-}
+export { FIFOFrames };
+
+// Each FIFO value is a 16 bit word
+const FIFO_FRAME_BYTES: number = FIFO_FRAME_VALUES * 2;
+
+// SMBus block reads top out at 32 bytes, so drain the FIFO in bursts of
+// whole frames that fit within that
+const FIFO_MAX_BURST_FRAMES: number = Math.floor(32 / FIFO_FRAME_BYTES);
 
 // Used with FIFO_CTRL5
 const FIFO_ODR_BYTE: Map<OutputDataRate, number> = new Map<OutputDataRate, number>();
@@ -236,19 +237,21 @@ export default class LSM6 {
     private _gyroOffset: Vector3 = { x: 0, y: 0, z: 0 };
     private _gyroRuntimeOffset: Vector3 = { x: 0, y: 0, z: 0 };
 
-    private _i2cBus: I2CPromisifiedBus;
-    private _i2cAddress: number;
+    private _i2cHandle: QueuedI2CHandle;
 
     private _isReady: boolean = false;
 
     private _settings: LSM6Settings = new LSM6Settings();
 
     private _fifoRunning: boolean = false;
-    private _fifoBuffer: FIFOFrame[] = [];
+    private _fifoPollPeriodMs: number = 0;
+    private _fifoBuffer: FIFOFrameBuffer = new FIFOFrameBuffer();
 
-    constructor(bus: I2CPromisifiedBus, address: number, config?: LSM6Config) {
-        this._i2cAddress = address;
-        this._i2cBus = bus;
+    // Latest FIFO read, so that reads never overlap
+    private _fifoReadP: Promise<number> = Promise.resolve(0);
+
+    constructor(bus: QueuedI2CBus, address: number, config?: LSM6Config) {
+        this._i2cHandle = bus.getNewAddressedHandle(address, false, I2CPriority.TELEMETRY);
 
         if (config?.accelOffset) {
             this.accelOffset = config.accelOffset;
@@ -321,10 +324,33 @@ export default class LSM6 {
         this._gyroRuntimeOffset.z = val;
     }
 
+    /**
+     * Nudge the runtime offset by a small amount, e.g. from bias tracking
+     */
+    public adjustRuntimeOffset(delta: Vector3) {
+        this._gyroRuntimeOffset.x += delta.x;
+        this._gyroRuntimeOffset.y += delta.y;
+        this._gyroRuntimeOffset.z += delta.z;
+        logger.debug("Adjusted runtime offset to " + JSON.stringify(this._gyroRuntimeOffset));
+    }
+
     public getFIFOPeriod(): number {
         return getFIFOPeriod(this.settings.fifoSampleRate);
     }
 
+    /**
+     * Minimum time between FIFO drains. With the default of 0, the FIFO is
+     * drained as soon as new frames arrive. Longer periods pull more frames
+     * per drain, and leave the bus free for longer in between
+     */
+    public get fifoPollPeriodMs(): number {
+        return this._fifoPollPeriodMs;
+    }
+
+    public set fifoPollPeriodMs(val: number) {
+        this._fifoPollPeriodMs = Math.max(0, val);
+    }
+
     public async begin(): Promise<void> {
         await this._reset();
 
@@ -456,12 +482,26 @@ export default class LSM6 {
     }
 
     /**
-     * Returns any unprocessed FIFO Frames and clears the internal buffer
+     * Returns a view of any unprocessed FIFO Frames and marks them as read
+     * The view is reused on the next call, so don't hold on to it
+     *
+     * The runtime offset is applied here rather than when frames are
+     * decoded, so a change to it covers frames already in the buffer
+     */
+    public getNewFIFOData(): FIFOFrames {
+        return this._fifoBuffer.takeNewFrames(this._gyroRuntimeOffset.x,
+                                              this._gyroRuntimeOffset.y,
+                                              this._gyroRuntimeOffset.z);
+    }
+
+    /**
+     * Drain the FIFO once, outside of the polling loop. With the loop
+     * stopped, this lets a caller (e.g. a session replay) decide exactly
+     * when frames are read
+     * @returns The number of frames read
      */
-    public getNewFIFOData(): FIFOFrame[] {
-        const ret: FIFOFrame[] = [...this._fifoBuffer];
-        this._fifoBuffer = [];
-        return ret;
+    public pollFIFO(): Promise<number> {
+        return this._readFIFO();
     }
 
     private async _reset(): Promise<void> {
@@ -498,28 +538,29 @@ export default class LSM6 {
      *
      * A "frame" consists of a snapshot of gyro and accelerometer values. The
      * time between each "frame" is dependent on the FIFO ODR value
+     * @returns The number of frames read
      * @private
      */
-    private async _fifoLoop(): Promise<void> {
+    private async _fifoLoop(): Promise<number> {
         const start = Date.now();
         const status = await this._fifoGetStatus();
         logger.silly(`FIFO Status: 0x${status.toString(16)}`);
 
-        const numUnread = status & 0xFFF;
+        let numUnread = status & 0xFFF;
         logger.silly(`Num unread entries: ${numUnread}`);
-        const valBuf = Buffer.alloc(2);
-
-        const tempFrame: FIFOFrame = {
-            gyroX: 0,
-            gyroY: 0,
-            gyroZ: 0,
-            accelX: 0,
-            accelY: 0,
-            accelZ: 0
+
+        // The FIFO pattern tells us which value of the frame comes out
+        // next (0 = GyroX). If we're not at the start of a frame (e.g. the
+        // FIFO overran), discard values until we are
+        const pattern = (status >> 16) & 0x3FF;
+        if (pattern !== 0 && numUnread > 0) {
+            const numToDiscard = Math.min(FIFO_FRAME_VALUES - pattern, numUnread);
+            await this._readBlock(RegAddr.FIFO_DATA_OUT_L, numToDiscard * 2);
+            numUnread -= numToDiscard;
         }
 
-        const accelScaleFactor = ACCEL_OUTPUT_SCALE_FACTOR.get(this._settings.accelRange);
-        const gyroScaleFactor = GYRO_OUTPUT_SCALE_FACTOR.get(this._settings.gyroRange);
+        const accelScaleFactor = ACCEL_OUTPUT_SCALE_FACTOR.get(this._settings.accelRange) / 1000;
+        const gyroScaleFactor = GYRO_OUTPUT_SCALE_FACTOR.get(this._settings.gyroRange) / 1000;
 
         // We only want to process groups of 6 values (which correspond to 3 gyro + 3 accel values)
         // An IMU "data frame" consists of 6 reads off the FIFO register
@@ -535,91 +576,90 @@ export default class LSM6 {
         // References
         // Angular Rate Sensitivity: G_So (page 15)
         // Linear Acceleration Sensitivity: LA_So (page 15)
-        const shouldProcess = (numUnread % 6 === 0);
-        for (let i = 0; i < numUnread; i++) {
-            // ReadWord is implemented as a Little Endian 2 byte read
-            // The register layout (in increasing memory address order) is
-            // FIFO_DATA_OUT_L, FIFO_DATA_OUT_H
-            // We now read the 2 bytes starting at FIFO_DATA_OUT_L as an
-            // unsigned 16 bit number, and convert that to a signed 16 bit
-            let val = await this._readWord(RegAddr.FIFO_DATA_OUT_L);
-            valBuf.writeUInt16LE(val);
-            val = valBuf.readInt16LE();
-
-            if (shouldProcess) {
-                switch (i % 6) {
-                    case 0:
-                        tempFrame.gyroX = ((val * gyroScaleFactor) / 1000) - this._gyroOffset.x + this._gyroRuntimeOffset.x;
-                        break;
-                    case 1:
-                        tempFrame.gyroY = ((val * gyroScaleFactor) / 1000) - this._gyroOffset.y + this._gyroRuntimeOffset.y;
-                        break;
-                    case 2:
-                        tempFrame.gyroZ = ((val * gyroScaleFactor) / 1000) - this._gyroOffset.z + this._gyroRuntimeOffset.z;
-                        break;
-                    case 3:
-                        tempFrame.accelX = (val * accelScaleFactor) / 1000;
-                        break;
-                    case 4:
-                        tempFrame.accelY = (val * accelScaleFactor) / 1000;
-                        break;
-                    case 5:
-                        tempFrame.accelZ = (val * accelScaleFactor) / 1000;
-                        this._fifoBuffer.push({...tempFrame});
-                        break;
-                }
+        //
+        // With register auto-increment enabled, reads past FIFO_DATA_OUT_H
+        // roll back around to FIFO_DATA_OUT_L, so a single block read
+        // pulls several values off the FIFO
+        const totalFrames = Math.floor(numUnread / FIFO_FRAME_VALUES);
+        let numFrames = totalFrames;
+        while (numFrames > 0) {
+            const burstFrames = Math.min(numFrames, FIFO_MAX_BURST_FRAMES);
+            const data = await this._readBlock(RegAddr.FIFO_DATA_OUT_L, burstFrames * FIFO_FRAME_BYTES);
+
+            for (let offset = 0; offset < data.length; offset += FIFO_FRAME_BYTES) {
+                this._fifoBuffer.push(
+                    (data.readInt16LE(offset) * gyroScaleFactor) - this._gyroOffset.x,
+                    (data.readInt16LE(offset + 2) * gyroScaleFactor) - this._gyroOffset.y,
+                    (data.readInt16LE(offset + 4) * gyroScaleFactor) - this._gyroOffset.z,
+                    data.readInt16LE(offset + 6) * accelScaleFactor,
+                    data.readInt16LE(offset + 8) * accelScaleFactor,
+                    data.readInt16LE(offset + 10) * accelScaleFactor);
             }
+
+            numFrames -= burstFrames;
         }
 
         const end = Date.now();
-        logger.silly(`FIFO LOOP took ${end-start}ms. Local Buffer size ${this._fifoBuffer.length}`);
+        logger.silly(`FIFO LOOP took ${end-start}ms. Local Buffer size ${this._fifoBuffer.numUnread}`);
+
+        return totalFrames;
     }
 
     /**
-     * Read the FIFO status byte
+     * Read the FIFO status registers in one go
+     * Bits 0-15 are FIFO_STATUS1/2 (unread count and flags), and
+     * bits 16-25 are FIFO_STATUS3/4 (the FIFO pattern)
      */
     private async _fifoGetStatus(): Promise<number> {
-        let temp = 0;
-        let accum = 0;
-
-        temp = await this._readByte(RegAddr.FIFO_STATUS1);
-        accum = temp;
-        temp = await this._readByte(RegAddr.FIFO_STATUS2);
-        accum |= (temp << 8);
-
-        return accum;
+        const status = await this._readBlock(RegAddr.FIFO_STATUS1, 4);
+        return status.readUInt32LE(0);
     }
 
     /**
      * Wrapper function for constantly checking the FIFO buffer
      */
-    private _runFifoLoop() {
-        setImmediate(async () => {
-            await this._fifoLoop();
+    private _runFifoLoop(delayMs: number = 0) {
+        setTimeout(async () => {
+            if (!this._fifoRunning) {
+                return;
+            }
+
+            const numFrames = await this._readFIFO();
             if (this._fifoRunning) {
-                this._runFifoLoop();
+                // If the FIFO was empty, there's no point polling it again
+                // until the next frame is due. This leaves the bus free
+                // for everyone else in the meantime
+                const idleDelayMs = numFrames > 0 ? 0 : this.getFIFOPeriod() * 1000;
+                this._runFifoLoop(Math.max(idleDelayMs, this._fifoPollPeriodMs));
             }
-        });
+        }, delayMs);
+    }
+
+    /**
+     * Queue up a FIFO read behind any that are still in progress
+     */
+    private _readFIFO(): Promise<number> {
+        this._fifoReadP = this._fifoReadP
+        .catch(() => 0)
+        .then(() => this._fifoLoop());
+
+        return this._fifoReadP;
     }
 
     private async _readByte(cmd: number): Promise<number> {
-        return this._i2cBus.readByte(this._i2cAddress, cmd);
+        return this._i2cHandle.readByte(cmd);
     }
 
     private async _writeByte(cmd: number, byte: number): Promise<void> {
-        return this._i2cBus.writeByte(this._i2cAddress, cmd, byte);
+        return this._i2cHandle.writeByte(cmd, byte);
     }
 
     private async _readWord(cmd: number): Promise<number> {
-        return this._i2cBus.readWord(this._i2cAddress, cmd);
-    }
-
-    private async _sendByte(cmd: number): Promise<void> {
-        return this._i2cBus.sendByte(this._i2cAddress, cmd);
+        return this._i2cHandle.readWord(cmd);
     }
 
-    private async _receiveByte(): Promise<number> {
-        return this._i2cBus.receiveByte(this._i2cAddress);
+    private async _readBlock(cmd: number, length: number): Promise<Buffer> {
+        return this._i2cHandle.readBlock(cmd, length);
     }
 
     private async _waitMS(delayMS: number): Promise<void> {
@@ -0,0 +1,186 @@
+import { DEFAULT_CUSTOM_DEVICE_BUS_BUDGET, DEFAULT_POLLING_RATES_HZ } from "../../polling-rates";
+import CustomDevice, { CustomDeviceUpdateStats } from "./custom-device";
+
+// Weight of the latest update in the bus time per update average
+const COST_AVERAGE_WEIGHT: number = 0.2;
+
+export interface CustomDeviceStats extends CustomDeviceUpdateStats {
+    identifier: string;
+    updates: number;
+}
+
+export interface CustomDeviceSchedulerStats {
+    devices: CustomDeviceStats[];
+    busUtilization: number;
+    budgetScale: number;
+}
+
+interface ScheduledDevice {
+    device: CustomDevice;
+    rateHz: number | undefined; // Undefined uses the default rate
+    essential: boolean; // Never slowed down to fit the budget
+
+    costUs: number; // Average bus time per update
+    updates: number;
+
+    // For the achieved rates, since the last call to update()
+    windowUpdates: number;
+    windowBusTimeUs: number;
+    achievedRateHz: number;
+    busUtilization: number;
+}
+
+/**
+ * Works out how often each custom device should be updated, and keeps
+ * track of how that's going
+ *
+ * Each device is updated at its own rate: the one set in its config, or
+ * failing that, the one it declares, or failing that, the default rate.
+ * The bus time each device's updates take is accounted for, and if the
+ * devices between them would take more than the budgeted fraction of bus
+ * time, every device is slowed down by the same factor to fit (so a
+ * chatty device can't starve the Romi and the IMU). Essential devices,
+ * such as other Romi boards, are left out of this, and always run at
+ * their own rate
+ */
+export default class CustomDeviceScheduler {
+    private _busBudget: number;
+    private _defaultPeriodMs: () => number;
+
+    private _devices: Map<CustomDevice, ScheduledDevice> = new Map<CustomDevice, ScheduledDevice>();
+
+    private _budgetScale: number = 1;
+    private _busUtilization: number = 0;
+    private _lastUpdateTime: number = -1;
+
+    /**
+     * @param busBudget Fraction of bus time the devices can use between them
+     * @param defaultPeriodMs Period for devices without a rate of their own
+     */
+    constructor(busBudget: number = DEFAULT_CUSTOM_DEVICE_BUS_BUDGET,
+                defaultPeriodMs: () => number = () => 1000 / DEFAULT_POLLING_RATES_HZ.customDevices) {
+        this._busBudget = busBudget;
+        this._defaultPeriodMs = defaultPeriodMs;
+    }
+
+    /**
+     * Add a device to be scheduled
+     * @param rateHz Rate from the device's config, overriding the one it declares
+     */
+    public addDevice(device: CustomDevice, rateHz?: number): void {
+        this._devices.set(device, {
+            device,
+            rateHz: rateHz !== undefined ? rateHz : device.updateRateHz,
+            essential: device.isEssential,
+            costUs: 0,
+            updates: 0,
+            windowUpdates: 0,
+            windowBusTimeUs: device.busTimeUs,
+            achievedRateHz: 0,
+            busUtilization: 0
+        });
+    }
+
+    /**
+     * Current update period for a device, including any slowdown to fit
+     * the bus budget
+     */
+    public periodMs(device: CustomDevice): number {
+        const entry = this._devices.get(device);
+        return this._requestedPeriodMs(entry) * (entry.essential ? 1 : this._budgetScale);
+    }
+
+    /**
+     * Update a device, accounting for the bus time it takes. If the
+     * device's update is async, so is this
+     */
+    public runUpdate(device: CustomDevice): void | Promise<void> {
+        const entry = this._devices.get(device);
+        const startBusTimeUs = device.busTimeUs;
+        const result = device.update();
+
+        if (result instanceof Promise) {
+            // Failed updates still took bus time
+            return result
+            .catch(() => {})
+            .then(() => {
+                this._recordUpdate(entry, device.busTimeUs - startBusTimeUs);
+            });
+        }
+
+        this._recordUpdate(entry, device.busTimeUs - startBusTimeUs);
+    }
+
+    public get stats(): CustomDeviceSchedulerStats {
+        const devices: CustomDeviceStats[] = [];
+        this._devices.forEach(entry => {
+            devices.push(this._deviceStats(entry));
+        });
+
+        return {
+            devices,
+            busUtilization: this._busUtilization,
+            budgetScale: this._budgetScale
+        };
+    }
+
+    /**
+     * Work out the achieved rates since the last call, and fit the
+     * requested rates into the bus budget. This should be called
+     * periodically (around once a second is plenty)
+     */
+    public update(now: number): void {
+        const elapsedMs = this._lastUpdateTime >= 0 ? now - this._lastUpdateTime : 0;
+        this._lastUpdateTime = now;
+
+        let demand = 0;
+        this._devices.forEach(entry => {
+            const busTimeUs = entry.device.busTimeUs;
+
+            if (elapsedMs > 0) {
+                entry.achievedRateHz = entry.windowUpdates * 1000 / elapsedMs;
+                entry.busUtilization = (busTimeUs - entry.windowBusTimeUs) / (elapsedMs * 1000);
+            }
+
+            entry.windowUpdates = 0;
+            entry.windowBusTimeUs = busTimeUs;
+
+            if (!entry.essential) {
+                demand += entry.costUs / (this._requestedPeriodMs(entry) * 1000);
+            }
+        });
+
+        this._budgetScale = demand > this._busBudget ? demand / this._busBudget : 1;
+        this._busUtilization = demand / this._budgetScale;
+    }
+
+    /**
+     * Publish each device's stats to its NetworkTable
+     */
+    public publishStats(): void {
+        this._devices.forEach(entry => {
+            entry.device.publishUpdateStats(this._deviceStats(entry));
+        });
+    }
+
+    private _deviceStats(entry: ScheduledDevice): CustomDeviceStats {
+        return {
+            identifier: entry.device.identifier,
+            updates: entry.updates,
+            targetRateHz: 1000 / this.periodMs(entry.device),
+            rateHz: entry.achievedRateHz,
+            busTimeUs: entry.costUs,
+            busUtilization: entry.busUtilization
+        };
+    }
+
+    private _requestedPeriodMs(entry: ScheduledDevice): number {
+        return entry.rateHz !== undefined ? 1000 / entry.rateHz : this._defaultPeriodMs();
+    }
+
+    private _recordUpdate(entry: ScheduledDevice, busTimeUs: number): void {
+        entry.costUs = entry.updates === 0 ? busTimeUs : entry.costUs + ((busTimeUs - entry.costUs) * COST_AVERAGE_WEIGHT);
+        entry.updates++;
+        entry.windowUpdates++;
+    }
+}
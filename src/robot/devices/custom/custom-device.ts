@@ -1,6 +1,7 @@
 import { DigitalChannelMode, SimDevice } from "@wpilib/wpilib-ws-robot";
 import { NetworkTable, NetworkTableInstance } from "node-ntcore";
-import QueuedI2CBus from "../../../device-interfaces/i2c/queued-i2c-bus";
+import QueuedI2CBus, { I2CPriority } from "../../../device-interfaces/i2c/queued-i2c-bus";
+import MeteredI2CHandle from "./metered-i2c-handle";
 
 export interface IOInterfaces {
     numDioPorts?: number;
@@ -13,11 +14,31 @@ export interface RobotHardwareInterfaces {
     i2cBus: QueuedI2CBus
 }
 
+/**
+ * Encoder made up of a pair of a device's DIO ports
+ */
+export interface CustomDeviceEncoder {
+    index: number; // Which of the device's encoders
+    reversed: boolean; // Whether the ports are the other way round
+}
+
+/**
+ * How a device's updates are actually going, as reported by the
+ * custom device scheduler
+ */
+export interface CustomDeviceUpdateStats {
+    targetRateHz: number; // After any slowdown to fit the bus budget
+    rateHz: number;
+    busTimeUs: number; // Estimated bus time per update
+    busUtilization: number;
+}
+
 export default abstract class CustomDevice {
     private _deviceType: string;
     private _isSingleton: boolean;
 
     private _deviceNetworkTable: NetworkTable | null = null;
+    private _i2cHandles: MeteredI2CHandle[] = [];
 
     protected _robotHWInterfaces: RobotHardwareInterfaces;
 
@@ -49,7 +70,74 @@ export default abstract class CustomDevice {
         return this._deviceNetworkTable;
     }
 
-    public abstract update(): void;
+    /**
+     * Rate the device would like to be updated at, e.g. how often it
+     * takes a new measurement. Undefined uses the customDevices polling
+     * rate. This can be overridden per device in the configuration
+     */
+    public get updateRateHz(): number | undefined {
+        return undefined;
+    }
+
+    /**
+     * Whether the device carries control loop data, e.g. another Romi
+     * board. Essential devices are always updated at their own rate, and
+     * are left out when custom devices are slowed down to fit the bus
+     * budget
+     */
+    public get isEssential(): boolean {
+        return false;
+    }
+
+    /**
+     * Estimated bus time taken by all of this device's transfers so far,
+     * in us. Only transfers made through handles from getI2CHandle() count
+     */
+    public get busTimeUs(): number {
+        let total = 0;
+        this._i2cHandles.forEach(handle => {
+            total += handle.busTimeUs;
+        });
+
+        return total;
+    }
+
+    /**
+     * Update the device. If this returns a promise, the next update
+     * won't start until it has settled
+     */
+    public abstract update(): void | Promise<void>;
+
+    /**
+     * Publish the device's update stats, alongside its other values
+     */
+    public publishUpdateStats(stats: CustomDeviceUpdateStats): void {
+        const table = this._deviceNetworkTable || NetworkTableInstance.getDefault().getTable(`/Romi/CustomDevice/${this.identifier}`);
+
+        table.getEntry("Update Rate").setDouble(stats.rateHz);
+        table.getEntry("Target Update Rate").setDouble(stats.targetRateHz);
+        table.getEntry("Bus Time Per Update").setDouble(stats.busTimeUs);
+        table.getEntry("Bus Utilization").setDouble(stats.busUtilization);
+    }
+
+    /**
+     * Called on every robot heartbeat, while the robot program has the
+     * robot enabled. Devices with a failsafe of their own (like another
+     * Romi) should pass it on
+     */
+    public heartbeat(): void {}
+
+    /**
+     * Get a handle for a device on the bus, with its bus time counted
+     * against this device. Only devices standing in for part of the robot
+     * itself (like another Romi) should need more than custom device priority
+     */
+    protected getI2CHandle(address: number, romiMode: boolean = false, priority: I2CPriority = I2CPriority.CUSTOM_DEVICE): MeteredI2CHandle {
+        const handle = new MeteredI2CHandle(this._robotHWInterfaces.i2cBus, address, romiMode, priority);
+        this._i2cHandles.push(handle);
+
+        return handle;
+    }
 
     // IO operations
     public setDigitalChannelMode(channel: number, mode: DigitalChannelMode): void {
@@ -72,4 +160,19 @@ export default abstract class CustomDevice {
         throw new Error("getDigitalInValue must be implemented by subclass");
     }
 
+    /**
+     * The encoder on a pair of DIO ports, if they make one up
+     */
+    public getEncoder(channelA: number, channelB: number): CustomDeviceEncoder | undefined {
+        return undefined;
+    }
+
+    public getEncoderCount(encoder: number): number {
+        throw new Error("getEncoderCount must be implemented by subclass");
+    }
+
+    public resetEncoder(encoder: number): void {
+        throw new Error("resetEncoder must be implemented by subclass");
+    }
+
 }
@@ -1,6 +1,7 @@
 import CustomDevice, { RobotHardwareInterfaces } from "./custom-device";
 import ExampleCustomDevice from "./example-custom-device";
 import RevColorSensorV3 from "./rev-color-sensor-v3";
+import RomiBoard from "./romi-board";
 
 export interface CustomDeviceConstructor {
     new (robotHardware: RobotHardwareInterfaces, config: any): CustomDevice;
@@ -11,6 +12,7 @@ const CUSTOM_DEVICE_LIST: Map<string, CustomDeviceConstructor> = new Map<string,
 // Add new devices to the map
 CUSTOM_DEVICE_LIST.set("example-custom-device", ExampleCustomDevice);
 CUSTOM_DEVICE_LIST.set("rev-color-sensor", RevColorSensorV3);
+CUSTOM_DEVICE_LIST.set("romi-board", RomiBoard);
 
 export default class CustomDeviceFactory {
     public static createDevice(type: string, robotHardware: RobotHardwareInterfaces, config: any): CustomDevice {
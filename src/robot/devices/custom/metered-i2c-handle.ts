@@ -0,0 +1,70 @@
+import { DEFAULT_POST_WRITE_DELAY_US } from "../../../device-interfaces/i2c/i2c-batch";
+import QueuedI2CBus, { I2CPriority, QueuedI2CHandle } from "../../../device-interfaces/i2c/queued-i2c-bus";
+import { estimateTransferUs } from "../../polling-rates";
+
+/**
+ * Addressed handle that keeps a running total of the bus time its
+ * transfers take, so that a device's share of the bus can be accounted for
+ *
+ * Times are estimated (in the same way as for the polling budget) rather
+ * than measured, and transfers count as soon as they're issued, whether
+ * or not they succeed
+ */
+export default class MeteredI2CHandle extends QueuedI2CHandle {
+    private _busTimeUs: number = 0;
+    private _transfers: number = 0;
+    private _readDelayUs: number;
+
+    constructor(bus: QueuedI2CBus, addr: number, romiMode: boolean = false, priority: I2CPriority = I2CPriority.CUSTOM_DEVICE) {
+        super(bus, addr, romiMode, priority);
+
+        // Romi mode reads wait for the firmware between the write and the read
+        this._readDelayUs = romiMode ? DEFAULT_POST_WRITE_DELAY_US : 0;
+    }
+
+    /**
+     * Estimated bus time taken by all transfers so far, in us
+     */
+    public get busTimeUs(): number {
+        return this._busTimeUs;
+    }
+
+    public get transfers(): number {
+        return this._transfers;
+    }
+
+    public async readByte(cmd: number): Promise<number> {
+        this._meter(1, 1, this._readDelayUs);
+        return super.readByte(cmd);
+    }
+
+    public async readWord(cmd: number): Promise<number> {
+        this._meter(1, 2, this._readDelayUs);
+        return super.readWord(cmd);
+    }
+
+    public async writeByte(cmd: number, byte: number, delayMs: number = 0): Promise<void> {
+        this._meter(2, 0, delayMs * 1000);
+        return super.writeByte(cmd, byte, delayMs);
+    }
+
+    public async writeWord(cmd: number, word: number, delayMs: number = 0): Promise<void> {
+        this._meter(3, 0, delayMs * 1000);
+        return super.writeWord(cmd, word, delayMs);
+    }
+
+    public async readBlock(cmd: number, length: number): Promise<Buffer> {
+        this._meter(1, length, this._readDelayUs);
+        return super.readBlock(cmd, length);
+    }
+
+    public async writeBlock(cmd: number, data: Buffer, delayMs: number = 0): Promise<void> {
+        this._meter(1 + data.length, 0, delayMs * 1000);
+        return super.writeBlock(cmd, data, delayMs);
+    }
+
+    private _meter(bytesWritten: number, bytesRead: number, delayUs: number): void {
+        this._busTimeUs += estimateTransferUs(bytesWritten, bytesRead, delayUs);
+        this._transfers++;
+    }
+}
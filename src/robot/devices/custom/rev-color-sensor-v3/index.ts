@@ -1,8 +1,8 @@
 import { NetworkTableEntry } from "node-ntcore";
-import I2CPromisifiedBus from "../../../../device-interfaces/i2c/i2c-connection";
+import { QueuedI2CHandle } from "../../../../device-interfaces/i2c/queued-i2c-bus";
 import LogUtil from "../../../../utils/logging/log-util";
 import CustomDevice, { IOInterfaces, RobotHardwareInterfaces } from "../custom-device";
-import SimColorSensor from "./sim-color-sensor";
+import SimColorSensor, { ColorSensorChannel as Channel, NUM_COLOR_SENSOR_CHANNELS } from "./sim-color-sensor";
 
 /**
  * Implementation Note
@@ -10,7 +10,9 @@ import SimColorSensor from "./sim-color-sensor";
  * This implementation copies a lot from REV's Java API
  * https://github.com/REVrobotics/Color-Sensor-v3/blob/master/src/main/java/com/revrobotics/ColorSensorV3.java
  *
- * Specifically around the I2C reads.
+ * Specifically around the I2C reads. Where that reads each data register
+ * separately, we check MAIN_STATUS for new data first, and then pull all of
+ * the data registers in a single block read.
  *
  * It is currently not 100% feature complete (we don't allow configuration changes
  * just yet) but works decently well as is.
@@ -21,6 +23,12 @@ const DEVICE_IDENT: string = "REV-ColorSensorV3";
 const I2C_ADDRESS = 0x52;
 const PART_IDENT = 0xC2;
 
+// The proximity sensor is set to measure every 100ms in _initializeDevice(),
+// which is also the color sensor's default. Updates only read the data
+// registers when there's a new measurement, so checking twice as often
+// catches each one soon after it lands, without missing any
+const UPDATE_RATE_HZ: number = 20;
+
 enum Register {
     MAIN_CTRL = 0x00,
     PROX_SENSOR_LED = 0x01,
@@ -37,6 +45,21 @@ enum Register {
     DATA_RED = 0x13
 }
 
+// MAIN_STATUS flags. The data flags are cleared when MAIN_STATUS is read
+enum MainStatus {
+    PROX_DATA_READY = 0x01,
+    PROX_INTERRUPT = 0x02,
+    PROX_LOGIC = 0x04,
+    LIGHT_DATA_READY = 0x08,
+    LIGHT_INTERRUPT = 0x10,
+    POWER_ON = 0x20
+}
+
+// The data registers run on from PROX_DATA to the end of DATA_RED, so
+// they can all be read in one go
+const DATA_BLOCK_START: number = Register.PROX_DATA;
+const DATA_BLOCK_LENGTH: number = Register.DATA_RED + 3 - Register.PROX_DATA;
+
 enum MainControl {
     RGB_MODE = 0x04, // If bit is set to 1, color channels are activated
     LIGHT_SENSOR_ENABLE = 0x02,
@@ -116,14 +139,11 @@ export interface RevColorSensorConfig {
 
 export default class RevColorSensorV3 extends CustomDevice {
     private _config: RevColorSensorConfig;
-    private _i2cBus: I2CPromisifiedBus;
-
-    private _lastRed: number = 0;
-    private _lastBlue: number = 0;
-    private _lastGreen: number = 0;
-    private _lastIR: number = 0;
+    private _i2cHandle: QueuedI2CHandle;
 
-    private _lastProx: number = 0;
+    // Latest values, by Channel
+    private _values: Uint32Array = new Uint32Array(NUM_COLOR_SENSOR_CHANNELS);
+    private _isInitialized: boolean = false;
 
     private _simDevice: SimColorSensor;
 
@@ -137,7 +157,7 @@ export default class RevColorSensorV3 extends CustomDevice {
         super(DEVICE_IDENT, true, robotHW, true);
 
         this._config = config;
-        this._i2cBus = robotHW.i2cBus.rawBus;
+        this._i2cHandle = this.getI2CHandle(I2C_ADDRESS);
 
         // Set up NT entries
         if (this.networkTable) {
@@ -159,8 +179,14 @@ export default class RevColorSensorV3 extends CustomDevice {
                 return this._initializeDevice()
                 .then(() => {
                     return this.hasReset();
+                })
+                .then(() => {
+                    this._isInitialized = true;
                 });
             }
+        })
+        .catch(err => {
+            logger.error("Failed to initialize REV Color Sensor: " + err);
         });
     }
 
@@ -171,28 +197,50 @@ export default class RevColorSensorV3 extends CustomDevice {
         };
     }
 
+    public get updateRateHz(): number {
+        return UPDATE_RATE_HZ;
+    }
+
     public async update(): Promise<void> {
-        this._lastRed = await this._read20BitRegister(Register.DATA_RED);
-        this._lastGreen = await this._read20BitRegister(Register.DATA_GREEN);
-        this._lastBlue = await this._read20BitRegister(Register.DATA_BLUE);
-        this._lastIR = await this._read20BitRegister(Register.DATA_INFRARED);
+        // Nothing to read until the sensor has been set up
+        if (!this._isInitialized) {
+            return;
+        }
 
-        this._lastProx = await this._read11BitRegister(Register.PROX_DATA);
+        // Only pull the data registers if there's been a new measurement
+        // since we last looked
+        const status = await this._readByte(Register.MAIN_STATUS);
+        const newProx = (status & MainStatus.PROX_DATA_READY) !== 0;
+        const newColor = (status & MainStatus.LIGHT_DATA_READY) !== 0;
 
-        // Update the SimDevice
-        this._simDevice.red = this._lastRed;
-        this._simDevice.green = this._lastGreen;
-        this._simDevice.blue = this._lastBlue;
-        this._simDevice.infrared = this._lastIR;
-        this._simDevice.proximity = this._lastProx;
+        if (!newProx && !newColor) {
+            return;
+        }
 
-        // Also update the NT Interface
-        if (this.networkTable) {
-            this._ntEntryRed.setDouble(this._lastRed);
-            this._ntEntryGreen.setDouble(this._lastGreen);
-            this._ntEntryBlue.setDouble(this._lastBlue);
-            this._ntEntryIR.setDouble(this._lastIR);
-            this._ntEntryProx.setDouble(this._lastProx);
+        const data = await this._i2cHandle.readBlock(DATA_BLOCK_START, DATA_BLOCK_LENGTH);
+
+        if (newProx) {
+            this._values[Channel.PROXIMITY] = this._decode11Bit(data, Register.PROX_DATA);
+            this._simDevice.updateProximity(this._values);
+
+            if (this.networkTable) {
+                this._ntEntryProx.setDouble(this._values[Channel.PROXIMITY]);
+            }
+        }
+
+        if (newColor) {
+            this._values[Channel.IR] = this._decode20Bit(data, Register.DATA_INFRARED);
+            this._values[Channel.GREEN] = this._decode20Bit(data, Register.DATA_GREEN);
+            this._values[Channel.BLUE] = this._decode20Bit(data, Register.DATA_BLUE);
+            this._values[Channel.RED] = this._decode20Bit(data, Register.DATA_RED);
+            this._simDevice.updateColor(this._values);
+
+            if (this.networkTable) {
+                this._ntEntryRed.setDouble(this._values[Channel.RED]);
+                this._ntEntryGreen.setDouble(this._values[Channel.GREEN]);
+                this._ntEntryBlue.setDouble(this._values[Channel.BLUE]);
+                this._ntEntryIR.setDouble(this._values[Channel.IR]);
+            }
         }
     }
 
@@ -224,28 +272,32 @@ export default class RevColorSensorV3 extends CustomDevice {
     }
 
     public getProximity(): number {
-        return this._lastProx;
+        return this._values[Channel.PROXIMITY];
     }
 
     public getRed(): number {
-        return this._lastRed;
+        return this._values[Channel.RED];
     }
 
     public getGreen(): number {
-        return this._lastGreen;
+        return this._values[Channel.GREEN];
     }
 
     public getBlue(): number {
-        return this._lastBlue;
+        return this._values[Channel.BLUE];
     }
 
     public getIR(): number {
-        return this._lastIR;
+        return this._values[Channel.IR];
     }
 
+    /**
+     * Note that this clears the data ready flags, so the next update will
+     * skip any measurement that was waiting to be read
+     */
     public async hasReset(): Promise<boolean> {
         const value = await this._readByte(Register.MAIN_STATUS);
-        return (value & 0x20) !== 0;
+        return (value & MainStatus.POWER_ON) !== 0;
     }
 
     private async _checkDeviceID(): Promise<boolean> {
@@ -270,32 +322,22 @@ export default class RevColorSensorV3 extends CustomDevice {
         await this._writeByte(Register.PROX_SENSOR_PULSES, 32);
     }
 
-    private async _read11BitRegister(reg: Register): Promise<number> {
-        const buf = Buffer.alloc(2);
-        const offset = (reg as number);
-
-        buf[0] = await this._readByte(offset);
-        buf[1] = await this._readByte(offset + 1);
-
-        return buf.readUInt16LE() & 0x7FF;
+    // Decode a register from a block read of the data registers
+    private _decode11Bit(data: Buffer, reg: Register): number {
+        const offset = reg - DATA_BLOCK_START;
+        return (data[offset] | (data[offset + 1] << 8)) & 0x7FF;
     }
 
-    private async _read20BitRegister(reg: Register): Promise<number> {
-        const buf = Buffer.alloc(4);
-        const offset = (reg as number);
-
-        buf[0] = await this._readByte(offset);
-        buf[1] = await this._readByte(offset + 1);
-        buf[2] = await this._readByte(offset + 2);
-
-        return buf.readUInt32LE() & 0x03FFFF;
+    private _decode20Bit(data: Buffer, reg: Register): number {
+        const offset = reg - DATA_BLOCK_START;
+        return (data[offset] | (data[offset + 1] << 8) | (data[offset + 2] << 16)) & 0x03FFFF;
     }
 
     private async _writeByte(cmd: number, byte: number): Promise<void> {
-        return this._i2cBus.writeByte(I2C_ADDRESS, cmd, byte);
+        return this._i2cHandle.writeByte(cmd, byte);
     }
 
     private async _readByte(cmd: number): Promise<number> {
-        return this._i2cBus.readByte(I2C_ADDRESS, cmd);
+        return this._i2cHandle.readByte(cmd);
     }
 }
@@ -1,5 +1,16 @@
 import { SimDevice, FieldDirection } from "@wpilib/wpilib-ws-robot";
 
+// Where each value goes in a set of decoded readings
+export enum ColorSensorChannel {
+    PROXIMITY = 0,
+    IR = 1,
+    GREEN = 2,
+    BLUE = 3,
+    RED = 4
+}
+
+export const NUM_COLOR_SENSOR_CHANNELS: number = 5;
+
 export default class SimColorSensor extends SimDevice {
     constructor(portIdx: number, chIdx: number) {
         super("REV Color Sensor V3", portIdx, chIdx);
@@ -50,4 +61,20 @@ export default class SimColorSensor extends SimDevice {
     public get proximity(): number {
         return this.getValue("Proximity");
     }
+
+    /**
+     * Update the color fields from a set of decoded readings (indexed by
+     * ColorSensorChannel). Proximity is left alone, since the sensor
+     * measures it separately
+     */
+    public updateColor(values: Uint32Array): void {
+        this.red = values[ColorSensorChannel.RED];
+        this.green = values[ColorSensorChannel.GREEN];
+        this.blue = values[ColorSensorChannel.BLUE];
+        this.infrared = values[ColorSensorChannel.IR];
+    }
+
+    public updateProximity(values: Uint32Array): void {
+        this.proximity = values[ColorSensorChannel.PROXIMITY];
+    }
 }
@@ -0,0 +1,527 @@
+import { DigitalChannelMode } from "@wpilib/wpilib-ws-robot";
+import { NetworkTableInstance } from "node-ntcore";
+import I2CErrorDetector from "../../../../device-interfaces/i2c/i2c-error-detector";
+import { I2CPriority } from "../../../../device-interfaces/i2c/queued-i2c-bus";
+import LogUtil from "../../../../utils/logging/log-util";
+import { DEFAULT_POLLING_RATES_HZ } from "../../../polling-rates";
+import type { AnalogFilterConfig, SafeValue } from "../../../romi-config";
+import RomiDataBuffer, { FIRMWARE_IDENT, ShmemElementDefinition } from "../../../romi-shmem-buffer";
+import RomiCommandBlock, { analogFilterRegister, ANALOG_FULL_SCALE, COMMAND_BLOCK_START, DEFAULT_HEARTBEAT_TIMEOUT_MS, extIOConfigRegister, getTelemetryValue, isTelemetryBlockValid, lastStaleTelemetrySample, MIN_HEARTBEAT_TIMEOUT_MS, MODE_ANALOG_IN, MODE_DIGITAL_IN, MODE_DIGITAL_OUT, MODE_PWM, motorSlewRateRegister, onboardIOConfigRegister, safeValueRegister, TELEMETRY_BLOCK_LENGTH, TELEMETRY_BLOCK_START } from "../../../romi-shmem-protocol";
+import CustomDevice, { CustomDeviceEncoder, CustomDeviceUpdateStats, IOInterfaces, RobotHardwareInterfaces } from "../custom-device";
+import MeteredI2CHandle from "../metered-i2c-handle";
+
+/**
+ * Implementation Note
+ *
+ * This drives another Romi 32U4 board (running the same firmware, on an
+ * address of its own) on the same bus as the main one. It talks to the
+ * firmware through the same protocol as the robot (romi-shmem-protocol.ts):
+ * outputs go out in CRC protected command blocks, at actuation priority,
+ * and inputs come back in a single telemetry block read, at telemetry
+ * priority. Like the main board, its status byte is checked every so
+ * often, and if the board has browned out, its configuration and latest
+ * outputs are written again.
+ *
+ * The board's IO is numbered the same way as the main board's, starting
+ * from 0 on each of the device's ports:
+ * - DIO 0-3 are the buttons and LEDs, 4-7 the encoders, and 8 onwards
+ *   the external pins configured as DIO
+ * - PWM 0 and 1 are the left and right motors, and 2 onwards the external
+ *   pins configured as PWM
+ * - Analog inputs are the external pins configured as analog inputs
+ *
+ * The board's outputs are only kept alive by the robot's heartbeat, so
+ * its failsafe trips along with the main board's. Its heartbeat timeout
+ * shouldn't be shorter than the main board's, which sets how often
+ * heartbeats are sent.
+ */
+
+// Options with the same meaning as in the Romi configuration
+export interface RomiBoardConfig {
+    address: number;
+    ioConfig?: string[]; // External pin modes
+    analogFilters?: AnalogFilterConfig[];
+    motorSlewRate?: number;
+    heartbeatTimeoutMs?: number;
+    safeValues?: SafeValue[];
+}
+
+const logger = LogUtil.getLogger("ROMI-BOARD");
+
+type PinMode = "dio" | "ain" | "pwm";
+
+// Pin 0 has no analog input
+const PIN_MODES: PinMode[][] = [
+    ["dio", "pwm"],
+    ["dio", "pwm", "ain"],
+    ["dio", "pwm", "ain"],
+    ["dio", "pwm", "ain"],
+    ["dio", "pwm", "ain"]
+];
+
+const DEFAULT_IO_CONFIG: PinMode[] = ["dio", "ain", "ain", "pwm", "pwm"];
+
+const NUM_ONBOARD_DIO: number = 4;
+const FIRST_EXT_DIO_PORT: number = 8; // After the encoder channels
+const NUM_MOTORS: number = 2;
+
+const LEFT_ENCODER: number = 0;
+const RIGHT_ENCODER: number = 1;
+
+// Same as the main board
+const STATUS_CHECK_PERIOD_MS: number = 500;
+
+// Addresses the boards can be given, leaving out the reserved ones
+const MIN_ADDRESS: number = 0x08;
+const MAX_ADDRESS: number = 0x77;
+
+export default class RomiBoard extends CustomDevice {
+    private _address: number;
+
+    private _telemetryHandle: MeteredI2CHandle;
+    private _actuationHandle: MeteredI2CHandle;
+
+    // External pins behind each DIO, analog in and PWM port
+    private _extDioPins: number[] = [];
+    private _extAinPins: number[] = [];
+    private _extPwmPins: number[] = [];
+
+    private _onboardPinConfiguration: number[] = [MODE_DIGITAL_IN, MODE_DIGITAL_OUT, MODE_DIGITAL_OUT, MODE_DIGITAL_OUT];
+    private _extPinConfiguration: number[] = [];
+    private _analogFilterConfiguration: number[] = [];
+    private _motorSlewRate: number = 0;
+    private _heartbeatTimeoutMs: number = DEFAULT_HEARTBEAT_TIMEOUT_MS;
+    private _safeValues: SafeValue[] = [];
+
+    private _isReady: boolean = false;
+    private _readyP: Promise<void>;
+    private _lastStatusCheckTime: number = 0;
+
+    // Command blocks never stand in for a heartbeat here. The board only
+    // hears one when the main board does, through heartbeat()
+    private _commandBlock: RomiCommandBlock = new RomiCommandBlock(block => this._sendCommandBlock(block));
+
+    private _telemetryBlock: Buffer = Buffer.alloc(TELEMETRY_BLOCK_LENGTH);
+    private _hasTelemetry: boolean = false;
+    private _telemetrySampleCount: number = 0;
+
+    // Last telemetry sample that may predate each encoder's reset
+    // (Infinity while the reset is being written), as on the main board
+    private _encoderResetSamples: number[] = [-1, -1];
+    private _telemetryCrcErrors: number = 0;
+
+    // Failed transfers, which also go to the error detector, as on the
+    // main board
+    private _readErrors: number = 0;
+    private _writeErrors: number = 0;
+    private _i2cErrorDetector: I2CErrorDetector;
+    private _lastErrorCheckTime: number = 0;
+
+    constructor(robotHW: RobotHardwareInterfaces, config: RomiBoardConfig) {
+        super("romi-board", false, robotHW);
+
+        if (typeof config.address !== "number" || config.address < MIN_ADDRESS || config.address > MAX_ADDRESS) {
+            throw new Error(`Invalid Romi board address (${config.address})`);
+        }
+
+        this._address = config.address;
+        this._setupPins(config.ioConfig ? config.ioConfig as PinMode[] : DEFAULT_IO_CONFIG);
+
+        if (config.analogFilters) {
+            this._analogFilterConfiguration = config.analogFilters.slice(0, PIN_MODES.length).map(filterConfig => filterConfig ? analogFilterRegister(filterConfig) : 0);
+        }
+
+        if (config.motorSlewRate !== undefined) {
+            if (typeof config.motorSlewRate !== "number" || config.motorSlewRate < 0) {
+                throw new Error(`Invalid motor slew rate (${config.motorSlewRate}) for Romi board`);
+            }
+
+            this._motorSlewRate = config.motorSlewRate;
+        }
+
+        if (config.heartbeatTimeoutMs !== undefined) {
+            if (typeof config.heartbeatTimeoutMs !== "number" ||
+                config.heartbeatTimeoutMs < MIN_HEARTBEAT_TIMEOUT_MS ||
+                config.heartbeatTimeoutMs > 0xFFFF) {
+                throw new Error(`Invalid heartbeat timeout (${config.heartbeatTimeoutMs}) for Romi board`);
+            }
+
+            this._heartbeatTimeoutMs = Math.floor(config.heartbeatTimeoutMs);
+        }
+
+        if (config.safeValues) {
+            this._safeValues = config.safeValues;
+        }
+
+        this._i2cErrorDetector = new I2CErrorDetector(10, 500, 100, this.identifier);
+
+        this._telemetryHandle = this.getI2CHandle(this._address, true, I2CPriority.TELEMETRY);
+        this._actuationHandle = this.getI2CHandle(this._address, true, I2CPriority.ACTUATION);
+
+        this._readyP = this._configure();
+    }
+
+    public get identifier(): string {
+        return `romi-board-0x${this._address.toString(16)}`;
+    }
+
+    public get ioInterfaces(): IOInterfaces {
+        return {
+            numDioPorts: FIRST_EXT_DIO_PORT + this._extDioPins.length,
+            numAnalogInPorts: this._extAinPins.length,
+            numPwmOutPorts: NUM_MOTORS + this._extPwmPins.length
+        };
+    }
+
+    /**
+     * The board is read at the same rate as the main board's telemetry
+     */
+    public get updateRateHz(): number {
+        return DEFAULT_POLLING_RATES_HZ.encoders;
+    }
+
+    /**
+     * The board's encoders and command acknowledgements are control loop
+     * data, so its updates aren't slowed down by other custom devices
+     */
+    public get isEssential(): boolean {
+        return true;
+    }
+
+    public get address(): number {
+        return this._address;
+    }
+
+    public get telemetryCrcErrors(): number {
+        return this._telemetryCrcErrors;
+    }
+
+    public get readErrors(): number {
+        return this._readErrors;
+    }
+
+    public get writeErrors(): number {
+        return this._writeErrors;
+    }
+
+    /**
+     * Whether the board has had too many failed transfers lately
+     */
+    public get isErrorState(): boolean {
+        return this._i2cErrorDetector.isErrorState;
+    }
+
+    /**
+     * Resolves once the board has been configured
+     */
+    public get ready(): Promise<void> {
+        return this._readyP;
+    }
+
+    public async update(): Promise<void> {
+        if (!this._isReady) {
+            return;
+        }
+
+        const now = Date.now();
+        if (now - this._lastErrorCheckTime >= this._i2cErrorDetector.checkIntervalMs) {
+            this._lastErrorCheckTime = now;
+            this._i2cErrorDetector.check();
+        }
+
+        if (now - this._lastStatusCheckTime >= STATUS_CHECK_PERIOD_MS) {
+            this._lastStatusCheckTime = now;
+            await this.checkStatus();
+        }
+
+        let block: Buffer;
+        try {
+            block = await this._telemetryHandle.readBlock(TELEMETRY_BLOCK_START, TELEMETRY_BLOCK_LENGTH);
+        }
+        catch (err) {
+            this._hasTelemetry = false;
+            this._addReadError();
+            return;
+        }
+
+        // Keep the last good values rather than passing on bad ones
+        if (!isTelemetryBlockValid(block)) {
+            this._telemetryCrcErrors++;
+            return;
+        }
+
+        block.copy(this._telemetryBlock);
+        this._hasTelemetry = true;
+        this._telemetrySampleCount++;
+        this._commandBlock.checkAck(this._getTelemetryValue(RomiDataBuffer.commandAck));
+    }
+
+    /**
+     * The firmware sets the status byte once it has been configured, so a
+     * 0 means the board has reset (most likely a brown out). If so, write
+     * the configuration again, and the latest outputs, since the firmware
+     * starts up with everything stopped
+     */
+    public async checkStatus(): Promise<void> {
+        let status: number;
+        try {
+            status = await this._telemetryHandle.readByte(RomiDataBuffer.status.offset);
+        }
+        catch (err) {
+            this._addReadError();
+            return;
+        }
+
+        if (status !== 0) {
+            return;
+        }
+
+        logger.warn(`Status byte of ${this.identifier} is 0. Assuming brown out. Rewriting configuration`);
+        try {
+            await this._writeConfiguration();
+            await this._commandBlock.write();
+        }
+        catch (err) {
+            this._addWriteError();
+            logger.error(`Failed to reconfigure ${this.identifier}: ${err.message}`);
+        }
+    }
+
+    public heartbeat(): void {
+        if (!this._isReady) {
+            return;
+        }
+
+        this._actuationHandle.writeByte(RomiDataBuffer.heartbeat.offset, 1)
+        .catch(err => this._addWriteError());
+    }
+
+    /**
+     * Failed transfers and CRC errors go out with the update stats, so a
+     * board that has stopped responding shows up there
+     */
+    public publishUpdateStats(stats: CustomDeviceUpdateStats): void {
+        super.publishUpdateStats(stats);
+
+        const table = NetworkTableInstance.getDefault().getTable(`/Romi/CustomDevice/${this.identifier}`);
+        table.getEntry("Read Errors").setDouble(this._readErrors);
+        table.getEntry("Write Errors").setDouble(this._writeErrors);
+        table.getEntry("Telemetry CRC Errors").setDouble(this._telemetryCrcErrors);
+    }
+
+    // IO operations
+    public setDigitalChannelMode(channel: number, mode: DigitalChannelMode): void {
+        const channelMode = (mode === DigitalChannelMode.INPUT) ? MODE_DIGITAL_IN : MODE_DIGITAL_OUT;
+
+        // Button A is input only, and the yellow LED output only
+        if (channel === 1 || channel === 2) {
+            this._onboardPinConfiguration[channel] = channelMode;
+            this._writeOnboardIOConfiguration()
+            .catch(err => this._addWriteError());
+        }
+        else if (channel >= FIRST_EXT_DIO_PORT) {
+            const pin = this._extDioPins[channel - FIRST_EXT_DIO_PORT];
+            if (pin !== undefined) {
+                this._extPinConfiguration[pin] = channelMode;
+                this._writeExtIOConfiguration()
+                .catch(err => this._addWriteError());
+            }
+        }
+    }
+
+    public setDIOValue(channel: number, value: boolean): void {
+        if (channel >= 0 && channel < NUM_ONBOARD_DIO) {
+            this._actuationHandle.writeByte(RomiDataBuffer.builtinDioValues.offset + channel, value ? 1 : 0)
+            .catch(err => this._addWriteError());
+        }
+        else if (channel >= FIRST_EXT_DIO_PORT) {
+            const pin = this._extDioPins[channel - FIRST_EXT_DIO_PORT];
+            if (pin !== undefined) {
+                this._commandBlock.setValue(RomiDataBuffer.extIoOutputs, value ? 1 : 0, pin);
+            }
+        }
+    }
+
+    public setPWMValue(channel: number, value: number): void {
+        // We get the value in the range 0-255 but the romi
+        // expects -400 to 400
+        const romiValue = Math.floor(((value / 255) * 800) - 400);
+
+        if (channel === 0) {
+            this._commandBlock.setValue(RomiDataBuffer.leftMotor, romiValue);
+        }
+        else if (channel === 1) {
+            this._commandBlock.setValue(RomiDataBuffer.rightMotor, romiValue);
+        }
+        else {
+            const pin = this._extPwmPins[channel - NUM_MOTORS];
+            if (pin !== undefined) {
+                this._commandBlock.setValue(RomiDataBuffer.extIoOutputs, romiValue, pin);
+            }
+        }
+    }
+
+    public getAnalogInVoltage(channel: number): Promise<number> {
+        const pin = this._extAinPins[channel];
+        if (pin === undefined || !this._hasTelemetry) {
+            return Promise.resolve(0);
+        }
+
+        // 10-bit ADC value in 10.6 fixed point
+        const adcVal = this._getTelemetryValue(RomiDataBuffer.analog, pin);
+        return Promise.resolve((adcVal / ANALOG_FULL_SCALE) * 5.0);
+    }
+
+    public getDigitalInValue(channel: number): Promise<boolean> {
+        if (!this._hasTelemetry) {
+            return Promise.resolve(false);
+        }
+
+        if (channel >= 0 && channel < NUM_ONBOARD_DIO) {
+            const inputs = this._getTelemetryValue(RomiDataBuffer.builtinDioInputs);
+            return Promise.resolve(((inputs >> channel) & 0x1) !== 0);
+        }
+
+        const pin = this._extDioPins[channel - FIRST_EXT_DIO_PORT];
+        if (pin === undefined) {
+            return Promise.resolve(false);
+        }
+
+        return Promise.resolve(this._getTelemetryValue(RomiDataBuffer.extIoValues, pin) !== 0);
+    }
+
+    public getEncoder(channelA: number, channelB: number): CustomDeviceEncoder | undefined {
+        // Left encoder uses dio 4/5, right uses 6/7, as on the main board
+        if (channelA === 4 && channelB === 5) {
+            return { index: LEFT_ENCODER, reversed: false };
+        }
+        else if (channelA === 5 && channelB === 4) {
+            return { index: LEFT_ENCODER, reversed: true };
+        }
+        else if ((channelA === 6 && channelB === 7) || (channelA === 7 && channelB === 6)) {
+            return { index: RIGHT_ENCODER, reversed: false };
+        }
+
+        return undefined;
+    }
+
+    /**
+     * Until a sample taken after a reset comes in, the count is reported
+     * as the 0 it was reset to
+     */
+    public getEncoderCount(encoder: number): number {
+        if (!this._hasTelemetry || this._telemetrySampleCount <= this._encoderResetSamples[encoder]) {
+            return 0;
+        }
+
+        return this._getTelemetryValue(encoder === LEFT_ENCODER ? RomiDataBuffer.leftEncoder : RomiDataBuffer.rightEncoder);
+    }
+
+    public resetEncoder(encoder: number): void {
+        const offset = (encoder === LEFT_ENCODER) ? RomiDataBuffer.resetLeftEncoder.offset : RomiDataBuffer.resetRightEncoder.offset;
+        this._encoderResetSamples[encoder] = Infinity;
+
+        this._actuationHandle.writeByte(offset, 1)
+        .then(() => {
+            this._encoderResetSamples[encoder] = lastStaleTelemetrySample(this._telemetrySampleCount);
+        })
+        .catch(err => {
+            // The counter may or may not have been zeroed
+            this._encoderResetSamples[encoder] = -1;
+            this._addWriteError();
+        });
+    }
+
+    private _setupPins(ioConfig: PinMode[]): void {
+        if (ioConfig.length !== PIN_MODES.length) {
+            throw new Error(`Invalid number of pin modes for Romi board. Expected ${PIN_MODES.length} but got ${ioConfig.length}`);
+        }
+
+        ioConfig.forEach((mode, pin) => {
+            if (PIN_MODES[pin].indexOf(mode) < 0) {
+                throw new Error(`Invalid mode (${mode}) for pin ${pin} of Romi board`);
+            }
+
+            switch (mode) {
+                case "dio":
+                    // Default to OUTPUT for digital pins
+                    this._extPinConfiguration.push(MODE_DIGITAL_OUT);
+                    this._extDioPins.push(pin);
+                    break;
+                case "ain":
+                    this._extPinConfiguration.push(MODE_ANALOG_IN);
+                    this._extAinPins.push(pin);
+                    break;
+                case "pwm":
+                    this._extPinConfiguration.push(MODE_PWM);
+                    this._extPwmPins.push(pin);
+                    break;
+            }
+        });
+    }
+
+    private async _configure(): Promise<void> {
+        try {
+            const ident = await this._telemetryHandle.readByte(RomiDataBuffer.firmwareIdent.offset);
+            if (ident !== FIRMWARE_IDENT) {
+                logger.error(`Firmware Identifier Mismatch on ${this.identifier}. Expected ${FIRMWARE_IDENT} but got ${ident}`);
+            }
+
+            this._commandBlock.resumeFrom(await this._telemetryHandle.readByte(RomiDataBuffer.commandAck.offset));
+            await this._writeConfiguration();
+
+            this._isReady = true;
+        }
+        catch (err) {
+            logger.error(`Failed to configure ${this.identifier}: ${err.message}`);
+        }
+    }
+
+    private async _writeConfiguration(): Promise<void> {
+        await this._writeOnboardIOConfiguration();
+        await this._writeExtIOConfiguration();
+
+        for (let ioIdx = 0; ioIdx < this._analogFilterConfiguration.length; ioIdx++) {
+            await this._telemetryHandle.writeByte(RomiDataBuffer.analogConfig.offset + ioIdx, this._analogFilterConfiguration[ioIdx]);
+        }
+
+        await this._telemetryHandle.writeWord(RomiDataBuffer.motorSlewRate.offset, motorSlewRateRegister(this._motorSlewRate));
+        await this._telemetryHandle.writeWord(RomiDataBuffer.heartbeatTimeoutMs.offset, this._heartbeatTimeoutMs);
+
+        for (let ioIdx = 0; ioIdx < this._extPinConfiguration.length; ioIdx++) {
+            const romiValue = safeValueRegister(this._safeValues[ioIdx], this._extPinConfiguration[ioIdx]);
+            await this._telemetryHandle.writeWord(RomiDataBuffer.extIoSafeValues.offset + (ioIdx * 2), romiValue);
+        }
+    }
+
+    private async _writeOnboardIOConfiguration(): Promise<void> {
+        return this._telemetryHandle.writeByte(RomiDataBuffer.builtinConfig.offset, onboardIOConfigRegister(this._onboardPinConfiguration), 3);
+    }
+
+    private async _writeExtIOConfiguration(): Promise<void> {
+        return this._telemetryHandle.writeWord(RomiDataBuffer.ioConfig.offset, extIOConfigRegister(this._extPinConfiguration), 3);
+    }
+
+    private async _sendCommandBlock(block: Buffer): Promise<void> {
+        if (!this._isReady) {
+            return;
+        }
+
+        return this._actuationHandle.writeBlock(COMMAND_BLOCK_START, block)
+        .catch(err => this._addWriteError());
+    }
+
+    private _addReadError(): void {
+        this._readErrors++;
+        this._i2cErrorDetector.addErrorInstance();
+    }
+
+    private _addWriteError(): void {
+        this._writeErrors++;
+        this._i2cErrorDetector.addErrorInstance();
+    }
+
+    private _getTelemetryValue(field: ShmemElementDefinition, index: number = 0): number {
+        return getTelemetryValue(this._telemetryBlock, field, index);
+    }
+}
@@ -0,0 +1,237 @@
+/**
+ * Groups of values that can be polled at different rates
+ */
+export enum TelemetryClass {
+    ENCODERS = "encoders",
+    DIO = "dio",
+    ANALOG = "analog",
+    BATTERY = "battery",
+    IMU = "imu",
+    CUSTOM_DEVICES = "customDevices"
+}
+
+export const TELEMETRY_CLASSES: TelemetryClass[] = [
+    TelemetryClass.ENCODERS,
+    TelemetryClass.DIO,
+    TelemetryClass.ANALOG,
+    TelemetryClass.BATTERY,
+    TelemetryClass.IMU,
+    TelemetryClass.CUSTOM_DEVICES
+];
+
+export type PollingRates = { [C in TelemetryClass]: number };
+
+// Position of each class in the controller's per-class arrays
+const CLASS_INDEX: { [C in TelemetryClass]: number } = {
+    encoders: 0,
+    dio: 1,
+    analog: 2,
+    battery: 3,
+    imu: 4,
+    customDevices: 5
+};
+
+export const DEFAULT_POLLING_RATES_HZ: PollingRates = {
+    encoders: 20,
+    dio: 20,
+    analog: 20,
+    battery: 20,
+    imu: 100,
+    customDevices: 50
+};
+
+export const MIN_POLLING_RATE_HZ: number = 1;
+export const MAX_POLLING_RATE_HZ: number = 500;
+
+// Default fraction of bus time that polling is allowed to use
+export const DEFAULT_BUS_BUDGET: number = 0.5;
+
+// Default fraction of bus time that custom devices are allowed to use,
+// between them. This comes on top of the polling budget
+export const DEFAULT_CUSTOM_DEVICE_BUS_BUDGET: number = 0.2;
+
+// In adaptive mode, a class that hasn't been read for this long is
+// considered idle, and polled at a fraction of its configured rate
+const IDLE_TIMEOUT_MS: number = 2000;
+const IDLE_RATE_DIVISOR: number = 4;
+const MIN_IDLE_RATE_HZ: number = 2;
+
+// Assumed bus clock, used to estimate the cost of each transfer
+const I2C_BUS_SPEED_HZ: number = 400000;
+
+/**
+ * Rough bus time for a transfer, counting 9 clocks per byte (including
+ * the address byte of each message) plus any enforced delays
+ */
+export function estimateTransferUs(bytesWritten: number, bytesRead: number, delayUs: number = 0): number {
+    const numBytes = (bytesWritten > 0 ? bytesWritten + 1 : 0) + (bytesRead > 0 ? bytesRead + 1 : 0);
+    return ((numBytes * 9 * 1e6) / I2C_BUS_SPEED_HZ) + delayUs;
+}
+
+export interface PollingClassStats {
+    rateHz: number;
+    active: boolean;
+}
+
+export interface PollingStats {
+    classes: { [C in TelemetryClass]: PollingClassStats };
+    busUtilization: number;
+    budgetScale: number;
+}
+
+interface BusTransfer {
+    classes: TelemetryClass[];
+    costUs: number;
+}
+
+/**
+ * Works out how often each class of telemetry should be polled
+ *
+ * Each class has a configured rate. In adaptive mode, classes that the
+ * robot program hasn't read recently drop to a fraction of that rate. If
+ * the resulting bus traffic would take more than the budgeted fraction of
+ * bus time, every class is slowed down by the same factor to fit
+ */
+export default class PollingRateController {
+    private _configuredRates: PollingRates;
+    private _adaptive: boolean;
+    private _busBudget: number;
+
+    // Per-class state is indexed by CLASS_INDEX. These are read on every
+    // poll, so they're kept in typed arrays rather than maps of boxed numbers
+    private _transfers: BusTransfer[] = [];
+    private _lastAccessTime: Float64Array = new Float64Array(TELEMETRY_CLASSES.length).fill(-1);
+    private _accessedSinceUpdate: Uint8Array = new Uint8Array(TELEMETRY_CLASSES.length);
+    private _periodsMs: Float64Array = new Float64Array(TELEMETRY_CLASSES.length);
+    private _active: Uint8Array = new Uint8Array(TELEMETRY_CLASSES.length);
+    private _busUtilization: number = 0;
+    private _budgetScale: number = 1;
+
+    constructor(rates: PollingRates = DEFAULT_POLLING_RATES_HZ, adaptive: boolean = false, busBudget: number = DEFAULT_BUS_BUDGET) {
+        this._configuredRates = { ...rates };
+        this._adaptive = adaptive;
+        this._busBudget = busBudget;
+
+        this.update();
+    }
+
+    public get adaptive(): boolean {
+        return this._adaptive;
+    }
+
+    /**
+     * Register a bus transfer that is made each time any of the given
+     * classes is polled (classes sharing a transfer are polled together,
+     * at the fastest of their rates)
+     * @param costUs Estimated bus time for one transfer
+     */
+    public addTransfer(classes: TelemetryClass[], costUs: number): void {
+        this._transfers.push({ classes, costUs });
+        this.update();
+    }
+
+    /**
+     * Note that the robot program has read a value from this class. This
+     * runs on every read, so without a time it just sets a flag, and the
+     * next update() fills in the time (reading the clock here would
+     * allocate a boxed number on every call)
+     * @param now Time of the access, if the caller already has it
+     */
+    public markAccessed(telemetryClass: TelemetryClass, now?: number): void {
+        const idx = CLASS_INDEX[telemetryClass];
+        if (now === undefined) {
+            this._accessedSinceUpdate[idx] = 1;
+        }
+        else {
+            this._lastAccessTime[idx] = now;
+        }
+    }
+
+    /**
+     * Current polling period for a class
+     */
+    public periodMs(telemetryClass: TelemetryClass): number {
+        return this._periodsMs[CLASS_INDEX[telemetryClass]];
+    }
+
+    /**
+     * Current polling period for a set of classes sharing a transfer
+     */
+    public sharedPeriodMs(classes: TelemetryClass[]): number {
+        return this._sharedPeriodMs(this._periodsMs, classes);
+    }
+
+    public get stats(): PollingStats {
+        const classes: { [C in TelemetryClass]?: PollingClassStats } = {};
+        TELEMETRY_CLASSES.forEach(telemetryClass => {
+            classes[telemetryClass] = {
+                rateHz: 1000 / this.periodMs(telemetryClass),
+                active: this._active[CLASS_INDEX[telemetryClass]] !== 0
+            };
+        });
+
+        return {
+            classes: classes as { [C in TelemetryClass]: PollingClassStats },
+            busUtilization: this._busUtilization,
+            budgetScale: this._budgetScale
+        };
+    }
+
+    /**
+     * Recalculate the polling periods. This should be called periodically
+     * in adaptive mode, so that idle classes get backed off
+     */
+    public update(now: number = Date.now()): void {
+        const periods = this._periodsMs;
+
+        for (let idx = 0; idx < TELEMETRY_CLASSES.length; idx++) {
+            let rateHz = this._configuredRates[TELEMETRY_CLASSES[idx]];
+            let active = true;
+
+            if (this._accessedSinceUpdate[idx]) {
+                this._lastAccessTime[idx] = now;
+                this._accessedSinceUpdate[idx] = 0;
+            }
+
+            if (this._adaptive) {
+                const lastAccess = this._lastAccessTime[idx];
+                active = lastAccess >= 0 && (now - lastAccess) < IDLE_TIMEOUT_MS;
+
+                if (!active) {
+                    rateHz = Math.min(rateHz, Math.max(rateHz / IDLE_RATE_DIVISOR, MIN_IDLE_RATE_HZ));
+                }
+            }
+
+            this._active[idx] = active ? 1 : 0;
+            periods[idx] = 1000 / rateHz;
+        }
+
+        // Fit everything into the bus budget
+        const utilization = this._calculateUtilization(periods);
+        this._budgetScale = utilization > this._busBudget ? utilization / this._busBudget : 1;
+        for (let idx = 0; idx < periods.length; idx++) {
+            periods[idx] *= this._budgetScale;
+        }
+
+        this._busUtilization = this._calculateUtilization(periods);
+    }
+
+    private _sharedPeriodMs(periods: Float64Array, classes: TelemetryClass[]): number {
+        let periodMs = Infinity;
+        for (let i = 0; i < classes.length; i++) {
+            periodMs = Math.min(periodMs, periods[CLASS_INDEX[classes[i]]]);
+        }
+
+        return periodMs;
+    }
+
+    private _calculateUtilization(periods: Float64Array): number {
+        let total = 0;
+        for (let i = 0; i < this._transfers.length; i++) {
+            const transfer = this._transfers[i];
+            total += transfer.costUs / (this._sharedPeriodMs(periods, transfer.classes) * 1000);
+        }
+
+        return total;
+    }
+}
@@ -1,5 +1,5 @@
 import { RobotAccelerometer } from "@wpilib/wpilib-ws-robot";
-import LSM6, { FIFOFrame } from "./devices/core/lsm6/lsm6";
+import LSM6, { FIFOFrames } from "./devices/core/lsm6/lsm6";
 import { AccelerometerScale } from "./devices/core/lsm6/lsm6-settings";
 
 export default class RomiAccelerometer extends RobotAccelerometer {
@@ -32,17 +32,17 @@ export default class RomiAccelerometer extends RobotAccelerometer {
         this._lsm6.setAccelerometerScale(this._sensitivity);
     }
 
-    public updateFromFrames(buffer: FIFOFrame[], dt: number): void {
-        if (buffer.length === 0) {
+    public updateFromFrames(frames: FIFOFrames, dt: number): void {
+        if (frames.length === 0) {
             return;
         }
 
         // Update to the latest frame's data
-        const frame = buffer[buffer.length - 1];
+        const latest = frames.length - 1;
 
         // These follow NED conventions
-        this.accelX = -frame.accelX;
-        this.accelY = frame.accelY;
-        this.accelZ = frame.accelZ;
+        this.accelX = -frames.accelX(latest);
+        this.accelY = frames.accelY(latest);
+        this.accelZ = frames.accelZ(latest);
     }
 }
@@ -2,19 +2,56 @@ import { NUM_CONFIGURABLE_PINS } from "./romi-robot";
 import jsonfile from "jsonfile";
 import ProgramArguments from "../program-arguments";
 import { Vector3 } from "./devices/core/lsm6/lsm6";
+import { DEFAULT_BUS_BUDGET, DEFAULT_CUSTOM_DEVICE_BUS_BUDGET, DEFAULT_POLLING_RATES_HZ, MAX_POLLING_RATE_HZ, MIN_POLLING_RATE_HZ, PollingRates, TelemetryClass } from "./polling-rates";
+import { DEFAULT_MADGWICK_BETA } from "../utils/fusion/madgwick-ahrs";
+import { DEFAULT_HEARTBEAT_TIMEOUT_MS, MIN_HEARTBEAT_TIMEOUT_MS } from "./romi-shmem-protocol";
 
 export interface CustomDeviceSpec {
     type: string;
     config?: any;
+    rateHz?: number; // Overrides the rate the device asks to be updated at
+}
+
+export interface AnalogFilterConfig {
+    oversampleBits?: number; // Oversample by 4^n and decimate, adding n bits of resolution (0-3)
+    filterShift?: number; // IIR filter strength, y += (x - y) / 2^n (0 disables, 1-7)
 }
 
 export interface RomiConfigJson {
+    i2cAddress?: number; // Of the main Romi board, if it has been moved (see firmware/include/i2c_address.h)
     ioConfig: string[];
     gyroZeroOffset: Vector3;
     gyroFilterWindowSize?: number;
+    imuFusionGain?: number; // Madgwick filter beta
+    gyroBiasTracking?: boolean; // Refine the gyro offset whenever the robot is still
+    analogFilters?: AnalogFilterConfig[];
+    motorSlewRate?: number;
+    heartbeatTimeoutMs?: number;
+    safeValues?: SafeValue[];
+    pollingRates?: Partial<PollingRates>; // Hz, per telemetry class
+    adaptivePolling?: boolean;
+    busBudget?: number; // Fraction of bus time available for polling (0-1)
     customDevices?: CustomDeviceSpec[];
+    customDeviceBusBudget?: number; // Fraction of bus time available to custom devices (0-1)
 }
 
+/**
+ * Value an external output switches to when the firmware loses the heartbeat
+ * true/false (or 1/0) for DIO, -1.0 to 1.0 for PWM. null holds the last value
+ */
+export type SafeValue = number | boolean | null;
+
+export const DEFAULT_ROMI_I2C_ADDRESS: number = 0x14;
+
+// 7-bit addresses, leaving out the reserved ones
+export const MIN_I2C_ADDRESS: number = 0x08;
+export const MAX_I2C_ADDRESS: number = 0x77;
+
+export { MIN_HEARTBEAT_TIMEOUT_MS, DEFAULT_HEARTBEAT_TIMEOUT_MS };
+
+export const MAX_ANALOG_OVERSAMPLE_BITS: number = 3;
+export const MAX_ANALOG_FILTER_SHIFT: number = 7;
+
 export enum IOPinMode {
     DIO = "dio",
     ANALOG_IN = "ain",
@@ -38,11 +75,22 @@ export const DEFAULT_IO_CONFIGURATION: PinConfiguration[] = [
 ];
 
 export default class RomiConfiguration {
+    private _i2cAddress: number = DEFAULT_ROMI_I2C_ADDRESS;
     private _extIOConfig: PinConfiguration[] = [];
     private _gyroZeroOffset: Vector3 = { x: 0, y: 0, z: 0};
 
     private _gyroFilterWindowSize: number = 5;
+    private _imuFusionGain: number = DEFAULT_MADGWICK_BETA;
+    private _gyroBiasTracking: boolean = true;
+    private _analogFilters: AnalogFilterConfig[] = [];
+    private _motorSlewRate: number = 0;
+    private _heartbeatTimeoutMs: number = DEFAULT_HEARTBEAT_TIMEOUT_MS;
+    private _safeValues: SafeValue[] = [];
+    private _pollingRates: PollingRates = { ...DEFAULT_POLLING_RATES_HZ };
+    private _adaptivePolling: boolean = false;
+    private _busBudget: number = DEFAULT_BUS_BUDGET;
     private _customDevices: CustomDeviceSpec[] = [];
+    private _customDeviceBusBudget: number = DEFAULT_CUSTOM_DEVICE_BUS_BUDGET;
 
     constructor(programArgs?: ProgramArguments) {
         // Pre-load the external IO configuration
@@ -55,6 +103,15 @@ export default class RomiConfiguration {
                 const romiConfig: RomiConfigJson = jsonfile.readFileSync(programArgs.config);
 
                 if (romiConfig) {
+                    if (romiConfig.i2cAddress !== undefined) {
+                        if (typeof romiConfig.i2cAddress !== "number" || romiConfig.i2cAddress < MIN_I2C_ADDRESS || romiConfig.i2cAddress > MAX_I2C_ADDRESS) {
+                            isConfigError = true;
+                            throw new Error(`[CONFIG] Invalid i2cAddress. Must be between ${MIN_I2C_ADDRESS} and ${MAX_I2C_ADDRESS}`);
+                        }
+
+                        this._i2cAddress = romiConfig.i2cAddress;
+                    }
+
                     if (romiConfig.ioConfig) {
                         if (!(romiConfig.ioConfig instanceof Array)) {
                             isConfigError = true;
@@ -100,9 +157,146 @@ export default class RomiConfiguration {
                         this._gyroFilterWindowSize = romiConfig.gyroFilterWindowSize;
                     }
 
+                    if (romiConfig.imuFusionGain !== undefined) {
+                        if (typeof romiConfig.imuFusionGain !== "number" || romiConfig.imuFusionGain < 0) {
+                            isConfigError = true;
+                            throw new Error("[CONFIG] Invalid imuFusionGain. Must be 0 or greater");
+                        }
+
+                        this._imuFusionGain = romiConfig.imuFusionGain;
+                    }
+
+                    if (romiConfig.gyroBiasTracking !== undefined) {
+                        this._gyroBiasTracking = !!romiConfig.gyroBiasTracking;
+                    }
+
+                    if (romiConfig.analogFilters) {
+                        if (!(romiConfig.analogFilters instanceof Array) || romiConfig.analogFilters.length > NUM_CONFIGURABLE_PINS) {
+                            isConfigError = true;
+                            throw new Error("[CONFIG] Invalid analog filter configuration");
+                        }
+
+                        romiConfig.analogFilters.forEach((filterConfig, idx) => {
+                            if (!filterConfig) {
+                                return;
+                            }
+
+                            const oversampleBits = filterConfig.oversampleBits || 0;
+                            const filterShift = filterConfig.filterShift || 0;
+
+                            if (oversampleBits < 0 || oversampleBits > MAX_ANALOG_OVERSAMPLE_BITS) {
+                                isConfigError = true;
+                                throw new Error(`[CONFIG] Invalid oversampleBits for pin EXT ${idx}. Must be between 0 and ${MAX_ANALOG_OVERSAMPLE_BITS}`);
+                            }
+
+                            if (filterShift < 0 || filterShift > MAX_ANALOG_FILTER_SHIFT) {
+                                isConfigError = true;
+                                throw new Error(`[CONFIG] Invalid filterShift for pin EXT ${idx}. Must be between 0 and ${MAX_ANALOG_FILTER_SHIFT}`);
+                            }
+                        });
+
+                        this._analogFilters = romiConfig.analogFilters;
+                    }
+
+                    if (romiConfig.motorSlewRate !== undefined) {
+                        if (typeof romiConfig.motorSlewRate !== "number" || romiConfig.motorSlewRate < 0) {
+                            isConfigError = true;
+                            throw new Error("[CONFIG] Invalid motorSlewRate. Must be a non-negative number");
+                        }
+
+                        this._motorSlewRate = romiConfig.motorSlewRate;
+                    }
+
+                    if (romiConfig.heartbeatTimeoutMs !== undefined) {
+                        if (typeof romiConfig.heartbeatTimeoutMs !== "number" ||
+                            romiConfig.heartbeatTimeoutMs < MIN_HEARTBEAT_TIMEOUT_MS ||
+                            romiConfig.heartbeatTimeoutMs > 0xFFFF) {
+                            isConfigError = true;
+                            throw new Error(`[CONFIG] Invalid heartbeatTimeoutMs. Must be between ${MIN_HEARTBEAT_TIMEOUT_MS} and 65535`);
+                        }
+
+                        this._heartbeatTimeoutMs = Math.floor(romiConfig.heartbeatTimeoutMs);
+                    }
+
+                    if (romiConfig.safeValues) {
+                        if (!(romiConfig.safeValues instanceof Array) || romiConfig.safeValues.length > NUM_CONFIGURABLE_PINS) {
+                            isConfigError = true;
+                            throw new Error("[CONFIG] Invalid safe value configuration");
+                        }
+
+                        romiConfig.safeValues.forEach((safeValue, idx) => {
+                            if (typeof safeValue === "number" && (safeValue < -1 || safeValue > 1)) {
+                                isConfigError = true;
+                                throw new Error(`[CONFIG] Invalid safe value for pin EXT ${idx}. Must be between -1.0 and 1.0`);
+                            }
+                        });
+
+                        this._safeValues = romiConfig.safeValues;
+                    }
+
+                    if (romiConfig.pollingRates) {
+                        Object.keys(romiConfig.pollingRates).forEach((key: string) => {
+                            const rateHz: number = (romiConfig.pollingRates as any)[key];
+
+                            if (!(key in DEFAULT_POLLING_RATES_HZ)) {
+                                isConfigError = true;
+                                throw new Error(`[CONFIG] Unknown polling rate class ${key}`);
+                            }
+
+                            if (typeof rateHz !== "number" || rateHz < MIN_POLLING_RATE_HZ || rateHz > MAX_POLLING_RATE_HZ) {
+                                isConfigError = true;
+                                throw new Error(`[CONFIG] Invalid polling rate for ${key}. Must be between ${MIN_POLLING_RATE_HZ} and ${MAX_POLLING_RATE_HZ} Hz`);
+                            }
+
+                            this._pollingRates[key as TelemetryClass] = rateHz;
+                        });
+                    }
+
+                    if (romiConfig.adaptivePolling !== undefined) {
+                        this._adaptivePolling = !!romiConfig.adaptivePolling;
+                    }
+
+                    if (romiConfig.busBudget !== undefined) {
+                        if (typeof romiConfig.busBudget !== "number" || romiConfig.busBudget <= 0 || romiConfig.busBudget > 1) {
+                            isConfigError = true;
+                            throw new Error("[CONFIG] Invalid busBudget. Must be greater than 0 and at most 1");
+                        }
+
+                        this._busBudget = romiConfig.busBudget;
+                    }
+
                     if (romiConfig.customDevices) {
+                        // Every Romi board on the bus needs an address of its own
+                        const romiAddresses: Set<number> = new Set<number>([this._i2cAddress]);
+
+                        romiConfig.customDevices.forEach(deviceSpec => {
+                            if (deviceSpec.type === "romi-board" && deviceSpec.config) {
+                                if (romiAddresses.has(deviceSpec.config.address)) {
+                                    isConfigError = true;
+                                    throw new Error(`[CONFIG] Romi board address ${deviceSpec.config.address} is already in use`);
+                                }
+
+                                romiAddresses.add(deviceSpec.config.address);
+                            }
+
+                            if (deviceSpec.rateHz !== undefined &&
+                                (typeof deviceSpec.rateHz !== "number" || deviceSpec.rateHz < MIN_POLLING_RATE_HZ || deviceSpec.rateHz > MAX_POLLING_RATE_HZ)) {
+                                isConfigError = true;
+                                throw new Error(`[CONFIG] Invalid rateHz for custom device ${deviceSpec.type}. Must be between ${MIN_POLLING_RATE_HZ} and ${MAX_POLLING_RATE_HZ} Hz`);
+                            }
+                        });
+
                         this._customDevices = romiConfig.customDevices;
                     }
+
+                    if (romiConfig.customDeviceBusBudget !== undefined) {
+                        if (typeof romiConfig.customDeviceBusBudget !== "number" || romiConfig.customDeviceBusBudget <= 0 || romiConfig.customDeviceBusBudget > 1) {
+                            isConfigError = true;
+                            throw new Error("[CONFIG] Invalid customDeviceBusBudget. Must be greater than 0 and at most 1");
+                        }
+
+                        this._customDeviceBusBudget = romiConfig.customDeviceBusBudget;
+                    }
                 }
                 else {
                     isConfigError = true;
@@ -120,6 +314,14 @@ export default class RomiConfiguration {
         }
     }
 
+    public get i2cAddress(): number {
+        return this._i2cAddress;
+    }
+
+    public set i2cAddress(val: number) {
+        this._i2cAddress = val;
+    }
+
     public get externalIOConfig(): PinConfiguration[] {
         return this._extIOConfig;
     }
@@ -136,6 +338,22 @@ export default class RomiConfiguration {
         this._gyroZeroOffset = val;
     }
 
+    public get imuFusionGain(): number {
+        return this._imuFusionGain;
+    }
+
+    public set imuFusionGain(val: number) {
+        this._imuFusionGain = val;
+    }
+
+    public get gyroBiasTracking(): boolean {
+        return this._gyroBiasTracking;
+    }
+
+    public set gyroBiasTracking(val: boolean) {
+        this._gyroBiasTracking = val;
+    }
+
     public get gyroFilterWindowSize(): number {
         return this._gyroFilterWindowSize;
     }
@@ -144,6 +362,66 @@ export default class RomiConfiguration {
         this._gyroFilterWindowSize = val;
     }
 
+    public get analogFilters(): AnalogFilterConfig[] {
+        return this._analogFilters;
+    }
+
+    public set analogFilters(val: AnalogFilterConfig[]) {
+        this._analogFilters = val;
+    }
+
+    /**
+     * Maximum change in motor output per second, as a fraction of full
+     * scale (e.g. 4 means 0 to full speed in 250ms). 0 disables slew limiting
+     */
+    public get motorSlewRate(): number {
+        return this._motorSlewRate;
+    }
+
+    public set motorSlewRate(val: number) {
+        this._motorSlewRate = val;
+    }
+
+    public get heartbeatTimeoutMs(): number {
+        return this._heartbeatTimeoutMs;
+    }
+
+    public set heartbeatTimeoutMs(val: number) {
+        this._heartbeatTimeoutMs = val;
+    }
+
+    public get safeValues(): SafeValue[] {
+        return this._safeValues;
+    }
+
+    public set safeValues(val: SafeValue[]) {
+        this._safeValues = val;
+    }
+
+    public get pollingRates(): PollingRates {
+        return this._pollingRates;
+    }
+
+    public set pollingRates(val: PollingRates) {
+        this._pollingRates = val;
+    }
+
+    public get adaptivePolling(): boolean {
+        return this._adaptivePolling;
+    }
+
+    public set adaptivePolling(val: boolean) {
+        this._adaptivePolling = val;
+    }
+
+    public get busBudget(): number {
+        return this._busBudget;
+    }
+
+    public set busBudget(val: number) {
+        this._busBudget = val;
+    }
+
     public get pinConfigurationString(): string {
         return this._extIOConfig.map((val, idx) => {
             return `EXT${idx}(${val.mode})`;
@@ -158,4 +436,12 @@ export default class RomiConfiguration {
     public get customDevices(): CustomDeviceSpec[] {
         return this._customDevices;
     }
+
+    public get customDeviceBusBudget(): number {
+        return this._customDeviceBusBudget;
+    }
+
+    public set customDeviceBusBudget(val: number) {
+        this._customDeviceBusBudget = val;
+    }
 }
@@ -1,5 +1,6 @@
 import { RobotGyro } from "@wpilib/wpilib-ws-robot";
-import LSM6, { FIFOFrame, Vector3 } from "./devices/core/lsm6/lsm6";
+import LSM6, { FIFOFrames, Vector3 } from "./devices/core/lsm6/lsm6";
+import { FIFOFrameValue } from "./devices/core/lsm6/lsm6-fifo-buffer";
 import SimpleMovingAverage from "../utils/filters/simple-moving-average";
 import StreamFilter from "../utils/filters/stream-filter";
 import PassThroughFilter from "../utils/filters/pass-through";
@@ -21,6 +22,12 @@ export default class RomiGyro extends RobotGyro {
     private _rateYFilter: StreamFilter;
     private _rateZFilter: StreamFilter;
 
+    // Scratch space for filtering each axis of a FIFO drain in one go.
+    // This only grows, so steady state reads don't allocate
+    private _rateX: Float64Array = new Float64Array(32);
+    private _rateY: Float64Array = new Float64Array(32);
+    private _rateZ: Float64Array = new Float64Array(32);
+
     constructor(lsm6: LSM6, filterWindow: number = SMA_WINDOW_SIZE) {
         super("RomiGyro");
 
@@ -55,29 +62,48 @@ export default class RomiGyro extends RobotGyro {
         return this._filterWindow;
     }
 
-    public updateFromFrames(buffer: FIFOFrame[], dt: number): void {
-        if (buffer.length === 0) {
+    public updateFromFrames(frames: FIFOFrames, dt: number): void {
+        if (frames.length === 0) {
             return;
         }
 
-        buffer.forEach(frame => {
-            const gyroRateX = this._rateXFilter.getValue(frame.gyroX);
-            const gyroRateY = this._rateYFilter.getValue(-frame.gyroY);
-            const gyroRateZ = this._rateZFilter.getValue(-frame.gyroZ);
-
-            this.rateX = gyroRateX;
-            this.rateY = gyroRateY;
-            this.rateZ = gyroRateZ;
-
-            this._angle.x = this._angle.x + (dt * gyroRateX);
-            this._angle.y = this._angle.y + (dt * gyroRateY);
-            this._angle.z = this._angle.z + (dt * gyroRateZ);
+        const numFrames = frames.length;
+        if (numFrames > this._rateX.length) {
+            this._rateX = new Float64Array(numFrames);
+            this._rateY = new Float64Array(numFrames);
+            this._rateZ = new Float64Array(numFrames);
+        }
 
-            // Set the angles
-            this.angleX = this._angle.x;
-            this.angleY = this._angle.y;
-            this.angleZ = this._angle.z;
-        });
+        // Filter each axis of the whole drain at once
+        frames.copyValues(FIFOFrameValue.GYRO_X, this._rateX);
+        frames.copyValues(FIFOFrameValue.GYRO_Y, this._rateY, -1);
+        frames.copyValues(FIFOFrameValue.GYRO_Z, this._rateZ, -1);
+
+        this._rateXFilter.processFrames(this._rateX, numFrames);
+        this._rateYFilter.processFrames(this._rateY, numFrames);
+        this._rateZFilter.processFrames(this._rateZ, numFrames);
+
+        // Integrate every filtered sample, so no motion between reads is lost
+        let angleX = this._angle.x;
+        let angleY = this._angle.y;
+        let angleZ = this._angle.z;
+        for (let i = 0; i < numFrames; i++) {
+            angleX += dt * this._rateX[i];
+            angleY += dt * this._rateY[i];
+            angleZ += dt * this._rateZ[i];
+        }
+        this._angle.x = angleX;
+        this._angle.y = angleY;
+        this._angle.z = angleZ;
+
+        // Only the latest values are reported
+        this.rateX = this._rateX[numFrames - 1];
+        this.rateY = this._rateY[numFrames - 1];
+        this.rateZ = this._rateZ[numFrames - 1];
+
+        this.angleX = angleX;
+        this.angleY = angleY;
+        this.angleZ = angleZ;
     }
 
     public reset(): void {
@@ -0,0 +1,107 @@
+import { SimDevice, FieldDirection } from "@wpilib/wpilib-ws-robot";
+import { FIFOFrames } from "./devices/core/lsm6/lsm6";
+import MadgwickAHRS, { DEFAULT_MADGWICK_BETA } from "../utils/fusion/madgwick-ahrs";
+
+const DEG_TO_RAD: number = Math.PI / 180;
+
+/**
+ * Heading and tilt from fusing the Romi's gyro and accelerometer
+ *
+ * Every FIFO frame is fed into the fusion filter, spaced by the FIFO
+ * period, so nothing is lost between reads. Results are published to the
+ * robot program through a SimDevice ("RomiIMUFusion")
+ *
+ * Angles follow the same conventions as RomiGyro: yaw is positive
+ * clockwise (looking down on the robot), pitch is positive nose up and
+ * roll is positive right side down
+ */
+export default class RomiIMUFusion extends SimDevice {
+    private _ahrs: MadgwickAHRS;
+
+    constructor(beta: number = DEFAULT_MADGWICK_BETA) {
+        super("RomiIMUFusion", 0, 0);
+
+        this._ahrs = new MadgwickAHRS(beta);
+
+        this.registerField("Yaw", FieldDirection.INPUT_TO_ROBOT_CODE, 0.0);
+        this.registerField("Pitch", FieldDirection.INPUT_TO_ROBOT_CODE, 0.0);
+        this.registerField("Roll", FieldDirection.INPUT_TO_ROBOT_CODE, 0.0);
+        this.registerField("Quaternion W", FieldDirection.INPUT_TO_ROBOT_CODE, 1.0);
+        this.registerField("Quaternion X", FieldDirection.INPUT_TO_ROBOT_CODE, 0.0);
+        this.registerField("Quaternion Y", FieldDirection.INPUT_TO_ROBOT_CODE, 0.0);
+        this.registerField("Quaternion Z", FieldDirection.INPUT_TO_ROBOT_CODE, 0.0);
+    }
+
+    public get gain(): number {
+        return this._ahrs.beta;
+    }
+
+    public set gain(val: number) {
+        this._ahrs.beta = val;
+    }
+
+    // The filter works in the sensor's axes, which have Z pointing up.
+    // Flipping Y and Z (as RomiGyro does) gives the robot convention
+
+    public get yaw(): number {
+        return -this._ahrs.yaw;
+    }
+
+    public get pitch(): number {
+        return -this._ahrs.pitch;
+    }
+
+    public get roll(): number {
+        return this._ahrs.roll;
+    }
+
+    public get quaternion(): [number, number, number, number] {
+        return [this._ahrs.qw, this._ahrs.qx, -this._ahrs.qy, -this._ahrs.qz];
+    }
+
+    /**
+     * Run every frame through the fusion filter
+     * @param dt Time between frames (the FIFO period), in seconds
+     */
+    public updateFromFrames(frames: FIFOFrames, dt: number): void {
+        if (frames.length === 0) {
+            return;
+        }
+
+        this.processFrames(frames, dt);
+
+        this.setValue("Yaw", this.yaw);
+        this.setValue("Pitch", this.pitch);
+        this.setValue("Roll", this.roll);
+        this.setValue("Quaternion W", this._ahrs.qw);
+        this.setValue("Quaternion X", this._ahrs.qx);
+        this.setValue("Quaternion Y", -this._ahrs.qy);
+        this.setValue("Quaternion Z", -this._ahrs.qz);
+    }
+
+    /**
+     * Update the fused orientation without publishing it
+     */
+    public processFrames(frames: FIFOFrames, dt: number): void {
+        for (let i = 0; i < frames.length; i++) {
+            this._ahrs.update(frames.gyroX(i) * DEG_TO_RAD,
+                              frames.gyroY(i) * DEG_TO_RAD,
+                              frames.gyroZ(i) * DEG_TO_RAD,
+                              frames.accelX(i),
+                              frames.accelY(i),
+                              frames.accelZ(i),
+                              dt);
+        }
+    }
+
+    /**
+     * Zero the heading, keeping the current tilt
+     */
+    public resetYaw(): void {
+        this._ahrs.resetYaw();
+    }
+
+    public reset(): void {
+        this._ahrs.reset();
+    }
+}
@@ -1,32 +1,62 @@
 import { WPILibWSRobotBase, DigitalChannelMode } from "@wpilib/wpilib-ws-robot";
+import { performance } from "perf_hooks";
 
-import RomiDataBuffer, { FIRMWARE_IDENT } from "./romi-shmem-buffer";
+import RomiDataBuffer, { FIRMWARE_IDENT, ShmemDataType, ShmemElementDefinition } from "./romi-shmem-buffer";
+import RomiCommandBlock, { analogFilterRegister, ANALOG_FULL_SCALE, COMMAND_BLOCK_LENGTH, COMMAND_BLOCK_START, COMMAND_FLAG_HEARTBEAT, extIOConfigRegister, getTelemetryValue, isTelemetryBlockValid, lastStaleTelemetrySample, motorSlewRateRegister, onboardIOConfigRegister, safeValueRegister, TELEMETRY_BLOCK_LENGTH, TELEMETRY_BLOCK_START } from "./romi-shmem-protocol";
 import I2CErrorDetector from "../device-interfaces/i2c/i2c-error-detector";
 import LSM6 from "./devices/core/lsm6/lsm6";
-import RomiConfiguration, { CustomDeviceSpec, DEFAULT_IO_CONFIGURATION, IOPinMode, PinCapability, PinConfiguration } from "./romi-config";
+import RomiConfiguration, { AnalogFilterConfig, CustomDeviceSpec, DEFAULT_HEARTBEAT_TIMEOUT_MS, DEFAULT_IO_CONFIGURATION, IOPinMode, PinCapability, PinConfiguration, SafeValue } from "./romi-config";
 import RomiAccelerometer from "./romi-accelerometer";
 import RomiGyro from "./romi-gyro";
-import QueuedI2CBus, { QueuedI2CHandle } from "../device-interfaces/i2c/queued-i2c-bus";
+import RomiIMUFusion from "./romi-imu-fusion";
+import { DEFAULT_MADGWICK_BETA } from "../utils/fusion/madgwick-ahrs";
+import StreamingGyroCalibration, { StreamingCalibrationStats } from "../services/gyro-calibration/streaming-gyro-calibration";
+import TelemetryRecorder from "../services/recorder/telemetry-recorder";
+import { fieldsForSchema, I2CErrorKind, LogSchema } from "../services/recorder/log-format";
+import QueuedI2CBus, { I2CPriority, QueuedI2CHandle } from "../device-interfaces/i2c/queued-i2c-bus";
+import SharedSnapshot, { SnapshotInfo } from "../device-interfaces/i2c/shared-snapshot";
+import { DEFAULT_POST_WRITE_DELAY_US } from "../device-interfaces/i2c/i2c-batch";
+import TickScheduler, { TickSchedulerStats } from "../utils/tick-scheduler";
+import PollingRateController, { DEFAULT_BUS_BUDGET, DEFAULT_CUSTOM_DEVICE_BUS_BUDGET, DEFAULT_POLLING_RATES_HZ, estimateTransferUs, PollingStats, TelemetryClass } from "./polling-rates";
+import TelemetryStore, { MAX_DIO_CHANNELS } from "./telemetry-store";
 import { NetworkTableInstance, NetworkTable, EntryListenerFlags } from "node-ntcore";
 import LogUtil from "../utils/logging/log-util";
 import { FIFOModeSelection, OutputDataRate } from "./devices/core/lsm6/lsm6-settings";
 import CustomDevice, { RobotHardwareInterfaces } from "./devices/custom/custom-device";
 import CustomDeviceFactory from "./devices/custom/device-library";
-
-interface IEncoderInfo {
-    reportedValue: number; // This is the reading that is reported to usercode
-    reportedPeriod: number; // This is the period that is reported to usercode
-    lastRobotValue: number; // The last robot-reported value
-    isHardwareReversed?: boolean;
-    isSoftwareReversed?: boolean;
-    lastReportedTime?: number;
-}
+import CustomDeviceScheduler, { CustomDeviceSchedulerStats } from "./devices/custom/custom-device-scheduler";
 
 interface DevicePortMapping {
     device: CustomDevice | "romi-onboard" | "romi-external";
     port: number;
 }
 
+// Encoder on a pair of a custom device's DIO ports
+interface CustomEncoderMapping {
+    channel: number;
+    device: CustomDevice;
+    encoder: number;
+}
+
+export interface ShmemRegionStats {
+    transfers: number;
+    crcErrors: number;
+}
+
+export interface HeartbeatStats {
+    // Heartbeats carried by a command block write
+    piggybacked: number;
+
+    // Heartbeats that needed a write of their own
+    standalone: number;
+}
+
+export interface ShmemStats {
+    command: ShmemRegionStats & { resends: number };
+    telemetry: ShmemRegionStats;
+    heartbeat: HeartbeatStats;
+}
+
 type OnboardDIOFunction = "general" | "encoder";
 type OnboardPWMFunction = "motor";
 
@@ -70,28 +100,94 @@ const IO_CAPABILITIES: PinCapability[] = [
 
 export const NUM_CONFIGURABLE_PINS: number = 5;
 
+// Bits of the firmware resetCause register
+const RESET_CAUSE_FLAGS: [number, string][] = [
+    [0x01, "POWER_ON"],
+    [0x02, "EXTERNAL"],
+    [0x04, "BROWN_OUT"],
+    [0x08, "WATCHDOG"]
+];
+
+// Send heartbeats several times per firmware timeout period, so a
+// single late or dropped write doesn't trip the failsafe
+const HEARTBEATS_PER_TIMEOUT: number = 4;
+const MAX_HEARTBEAT_PERIOD_MS: number = 100;
+const MIN_HEARTBEAT_PERIOD_MS: number = 5;
+
+// Romi drivetrain geometry, used to convert motion profile moves into
+// encoder ticks
+const ENCODER_TICKS_PER_REV: number = 1440;
+const WHEEL_DIAMETER_M: number = 0.07;
+const TRACK_WIDTH_M: number = 0.141;
+const METERS_PER_TICK: number = (Math.PI * WHEEL_DIAMETER_M) / ENCODER_TICKS_PER_REV;
+const DEGREES_PER_TICK: number = (METERS_PER_TICK / (TRACK_WIDTH_M / 2)) * (180 / Math.PI);
+
+// Values of the firmware motionCommand and motionState registers
+// See firmware/include/motion_profile.h
+const MOTION_COMMAND_DRIVE: number = 1;
+const MOTION_COMMAND_TURN: number = 2;
+const MOTION_COMMAND_CANCEL: number = 3;
+const MOTION_STATES: string[] = ["IDLE", "RUNNING", "COMPLETE", "ABORTED"];
+const MOTION_STATE_RUNNING: number = 1;
+
+// Classes of data that all come from the telemetry block
+const TELEMETRY_BLOCK_CLASSES: TelemetryClass[] = [
+    TelemetryClass.ENCODERS,
+    TelemetryClass.DIO,
+    TelemetryClass.ANALOG,
+    TelemetryClass.BATTERY
+];
+
+// How often to re-evaluate polling rates in adaptive mode
+const POLLING_ADAPT_PERIOD_MS: number = 1000;
+
+const STATUS_CHECK_PERIOD_MS: number = 500;
+const SCHEDULER_STATUS_PERIOD_MS: number = 1000;
+
+// How often custom device rates are fitted to the bus budget (and their
+// achieved rates published)
+const CUSTOM_DEVICE_RATES_PERIOD_MS: number = 1000;
+
+// The fused IMU angles go to the robot program with every FIFO drain, but
+// NetworkTables only gets them at a rate that's useful for dashboards
+const IMU_STATUS_PERIOD_MS: number = 100;
+
+// How long after the last encoder change the robot still counts as
+// moving, for gyro bias tracking
+const WHEEL_SETTLE_MS: number = 250;
+
+const GYRO_ADD_OFFSET_X_KEY = "Gyro Runtime Offset X";
+const GYRO_ADD_OFFSET_Y_KEY = "Gyro Runtime Offset Y";
+const GYRO_ADD_OFFSET_Z_KEY = "Gyro Runtime Offset Z";
+
 const logger = LogUtil.getLogger("ROMI");
 
 export default class WPILibWSRomiRobot extends WPILibWSRobotBase {
     private _queuedBus: QueuedI2CBus;
     private _i2cHandle: QueuedI2CHandle;
+    private _actuationHandle: QueuedI2CHandle;
 
     private _firmwareIdent: number = -1;
+    private _resetCause: number = 0;
 
     private _batteryPct: number = 0;
 
-    private _heartbeatTimer: NodeJS.Timeout;
-    private _readTimer: NodeJS.Timeout;
-    private _imuReadTimer: NodeJS.Timeout;
+    private _scheduler: TickScheduler = new TickScheduler();
+    private _pollingRates: PollingRateController;
 
-    private _digitalInputValues: Map<number, boolean> = new Map<number, boolean>();
-    private _analogInputValues: Map<number, number> = new Map<number, number>();
-    private _encoderInputValues: Map<number, IEncoderInfo> = new Map<number, IEncoderInfo>();
+    private _inputValues: TelemetryStore = new TelemetryStore();
 
     // These store the HAL-registered encoder channels. -1 implies uninitialized
     private _leftEncoderChannel: number = -1;
     private _rightEncoderChannel: number = -1;
 
+    // After an encoder reset, telemetry samples up to this count may have
+    // been taken before the Romi zeroed its counter, so they're ignored
+    // for that encoder. Infinity while the reset write is in flight
+    private _leftEncoderResetSample: number = -1;
+    private _rightEncoderResetSample: number = -1;
+    private _customEncoders: CustomEncoderMapping[] = [];
+
     private _ioConfiguration: PinConfiguration[] = DEFAULT_IO_CONFIGURATION;
 
     private _dioDevicePortMapping: DevicePortMapping[] = [];
@@ -100,6 +196,34 @@ export default class WPILibWSRomiRobot extends WPILibWSRobotBase {
 
     private _extPinConfiguration: number[] = [];
     private _onboardPinConfiguration: number[] = [1, 0, 0, 0];
+    private _analogFilterConfiguration: number[] = [0, 0, 0, 0, 0];
+    private _motorSlewRate: number = 0;
+    private _heartbeatTimeoutMs: number = DEFAULT_HEARTBEAT_TIMEOUT_MS;
+    private _safeValues: SafeValue[] = [];
+
+    private _motionState: number = 0;
+    private _motionProgressTicks: number = 0;
+    private _motionUnitsPerTick: number = METERS_PER_TICK;
+
+    // Last telemetry sample that may predate the latest motion command
+    // (Infinity while it is being written), or -1 once a newer one has
+    // been read
+    private _motionCommandSample: number = -1;
+
+    private _commandBlock: RomiCommandBlock = new RomiCommandBlock(block => this._sendRomiCommandBlock(block),
+                                                                   () => this._nextCommandFlags());
+    private _telemetryBlock: Buffer | null = null;
+    private _telemetrySnapshot: SharedSnapshot;
+    private _telemetrySnapshotBuffer: Buffer = Buffer.alloc(TELEMETRY_BLOCK_LENGTH);
+    private _telemetrySnapshotInfo: SnapshotInfo = { sampleCount: 0, error: false };
+    private _telemetrySampleCount: number = 0;
+    private _lastCommandCrcErrors: number = -1;
+    private _lastHeartbeatTime: number = 0;
+    private _shmemStats: ShmemStats = {
+        command: { transfers: 0, crcErrors: 0, resends: 0 },
+        telemetry: { transfers: 0, crcErrors: 0 },
+        heartbeat: { piggybacked: 0, standalone: 0 }
+    };
 
     private _readyP: Promise<void>;
     private _i2cErrorDetector: I2CErrorDetector = new I2CErrorDetector(10, 500, 100);
@@ -109,8 +233,19 @@ export default class WPILibWSRomiRobot extends WPILibWSRobotBase {
     private _imuFIFOperiod: number = 0;
     private _romiAccelerometer: RomiAccelerometer;
     private _romiGyro: RomiGyro;
+    private _imuFusion: RomiIMUFusion;
     private _imuReadsPaused: boolean = false;
 
+    // Gyro bias tracking, while the robot sits still
+    private _gyroCalibration: StreamingGyroCalibration = new StreamingGyroCalibration();
+    private _gyroBiasTracking: boolean = true;
+    private _publishedBiasUpdates: number = 0;
+    private _lastLeftEncoderRaw: number = 0;
+    private _lastRightEncoderRaw: number = 0;
+    private _lastWheelMotionTime: number = 0;
+
+    private _recorder: TelemetryRecorder | null = null;
+
     // Keep track of the number of active WS connections
     private _numWsConnections: number = 0;
 
@@ -121,9 +256,12 @@ export default class WPILibWSRomiRobot extends WPILibWSRobotBase {
     private _dsHeartbeatPresent: boolean = false;
 
     private _customDevices: CustomDevice[] = [];
+    private _customDeviceScheduler: CustomDeviceScheduler;
 
     private _statusNetworkTable: NetworkTable;
     private _configNetworkTable: NetworkTable;
+    private _motionNetworkTable: NetworkTable;
+    private _imuNetworkTable: NetworkTable;
 
     // Take in the abstract bus, since this will allow us to
     // write unit tests more easily
@@ -133,19 +271,44 @@ export default class WPILibWSRomiRobot extends WPILibWSRobotBase {
         const ntInstance = NetworkTableInstance.getDefault();
         this._statusNetworkTable = ntInstance.getTable("/Romi/Status");
         this._configNetworkTable = ntInstance.getTable("/Romi/Config");
+        this._motionNetworkTable = ntInstance.getTable("/Romi/Motion");
+        this._imuNetworkTable = ntInstance.getTable("/Romi/IMU");
 
         // By default, we'll use a queued I2C bus
         this._queuedBus = bus;
-        this._i2cHandle = this._queuedBus.getNewAddressedHandle(address, true);
+        this._i2cHandle = this._queuedBus.getNewAddressedHandle(address, true, I2CPriority.TELEMETRY);
+
+        // Outputs and the heartbeat jump ahead of sensor polling on the bus
+        this._actuationHandle = this._queuedBus.getNewAddressedHandle(address, true, I2CPriority.ACTUATION);
 
         // Set up the LSM6DS33 (and associated Romi IMU devices-s)
-        this._lsm6 = new LSM6(this._queuedBus.rawBus, 0x6B);
+        this._lsm6 = new LSM6(this._queuedBus, 0x6B);
         this._romiAccelerometer = new RomiAccelerometer(this._lsm6);
         this._romiGyro = new RomiGyro(this._lsm6);
 
         this.registerAccelerometer(this._romiAccelerometer);
         this.registerGyro(this._romiGyro);
 
+        // Fused heading and tilt, from the same frames
+        this._imuFusion = new RomiIMUFusion(romiConfig ? romiConfig.imuFusionGain : DEFAULT_MADGWICK_BETA);
+        this.registerSimDevice(this._imuFusion);
+
+        this._pollingRates = new PollingRateController(romiConfig ? romiConfig.pollingRates : DEFAULT_POLLING_RATES_HZ,
+                                                       romiConfig ? romiConfig.adaptivePolling : false,
+                                                       romiConfig ? romiConfig.busBudget : DEFAULT_BUS_BUDGET);
+
+        // Custom devices have a budget of their own. Devices that don't ask
+        // for a particular rate are updated at the customDevices polling rate
+        this._customDeviceScheduler = new CustomDeviceScheduler(romiConfig ? romiConfig.customDeviceBusBudget : DEFAULT_CUSTOM_DEVICE_BUS_BUDGET,
+                                                                () => this._pollingRates.periodMs(TelemetryClass.CUSTOM_DEVICES));
+
+        // Register what each poll costs on the bus, for the bus budget
+        // The IMU cost is the FIFO status read plus one burst of frames
+        this._pollingRates.addTransfer(TELEMETRY_BLOCK_CLASSES,
+                                       estimateTransferUs(1, TELEMETRY_BLOCK_LENGTH, DEFAULT_POST_WRITE_DELAY_US));
+        this._pollingRates.addTransfer([TelemetryClass.IMU],
+                                       estimateTransferUs(1, 4) + estimateTransferUs(1, 24));
+
         // Configure the onboard hardware
         if (romiConfig) {
             if (romiConfig.externalIOConfig) {
@@ -157,10 +320,28 @@ export default class WPILibWSRomiRobot extends WPILibWSRobotBase {
                 }
             }
 
+            this._gyroBiasTracking = romiConfig.gyroBiasTracking;
+
             if (romiConfig.gyroZeroOffset) {
                 this._lsm6.gyroOffset = romiConfig.gyroZeroOffset;
             }
 
+            if (romiConfig.analogFilters) {
+                this._setAnalogFilterConfiguration(romiConfig.analogFilters);
+            }
+
+            if (romiConfig.motorSlewRate !== undefined) {
+                this._motorSlewRate = romiConfig.motorSlewRate;
+            }
+
+            if (romiConfig.heartbeatTimeoutMs !== undefined) {
+                this._heartbeatTimeoutMs = romiConfig.heartbeatTimeoutMs;
+            }
+
+            if (romiConfig.safeValues) {
+                this._safeValues = romiConfig.safeValues;
+            }
+
             if (romiConfig.gyroFilterWindowSize !== undefined) {
                 this._romiGyro.filterWindow = romiConfig.gyroFilterWindowSize;
             }
@@ -189,6 +370,20 @@ export default class WPILibWSRomiRobot extends WPILibWSRobotBase {
                 if (this._firmwareIdent !== FIRMWARE_IDENT) {
                     logger.error(`Firmware Identifier Mismatch. Expected ${FIRMWARE_IDENT} but got ${this._firmwareIdent}`);
                 }
+
+                return this.queryResetCause();
+            })
+            .then(() => {
+                // Carry on from the last command sequence number the
+                // firmware accepted, so our first command isn't mistaken
+                // for one it has already applied
+                return this._i2cHandle.readByte(RomiDataBuffer.commandAck.offset)
+                .then(ack => {
+                    this._commandBlock.resumeFrom(ack);
+                })
+                .catch(err => {
+                    this._i2cErrorDetector.addErrorInstance();
+                });
             })
             .then(() => {
                 // Initialize LSM6
@@ -223,27 +418,56 @@ export default class WPILibWSRomiRobot extends WPILibWSRobotBase {
                 // Set up the heartbeat. Only send the heartbeat if we have
                 // an active WS connection, the robot is in enabled state
                 // AND we have a recent-ish DS packet
-                this._heartbeatTimer = setInterval(() => {this._setRomiHeartBeat();}, 100 );
+                this._scheduler.addTask("Heartbeat", this.heartbeatPeriodMs, () => {
+                    this._setRomiHeartBeat();
 
-                // Set up the custom device update loop (if needed)
-                if (this._customDevices.length > 0) {
-                    setInterval(() => {
+                    // Other Romi boards only hear the heartbeat through us
+                    if (this._shouldSendHeartbeat()) {
                         this._customDevices.forEach(device => {
-                            device.update();
+                            device.heartbeat();
                         });
-                    }, 20);
+                    }
+                });
+
+                // Each custom device is updated at its own rate, and a
+                // device's updates never overlap
+                this._customDevices.forEach(device => {
+                    this._scheduler.addTask(`Custom Device ${device.identifier}`,
+                                            () => this._customDeviceScheduler.periodMs(device),
+                                            () => this._customDeviceScheduler.runUpdate(device));
+                });
+
+                if (this._customDevices.length > 0) {
+                    this._scheduler.addTask("Custom Device Rates", CUSTOM_DEVICE_RATES_PERIOD_MS, (now) => {
+                        this._customDeviceScheduler.update(now);
+                        this._customDeviceScheduler.publishStats();
+                    });
                 }
 
-                // Set up the read timer
-                this._readTimer = setInterval(() => {
+                // The telemetry block is sampled by the bus (on its own
+                // thread, where possible), and we just pick up the latest
+                // sample on each read tick
+                this._telemetrySnapshot = this._queuedBus.startPeriodicRead(this._i2cHandle.address,
+                                                                            TELEMETRY_BLOCK_START,
+                                                                            TELEMETRY_BLOCK_LENGTH,
+                                                                            this._pollingRates.sharedPeriodMs(TELEMETRY_BLOCK_CLASSES),
+                                                                            true);
+
+                // Set up the read loop
+                this._addPollingTask("Telemetry", TELEMETRY_BLOCK_CLASSES, (now) => {
+                    this._readTelemetryBlock(now);
+
                     this._bulkAnalogRead();
                     this._bulkDigitalRead();
-                    this._bulkEncoderRead();
+                    this._bulkEncoderRead(now);
+                    this._trackWheelMotion(now);
 
                     this._readBattery();
-                }, 50);
+                    this._readMotionStatus();
+                });
 
-                this._imuReadTimer = setInterval(() => {
+                this._lsm6.fifoPollPeriodMs = this._pollingRates.periodMs(TelemetryClass.IMU);
+                this._addPollingTask("IMU", TelemetryClass.IMU, (now) => {
                     if (this._imuReadsPaused) {
                         return;
                     }
@@ -252,14 +476,43 @@ export default class WPILibWSRomiRobot extends WPILibWSRobotBase {
                     const frames = this._lsm6.getNewFIFOData();
 
                     if (frames.length > 0) {
+                        if (this._recorder) {
+                            this._recorder.recordIMUFrames(frames, now, this._imuFIFOperiod);
+                        }
+
                         this._romiAccelerometer.updateFromFrames(frames, this._imuFIFOperiod);
                         this._romiGyro.updateFromFrames(frames, this._imuFIFOperiod);
+                        this._imuFusion.updateFromFrames(frames, this._imuFIFOperiod);
+
+                        // Refine the gyro offset from the same frames, whenever
+                        // the robot has been sitting still long enough
+                        if (this._gyroBiasTracking &&
+                            this._gyroCalibration.processFrames(frames, this._imuFIFOperiod,
+                                                                now - this._lastWheelMotionTime < WHEEL_SETTLE_MS)) {
+                            this._lsm6.adjustRuntimeOffset(this._gyroCalibration.correction);
+                        }
                     }
-                }, 10);
+                });
+
+                this._scheduler.addTask("IMU Status", IMU_STATUS_PERIOD_MS, () => {
+                    this._publishIMUStatus();
+                });
+
+                // In adaptive mode, keep rates in line with what the robot
+                // program is actually reading
+                if (this._pollingRates.adaptive) {
+                    this._scheduler.addTask("Polling Rates", POLLING_ADAPT_PERIOD_MS, () => {
+                        this._updatePollingRates();
+                    });
+                }
+
+                this._scheduler.addTask("I2C Error Check", this._i2cErrorDetector.checkIntervalMs, () => {
+                    this._i2cErrorDetector.check();
+                });
 
                 // Set up the status check
-                setInterval(() => {
-                    this._i2cHandle.readByte(RomiDataBuffer.status.offset)
+                this._scheduler.addTask("Status Check", STATUS_CHECK_PERIOD_MS, () => {
+                    return this._i2cHandle.readByte(RomiDataBuffer.status.offset)
                     .then(val => {
                         if (val === 0) {
                             logger.warn("Status byte is 0. Assuming brown out. Rewriting IO config");
@@ -267,7 +520,21 @@ export default class WPILibWSRomiRobot extends WPILibWSRobotBase {
                             // So we write the IO configuration again
                             this._writeRomiOnboardIOConfiguration()
                             .then(() => {
-                                this._writeRomiExtIOConfiguration();
+                                return this._writeRomiExtIOConfiguration();
+                            })
+                            .then(() => {
+                                return this._writeRomiAnalogFilterConfiguration();
+                            })
+                            .then(() => {
+                                return this._writeRomiMotorSlewRate();
+                            })
+                            .then(() => {
+                                return this._writeRomiFailsafeConfiguration();
+                            })
+                            .then(() => {
+                                // The firmware starts up with everything
+                                // stopped, so send the latest outputs again
+                                return this._commandBlock.write();
                             })
                             .then(() => {
                                 // While we're at it... re-query the firmware
@@ -277,6 +544,7 @@ export default class WPILibWSRomiRobot extends WPILibWSRobotBase {
                                     this.queryFirmwareIdent()
                                     .then((fwIdent) => {
                                         logger.info("Firmware Identifier: " + fwIdent);
+                                        return this.queryResetCause();
                                     });
                                 }, 2000);
                             });
@@ -286,7 +554,13 @@ export default class WPILibWSRomiRobot extends WPILibWSRobotBase {
                     .catch(err => {
                         this._i2cErrorDetector.addErrorInstance();
                     });
-                }, 500);
+                });
+
+                this._scheduler.addTask("Scheduler Status", SCHEDULER_STATUS_PERIOD_MS, () => {
+                    this._publishSchedulerStatus();
+                });
+
+                this._scheduler.start();
             })
             .catch(err => {
                 logger.error("Failed to initialize robot: ", err);
@@ -305,6 +579,9 @@ export default class WPILibWSRomiRobot extends WPILibWSRobotBase {
     public resumeIMUReads(reason?: string): void {
         logger.info(`Resuming IMU Reads ${reason ? "(" + reason + ")" : ""}`);
         this._imuReadsPaused = false;
+
+        // Whatever paused reads may have changed the offsets
+        this._gyroCalibration.reset();
     }
 
     public readyP(): Promise<void> {
@@ -319,6 +596,47 @@ export default class WPILibWSRomiRobot extends WPILibWSRobotBase {
         return this._firmwareIdent;
     }
 
+    /**
+     * Causes of the most recent firmware reset, as reported by the 32U4
+     */
+    public get resetCause(): string[] {
+        return RESET_CAUSE_FLAGS.filter(([flag]) => (this._resetCause & flag) !== 0)
+                                .map(([flag, name]) => name);
+    }
+
+    /**
+     * Layout of what the robot records, for the header of a telemetry log
+     */
+    public get logSchema(): LogSchema {
+        return {
+            firmwareIdent: FIRMWARE_IDENT,
+            telemetryBlock: { start: TELEMETRY_BLOCK_START, length: TELEMETRY_BLOCK_LENGTH },
+            commandBlock: { start: COMMAND_BLOCK_START, length: COMMAND_BLOCK_LENGTH },
+            imuFramePeriod: this._lsm6.getFIFOPeriod(),
+            fields: fieldsForSchema(RomiDataBuffer, ShmemDataType)
+        };
+    }
+
+    /**
+     * Record every telemetry block, IMU frame and command block (and any
+     * problems reading them) from now on. Pass null to stop
+     */
+    public setRecorder(recorder: TelemetryRecorder | null): void {
+        this._recorder = recorder;
+    }
+
+    public get gyroBiasTrackingStats(): StreamingCalibrationStats & { enabled: boolean } {
+        return {
+            enabled: this._gyroBiasTracking,
+            ...this._gyroCalibration.stats
+        };
+    }
+
+    public get heartbeatPeriodMs(): number {
+        const period = Math.floor(this._heartbeatTimeoutMs / HEARTBEATS_PER_TIMEOUT);
+        return Math.max(MIN_HEARTBEAT_PERIOD_MS, Math.min(MAX_HEARTBEAT_PERIOD_MS, period));
+    }
+
     public get ioChannelInfo(): RobotIOChannelInfo {
         const result: RobotIOChannelInfo = {
             dio: [],
@@ -375,6 +693,7 @@ export default class WPILibWSRomiRobot extends WPILibWSRobotBase {
     }
 
     public getBatteryPercentage(): number {
+        this._pollingRates.markAccessed(TelemetryClass.BATTERY);
         return this._batteryPct;
     }
 
@@ -421,12 +740,7 @@ export default class WPILibWSRomiRobot extends WPILibWSRobotBase {
             devicePortMapping.device.setDigitalChannelMode(devicePortMapping.port, mode);
         }
 
-        if (mode !== DigitalChannelMode.INPUT) {
-            this._digitalInputValues.delete(channel);
-        }
-        else if (!this._digitalInputValues.has(channel)) {
-            this._digitalInputValues.set(channel, false);
-        }
+        this._inputValues.setDIOActive(channel, mode === DigitalChannelMode.INPUT);
     }
 
     public setDIOValue(channel: number, value: boolean): void {
@@ -450,10 +764,7 @@ export default class WPILibWSRomiRobot extends WPILibWSRobotBase {
         }
         else if (devicePortMapping.device === "romi-external") {
             const ioIdx = devicePortMapping.port;
-            this._i2cHandle.writeByte(RomiDataBuffer.extIoValues.offset + (ioIdx * 2), value ? 1 : 0)
-            .catch(err => {
-                this._i2cErrorDetector.addErrorInstance();
-            });
+            this._commandBlock.setValue(RomiDataBuffer.extIoOutputs, value ? 1 : 0, ioIdx);
         }
         else {
             devicePortMapping.device.setDIOValue(devicePortMapping.port, value);
@@ -461,11 +772,8 @@ export default class WPILibWSRomiRobot extends WPILibWSRobotBase {
     }
 
     public getDIOValue(channel: number): boolean {
-        if (!this._digitalInputValues.has(channel)) {
-            return false;
-        }
-
-        return this._digitalInputValues.get(channel);
+        this._pollingRates.markAccessed(TelemetryClass.DIO);
+        return this._inputValues.getDIO(channel);
     }
 
     public setAnalogOutVoltage(channel: number, voltage: number): void {
@@ -473,11 +781,8 @@ export default class WPILibWSRomiRobot extends WPILibWSRobotBase {
     }
 
     public getAnalogInVoltage(channel: number): number {
-        if (!this._analogInputValues.has(channel)) {
-            return 0.0;
-        }
-
-        return this._analogInputValues.get(channel);
+        this._pollingRates.markAccessed(TelemetryClass.ANALOG);
+        return this._inputValues.getAnalog(channel);
     }
 
     public setPWMValue(channel: number, value: number): void {
@@ -496,40 +801,19 @@ export default class WPILibWSRomiRobot extends WPILibWSRobotBase {
             // Positive values here correspond to forward motion
             const romiValue = Math.floor(((value / 255) * 800) - 400);
 
-            // We need to do some trickery to get a twos-complement number
-            // Essentially we'll write a 16 bit signed int to the buffer
-            // and read it out as an unsigned int
-            // Mainly to work around the fact that the i2c-bus library's
-            // writeBlock() doesn't work...
-            const tmp = Buffer.alloc(2);
-            tmp.writeInt16BE(romiValue);
-
-            let offset;
             if (devicePortMapping.port === 0) {
-                offset = RomiDataBuffer.leftMotor.offset;
+                this._commandBlock.setValue(RomiDataBuffer.leftMotor, romiValue);
             }
             else {
-                offset = RomiDataBuffer.rightMotor.offset;
+                this._commandBlock.setValue(RomiDataBuffer.rightMotor, romiValue);
             }
-
-            this._i2cHandle.writeWord(offset, tmp.readUInt16BE())
-            .catch(err => {
-                this._i2cErrorDetector.addErrorInstance();
-            });
         }
         else if (devicePortMapping.device === "romi-external") {
             // Same conversion logic as above
             const romiValue = Math.floor(((value / 255) * 800) - 400);
-            const tmp = Buffer.alloc(2);
-            tmp.writeInt16BE(romiValue);
 
             const ioIdx = devicePortMapping.port;
-            const offset = RomiDataBuffer.extIoValues.offset + (ioIdx * 2);
-
-            this._i2cHandle.writeWord(offset, tmp.readUInt16BE())
-            .catch(err => {
-                this._i2cErrorDetector.addErrorInstance();
-            });
+            this._commandBlock.setValue(RomiDataBuffer.extIoOutputs, romiValue, ioIdx);
         }
         else {
             devicePortMapping.device.setPWMValue(devicePortMapping.port, value);
@@ -540,93 +824,87 @@ export default class WPILibWSRomiRobot extends WPILibWSRobotBase {
         // Left encoder uses dio 4/5, right uses 6/7
         // If the channels are reversed, we'll set the hardware reversed flag
         if (channelA === 4 && channelB === 5) {
-            this._encoderInputValues.set(encoderChannel, {
-                reportedValue: 0,
-                reportedPeriod: Number.MAX_VALUE,
-                lastRobotValue: 0,
-                isHardwareReversed: false
-            });
+            this._inputValues.addEncoder(encoderChannel, false);
             this._leftEncoderChannel = encoderChannel;
         }
         else if (channelA === 5 && channelB === 4) {
-            this._encoderInputValues.set(encoderChannel, {
-                reportedValue: 0,
-                reportedPeriod: Number.MAX_VALUE,
-                lastRobotValue: 0,
-                isHardwareReversed: true
-            });
+            this._inputValues.addEncoder(encoderChannel, true);
             this._leftEncoderChannel = encoderChannel;
         }
         else if (channelA === 6 && channelB === 7) {
-            this._encoderInputValues.set(encoderChannel, {
-                reportedValue: 0,
-                reportedPeriod: Number.MAX_VALUE,
-                lastRobotValue: 0,
-                isHardwareReversed: false
-            });
+            this._inputValues.addEncoder(encoderChannel, false);
             this._rightEncoderChannel = encoderChannel;
         }
         else if (channelA === 7 && channelB === 6) {
-            this._encoderInputValues.set(encoderChannel, {
-                reportedValue: 0,
-                reportedPeriod: Number.MAX_VALUE,
-                lastRobotValue: 0,
-                isHardwareReversed: false
-            });
+            this._inputValues.addEncoder(encoderChannel, false);
             this._rightEncoderChannel = encoderChannel;
         }
+        else {
+            this._registerCustomEncoder(encoderChannel, channelA, channelB);
+        }
 
         // If we have the wrong combination of pins, we ignore the encoder
     }
 
     public getEncoderCount(channel: number): number {
-        if (!this._encoderInputValues.has(channel)) {
-            return 0;
-        }
-
-        return this._encoderInputValues.get(channel).reportedValue;
+        this._pollingRates.markAccessed(TelemetryClass.ENCODERS);
+        return this._inputValues.getEncoderCount(channel);
     }
 
     public getEncoderPeriod(channel: number): number {
-        if (!this._encoderInputValues.has(channel)) {
-            return Number.MAX_VALUE;
-        }
-
-        return this._encoderInputValues.get(channel).reportedPeriod;
+        this._pollingRates.markAccessed(TelemetryClass.ENCODERS);
+        return this._inputValues.getEncoderPeriod(channel);
     }
 
     public resetEncoder(channel: number, keepLast?: boolean): void {
         let offset;
-        if (channel === this._leftEncoderChannel) {
+        const isLeft = channel === this._leftEncoderChannel;
+        if (isLeft) {
             offset = RomiDataBuffer.resetLeftEncoder.offset;
         }
         else if (channel === this._rightEncoderChannel) {
             offset = RomiDataBuffer.resetRightEncoder.offset;
         }
         else {
+            const mapping = this._getCustomEncoder(channel);
+            if (mapping) {
+                this._inputValues.resetEncoder(channel, keepLast);
+                mapping.device.resetEncoder(mapping.encoder);
+            }
             return;
         }
 
-        const encoderInfo = this._encoderInputValues.get(channel);
-        encoderInfo.lastRobotValue = 0;
-
-        if (!keepLast) {
-            encoderInfo.reportedValue = 0;
-        }
+        this._inputValues.resetEncoder(channel, keepLast);
+        this._setEncoderResetSample(isLeft, Infinity);
 
-        this._i2cHandle.writeByte(offset, 1)
+        this._actuationHandle.writeByte(offset, 1)
+        .then(() => {
+            // The next sample may still have been read before the firmware
+            // applied the reset, so only ones after that are used
+            this._setEncoderResetSample(isLeft, this._lastStaleTelemetrySample());
+        })
         .catch(err => {
+            // The counter may or may not have been zeroed, so the next
+            // sample is taken as the new starting point either way
+            this._inputValues.resyncEncoder(channel);
+            this._setEncoderResetSample(isLeft, -1);
             this._i2cErrorDetector.addErrorInstance();
         });
     }
 
-    public setEncoderReverseDirection(channel: number, reverse: boolean): void {
-        const encoderInfo = this._encoderInputValues.get(channel);
-        if (encoderInfo) {
-            encoderInfo.isSoftwareReversed = reverse;
+    private _setEncoderResetSample(isLeft: boolean, sampleCount: number): void {
+        if (isLeft) {
+            this._leftEncoderResetSample = sampleCount;
+        }
+        else {
+            this._rightEncoderResetSample = sampleCount;
         }
     }
 
+    public setEncoderReverseDirection(channel: number, reverse: boolean): void {
+        this._inputValues.setEncoderSoftwareReversed(channel, reverse);
+    }
+
     /**
      * Called when a new WebSocket connection occurs
      */
@@ -636,6 +914,7 @@ export default class WPILibWSRomiRobot extends WPILibWSRobotBase {
             // Reset the gyro. This will ensure that the gyro will
             // read 0 (or close to it) as the robot program starts up
             this._romiGyro.reset();
+            this._imuFusion.resetYaw();
         }
 
         this._numWsConnections++;
@@ -664,7 +943,7 @@ export default class WPILibWSRomiRobot extends WPILibWSRobotBase {
         logger.info("Robot ENABLED");
         this._dsEnabled = true;
         // To ensure Romi will act on signals sent immediately
-        this._setRomiHeartBeat();
+        this._setRomiHeartBeat(true);
     }
 
     public onRobotDisabled(): void {
@@ -682,6 +961,87 @@ export default class WPILibWSRomiRobot extends WPILibWSRobotBase {
         this._dsHeartbeatPresent = true;
     }
 
+    /**
+     * Current state of the on-board motion profile
+     * One of IDLE, RUNNING, COMPLETE or ABORTED
+     */
+    public get motionState(): string {
+        return MOTION_STATES[this._motionState] || "UNKNOWN";
+    }
+
+    /**
+     * Progress of the current (or last) motion profile, in meters for
+     * drive moves and degrees for turns
+     */
+    public get motionProgress(): number {
+        return this._motionProgressTicks * this._motionUnitsPerTick;
+    }
+
+    /**
+     * Drive straight for the given distance using an on-board trapezoidal
+     * motion profile
+     * @param distance Distance in meters (negative to drive backwards)
+     * @param maxVelocity Max velocity in meters per second
+     * @param maxAccel Max acceleration in meters per second squared
+     */
+    public async startDriveProfile(distance: number, maxVelocity: number, maxAccel: number): Promise<void> {
+        this._motionUnitsPerTick = METERS_PER_TICK;
+        return this._writeRomiMotionProfile(MOTION_COMMAND_DRIVE, distance / METERS_PER_TICK,
+                                            maxVelocity / METERS_PER_TICK, maxAccel / METERS_PER_TICK);
+    }
+
+    /**
+     * Turn in place by the given angle using an on-board trapezoidal
+     * motion profile
+     * @param angle Angle in degrees (positive is clockwise)
+     * @param maxAngularVelocity Max angular velocity in degrees per second
+     * @param maxAngularAccel Max angular acceleration in degrees per second squared
+     */
+    public async startTurnProfile(angle: number, maxAngularVelocity: number, maxAngularAccel: number): Promise<void> {
+        this._motionUnitsPerTick = DEGREES_PER_TICK;
+        return this._writeRomiMotionProfile(MOTION_COMMAND_TURN, angle / DEGREES_PER_TICK,
+                                            maxAngularVelocity / DEGREES_PER_TICK, maxAngularAccel / DEGREES_PER_TICK);
+    }
+
+    public async cancelMotionProfile(): Promise<void> {
+        this._motionCommandSample = Infinity;
+        return this._actuationHandle.writeByte(RomiDataBuffer.motionCommand.offset, MOTION_COMMAND_CANCEL)
+        .catch(err => {
+            this._i2cErrorDetector.addErrorInstance();
+        })
+        .then(() => {
+            this._motionCommandSample = this._lastStaleTelemetrySample();
+        });
+    }
+
+    /**
+     * Scheduler that runs all of the robot's periodic work. Other services
+     * can add their own tasks to it
+     */
+    public get scheduler(): TickScheduler {
+        return this._scheduler;
+    }
+
+    public get schedulerStats(): TickSchedulerStats {
+        return this._scheduler.stats;
+    }
+
+    public get pollingStats(): PollingStats {
+        return this._pollingRates.stats;
+    }
+
+    public get customDeviceStats(): CustomDeviceSchedulerStats {
+        return this._customDeviceScheduler.stats;
+    }
+
+    /**
+     * Transfer and CRC error counts for the command and telemetry blocks
+     * Command CRC errors are the ones detected by the firmware
+     */
+    public get shmemStats(): ShmemStats {
+        return this._shmemStats;
+    }
+
     public async queryFirmwareIdent(): Promise<number> {
         return this._i2cHandle.readByte(RomiDataBuffer.firmwareIdent.offset)
         .then(fwIdent => {
@@ -695,6 +1055,23 @@ export default class WPILibWSRomiRobot extends WPILibWSRobotBase {
         });
     }
 
+    public async queryResetCause(): Promise<string[]> {
+        return this._i2cHandle.readByte(RomiDataBuffer.resetCause.offset)
+        .then(resetCause => {
+            this._resetCause = resetCause;
+
+            const causes = this.resetCause;
+            logger.info(`Firmware Reset Cause: ${causes.length > 0 ? causes.join(", ") : "UNKNOWN"}`);
+            this._statusNetworkTable.getEntry("Reset Cause").setStringArray(causes);
+
+            return causes;
+        })
+        .catch(err => {
+            this._i2cErrorDetector.addErrorInstance();
+            return [];
+        });
+    }
+
     private _verifyConfiguration(config: PinConfiguration[]): boolean {
         if (config.length !== IO_CAPABILITIES.length) {
             logger.warn(`Incorrect number of pin config options. Expected ${IO_CAPABILITIES.length} but got ${config.length}`);
@@ -752,7 +1129,7 @@ export default class WPILibWSRomiRobot extends WPILibWSRobotBase {
                         port: ioIdx // We use ioIdx here so that we know which offset to write to
                     });
 
-                    this._analogInputValues.set(this._analogInDevicePortMapping.length - 1, 0.0);
+                    this._inputValues.setAnalogActive(this._analogInDevicePortMapping.length - 1, true);
                     break;
                 case IOPinMode.DIO:
                     // Default to OUTPUT for digital pins
@@ -779,6 +1156,15 @@ export default class WPILibWSRomiRobot extends WPILibWSRobotBase {
         .then(() => {
             return this._writeRomiExtIOConfiguration();
         })
+        .then(() => {
+            return this._writeRomiAnalogFilterConfiguration();
+        })
+        .then(() => {
+            return this._writeRomiMotorSlewRate();
+        })
+        .then(() => {
+            return this._writeRomiFailsafeConfiguration();
+        })
         .then(() => {
             // Configure any custom devices we might have
             this._customDevices.forEach(device => {
@@ -799,6 +1185,7 @@ export default class WPILibWSRomiRobot extends WPILibWSRobotBase {
                             device,
                             port: i
                         });
+                        this._inputValues.setAnalogActive(this._analogInDevicePortMapping.length - 1, true);
                     }
                 }
 
@@ -824,11 +1211,7 @@ export default class WPILibWSRomiRobot extends WPILibWSRobotBase {
      * Write the onboard IO configuration in oneshot
      */
     private async _writeRomiOnboardIOConfiguration(): Promise<void> {
-        let configRegister: number = (1 << 7);
-        this._onboardPinConfiguration.forEach((pinMode, ioIdx) => {
-            let pinModeConfig: number = (pinMode & 0x1) << ioIdx;
-            configRegister |= pinModeConfig;
-        });
+        const configRegister = onboardIOConfigRegister(this._onboardPinConfiguration);
 
         return this._i2cHandle.writeByte(RomiDataBuffer.builtinConfig.offset, configRegister, 3)
         .catch(err => {
@@ -840,162 +1223,449 @@ export default class WPILibWSRomiRobot extends WPILibWSRobotBase {
      * Do the actual configuration write to the romi
      */
     private async _writeRomiExtIOConfiguration(): Promise<void> {
-        let configRegister: number = (1 << 15);
+        const configRegister = extIOConfigRegister(this._extPinConfiguration);
 
-        this._extPinConfiguration.forEach((pinMode, ioIdx) => {
-            let pinModeConfig: number = (pinMode & 0x3) << (13 - (2 * ioIdx));
-            configRegister |= pinModeConfig;
+        return this._i2cHandle.writeWord(RomiDataBuffer.ioConfig.offset, configRegister, 3)
+        .catch(err => {
+            this._i2cErrorDetector.addErrorInstance();
         });
+    }
 
-        return this._i2cHandle.writeWord(RomiDataBuffer.ioConfig.offset, configRegister, 3)
+    /**
+     * Write the per-channel analog oversampling/filter configuration
+     */
+    private async _writeRomiAnalogFilterConfiguration(): Promise<void> {
+        for (let ioIdx = 0; ioIdx < this._analogFilterConfiguration.length; ioIdx++) {
+            await this._i2cHandle.writeByte(RomiDataBuffer.analogConfig.offset + ioIdx, this._analogFilterConfiguration[ioIdx])
+            .catch(err => {
+                this._i2cErrorDetector.addErrorInstance();
+            });
+        }
+    }
+
+    /**
+     * Write the motor slew rate
+     */
+    private async _writeRomiMotorSlewRate(): Promise<void> {
+        return this._i2cHandle.writeWord(RomiDataBuffer.motorSlewRate.offset, motorSlewRateRegister(this._motorSlewRate))
         .catch(err => {
             this._i2cErrorDetector.addErrorInstance();
         });
     }
 
-    private _setRomiHeartBeat(): void {
-        if (this._numWsConnections > 0 && this._dsEnabled && this._dsHeartbeatPresent) {
-            this._i2cHandle.writeByte(RomiDataBuffer.heartbeat.offset, 1)
+    /**
+     * Write the heartbeat timeout and the per-channel safe values for
+     * external outputs
+     */
+    private async _writeRomiFailsafeConfiguration(): Promise<void> {
+        await this._i2cHandle.writeWord(RomiDataBuffer.heartbeatTimeoutMs.offset, this._heartbeatTimeoutMs & 0xFFFF)
+        .catch(err => {
+            this._i2cErrorDetector.addErrorInstance();
+        });
+
+        for (let ioIdx = 0; ioIdx < this._extPinConfiguration.length; ioIdx++) {
+            const romiValue = safeValueRegister(this._safeValues[ioIdx], this._extPinConfiguration[ioIdx]);
+            await this._i2cHandle.writeWord(RomiDataBuffer.extIoSafeValues.offset + (ioIdx * 2), romiValue)
             .catch(err => {
                 this._i2cErrorDetector.addErrorInstance();
             });
         }
     }
 
+    /**
+     * Write the profile parameters (in encoder ticks) followed by the
+     * command byte, which the firmware acts on
+     */
+    private async _writeRomiMotionProfile(command: number, distanceTicks: number, maxVelocityTicks: number, maxAccelTicks: number): Promise<void> {
+        const distance = Math.round(Math.max(-0x7FFF, Math.min(0x7FFF, distanceTicks)));
+        const maxVelocity = Math.round(Math.max(0, Math.min(0xFFFF, maxVelocityTicks)));
+        const maxAccel = Math.round(Math.max(0, Math.min(0xFFFF, maxAccelTicks)));
+
+        if (distance !== Math.round(distanceTicks)) {
+            logger.warn(`Motion profile distance exceeds the firmware limit of ${0x7FFF} ticks. Clamping`);
+        }
+
+        this._motionCommandSample = Infinity;
+
+        try {
+            await this._actuationHandle.writeWord(RomiDataBuffer.motionDistance.offset, distance & 0xFFFF);
+            await this._actuationHandle.writeWord(RomiDataBuffer.motionMaxVelocity.offset, maxVelocity);
+            await this._actuationHandle.writeWord(RomiDataBuffer.motionMaxAccel.offset, maxAccel);
+            await this._actuationHandle.writeByte(RomiDataBuffer.motionCommand.offset, command);
+        }
+        catch (err) {
+            this._i2cErrorDetector.addErrorInstance();
+        }
+
+        this._motionCommandSample = this._lastStaleTelemetrySample();
+    }
+
+    private _setAnalogFilterConfiguration(filterConfigs: AnalogFilterConfig[]) {
+        filterConfigs.forEach((filterConfig, ioIdx) => {
+            if (!filterConfig || ioIdx >= this._analogFilterConfiguration.length) {
+                return;
+            }
+
+            this._analogFilterConfiguration[ioIdx] = analogFilterRegister(filterConfig);
+        });
+    }
+
+    /**
+     * Whether the firmware should be kept alive, i.e. we're connected,
+     * enabled, and hearing from the DS
+     */
+    private _shouldSendHeartbeat(): boolean {
+        return this._numWsConnections > 0 && this._dsEnabled && this._dsHeartbeatPresent;
+    }
+
+    /**
+     * Send a heartbeat, unless a command block has carried one recently
+     * @param force Send one regardless (e.g. when the robot is enabled)
+     */
+    private _setRomiHeartBeat(force: boolean = false): void {
+        if (!this._shouldSendHeartbeat()) {
+            return;
+        }
+
+        // While outputs are being updated every loop, the command block
+        // writes keep the firmware alive on their own
+        const now = Date.now();
+        if (!force && (now - this._lastHeartbeatTime) < this.heartbeatPeriodMs) {
+            return;
+        }
+
+        this._lastHeartbeatTime = now;
+        this._shmemStats.heartbeat.standalone++;
+
+        this._actuationHandle.writeByte(RomiDataBuffer.heartbeat.offset, 1)
+        .catch(err => {
+            this._i2cErrorDetector.addErrorInstance();
+        });
+    }
+
+    // These run on every poll cycle, so they stick to plain loops over
+    // preallocated storage. Only custom devices (which are read
+    // asynchronously) create anything per read
+
     private _bulkAnalogRead() {
-        this._analogInDevicePortMapping.forEach((devicePortMapping, ainIdx) => {
+        for (let ainIdx = 0; ainIdx < this._analogInDevicePortMapping.length; ainIdx++) {
+            const devicePortMapping = this._analogInDevicePortMapping[ainIdx];
             if (devicePortMapping.device === "romi-onboard") {
-                return;
+                continue;
             }
 
             if (devicePortMapping.device === "romi-external") {
-                const offset = RomiDataBuffer.extIoValues.offset + (devicePortMapping.port * 2);
-                this._i2cHandle.readWord(offset)
-                .then(adcVal => {
-                    // The value sent over the wire is a 10-bit ADC value
-                    // We'll need to convert it to 5V
-                    const voltage = (adcVal / 1023.0) * 5.0;
-                    this._analogInputValues.set(ainIdx, voltage);
-                })
-                .catch(err => {
-                    this._i2cErrorDetector.addErrorInstance();
-                });
+                if (!this._telemetryBlock) {
+                    continue;
+                }
+
+                // The value sent over the wire is the (oversampled and filtered)
+                // 10-bit ADC value in 10.6 fixed point
+                // We'll need to convert it to 5V
+                const adcVal = this._getTelemetryValue(RomiDataBuffer.analog, devicePortMapping.port);
+                this._inputValues.setAnalog(ainIdx, (adcVal / ANALOG_FULL_SCALE) * 5.0);
             }
             else {
-                devicePortMapping.device.getAnalogInVoltage(devicePortMapping.port)
-                .then(voltage => {
-                    this._analogInputValues.set(ainIdx, voltage);
-                });
+                this._readCustomAnalogIn(devicePortMapping, ainIdx);
             }
-        });
+        }
+    }
 
+    private _readCustomAnalogIn(devicePortMapping: DevicePortMapping, ainIdx: number): void {
+        (devicePortMapping.device as CustomDevice).getAnalogInVoltage(devicePortMapping.port)
+        .then(voltage => {
+            this._inputValues.setAnalog(ainIdx, voltage);
+        });
     }
 
     private _bulkDigitalRead() {
-        this._digitalInputValues.forEach((val, channel) => {
-            const devicePortMapping = this._dioDevicePortMapping[channel];
-            if (!devicePortMapping) {
-                return;
+        const numChannels = Math.min(this._dioDevicePortMapping.length, MAX_DIO_CHANNELS);
+        for (let channel = 0; channel < numChannels; channel++) {
+            if (!this._inputValues.isDIOActive(channel)) {
+                continue;
             }
 
+            const devicePortMapping = this._dioDevicePortMapping[channel];
             if (devicePortMapping.device === "romi-onboard") {
-                const offset = RomiDataBuffer.builtinDioValues.offset + channel;
-                this._i2cHandle.readByte(offset)
-                .then(value => {
-                    this._digitalInputValues.set(channel, value !== 0);
-                })
-                .catch(err => {
-                    this._i2cErrorDetector.addErrorInstance();
-                });
+                if (!this._telemetryBlock) {
+                    continue;
+                }
+
+                const inputs = this._getTelemetryValue(RomiDataBuffer.builtinDioInputs);
+                this._inputValues.setDIO(channel, ((inputs >> devicePortMapping.port) & 0x1) !== 0);
             }
             else if (devicePortMapping.device === "romi-external") {
-                const offset = RomiDataBuffer.extIoValues.offset + (devicePortMapping.port * 2);
-                this._i2cHandle.readByte(offset)
-                .then(value => {
-                    this._digitalInputValues.set(channel, value !== 0);
-                })
-                .catch(err => {
-                    this._i2cErrorDetector.addErrorInstance();
-                });
+                if (!this._telemetryBlock) {
+                    continue;
+                }
+
+                const value = this._getTelemetryValue(RomiDataBuffer.extIoValues, devicePortMapping.port);
+                this._inputValues.setDIO(channel, value !== 0);
             }
             else {
-                devicePortMapping.device.getDigitalInValue(devicePortMapping.port)
-                .then(value => {
-                    this._digitalInputValues.set(channel, value);
-                });
+                this._readCustomDigitalIn(devicePortMapping, channel);
             }
+        }
+    }
+
+    private _readCustomDigitalIn(devicePortMapping: DevicePortMapping, channel: number): void {
+        (devicePortMapping.device as CustomDevice).getDigitalInValue(devicePortMapping.port)
+        .then(value => {
+            this._inputValues.setDIO(channel, value);
         });
     }
 
-    private _bulkEncoderRead() {
-        this._encoderInputValues.forEach((encoderInfo, channel) => {
-            let offset: number;
-            if (channel === this._leftEncoderChannel) {
-                offset = RomiDataBuffer.leftEncoder.offset;
-            }
-            else if (channel === this._rightEncoderChannel) {
-                offset = RomiDataBuffer.rightEncoder.offset;
-            }
-            else {
-                // Invalid encoder channel (shouldn't happen)
-                // bail out
-                return;
-            }
+    /**
+     * @param now Current time in ms, used to work out encoder periods
+     */
+    private _bulkEncoderRead(now: number) {
+        // Custom device encoders keep their own latest values
+        for (let i = 0; i < this._customEncoders.length; i++) {
+            const mapping = this._customEncoders[i];
+            this._updateEncoderValue(mapping.channel, mapping.device.getEncoderCount(mapping.encoder), now);
+        }
 
-            this._i2cHandle.readWord(offset)
-            .then(encoderValue => {
-                // This comes in as a uint16_t
-                const buf = Buffer.alloc(2);
-                buf.writeUInt16LE(encoderValue);
-                encoderValue = buf.readInt16LE();
+        if (!this._telemetryBlock) {
+            return;
+        }
 
-                const lastValue = encoderInfo.lastRobotValue;
+        this._updateEncoder(this._leftEncoderChannel, RomiDataBuffer.leftEncoder, this._leftEncoderResetSample, now);
+        this._updateEncoder(this._rightEncoderChannel, RomiDataBuffer.rightEncoder, this._rightEncoderResetSample, now);
+    }
 
-                // Figure out if we should be reporting flipped values
-                const reverseMultiplier = (encoderInfo.isHardwareReversed ? -1 : 1) *
-                                          (encoderInfo.isSoftwareReversed ? -1 : 1);
-                const delta = (encoderValue - lastValue) * reverseMultiplier;
+    private _updateEncoder(channel: number, field: ShmemElementDefinition, resetSample: number, now: number): void {
+        if (!this._inputValues.hasEncoder(channel) || this._telemetrySampleCount <= resetSample) {
+            return;
+        }
 
-                encoderInfo.reportedValue += delta;
-                encoderInfo.lastRobotValue = encoderValue;
+        this._updateEncoderValue(channel, this._getTelemetryValue(field), now);
+    }
 
-                const currTimestamp = Date.now();
+    private _updateEncoderValue(channel: number, encoderValue: number, now: number): void {
+        this._inputValues.updateEncoder(channel, encoderValue, now);
 
-                // Calculate the period
-                if (encoderInfo.lastReportedTime !== undefined) {
-                    const timespanMs = currTimestamp - encoderInfo.lastReportedTime;
-                    // Period = (approx) timespan / delta
-                    if (delta === 0) {
-                        encoderInfo.reportedPeriod = Number.MAX_VALUE;
-                    }
-                    else {
-                        encoderInfo.reportedPeriod = (timespanMs / delta) / 1000.0;
-                    }
-                }
+        // If we're getting close to the limits, reset the romi
+        // encoder so we don't overflow
+        if (Math.abs(encoderValue) > 30000) {
+            this.resetEncoder(channel, true);
+        }
+    }
 
-                encoderInfo.lastReportedTime = currTimestamp;
+    /**
+     * Note when either wheel last turned, whether or not the encoders are
+     * in use by the robot program
+     * @param now Current time in ms
+     */
+    private _trackWheelMotion(now: number): void {
+        if (!this._telemetryBlock) {
+            return;
+        }
 
-                // If we're getting close to the limits, reset the romi
-                // encoder so we don't overflow
-                if (Math.abs(encoderValue) > 30000) {
-                    this.resetEncoder(channel, true);
-                    encoderInfo.lastRobotValue = 0;
-                }
-            })
-            .catch(err => {
-                this._i2cErrorDetector.addErrorInstance();
-            })
-        });
+        const left = this._getTelemetryValue(RomiDataBuffer.leftEncoder);
+        const right = this._getTelemetryValue(RomiDataBuffer.rightEncoder);
+        if (left !== this._lastLeftEncoderRaw || right !== this._lastRightEncoderRaw) {
+            this._lastWheelMotionTime = now;
+            this._lastLeftEncoderRaw = left;
+            this._lastRightEncoderRaw = right;
+        }
     }
 
     private _readBattery(): void {
-        this._i2cHandle.readWord(RomiDataBuffer.batteryMillivolts.offset)
-        .then(battMv => {
-            this._batteryPct = battMv / 9000;
-        })
+        if (!this._telemetryBlock) {
+            return;
+        }
+
+        const battMv = this._getTelemetryValue(RomiDataBuffer.batteryMillivolts);
+        this._batteryPct = battMv / 9000;
+    }
+
+    /**
+     * Publish the motion profile state while a move is in progress, plus
+     * one final update once it finishes. After a motion command, nothing
+     * is published until a sample taken after the firmware picked the
+     * command up comes in, as earlier ones still hold the last move's state
+     */
+    private _readMotionStatus(): void {
+        if (!this._telemetryBlock) {
+            return;
+        }
+
+        if (this._motionCommandSample < 0 && this._motionState !== MOTION_STATE_RUNNING) {
+            return;
+        }
+
+        if (this._telemetrySampleCount <= this._motionCommandSample) {
+            return;
+        }
+        this._motionCommandSample = -1;
+
+        this._motionState = this._getTelemetryValue(RomiDataBuffer.motionState);
+        this._motionProgressTicks = this._getTelemetryValue(RomiDataBuffer.motionProgress);
+
+        this._motionNetworkTable.getEntry("State").setString(this.motionState);
+        this._motionNetworkTable.getEntry("Progress").setDouble(this.motionProgress);
+    }
+
+    /**
+     * Schedule a task at the current polling rate for the given class(es).
+     * The rate is looked up again each time, so changes made by adaptive
+     * polling take effect on the next run
+     */
+    private _addPollingTask(name: string, classes: TelemetryClass | TelemetryClass[], task: (now: number) => void): void {
+        const classList = classes instanceof Array ? classes : [classes];
+        this._scheduler.addTask(name, () => this._pollingRates.sharedPeriodMs(classList), task);
+    }
+
+    private _publishSchedulerStatus(): void {
+        const stats = this._scheduler.stats;
+        const schedulerTable = this._statusNetworkTable.getSubTable("Scheduler");
+
+        schedulerTable.getEntry("Event Loop Lag").setDouble(stats.avgLagMs);
+        schedulerTable.getEntry("Max Event Loop Lag").setDouble(stats.maxLagMs);
+
+        stats.tasks.forEach(task => {
+            schedulerTable.getEntry(`${task.name} Period`).setDouble(task.periodMs);
+            schedulerTable.getEntry(`${task.name} Overruns`).setDouble(task.overruns);
+        });
+    }
+
+    private _publishIMUStatus(): void {
+        this._imuNetworkTable.getEntry("Yaw").setDouble(this._imuFusion.yaw);
+        this._imuNetworkTable.getEntry("Pitch").setDouble(this._imuFusion.pitch);
+        this._imuNetworkTable.getEntry("Roll").setDouble(this._imuFusion.roll);
+        this._imuNetworkTable.getEntry("Quaternion").setDoubleArray(this._imuFusion.quaternion);
+        this._imuNetworkTable.getEntry("Stationary").setBoolean(this._gyroCalibration.isStationary);
+
+        // Keep the runtime offset entries in step with bias tracking
+        if (this._gyroCalibration.updates !== this._publishedBiasUpdates) {
+            this._publishedBiasUpdates = this._gyroCalibration.updates;
+
+            const offset = this._lsm6.gyroRuntimeOffset;
+            this._configNetworkTable.getEntry(GYRO_ADD_OFFSET_X_KEY).setDouble(offset.x);
+            this._configNetworkTable.getEntry(GYRO_ADD_OFFSET_Y_KEY).setDouble(offset.y);
+            this._configNetworkTable.getEntry(GYRO_ADD_OFFSET_Z_KEY).setDouble(offset.z);
+        }
+    }
+
+    private _updatePollingRates(): void {
+        // There's no way to tell when the robot program reads the IMU or
+        // custom devices, so treat them as in use while a client is connected
+        if (this._numWsConnections > 0) {
+            this._pollingRates.markAccessed(TelemetryClass.IMU);
+            this._pollingRates.markAccessed(TelemetryClass.CUSTOM_DEVICES);
+        }
+
+        this._pollingRates.update();
+
+        if (this._telemetrySnapshot) {
+            this._telemetrySnapshot.periodMs = this._pollingRates.sharedPeriodMs(TELEMETRY_BLOCK_CLASSES);
+        }
+        this._lsm6.fifoPollPeriodMs = this._pollingRates.periodMs(TelemetryClass.IMU);
+    }
+
+    /**
+     * Pick up the latest telemetry block sample and check its CRC. If the
+     * read failed or the block is corrupted, _telemetryBlock is cleared and
+     * the Romi values keep their last good readings. If no new sample has
+     * arrived since the last call, the previous one is kept
+     * @param now Current time in ms, for the recorder
+     */
+    private _readTelemetryBlock(now: number): void {
+        const info = this._telemetrySnapshot.read(this._telemetrySnapshotBuffer, this._telemetrySnapshotInfo);
+        if (info === null || info.sampleCount === this._telemetrySampleCount) {
+            return;
+        }
+
+        const newSamples = info.sampleCount - this._telemetrySampleCount;
+        this._telemetrySampleCount = info.sampleCount;
+
+        if (info.error) {
+            this._i2cErrorDetector.addErrorInstance();
+            this._recordI2CError(I2CErrorKind.TELEMETRY_SNAPSHOT, now);
+            this._telemetryBlock = null;
+            return;
+        }
+
+        const block = this._telemetrySnapshotBuffer;
+        this._shmemStats.telemetry.transfers += newSamples;
+
+        if (!isTelemetryBlockValid(block)) {
+            this._shmemStats.telemetry.crcErrors++;
+            this._i2cErrorDetector.addErrorInstance();
+            this._recordI2CError(I2CErrorKind.TELEMETRY_CRC, now);
+            this._telemetryBlock = null;
+            return;
+        }
+
+        if (this._recorder) {
+            this._recorder.recordTelemetry(block, now);
+        }
+
+        this._telemetryBlock = block;
+        this._checkCommandAck();
+    }
+
+    private _lastStaleTelemetrySample(): number {
+        return this._telemetrySnapshot ? lastStaleTelemetrySample(this._telemetrySnapshot.sampleCount) : 0;
+    }
+
+    private _recordI2CError(kind: I2CErrorKind, now: number): void {
+        if (this._recorder) {
+            this._recorder.recordI2CError(kind, this._i2cHandle.address, TELEMETRY_BLOCK_START, I2CPriority.TELEMETRY, now);
+        }
+    }
+
+    private _getTelemetryValue(field: ShmemElementDefinition, index: number = 0): number {
+        return getTelemetryValue(this._telemetryBlock, field, index);
+    }
+
+    /**
+     * Keep track of command CRC errors reported by the firmware, and
+     * resend the latest command if it hasn't been acknowledged
+     */
+    private _checkCommandAck(): void {
+        const crcErrors = this._getTelemetryValue(RomiDataBuffer.commandCrcErrors);
+        if (this._lastCommandCrcErrors >= 0) {
+            // The firmware counter is 8 bits and wraps
+            this._shmemStats.command.crcErrors += (crcErrors - this._lastCommandCrcErrors) & 0xFF;
+        }
+        this._lastCommandCrcErrors = crcErrors;
+
+        if (this._commandBlock.checkAck(this._getTelemetryValue(RomiDataBuffer.commandAck))) {
+            this._shmemStats.command.resends++;
+        }
+    }
+
+    /**
+     * commandFlags for the next command block. Only let the block stand
+     * in for a heartbeat if we'd be sending heartbeats anyway, so commands
+     * sent while disabled can't keep the motors running
+     */
+    private _nextCommandFlags(): number {
+        if (!this._shouldSendHeartbeat()) {
+            return 0;
+        }
+
+        this._lastHeartbeatTime = Date.now();
+        this._shmemStats.heartbeat.piggybacked++;
+        return COMMAND_FLAG_HEARTBEAT;
+    }
+
+    /**
+     * Send a stamped command block. The firmware only applies blocks that
+     * pass the CRC check
+     */
+    private async _sendRomiCommandBlock(block: Buffer): Promise<void> {
+        this._shmemStats.command.transfers++;
+
+        if (this._recorder) {
+            this._recorder.recordCommand(block, performance.now());
+        }
+
+        return this._actuationHandle.writeBlock(COMMAND_BLOCK_START, block)
         .catch(err => {
             this._i2cErrorDetector.addErrorInstance();
-        })
+        });
     }
 
     /**
@@ -1003,15 +1673,16 @@ export default class WPILibWSRomiRobot extends WPILibWSRobotBase {
      * This does NOT reset any IO configuration
      */
     private _resetToCleanState(): void {
-        this._digitalInputValues.clear();
-        this._encoderInputValues.clear();
-        this._analogInputValues.clear();
+        this._inputValues.clear();
 
         this._leftEncoderChannel = -1;
         this._rightEncoderChannel = -1;
+        this._leftEncoderResetSample = -1;
+        this._rightEncoderResetSample = -1;
+        this._customEncoders = [];
 
         // Set up DIO 0 as an input because it's a button
-        this._digitalInputValues.set(0, false);
+        this._inputValues.setDIOActive(0, true);
 
         // Set yellow LED to be true by default since
         // DigitalOutput in wpilib defaults to true
@@ -1022,9 +1693,6 @@ export default class WPILibWSRomiRobot extends WPILibWSRobotBase {
     }
 
     private _configureNTInterface() {
-        const GYRO_ADD_OFFSET_X_KEY = "Gyro Runtime Offset X";
-        const GYRO_ADD_OFFSET_Y_KEY = "Gyro Runtime Offset Y";
-        const GYRO_ADD_OFFSET_Z_KEY = "Gyro Runtime Offset Z";
         // Set up the gyro filter window
         this._configNetworkTable.getEntry("Gyro Filter Window").setDouble(this._romiGyro.filterWindow);
         this._configNetworkTable.addEntryListener("Gyro Filter Window", (table, key, entry, value, flags) => {
@@ -1037,6 +1705,69 @@ export default class WPILibWSRomiRobot extends WPILibWSRobotBase {
             }
         }, EntryListenerFlags.NEW | EntryListenerFlags.UPDATE);
 
+        // Set up the IMU fusion gain
+        this._configNetworkTable.getEntry("IMU Fusion Gain").setDouble(this._imuFusion.gain);
+        this._configNetworkTable.addEntryListener("IMU Fusion Gain", (table, key, entry, value, flags) => {
+            const newValue = Math.max(value.getDouble(), 0);
+            if (newValue !== this._imuFusion.gain) {
+                logger.info("IMU Fusion Gain set to " + newValue);
+                this._imuFusion.gain = newValue;
+            }
+        }, EntryListenerFlags.NEW | EntryListenerFlags.UPDATE);
+
+        // Set up the motor slew rate
+        this._configNetworkTable.getEntry("Motor Slew Rate").setDouble(this._motorSlewRate);
+        this._configNetworkTable.addEntryListener("Motor Slew Rate", (table, key, entry, value, flags) => {
+            const newValue = Math.max(value.getDouble(), 0);
+            if (newValue !== this._motorSlewRate) {
+                logger.info("Motor Slew Rate set to " + newValue);
+                this._motorSlewRate = newValue;
+                this._writeRomiMotorSlewRate();
+            }
+        }, EntryListenerFlags.NEW | EntryListenerFlags.UPDATE);
+
+        // Set up the motion profile interface. Moves are parameterized by the
+        // value entries, and kicked off by setting a trigger entry to true
+        const motionDefaults: [string, number][] = [
+            ["Drive Distance", 0],
+            ["Max Velocity", 0.3],
+            ["Max Acceleration", 0.6],
+            ["Turn Angle", 0],
+            ["Max Angular Velocity", 180],
+            ["Max Angular Acceleration", 360]
+        ];
+        motionDefaults.forEach(([key, defaultValue]) => {
+            this._motionNetworkTable.getEntry(key).setDouble(defaultValue);
+        });
+
+        this._motionNetworkTable.getEntry("State").setString(this.motionState);
+        this._motionNetworkTable.getEntry("Progress").setDouble(0);
+
+        const motionTriggers: [string, () => Promise<void>][] = [
+            ["Start Drive", () => {
+                return this.startDriveProfile(this._motionNetworkTable.getEntry("Drive Distance").getDouble(0),
+                                              this._motionNetworkTable.getEntry("Max Velocity").getDouble(0),
+                                              this._motionNetworkTable.getEntry("Max Acceleration").getDouble(0));
+            }],
+            ["Start Turn", () => {
+                return this.startTurnProfile(this._motionNetworkTable.getEntry("Turn Angle").getDouble(0),
+                                             this._motionNetworkTable.getEntry("Max Angular Velocity").getDouble(0),
+                                             this._motionNetworkTable.getEntry("Max Angular Acceleration").getDouble(0));
+            }],
+            ["Cancel", () => {
+                return this.cancelMotionProfile();
+            }]
+        ];
+        motionTriggers.forEach(([triggerKey, action]) => {
+            this._motionNetworkTable.getEntry(triggerKey).setBoolean(false);
+            this._motionNetworkTable.addEntryListener(triggerKey, (table, key, entry, value, flags) => {
+                if (value.getBoolean()) {
+                    this._motionNetworkTable.getEntry(triggerKey).setBoolean(false);
+                    action();
+                }
+            }, EntryListenerFlags.NEW | EntryListenerFlags.UPDATE);
+        });
+
         // Set up additional offsets on the gyro
         const addlOffsetXEntry = this._configNetworkTable.getEntry(GYRO_ADD_OFFSET_X_KEY);
         addlOffsetXEntry.setDouble(0.0);
@@ -1066,6 +1797,38 @@ export default class WPILibWSRomiRobot extends WPILibWSRobotBase {
         }, EntryListenerFlags.NEW | EntryListenerFlags.UPDATE);
     }
 
+    /**
+     * Set up an encoder on a pair of a custom device's DIO ports, if the
+     * device has one there (e.g. another Romi board)
+     */
+    private _registerCustomEncoder(encoderChannel: number, channelA: number, channelB: number): void {
+        const mappingA = this._dioDevicePortMapping[channelA];
+        const mappingB = this._dioDevicePortMapping[channelB];
+        if (!mappingA || !mappingB || mappingA.device !== mappingB.device || typeof mappingA.device === "string") {
+            return;
+        }
+
+        const device = mappingA.device;
+        const encoder = device.getEncoder(mappingA.port, mappingB.port);
+        if (!encoder) {
+            return;
+        }
+
+        this._customEncoders = this._customEncoders.filter(mapping => mapping.channel !== encoderChannel);
+        this._customEncoders.push({ channel: encoderChannel, device, encoder: encoder.index });
+        this._inputValues.addEncoder(encoderChannel, encoder.reversed);
+    }
+
+    private _getCustomEncoder(channel: number): CustomEncoderMapping | undefined {
+        for (let i = 0; i < this._customEncoders.length; i++) {
+            if (this._customEncoders[i].channel === channel) {
+                return this._customEncoders[i];
+            }
+        }
+
+        return undefined;
+    }
+
     private _registerCustomDevices(robotHardware: RobotHardwareInterfaces, deviceSpecs: CustomDeviceSpec[]) {
         const singletonDevices: Set<string> = new Set<string>();
 
@@ -1082,6 +1845,7 @@ export default class WPILibWSRomiRobot extends WPILibWSRobotBase {
                 }
 
                 this._customDevices.push(device);
+                this._customDeviceScheduler.addDevice(device, deviceSpec.rateHz);
             }
             catch (err) {
                 logger.error(`Error creating device (${deviceSpec.type}): ${err.message}`);
@@ -1,9 +1,9 @@
 // AUTOGENERATED FILE. DO NOT MODIFY.
 // Generated via `npm run gen-shmem`
 
-// Instance: b716f7f0-1c8e-4af6-8271-386c9c6c1276
+// Instance: f03b1fd3-75be-44cb-a802-6b3206767913
 
-export const FIRMWARE_IDENT: number = 118;
+export const FIRMWARE_IDENT: number = 19;
 
 export enum ShmemDataType {
     BOOL,
@@ -17,6 +17,8 @@ export interface ShmemElementDefinition {
     offset: number;
     type: ShmemDataType;
     arraySize?: number;
+    crcStart?: number;
+    crcLength?: number;
 }
 
 const shmemBuffer: {[key: string]: ShmemElementDefinition} = {
@@ -24,17 +26,36 @@ const shmemBuffer: {[key: string]: ShmemElementDefinition} = {
     firmwareIdent: { offset: 2, type: ShmemDataType.UINT8_T},
     status: { offset: 3, type: ShmemDataType.UINT8_T},
     heartbeat: { offset: 4, type: ShmemDataType.BOOL},
-    builtinConfig: { offset: 5, type: ShmemDataType.UINT8_T},
-    builtinDioValues: { offset: 6, type: ShmemDataType.BOOL, arraySize: 4},
-    extIoValues: { offset: 10, type: ShmemDataType.INT16_T, arraySize: 5},
-    analog: { offset: 20, type: ShmemDataType.UINT16_T, arraySize: 2},
-    leftMotor: { offset: 24, type: ShmemDataType.INT16_T},
-    rightMotor: { offset: 26, type: ShmemDataType.INT16_T},
-    batteryMillivolts: { offset: 28, type: ShmemDataType.UINT16_T},
+    resetCause: { offset: 5, type: ShmemDataType.UINT8_T},
+    heartbeatTimeoutMs: { offset: 6, type: ShmemDataType.UINT16_T},
+    builtinConfig: { offset: 8, type: ShmemDataType.UINT8_T},
+    builtinDioValues: { offset: 9, type: ShmemDataType.BOOL, arraySize: 4},
+    extIoSafeValues: { offset: 13, type: ShmemDataType.INT16_T, arraySize: 5},
+    analogConfig: { offset: 23, type: ShmemDataType.UINT8_T, arraySize: 5},
+    motorSlewRate: { offset: 28, type: ShmemDataType.UINT16_T},
     resetLeftEncoder: { offset: 30, type: ShmemDataType.BOOL},
     resetRightEncoder: { offset: 31, type: ShmemDataType.BOOL},
-    leftEncoder: { offset: 32, type: ShmemDataType.INT16_T},
-    rightEncoder: { offset: 34, type: ShmemDataType.INT16_T},
+    motionCommand: { offset: 32, type: ShmemDataType.UINT8_T},
+    motionDistance: { offset: 33, type: ShmemDataType.INT16_T},
+    motionMaxVelocity: { offset: 35, type: ShmemDataType.UINT16_T},
+    motionMaxAccel: { offset: 37, type: ShmemDataType.UINT16_T},
+    commandSeq: { offset: 39, type: ShmemDataType.UINT8_T},
+    commandFlags: { offset: 40, type: ShmemDataType.UINT8_T},
+    leftMotor: { offset: 41, type: ShmemDataType.INT16_T},
+    rightMotor: { offset: 43, type: ShmemDataType.INT16_T},
+    extIoOutputs: { offset: 45, type: ShmemDataType.INT16_T, arraySize: 5},
+    commandCrc: { offset: 55, type: ShmemDataType.UINT8_T, crcStart: 39, crcLength: 16},
+    extIoValues: { offset: 56, type: ShmemDataType.INT16_T, arraySize: 5},
+    builtinDioInputs: { offset: 66, type: ShmemDataType.UINT8_T},
+    analog: { offset: 67, type: ShmemDataType.UINT16_T, arraySize: 5},
+    batteryMillivolts: { offset: 77, type: ShmemDataType.UINT16_T},
+    leftEncoder: { offset: 79, type: ShmemDataType.INT16_T},
+    rightEncoder: { offset: 81, type: ShmemDataType.INT16_T},
+    motionState: { offset: 83, type: ShmemDataType.UINT8_T},
+    motionProgress: { offset: 84, type: ShmemDataType.INT16_T},
+    commandAck: { offset: 86, type: ShmemDataType.UINT8_T},
+    commandCrcErrors: { offset: 87, type: ShmemDataType.UINT8_T},
+    telemetryCrc: { offset: 88, type: ShmemDataType.UINT8_T, crcStart: 56, crcLength: 32},
 };
 
 export default Object.freeze(shmemBuffer);
@@ -0,0 +1,240 @@
+import RomiDataBuffer, { ShmemDataType, ShmemElementDefinition } from "./romi-shmem-buffer";
+import { crc8 } from "../utils/crc8";
+import type { AnalogFilterConfig, SafeValue } from "./romi-config";
+
+/**
+ * How the robot and custom Romi boards talk to the Romi firmware over the
+ * shared buffer: the CRC protected command and telemetry blocks, and the
+ * encoding of the configuration registers. See
+ * firmware/include/shmem_buffer.h and firmware/include/shmem_crc.h
+ */
+
+// Analog values are reported by the firmware as 10.6 fixed point ADC counts
+export const ANALOG_FULL_SCALE: number = 1023 * 64;
+
+// Romi motor commands range from -400 to 400
+export const MOTOR_FULL_SCALE: number = 400;
+
+// Tells the firmware to keep the last commanded value on heartbeat loss
+// See firmware/include/watchdog_supervisor.h
+export const SAFE_VALUE_HOLD: number = 0x7FFF;
+
+// Firmware pin modes (see firmware/src/main.cpp)
+export const MODE_DIGITAL_OUT: number = 0;
+export const MODE_DIGITAL_IN: number = 1;
+export const MODE_ANALOG_IN: number = 2;
+export const MODE_PWM: number = 3;
+
+// Firmware heartbeat timeout. The default matches the firmware's
+// (see firmware/include/watchdog_supervisor.h)
+export const MIN_HEARTBEAT_TIMEOUT_MS: number = 20;
+export const DEFAULT_HEARTBEAT_TIMEOUT_MS: number = 1000;
+
+// Bits of the firmware commandFlags register
+// Set on command blocks that should also count as a heartbeat
+export const COMMAND_FLAG_HEARTBEAT: number = 0x01;
+
+// CRC protected regions of the shared buffer. Each region is transferred
+// as a single block, with the CRC byte at the end
+export const COMMAND_BLOCK_START: number = RomiDataBuffer.commandCrc.crcStart;
+export const COMMAND_BLOCK_LENGTH: number = RomiDataBuffer.commandCrc.crcLength + 1;
+export const TELEMETRY_BLOCK_START: number = RomiDataBuffer.telemetryCrc.crcStart;
+export const TELEMETRY_BLOCK_LENGTH: number = RomiDataBuffer.telemetryCrc.crcLength + 1;
+
+// Number of telemetry reads a command can go unacknowledged before
+// we send it again
+const MAX_COMMAND_ACK_MISSES: number = 2;
+
+/**
+ * Last telemetry sample, given the number read so far, that may not
+ * reflect a write that has just completed. The firmware only acts on a
+ * write on its next loop, and publishes the result in finalizeWrites(),
+ * so a read finishing just after the write can still carry the old values
+ */
+export function lastStaleTelemetrySample(sampleCount: number): number {
+    return sampleCount + 1;
+}
+
+/**
+ * Whether a telemetry block read came through intact
+ */
+export function isTelemetryBlockValid(block: Buffer): boolean {
+    return crc8(block, 0, TELEMETRY_BLOCK_LENGTH - 1) === block[TELEMETRY_BLOCK_LENGTH - 1];
+}
+
+/**
+ * Read a field out of a telemetry block
+ */
+export function getTelemetryValue(block: Buffer, field: ShmemElementDefinition, index: number = 0): number {
+    const offset = field.offset - TELEMETRY_BLOCK_START;
+
+    switch (field.type) {
+        case ShmemDataType.UINT16_T:
+            return block.readUInt16LE(offset + (index * 2));
+        case ShmemDataType.INT16_T:
+            return block.readInt16LE(offset + (index * 2));
+        case ShmemDataType.INT8_T:
+            return block.readInt8(offset + index);
+        default:
+            return block.readUInt8(offset + index);
+    }
+}
+
+/**
+ * builtinConfig value for the onboard DIO modes (input or output only)
+ */
+export function onboardIOConfigRegister(pinModes: number[]): number {
+    let configRegister: number = (1 << 7);
+    pinModes.forEach((pinMode, ioIdx) => {
+        configRegister |= (pinMode & 0x1) << ioIdx;
+    });
+
+    return configRegister;
+}
+
+/**
+ * ioConfig value for the external pin modes
+ */
+export function extIOConfigRegister(pinModes: number[]): number {
+    let configRegister: number = (1 << 15);
+    pinModes.forEach((pinMode, ioIdx) => {
+        configRegister |= (pinMode & 0x3) << (13 - (2 * ioIdx));
+    });
+
+    return configRegister;
+}
+
+/**
+ * analogConfig value for one channel
+ * See firmware/include/analog_filter.h for the register layout
+ */
+export function analogFilterRegister(filterConfig: AnalogFilterConfig): number {
+    const oversampleBits = (filterConfig.oversampleBits || 0) & 0x7;
+    const filterShift = (filterConfig.filterShift || 0) & 0x7;
+    return (filterShift << 4) | oversampleBits;
+}
+
+/**
+ * motorSlewRate value, converted from fraction of full scale per second
+ * to firmware motor units per second
+ */
+export function motorSlewRateRegister(slewRate: number): number {
+    return Math.min(Math.round(slewRate * MOTOR_FULL_SCALE), 0xFFFF);
+}
+
+/**
+ * extIoSafeValues value for an external pin in the given firmware mode,
+ * as the unsigned representation of the int16_t
+ */
+export function safeValueRegister(safeValue: SafeValue | undefined, pinMode: number): number {
+    let romiValue: number = SAFE_VALUE_HOLD;
+
+    if (safeValue !== undefined && safeValue !== null) {
+        switch (pinMode) {
+            case MODE_DIGITAL_OUT:
+            case MODE_DIGITAL_IN:
+                romiValue = safeValue ? 1 : 0;
+                break;
+            case MODE_PWM:
+                romiValue = Math.round(Math.max(-1, Math.min(1, Number(safeValue))) * MOTOR_FULL_SCALE);
+                break;
+        }
+    }
+
+    return romiValue & 0xFFFF;
+}
+
+/**
+ * The command block, with its sequence numbering and resends
+ *
+ * Values set in the same tick go out together in a single block write.
+ * Each write is stamped with the next sequence number, the command flags
+ * and the CRC, and the firmware only applies blocks that pass the CRC
+ * check. The sequence number the firmware acknowledges comes back in
+ * telemetry, and a block that goes unacknowledged is sent again
+ */
+export default class RomiCommandBlock {
+    private _block: Buffer = Buffer.alloc(COMMAND_BLOCK_LENGTH);
+    private _seq: number = 0;
+    private _writePending: boolean = false;
+    private _ackMisses: number = 0;
+
+    private _send: (block: Buffer) => Promise<void>;
+    private _getFlags: () => number;
+
+    /**
+     * @param send Writes a block to the firmware. Gets a copy, since the
+     * write sits in the bus queue for a bit
+     * @param getFlags commandFlags value for the next write
+     */
+    constructor(send: (block: Buffer) => Promise<void>, getFlags: () => number = () => 0) {
+        this._send = send;
+        this._getFlags = getFlags;
+    }
+
+    public get seq(): number {
+        return this._seq;
+    }
+
+    /**
+     * Carry on from the last command sequence number the firmware
+     * accepted, so our first command isn't mistaken for one it has
+     * already applied
+     */
+    public resumeFrom(ack: number): void {
+        this._seq = ack & 0xFF;
+    }
+
+    /**
+     * Update a value in the block, and queue up a write for the end of
+     * the tick
+     */
+    public setValue(field: ShmemElementDefinition, value: number, index: number = 0): void {
+        const offset = field.offset - COMMAND_BLOCK_START + (index * 2);
+        this._block.writeInt16LE(value, offset);
+
+        if (!this._writePending) {
+            this._writePending = true;
+            setImmediate(() => {
+                this._writePending = false;
+                this.write();
+            });
+        }
+    }
+
+    /**
+     * Stamp the block with the next sequence number, the flags and the
+     * CRC, and send it
+     */
+    public write(): Promise<void> {
+        // Sequence number 0 is what the firmware starts up with, so skip it
+        this._seq = (this._seq % 255) + 1;
+
+        this._block[RomiDataBuffer.commandSeq.offset - COMMAND_BLOCK_START] = this._seq;
+        this._block[RomiDataBuffer.commandFlags.offset - COMMAND_BLOCK_START] = this._getFlags();
+        this._block[COMMAND_BLOCK_LENGTH - 1] = crc8(this._block, 0, COMMAND_BLOCK_LENGTH - 1);
+
+        return this._send(Buffer.from(this._block));
+    }
+
+    /**
+     * Check the acknowledged sequence number from a telemetry block, and
+     * resend the latest command if it has been missed too many times
+     * @returns Whether the block was sent again
+     */
+    public checkAck(ack: number): boolean {
+        if (ack === this._seq || this._writePending) {
+            this._ackMisses = 0;
+            return false;
+        }
+
+        this._ackMisses++;
+        if (this._ackMisses < MAX_COMMAND_ACK_MISSES) {
+            return false;
+        }
+
+        this._ackMisses = 0;
+        this.write();
+        return true;
+    }
+}
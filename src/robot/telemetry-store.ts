@@ -0,0 +1,233 @@
+// Channel counts that the store has room for. These cover everything the
+// WPILib simulation HAL hands out, with room to spare for custom devices
+export const MAX_DIO_CHANNELS: number = 32;
+export const MAX_ANALOG_CHANNELS: number = 8;
+export const MAX_ENCODER_CHANNELS: number = 8;
+
+// Bits of the per-encoder flags
+const ENCODER_ACTIVE: number = 0x01;
+const ENCODER_HARDWARE_REVERSED: number = 0x02;
+const ENCODER_SOFTWARE_REVERSED: number = 0x04;
+const ENCODER_HAS_TIMESTAMP: number = 0x08;
+const ENCODER_RESYNC: number = 0x10;
+
+function inRange(channel: number, numChannels: number): boolean {
+    return channel >= 0 && channel < numChannels;
+}
+
+/**
+ * Latest input values reported to the robot program
+ *
+ * Everything is kept in typed arrays indexed by channel, allocated up
+ * front, so that updating the store on every poll cycle doesn't create
+ * any garbage. Channels outside the supported range are ignored on write
+ * and read back as their default value
+ */
+export default class TelemetryStore {
+    private _dioActive: Uint8Array = new Uint8Array(MAX_DIO_CHANNELS);
+    private _dioValues: Uint8Array = new Uint8Array(MAX_DIO_CHANNELS);
+
+    private _analogActive: Uint8Array = new Uint8Array(MAX_ANALOG_CHANNELS);
+    private _analogValues: Float64Array = new Float64Array(MAX_ANALOG_CHANNELS);
+
+    private _encoderFlags: Uint8Array = new Uint8Array(MAX_ENCODER_CHANNELS);
+    // Reading that is reported to the robot program
+    private _encoderCounts: Float64Array = new Float64Array(MAX_ENCODER_CHANNELS);
+    // Period that is reported to the robot program
+    private _encoderPeriods: Float64Array = new Float64Array(MAX_ENCODER_CHANNELS);
+    // Last raw value reported by the Romi
+    private _encoderLastRaw: Float64Array = new Float64Array(MAX_ENCODER_CHANNELS);
+    private _encoderLastTime: Float64Array = new Float64Array(MAX_ENCODER_CHANNELS);
+
+    /**
+     * Forget all channels and values
+     */
+    public clear(): void {
+        this._dioActive.fill(0);
+        this._dioValues.fill(0);
+        this._analogActive.fill(0);
+        this._analogValues.fill(0);
+        this._encoderFlags.fill(0);
+        this._encoderCounts.fill(0);
+        this._encoderPeriods.fill(0);
+        this._encoderLastRaw.fill(0);
+        this._encoderLastTime.fill(0);
+    }
+
+    // DIO
+
+    /**
+     * Start (or stop) tracking a digital input. Newly added inputs read
+     * false until their first update
+     */
+    public setDIOActive(channel: number, active: boolean): void {
+        if (!inRange(channel, MAX_DIO_CHANNELS)) {
+            return;
+        }
+
+        if (active && !this._dioActive[channel]) {
+            this._dioValues[channel] = 0;
+        }
+        this._dioActive[channel] = active ? 1 : 0;
+    }
+
+    public isDIOActive(channel: number): boolean {
+        return inRange(channel, MAX_DIO_CHANNELS) && this._dioActive[channel] !== 0;
+    }
+
+    public getDIO(channel: number): boolean {
+        return this.isDIOActive(channel) && this._dioValues[channel] !== 0;
+    }
+
+    public setDIO(channel: number, value: boolean): void {
+        if (this.isDIOActive(channel)) {
+            this._dioValues[channel] = value ? 1 : 0;
+        }
+    }
+
+    // Analog
+
+    public setAnalogActive(channel: number, active: boolean): void {
+        if (!inRange(channel, MAX_ANALOG_CHANNELS)) {
+            return;
+        }
+
+        if (active && !this._analogActive[channel]) {
+            this._analogValues[channel] = 0;
+        }
+        this._analogActive[channel] = active ? 1 : 0;
+    }
+
+    public isAnalogActive(channel: number): boolean {
+        return inRange(channel, MAX_ANALOG_CHANNELS) && this._analogActive[channel] !== 0;
+    }
+
+    public getAnalog(channel: number): number {
+        return this.isAnalogActive(channel) ? this._analogValues[channel] : 0.0;
+    }
+
+    /**
+     * Update an analog input, starting to track it if it wasn't already
+     */
+    public setAnalog(channel: number, voltage: number): void {
+        if (inRange(channel, MAX_ANALOG_CHANNELS)) {
+            this._analogActive[channel] = 1;
+            this._analogValues[channel] = voltage;
+        }
+    }
+
+    // Encoders
+
+    /**
+     * Start tracking an encoder, from a count of 0
+     * @param hardwareReversed Whether the Romi counts this encoder backwards
+     */
+    public addEncoder(channel: number, hardwareReversed: boolean): void {
+        if (!inRange(channel, MAX_ENCODER_CHANNELS)) {
+            return;
+        }
+
+        this._encoderFlags[channel] = ENCODER_ACTIVE | (hardwareReversed ? ENCODER_HARDWARE_REVERSED : 0);
+        this._encoderCounts[channel] = 0;
+        this._encoderPeriods[channel] = Number.MAX_VALUE;
+        this._encoderLastRaw[channel] = 0;
+        this._encoderLastTime[channel] = 0;
+    }
+
+    public hasEncoder(channel: number): boolean {
+        return inRange(channel, MAX_ENCODER_CHANNELS) && (this._encoderFlags[channel] & ENCODER_ACTIVE) !== 0;
+    }
+
+    public getEncoderCount(channel: number): number {
+        return this.hasEncoder(channel) ? this._encoderCounts[channel] : 0;
+    }
+
+    public getEncoderPeriod(channel: number): number {
+        return this.hasEncoder(channel) ? this._encoderPeriods[channel] : Number.MAX_VALUE;
+    }
+
+    public setEncoderSoftwareReversed(channel: number, reverse: boolean): void {
+        if (!this.hasEncoder(channel)) {
+            return;
+        }
+
+        if (reverse) {
+            this._encoderFlags[channel] |= ENCODER_SOFTWARE_REVERSED;
+        }
+        else {
+            this._encoderFlags[channel] &= ~ENCODER_SOFTWARE_REVERSED;
+        }
+    }
+
+    /**
+     * Note that the Romi's counter for this encoder has been zeroed
+     * @param keepLast Keep reporting the current count, rather than
+     * dropping back to 0
+     */
+    public resetEncoder(channel: number, keepLast: boolean = false): void {
+        if (!this.hasEncoder(channel)) {
+            return;
+        }
+
+        this._encoderLastRaw[channel] = 0;
+        this._encoderFlags[channel] &= ~ENCODER_RESYNC;
+        if (!keepLast) {
+            this._encoderCounts[channel] = 0;
+        }
+    }
+
+    /**
+     * Take the next raw count as the new starting point, without adding
+     * anything to the reported count, e.g. when it isn't known whether
+     * the Romi's counter was zeroed
+     */
+    public resyncEncoder(channel: number): void {
+        if (!this.hasEncoder(channel)) {
+            return;
+        }
+
+        this._encoderFlags[channel] |= ENCODER_RESYNC;
+    }
+
+    /**
+     * Feed in the latest raw count from the Romi, accumulating the change
+     * since the last update into the reported count and period
+     * @param now Current time in ms
+     */
+    public updateEncoder(channel: number, rawValue: number, now: number): void {
+        if (!this.hasEncoder(channel)) {
+            return;
+        }
+
+        const flags = this._encoderFlags[channel];
+
+        if (flags & ENCODER_RESYNC) {
+            this._encoderLastRaw[channel] = rawValue;
+            this._encoderLastTime[channel] = now;
+            this._encoderFlags[channel] = flags & ~ENCODER_RESYNC;
+            return;
+        }
+
+        // Figure out if we should be reporting flipped values
+        const reverseMultiplier = ((flags & ENCODER_HARDWARE_REVERSED) ? -1 : 1) *
+                                  ((flags & ENCODER_SOFTWARE_REVERSED) ? -1 : 1);
+        const delta = (rawValue - this._encoderLastRaw[channel]) * reverseMultiplier;
+
+        this._encoderCounts[channel] += delta;
+        this._encoderLastRaw[channel] = rawValue;
+
+        // Period = (approx) timespan / delta
+        if (flags & ENCODER_HAS_TIMESTAMP) {
+            if (delta === 0) {
+                this._encoderPeriods[channel] = Number.MAX_VALUE;
+            }
+            else {
+                const timespanMs = now - this._encoderLastTime[channel];
+                this._encoderPeriods[channel] = (timespanMs / delta) / 1000.0;
+            }
+        }
+
+        this._encoderLastTime[channel] = now;
+        this._encoderFlags[channel] = flags | ENCODER_HAS_TIMESTAMP;
+    }
+}
@@ -1,4 +1,5 @@
 import ProgramArguments from "./program-arguments";
+import { DEFAULT_FIRMWARE_SIM_PROGRAM } from "./__mocks__/firmware-sim-romi";
 
 export enum EndpointType {
     CLIENT = "client",
@@ -11,6 +12,9 @@ export default class ServiceConfiguration {
     private _port: number = 3300;
     private _host: string = "localhost";
     private _uri: string = "/wpilibws";
+    private _recordDirectory: string | undefined;
+    private _firmwareSimProgram: string | undefined;
+    private _physicsSim: boolean = false;
 
     constructor(programArgs: ProgramArguments) {
         if (programArgs.endpointType !== "client" && programArgs.endpointType !== "server") {
@@ -43,6 +47,23 @@ export default class ServiceConfiguration {
         if (programArgs.mockI2c !== undefined) {
             this._forceMockI2C = programArgs.mockI2c;
         }
+
+        if (programArgs.record !== undefined) {
+            this._recordDirectory = programArgs.record;
+        }
+
+        if (programArgs.firmwareSim !== undefined) {
+            this._firmwareSimProgram = (typeof programArgs.firmwareSim === "string") ?
+                                        programArgs.firmwareSim : DEFAULT_FIRMWARE_SIM_PROGRAM;
+
+            // The simulator only makes sense on the mock bus
+            this._forceMockI2C = true;
+        }
+
+        if (programArgs.physics) {
+            this._physicsSim = true;
+            this._forceMockI2C = true;
+        }
     }
 
     public get endpointType(): EndpointType {
@@ -64,4 +85,25 @@ export default class ServiceConfiguration {
     public get uri(): string {
         return this._uri;
     }
+
+    /**
+     * Directory to write binary telemetry logs to, if recording
+     */
+    public get recordDirectory(): string | undefined {
+        return this._recordDirectory;
+    }
+
+    /**
+     * Natively built firmware to run as the mock Romi, if any
+     */
+    public get firmwareSimProgram(): string | undefined {
+        return this._firmwareSimProgram;
+    }
+
+    /**
+     * Whether the mock Romi drives a simulated drivetrain
+     */
+    public get physicsSim(): boolean {
+        return this._physicsSim;
+    }
 }
@@ -73,18 +73,22 @@ export default class GyroCalibrationUtil {
                 return;
             }
 
-            frames.forEach(frame => {
-                minX = Math.min(minX, frame.gyroX);
-                maxX = Math.max(maxX, frame.gyroX);
-                minY = Math.min(minY, frame.gyroY);
-                maxY = Math.max(maxY, frame.gyroY);
-                minZ = Math.min(minZ, frame.gyroZ);
-                maxZ = Math.max(maxZ, frame.gyroZ);
-
-                totalX += frame.gyroX;
-                totalY += frame.gyroY;
-                totalZ += frame.gyroZ;
-            });
+            for (let i = 0; i < frames.length; i++) {
+                const gyroX = frames.gyroX(i);
+                const gyroY = frames.gyroY(i);
+                const gyroZ = frames.gyroZ(i);
+
+                minX = Math.min(minX, gyroX);
+                maxX = Math.max(maxX, gyroX);
+                minY = Math.min(minY, gyroY);
+                maxY = Math.max(maxY, gyroY);
+                minZ = Math.min(minZ, gyroZ);
+                maxZ = Math.max(maxZ, gyroZ);
+
+                totalX += gyroX;
+                totalY += gyroY;
+                totalZ += gyroZ;
+            }
 
             this._numSamplesProcessed += frames.length;
 
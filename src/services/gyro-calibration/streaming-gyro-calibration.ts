@@ -0,0 +1,236 @@
+import { FIFOFrames, Vector3 } from "../../robot/devices/core/lsm6/lsm6";
+import RunningStats from "../../utils/running-stats";
+
+export interface StreamingCalibrationConfig {
+    // How long the robot has to sit still before its gyro readings are used
+    windowSeconds?: number;
+
+    // Any gyro axis reading above this means the robot is turning
+    maxRateDPS?: number;
+
+    // Upper limit on the standard deviation of each gyro axis over a window
+    maxNoiseDPS?: number;
+
+    // How far the accelerometer can stray from 1G for a frame to count as still
+    accelToleranceG?: number;
+
+    // Upper limit on the standard deviation of the acceleration over a window
+    maxAccelNoiseG?: number;
+
+    // Fraction of each new estimate applied after the first (0-1)
+    trackingGain?: number;
+}
+
+export interface StreamingCalibrationStats {
+    stationary: boolean;
+    updates: number;
+    rejectedWindows: number;
+    lastResidual: Vector3;
+    lastNoise: Vector3;
+}
+
+const DEFAULT_WINDOW_SECONDS: number = 1.0;
+const DEFAULT_MAX_RATE_DPS: number = 10.0;
+const DEFAULT_MAX_NOISE_DPS: number = 0.5;
+const DEFAULT_ACCEL_TOLERANCE_G: number = 0.05;
+const DEFAULT_MAX_ACCEL_NOISE_G: number = 0.01;
+const DEFAULT_TRACKING_GAIN: number = 0.25;
+
+// Windows need enough frames for the mean and spread to mean something,
+// even at low IMU data rates
+const MIN_WINDOW_FRAMES: number = 50;
+
+/**
+ * Gyro bias tracking that runs on the normal stream of IMU frames
+ *
+ * Whenever the robot sits still (wheels not turning, the accelerometer
+ * seeing nothing but gravity, and the gyro quiet) for a full window, the
+ * mean gyro reading over that window is whatever bias is left after the
+ * current offsets. That residual is turned into a correction to the LSM6
+ * runtime offset. The first estimate is applied in full, and later ones
+ * are blended in, so the offset follows the bias as the sensor warms up.
+ *
+ * Any sign of motion throws the current window away. Unlike
+ * GyroCalibrationUtil, IMU reads never stop, so the robot program keeps
+ * getting gyro data the whole time
+ */
+export default class StreamingGyroCalibration {
+    private _windowSeconds: number = DEFAULT_WINDOW_SECONDS;
+    private _maxRateDPS: number = DEFAULT_MAX_RATE_DPS;
+    private _maxNoiseDPS: number = DEFAULT_MAX_NOISE_DPS;
+    private _accelToleranceG: number = DEFAULT_ACCEL_TOLERANCE_G;
+    private _maxAccelNoiseG: number = DEFAULT_MAX_ACCEL_NOISE_G;
+    private _trackingGain: number = DEFAULT_TRACKING_GAIN;
+
+    private _gyroX: RunningStats = new RunningStats();
+    private _gyroY: RunningStats = new RunningStats();
+    private _gyroZ: RunningStats = new RunningStats();
+    private _accel: RunningStats = new RunningStats();
+
+    private _stationary: boolean = false;
+    private _updates: number = 0;
+    private _rejectedWindows: number = 0;
+
+    private _correction: Vector3 = { x: 0, y: 0, z: 0 };
+    private _lastResidual: Vector3 = { x: 0, y: 0, z: 0 };
+    private _lastNoise: Vector3 = { x: 0, y: 0, z: 0 };
+
+    constructor(config?: StreamingCalibrationConfig) {
+        if (config?.windowSeconds !== undefined) {
+            this._windowSeconds = config.windowSeconds;
+        }
+
+        if (config?.maxRateDPS !== undefined) {
+            this._maxRateDPS = config.maxRateDPS;
+        }
+
+        if (config?.maxNoiseDPS !== undefined) {
+            this._maxNoiseDPS = config.maxNoiseDPS;
+        }
+
+        if (config?.accelToleranceG !== undefined) {
+            this._accelToleranceG = config.accelToleranceG;
+        }
+
+        if (config?.maxAccelNoiseG !== undefined) {
+            this._maxAccelNoiseG = config.maxAccelNoiseG;
+        }
+
+        if (config?.trackingGain !== undefined) {
+            this._trackingGain = Math.min(Math.max(config.trackingGain, 0), 1);
+        }
+    }
+
+    /**
+     * Whether the last full window was accepted, with no motion since
+     */
+    public get isStationary(): boolean {
+        return this._stationary;
+    }
+
+    /**
+     * Number of corrections made since the last reset
+     */
+    public get updates(): number {
+        return this._updates;
+    }
+
+    /**
+     * Amount to add to the gyro runtime offset, in DPS. Only valid
+     * straight after processFrames() returns true
+     */
+    public get correction(): Vector3 {
+        return this._correction;
+    }
+
+    public get stats(): StreamingCalibrationStats {
+        return {
+            stationary: this._stationary,
+            updates: this._updates,
+            rejectedWindows: this._rejectedWindows,
+            lastResidual: { ...this._lastResidual },
+            lastNoise: { ...this._lastNoise }
+        };
+    }
+
+    /**
+     * Feed in the latest frames (with the current offsets already applied)
+     *
+     * Returns true when a window completed and a new correction is ready.
+     * Any frames left in the batch at that point were corrected with the
+     * old offset, so they are skipped rather than starting the next window
+     * @param period Time between frames, in seconds
+     * @param wheelsMoving Whether the encoders have recently changed
+     */
+    public processFrames(frames: FIFOFrames, period: number, wheelsMoving: boolean): boolean {
+        if (wheelsMoving) {
+            this._restartWindow();
+            this._stationary = false;
+            return false;
+        }
+
+        const windowFrames = Math.max(MIN_WINDOW_FRAMES, Math.round(this._windowSeconds / period));
+
+        for (let i = 0; i < frames.length; i++) {
+            const gx = frames.gyroX(i);
+            const gy = frames.gyroY(i);
+            const gz = frames.gyroZ(i);
+            const ax = frames.accelX(i);
+            const ay = frames.accelY(i);
+            const az = frames.accelZ(i);
+            const accelNorm = Math.sqrt((ax * ax) + (ay * ay) + (az * az));
+
+            if (Math.abs(gx) > this._maxRateDPS ||
+                Math.abs(gy) > this._maxRateDPS ||
+                Math.abs(gz) > this._maxRateDPS ||
+                Math.abs(accelNorm - 1) > this._accelToleranceG) {
+                this._restartWindow();
+                this._stationary = false;
+                continue;
+            }
+
+            this._gyroX.add(gx);
+            this._gyroY.add(gy);
+            this._gyroZ.add(gz);
+            this._accel.add(accelNorm);
+
+            if (this._gyroX.count >= windowFrames) {
+                if (this._completeWindow()) {
+                    return true;
+                }
+            }
+        }
+
+        return false;
+    }
+
+    /**
+     * Forget all progress, e.g. after the offsets were changed elsewhere
+     */
+    public reset(): void {
+        this._restartWindow();
+        this._stationary = false;
+        this._updates = 0;
+    }
+
+    private _completeWindow(): boolean {
+        this._lastNoise.x = this._gyroX.stdDev;
+        this._lastNoise.y = this._gyroY.stdDev;
+        this._lastNoise.z = this._gyroZ.stdDev;
+
+        // Slow turns and vibration can stay under the per frame limits,
+        // but show up as a wider spread than sensor noise alone
+        if (this._lastNoise.x > this._maxNoiseDPS ||
+            this._lastNoise.y > this._maxNoiseDPS ||
+            this._lastNoise.z > this._maxNoiseDPS ||
+            this._accel.stdDev > this._maxAccelNoiseG) {
+            this._rejectedWindows++;
+            this._stationary = false;
+            this._restartWindow();
+            return false;
+        }
+
+        this._lastResidual.x = this._gyroX.mean;
+        this._lastResidual.y = this._gyroY.mean;
+        this._lastResidual.z = this._gyroZ.mean;
+
+        // The runtime offset is added to readings, so a positive residual
+        // needs a negative correction
+        const gain = this._updates === 0 ? 1 : this._trackingGain;
+        this._correction.x = -gain * this._lastResidual.x;
+        this._correction.y = -gain * this._lastResidual.y;
+        this._correction.z = -gain * this._lastResidual.z;
+
+        this._updates++;
+        this._stationary = true;
+        this._restartWindow();
+        return true;
+    }
+
+    private _restartWindow(): void {
+        this._gyroX.reset();
+        this._gyroY.reset();
+        this._gyroZ.reset();
+        this._accel.reset();
+    }
+}
@@ -0,0 +1,113 @@
+import { ShmemElementDefinition } from "../../robot/romi-shmem-buffer";
+
+// Binary telemetry log layout
+//
+// File header (little endian):
+//   0  char[8]  magic ("ROMILOG\0")
+//   8  uint16   format version
+//   10 uint16   record length
+//   12 uint32   schema length (bytes of UTF-8 JSON that follow the header)
+//   16 float64  wall clock time the log started (ms since the epoch)
+//   24 ...      schema JSON (LogSchema)
+//
+// After that, the file is nothing but fixed length records:
+//   0  uint8    record type (LogRecordType)
+//   1  uint8    payload length
+//   2  uint32   microseconds since the previous record
+//   6  ...      payload, zero padded to the record length
+//
+// Timestamps only go forward. A SYNC record carries the absolute time (in
+// microseconds since the log started) whenever the gap is too big for a
+// delta, and readers should re-base from it
+
+export const LOG_MAGIC: string = "ROMILOG\0";
+export const LOG_FORMAT_VERSION: number = 1;
+
+export const FILE_HEADER_LENGTH: number = 24;
+export const RECORD_HEADER_LENGTH: number = 6;
+
+export const MAX_RECORD_DELTA_US: number = 0xFFFFFFFF;
+
+export enum LogRecordType {
+    SYNC = 0,
+    TELEMETRY = 1,
+    IMU_FRAME = 2,
+    COMMAND = 3,
+    I2C_ERROR = 4
+}
+
+export enum I2CErrorKind {
+    READ = 0,
+    WRITE = 1,
+    TELEMETRY_CRC = 2,
+    TELEMETRY_SNAPSHOT = 3
+}
+
+// SYNC: float64 microseconds since the log started
+export const SYNC_PAYLOAD_LENGTH: number = 8;
+
+// IMU_FRAME: float32 GyroX, GyroY, GyroZ (DPS), AccelX, AccelY, AccelZ (G)
+export const IMU_FRAME_PAYLOAD_LENGTH: number = 24;
+
+// I2C_ERROR: uint8 kind, uint8 address, uint8 register, uint8 priority
+export const I2C_ERROR_PAYLOAD_LENGTH: number = 4;
+
+export interface LogBlockRange {
+    start: number;
+    length: number;
+}
+
+/**
+ * Everything a reader needs to decode a log, stored as JSON in its header
+ *
+ * TELEMETRY and COMMAND payloads are raw copies of those blocks of the
+ * shared buffer, so fields are decoded using the layout from
+ * sharedmem.json that the log was recorded with
+ */
+export interface LogSchema {
+    firmwareIdent: number;
+    telemetryBlock: LogBlockRange;
+    commandBlock: LogBlockRange;
+
+    // Time between IMU frames, in seconds
+    imuFramePeriod: number;
+
+    // Shared buffer layout, with types given by name (e.g. "INT16_T")
+    fields: { [name: string]: LogFieldDefinition };
+}
+
+export interface LogFieldDefinition {
+    offset: number;
+    type: string;
+    arraySize?: number;
+}
+
+/**
+ * Convert the generated shared buffer layout into its header form
+ */
+export function fieldsForSchema(layout: { [name: string]: ShmemElementDefinition }, typeNames: { [type: number]: string }): { [name: string]: LogFieldDefinition } {
+    const fields: { [name: string]: LogFieldDefinition } = {};
+    Object.keys(layout).forEach(name => {
+        const def = layout[name];
+        fields[name] = { offset: def.offset, type: typeNames[def.type] };
+        if (def.arraySize !== undefined) {
+            fields[name].arraySize = def.arraySize;
+        }
+    });
+
+    return fields;
+}
+
+/**
+ * Every record is big enough for the largest payload, rounded up to a
+ * multiple of 4 bytes
+ */
+export function recordLengthForSchema(schema: LogSchema): number {
+    const maxPayload = Math.max(schema.telemetryBlock.length,
+                                schema.commandBlock.length,
+                                SYNC_PAYLOAD_LENGTH,
+                                IMU_FRAME_PAYLOAD_LENGTH,
+                                I2C_ERROR_PAYLOAD_LENGTH);
+
+    return Math.ceil((RECORD_HEADER_LENGTH + maxPayload) / 4) * 4;
+}
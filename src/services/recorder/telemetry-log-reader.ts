@@ -0,0 +1,260 @@
+import fs from "fs";
+import { FILE_HEADER_LENGTH, I2CErrorKind, LOG_FORMAT_VERSION, LOG_MAGIC, LogRecordType, LogSchema, RECORD_HEADER_LENGTH } from "./log-format";
+
+export interface LogHeader {
+    version: number;
+    recordLength: number;
+
+    // Wall clock time the log started (ms since the epoch)
+    startTime: number;
+
+    schema: LogSchema;
+}
+
+export interface FieldLocation {
+    recordType: LogRecordType;
+    offset: number;
+    type: string;
+}
+
+const DEFAULT_READ_CHUNK_BYTES: number = 4 * 1024 * 1024;
+
+/**
+ * A single record, as seen during a scan
+ *
+ * The same view is handed out for every record (it just points at the next
+ * one in the read buffer), so values need to be copied out of it rather
+ * than the view itself being kept
+ */
+export class LogRecordView {
+    private _fields: Map<string, FieldLocation>;
+
+    private _buffer: Buffer = Buffer.alloc(0);
+    private _offset: number = 0;
+    private _timeUs: number = 0;
+
+    constructor(fields: Map<string, FieldLocation>) {
+        this._fields = fields;
+    }
+
+    public get type(): LogRecordType {
+        return this._buffer[this._offset];
+    }
+
+    public get payloadLength(): number {
+        return this._buffer[this._offset + 1];
+    }
+
+    /**
+     * Time since the log started, in ms
+     */
+    public get timeMs(): number {
+        return this._timeUs / 1000;
+    }
+
+    /**
+     * Copy the raw payload (e.g. a telemetry block) into target
+     * @returns Number of bytes copied
+     */
+    public copyPayload(target: Uint8Array): number {
+        const start = this._offset + RECORD_HEADER_LENGTH;
+        const length = Math.min(this.payloadLength, target.length);
+        this._buffer.copy(target, 0, start, start + length);
+        return length;
+    }
+
+    /**
+     * One value of an IMU_FRAME record (0-2 are gyro X/Y/Z in DPS, 3-5 are
+     * accel X/Y/Z in G)
+     */
+    public imuValue(idx: number): number {
+        return this._buffer.readFloatLE(this._offset + RECORD_HEADER_LENGTH + (idx * 4));
+    }
+
+    public get i2cErrorKind(): I2CErrorKind {
+        return this._buffer[this._offset + RECORD_HEADER_LENGTH];
+    }
+
+    public get i2cAddress(): number {
+        return this._buffer[this._offset + RECORD_HEADER_LENGTH + 1];
+    }
+
+    public get i2cRegister(): number {
+        return this._buffer[this._offset + RECORD_HEADER_LENGTH + 2];
+    }
+
+    public get i2cPriority(): number {
+        return this._buffer[this._offset + RECORD_HEADER_LENGTH + 3];
+    }
+
+    /**
+     * Decode a shared buffer field (by its sharedmem.json name) from a
+     * TELEMETRY or COMMAND record
+     */
+    public getField(name: string, index: number = 0): number {
+        const field = this._fields.get(name);
+        if (field === undefined) {
+            throw new Error(`Unknown field "${name}"`);
+        }
+
+        if (field.recordType !== this.type) {
+            throw new Error(`Field "${name}" is not part of a ${LogRecordType[this.type]} record`);
+        }
+
+        const offset = this._offset + RECORD_HEADER_LENGTH + field.offset;
+        switch (field.type) {
+            case "UINT16_T":
+                return this._buffer.readUInt16LE(offset + (index * 2));
+            case "INT16_T":
+                return this._buffer.readInt16LE(offset + (index * 2));
+            case "INT8_T":
+                return this._buffer.readInt8(offset + index);
+            default:
+                return this._buffer[offset + index];
+        }
+    }
+
+    /**
+     * Point the view at the next record (used by the reader)
+     */
+    public moveTo(buffer: Buffer, offset: number, timeUs: number): void {
+        this._buffer = buffer;
+        this._offset = offset;
+        this._timeUs = timeUs;
+    }
+}
+
+/**
+ * Reader for logs written by TelemetryRecorder
+ *
+ * Scans are meant to be fast enough to run over a whole match worth of
+ * kHz data. Node has no built in way to memory map a file, so the file is
+ * paged through a single large, reused read buffer instead, with every
+ * record decoded in place. Nothing is allocated per record
+ */
+export default class TelemetryLogReader {
+    private _fd: number;
+    private _header: LogHeader;
+    private _dataStart: number;
+    private _readBuffer: Buffer;
+    private _view: LogRecordView;
+
+    constructor(filePath: string, readChunkBytes: number = DEFAULT_READ_CHUNK_BYTES) {
+        this._fd = fs.openSync(filePath, "r");
+
+        try {
+            const fixedHeader = Buffer.alloc(FILE_HEADER_LENGTH);
+            if (fs.readSync(this._fd, fixedHeader, 0, FILE_HEADER_LENGTH, 0) < FILE_HEADER_LENGTH ||
+                fixedHeader.toString("latin1", 0, LOG_MAGIC.length) !== LOG_MAGIC) {
+                throw new Error("Not a Romi telemetry log");
+            }
+
+            const version = fixedHeader.readUInt16LE(8);
+            if (version !== LOG_FORMAT_VERSION) {
+                throw new Error(`Unsupported log format version ${version}`);
+            }
+
+            const schemaLength = fixedHeader.readUInt32LE(12);
+            const schemaJson = Buffer.alloc(schemaLength);
+            fs.readSync(this._fd, schemaJson, 0, schemaLength, FILE_HEADER_LENGTH);
+
+            this._header = {
+                version,
+                recordLength: fixedHeader.readUInt16LE(10),
+                startTime: fixedHeader.readDoubleLE(16),
+                schema: JSON.parse(schemaJson.toString("utf8"))
+            };
+            this._dataStart = FILE_HEADER_LENGTH + schemaLength;
+        }
+        catch (err) {
+            fs.closeSync(this._fd);
+            throw err;
+        }
+
+        const chunkRecords = Math.max(1, Math.floor(readChunkBytes / this._header.recordLength));
+        this._readBuffer = Buffer.alloc(chunkRecords * this._header.recordLength);
+        this._view = new LogRecordView(this._locateFields(this._header.schema));
+    }
+
+    public get header(): LogHeader {
+        return this._header;
+    }
+
+    public get schema(): LogSchema {
+        return this._header.schema;
+    }
+
+    /**
+     * Number of complete records in the file (a record cut short by a
+     * crash is left out)
+     */
+    public get recordCount(): number {
+        const dataLength = fs.fstatSync(this._fd).size - this._dataStart;
+        return Math.max(0, Math.floor(dataLength / this._header.recordLength));
+    }
+
+    /**
+     * Visit every record in order. Return false from the visitor to stop
+     * early
+     * @returns Number of records visited
+     */
+    public scan(visitor: (record: LogRecordView) => boolean | void): number {
+        const recordLength = this._header.recordLength;
+        let position = this._dataStart;
+        let timeUs = 0;
+        let visited = 0;
+
+        while (true) {
+            const bytesRead = fs.readSync(this._fd, this._readBuffer, 0, this._readBuffer.length, position);
+            const numRecords = Math.floor(bytesRead / recordLength);
+            if (numRecords === 0) {
+                break;
+            }
+
+            for (let i = 0; i < numRecords; i++) {
+                const offset = i * recordLength;
+                timeUs += this._readBuffer.readUInt32LE(offset + 2);
+
+                if (this._readBuffer[offset] === LogRecordType.SYNC) {
+                    timeUs = this._readBuffer.readDoubleLE(offset + RECORD_HEADER_LENGTH);
+                    continue;
+                }
+
+                this._view.moveTo(this._readBuffer, offset, timeUs);
+                visited++;
+                if (visitor(this._view) === false) {
+                    return visited;
+                }
+            }
+
+            position += numRecords * recordLength;
+            if (bytesRead < this._readBuffer.length) {
+                break;
+            }
+        }
+
+        return visited;
+    }
+
+    public close(): void {
+        fs.closeSync(this._fd);
+    }
+
+    /**
+     * Work out which record type (and where in it) each field lives
+     */
+    private _locateFields(schema: LogSchema): Map<string, FieldLocation> {
+        const fields = new Map<string, FieldLocation>();
+        Object.keys(schema.fields).forEach(name => {
+            const def = schema.fields[name];
+            if (def.offset >= schema.telemetryBlock.start && def.offset < schema.telemetryBlock.start + schema.telemetryBlock.length) {
+                fields.set(name, { recordType: LogRecordType.TELEMETRY, offset: def.offset - schema.telemetryBlock.start, type: def.type });
+            }
+            else if (def.offset >= schema.commandBlock.start && def.offset < schema.commandBlock.start + schema.commandBlock.length) {
+                fields.set(name, { recordType: LogRecordType.COMMAND, offset: def.offset - schema.commandBlock.start, type: def.type });
+            }
+        });
+
+        return fields;
+    }
+}
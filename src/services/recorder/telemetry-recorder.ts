@@ -0,0 +1,308 @@
+import fs from "fs";
+import LogUtil from "../../utils/logging/log-util";
+import { FIFOFrames } from "../../robot/devices/core/lsm6/lsm6";
+import { I2CErrorKind, FILE_HEADER_LENGTH, IMU_FRAME_PAYLOAD_LENGTH, I2C_ERROR_PAYLOAD_LENGTH, LOG_FORMAT_VERSION, LOG_MAGIC, LogRecordType, LogSchema, MAX_RECORD_DELTA_US, RECORD_HEADER_LENGTH, recordLengthForSchema, SYNC_PAYLOAD_LENGTH } from "./log-format";
+
+const logger = LogUtil.getLogger("SVC-RECORDER");
+
+export interface RecorderConfig {
+    // Size of each in-memory chunk, in bytes
+    chunkBytes?: number;
+
+    // Number of chunks. Together with chunkBytes, this caps the memory used
+    numChunks?: number;
+}
+
+export interface RecorderStats {
+    filePath: string;
+    records: number;
+    droppedRecords: number;
+    bytesWritten: number;
+    writeErrors: number;
+}
+
+const DEFAULT_CHUNK_BYTES: number = 64 * 1024;
+const DEFAULT_NUM_CHUNKS: number = 4;
+
+/**
+ * Append-only binary log of everything that goes across the bus
+ *
+ * Records are written into a small, fixed set of preallocated chunks.
+ * Full chunks are written to disk in the background (in order, at known
+ * file positions) while recording carries on into the next one. If the
+ * disk can't keep up and every chunk is still waiting to be written,
+ * new records are dropped (and counted) rather than letting memory grow
+ *
+ * Times passed in should all come from the same monotonic clock
+ * (performance.now()) as the robot's scheduler
+ */
+export default class TelemetryRecorder {
+    private _filePath: string;
+    private _fd: number | null = null;
+    private _recordLength: number;
+
+    private _chunks: Buffer[] = [];
+    private _chunkBusy: boolean[] = [];
+    private _currentChunk: number = 0;
+    private _chunkUsed: number = 0;
+
+    private _filePosition: number = 0;
+    private _pendingWrites: number = 0;
+    private _onWritesDone: (() => void) | null = null;
+    private _closing: boolean = false;
+    private _closeP: Promise<void> | null = null;
+
+    private _startTimeMs: number;
+    private _lastTimeUs: number = 0;
+
+    private _records: number = 0;
+    private _droppedRecords: number = 0;
+    private _bytesWritten: number = 0;
+    private _writeErrors: number = 0;
+
+    /**
+     * Create the log file and write its header
+     * @param startTimeMs Monotonic time that record times are relative to
+     */
+    constructor(filePath: string, schema: LogSchema, startTimeMs: number, config?: RecorderConfig) {
+        this._filePath = filePath;
+        this._recordLength = recordLengthForSchema(schema);
+        this._startTimeMs = startTimeMs;
+
+        // Chunks hold whole records only
+        const chunkBytes = config?.chunkBytes !== undefined ? config.chunkBytes : DEFAULT_CHUNK_BYTES;
+        const numChunks = Math.max(2, config?.numChunks !== undefined ? config.numChunks : DEFAULT_NUM_CHUNKS);
+        const chunkRecords = Math.max(1, Math.floor(chunkBytes / this._recordLength));
+        for (let i = 0; i < numChunks; i++) {
+            this._chunks.push(Buffer.alloc(chunkRecords * this._recordLength));
+            this._chunkBusy.push(false);
+        }
+
+        const schemaJson = Buffer.from(JSON.stringify(schema), "utf8");
+        const header = Buffer.alloc(FILE_HEADER_LENGTH + schemaJson.length);
+        header.write(LOG_MAGIC, 0, "latin1");
+        header.writeUInt16LE(LOG_FORMAT_VERSION, 8);
+        header.writeUInt16LE(this._recordLength, 10);
+        header.writeUInt32LE(schemaJson.length, 12);
+        header.writeDoubleLE(Date.now(), 16);
+        schemaJson.copy(header, FILE_HEADER_LENGTH);
+
+        this._fd = fs.openSync(filePath, "w");
+        fs.writeSync(this._fd, header, 0, header.length, 0);
+        this._filePosition = header.length;
+        this._bytesWritten = header.length;
+
+        logger.info(`Recording to ${filePath} (${this._recordLength} byte records)`);
+    }
+
+    public get stats(): RecorderStats {
+        return {
+            filePath: this._filePath,
+            records: this._records,
+            droppedRecords: this._droppedRecords,
+            bytesWritten: this._bytesWritten,
+            writeErrors: this._writeErrors
+        };
+    }
+
+    /**
+     * Record a telemetry block that passed its CRC check
+     */
+    public recordTelemetry(block: Uint8Array, timeMs: number): void {
+        this._recordBlock(LogRecordType.TELEMETRY, block, timeMs);
+    }
+
+    /**
+     * Record a command block, as sent to the Romi
+     */
+    public recordCommand(block: Uint8Array, timeMs: number): void {
+        this._recordBlock(LogRecordType.COMMAND, block, timeMs);
+    }
+
+    /**
+     * Record a batch of IMU frames, one record each
+     *
+     * Frames come off the FIFO at a fixed rate, so the last one is taken
+     * to be from the time of the read, and the others are spaced back from
+     * it by the frame period
+     * @param period Time between frames, in seconds
+     */
+    public recordIMUFrames(frames: FIFOFrames, timeMs: number, period: number): void {
+        const periodMs = period * 1000;
+        for (let i = 0; i < frames.length; i++) {
+            const frameTime = timeMs - ((frames.length - 1 - i) * periodMs);
+            const offset = this._beginRecord(LogRecordType.IMU_FRAME, IMU_FRAME_PAYLOAD_LENGTH, frameTime);
+            if (offset < 0) {
+                return;
+            }
+
+            const chunk = this._chunks[this._currentChunk];
+            chunk.writeFloatLE(frames.gyroX(i), offset);
+            chunk.writeFloatLE(frames.gyroY(i), offset + 4);
+            chunk.writeFloatLE(frames.gyroZ(i), offset + 8);
+            chunk.writeFloatLE(frames.accelX(i), offset + 12);
+            chunk.writeFloatLE(frames.accelY(i), offset + 16);
+            chunk.writeFloatLE(frames.accelZ(i), offset + 20);
+        }
+    }
+
+    public recordI2CError(kind: I2CErrorKind, address: number, register: number, priority: number, timeMs: number): void {
+        const offset = this._beginRecord(LogRecordType.I2C_ERROR, I2C_ERROR_PAYLOAD_LENGTH, timeMs);
+        if (offset < 0) {
+            return;
+        }
+
+        const chunk = this._chunks[this._currentChunk];
+        chunk[offset] = kind;
+        chunk[offset + 1] = address & 0xFF;
+        chunk[offset + 2] = register & 0xFF;
+        chunk[offset + 3] = priority & 0xFF;
+    }
+
+    /**
+     * Send whatever has been recorded so far to disk. Call this
+     * periodically, so a crash loses at most one period of data
+     */
+    public flush(): void {
+        this._submitChunk();
+    }
+
+    /**
+     * Flush, wait for outstanding writes and close the file
+     */
+    public close(): Promise<void> {
+        if (this._closeP === null) {
+            this._submitChunk();
+            this._closing = true;
+
+            this._closeP = new Promise<void>(resolve => {
+                const finish = () => {
+                    if (this._fd !== null) {
+                        fs.closeSync(this._fd);
+                        this._fd = null;
+                    }
+                    logger.info(`Closed ${this._filePath} (${this._records} records, ${this._droppedRecords} dropped)`);
+                    resolve();
+                };
+
+                if (this._pendingWrites === 0) {
+                    finish();
+                }
+                else {
+                    this._onWritesDone = finish;
+                }
+            });
+        }
+
+        return this._closeP;
+    }
+
+    private _recordBlock(type: LogRecordType, block: Uint8Array, timeMs: number): void {
+        const offset = this._beginRecord(type, block.length, timeMs);
+        if (offset < 0) {
+            return;
+        }
+
+        this._chunks[this._currentChunk].set(block, offset);
+    }
+
+    /**
+     * Write a record header into the current chunk
+     * @returns Offset of the payload in the current chunk, or -1 if
+     * there's no room and the record was dropped
+     */
+    private _beginRecord(type: LogRecordType, payloadLength: number, timeMs: number): number {
+        if (this._fd === null || this._closing) {
+            return -1;
+        }
+
+        const timeUs = Math.round((timeMs - this._startTimeMs) * 1000);
+        let deltaUs = timeUs - this._lastTimeUs;
+
+        // Records can only move forward in time
+        if (deltaUs < 0) {
+            deltaUs = 0;
+        }
+        else if (deltaUs > MAX_RECORD_DELTA_US) {
+            const syncOffset = this._reserveRecord(LogRecordType.SYNC, SYNC_PAYLOAD_LENGTH, 0);
+            if (syncOffset < 0) {
+                return -1;
+            }
+
+            this._chunks[this._currentChunk].writeDoubleLE(timeUs, syncOffset);
+            this._lastTimeUs = timeUs;
+            deltaUs = 0;
+        }
+
+        const offset = this._reserveRecord(type, payloadLength, deltaUs);
+        if (offset >= 0) {
+            this._lastTimeUs += deltaUs;
+        }
+
+        return offset;
+    }
+
+    private _reserveRecord(type: LogRecordType, payloadLength: number, deltaUs: number): number {
+        if (this._chunkUsed + this._recordLength > this._chunks[this._currentChunk].length) {
+            this._submitChunk();
+        }
+
+        if (this._chunkBusy[this._currentChunk]) {
+            this._droppedRecords++;
+            return -1;
+        }
+
+        const chunk = this._chunks[this._currentChunk];
+        const start = this._chunkUsed;
+        chunk.fill(0, start, start + this._recordLength);
+        chunk[start] = type;
+        chunk[start + 1] = payloadLength;
+        chunk.writeUInt32LE(deltaUs, start + 2);
+
+        this._chunkUsed += this._recordLength;
+        this._records++;
+
+        return start + RECORD_HEADER_LENGTH;
+    }
+
+    /**
+     * Hand the current chunk over to be written, and move on to the next
+     */
+    private _submitChunk(): void {
+        if (this._fd === null || this._chunkUsed === 0 || this._chunkBusy[this._currentChunk]) {
+            return;
+        }
+
+        const chunkIdx = this._currentChunk;
+        const length = this._chunkUsed;
+        const position = this._filePosition;
+
+        this._chunkBusy[chunkIdx] = true;
+        this._filePosition += length;
+        this._pendingWrites++;
+
+        fs.write(this._fd, this._chunks[chunkIdx], 0, length, position, (err) => {
+            this._chunkBusy[chunkIdx] = false;
+            this._pendingWrites--;
+
+            if (err) {
+                if (this._writeErrors === 0) {
+                    logger.error(`Error writing to ${this._filePath}: ${err.message}`);
+                }
+                this._writeErrors++;
+            }
+            else {
+                this._bytesWritten += length;
+            }
+
+            if (this._pendingWrites === 0 && this._onWritesDone) {
+                const onWritesDone = this._onWritesDone;
+                this._onWritesDone = null;
+                onWritesDone();
+            }
+        });
+
+        this._currentChunk = (this._currentChunk + 1) % this._chunks.length;
+        this._chunkUsed = 0;
+    }
+}
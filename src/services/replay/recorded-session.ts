@@ -0,0 +1,209 @@
+import TelemetryLogReader from "../recorder/telemetry-log-reader";
+import { I2CErrorKind, LogRecordType, LogSchema } from "../recorder/log-format";
+
+// Telemetry events are either a block that passed its CRC check, or one
+// of the telemetry read errors
+export const TELEMETRY_EVENT_BLOCK: number = 0xFF;
+
+const IMU_FRAME_VALUES: number = 6;
+
+/**
+ * A whole recorded session, loaded into memory for replay
+ *
+ * Everything lives in flat typed arrays (one entry per record, in time
+ * order), so a long session at kHz IMU rates is still only a few tens of
+ * MB, and stepping through it doesn't allocate
+ */
+export default class RecordedSession {
+    public readonly schema: LogSchema;
+
+    // Wall clock time the session started (ms since the epoch)
+    public readonly startTime: number;
+
+    // Time of the last record, in ms since the session started
+    public readonly durationMs: number;
+
+    public readonly telemetryCount: number;
+    public readonly telemetryTimes: Float64Array;
+
+    // TELEMETRY_EVENT_BLOCK, or the I2CErrorKind of a failed read
+    public readonly telemetryEvents: Uint8Array;
+
+    // telemetryCount blocks back to back. Blocks for failed reads are zeroed
+    public readonly telemetryBlocks: Uint8Array;
+
+    public readonly imuFrameCount: number;
+    public readonly imuFrameTimes: Float64Array;
+
+    // GyroX, GyroY, GyroZ (DPS), AccelX, AccelY, AccelZ (G) for each frame
+    public readonly imuFrameValues: Float32Array;
+
+    public readonly commandCount: number;
+    public readonly commandTimes: Float64Array;
+    public readonly commandBlocks: Uint8Array;
+
+    // Bus errors other than telemetry reads. These are kept for reference,
+    // but aren't replayed
+    public readonly otherI2CErrors: number;
+
+    public static load(filePath: string): RecordedSession {
+        const reader = new TelemetryLogReader(filePath);
+        try {
+            return new RecordedSession(reader);
+        }
+        finally {
+            reader.close();
+        }
+    }
+
+    private constructor(reader: TelemetryLogReader) {
+        this.schema = reader.schema;
+        this.startTime = reader.header.startTime;
+
+        // First pass to size everything
+        let telemetryCount = 0;
+        let imuFrameCount = 0;
+        let commandCount = 0;
+        let otherI2CErrors = 0;
+        let durationMs = 0;
+
+        reader.scan(record => {
+            durationMs = record.timeMs;
+            switch (record.type) {
+                case LogRecordType.TELEMETRY:
+                    telemetryCount++;
+                    break;
+                case LogRecordType.IMU_FRAME:
+                    imuFrameCount++;
+                    break;
+                case LogRecordType.COMMAND:
+                    commandCount++;
+                    break;
+                case LogRecordType.I2C_ERROR:
+                    if (isTelemetryError(record.i2cErrorKind)) {
+                        telemetryCount++;
+                    }
+                    else {
+                        otherI2CErrors++;
+                    }
+                    break;
+            }
+        });
+
+        const telemetryLength = this.schema.telemetryBlock.length;
+        const commandLength = this.schema.commandBlock.length;
+
+        this.durationMs = durationMs;
+        this.otherI2CErrors = otherI2CErrors;
+
+        this.telemetryCount = telemetryCount;
+        this.telemetryTimes = new Float64Array(telemetryCount);
+        this.telemetryEvents = new Uint8Array(telemetryCount);
+        this.telemetryBlocks = new Uint8Array(telemetryCount * telemetryLength);
+
+        this.imuFrameCount = imuFrameCount;
+        this.imuFrameTimes = new Float64Array(imuFrameCount);
+        this.imuFrameValues = new Float32Array(imuFrameCount * IMU_FRAME_VALUES);
+
+        this.commandCount = commandCount;
+        this.commandTimes = new Float64Array(commandCount);
+        this.commandBlocks = new Uint8Array(commandCount * commandLength);
+
+        // Second pass to fill it in
+        let telemetryIdx = 0;
+        let imuFrameIdx = 0;
+        let commandIdx = 0;
+
+        reader.scan(record => {
+            switch (record.type) {
+                case LogRecordType.TELEMETRY:
+                    if (telemetryIdx < telemetryCount) {
+                        this.telemetryTimes[telemetryIdx] = record.timeMs;
+                        this.telemetryEvents[telemetryIdx] = TELEMETRY_EVENT_BLOCK;
+                        record.copyPayload(this.telemetryBlocks.subarray(telemetryIdx * telemetryLength, (telemetryIdx + 1) * telemetryLength));
+                        telemetryIdx++;
+                    }
+                    break;
+                case LogRecordType.IMU_FRAME:
+                    if (imuFrameIdx < imuFrameCount) {
+                        this.imuFrameTimes[imuFrameIdx] = record.timeMs;
+                        for (let i = 0; i < IMU_FRAME_VALUES; i++) {
+                            this.imuFrameValues[(imuFrameIdx * IMU_FRAME_VALUES) + i] = record.imuValue(i);
+                        }
+                        imuFrameIdx++;
+                    }
+                    break;
+                case LogRecordType.COMMAND:
+                    if (commandIdx < commandCount) {
+                        this.commandTimes[commandIdx] = record.timeMs;
+                        record.copyPayload(this.commandBlocks.subarray(commandIdx * commandLength, (commandIdx + 1) * commandLength));
+                        commandIdx++;
+                    }
+                    break;
+                case LogRecordType.I2C_ERROR:
+                    if (isTelemetryError(record.i2cErrorKind) && telemetryIdx < telemetryCount) {
+                        this.telemetryTimes[telemetryIdx] = record.timeMs;
+                        this.telemetryEvents[telemetryIdx] = record.i2cErrorKind;
+                        telemetryIdx++;
+                    }
+                    break;
+            }
+        });
+    }
+
+    /**
+     * View of one telemetry block (only valid for TELEMETRY_EVENT_BLOCK)
+     */
+    public telemetryBlock(idx: number): Uint8Array {
+        const length = this.schema.telemetryBlock.length;
+        return this.telemetryBlocks.subarray(idx * length, (idx + 1) * length);
+    }
+
+    public commandBlock(idx: number): Uint8Array {
+        const length = this.schema.commandBlock.length;
+        return this.commandBlocks.subarray(idx * length, (idx + 1) * length);
+    }
+
+    /**
+     * One value of an IMU frame (same order as the IMU_FRAME record)
+     */
+    public imuValue(frameIdx: number, valueIdx: number): number {
+        return this.imuFrameValues[(frameIdx * IMU_FRAME_VALUES) + valueIdx];
+    }
+
+    /**
+     * Decode a field of a telemetry block, using the layout the session
+     * was recorded with
+     */
+    public telemetryField(idx: number, name: string, index: number = 0): number {
+        return this._decodeField(this.telemetryBlock(idx), this.schema.telemetryBlock.start, name, index);
+    }
+
+    public commandField(idx: number, name: string, index: number = 0): number {
+        return this._decodeField(this.commandBlock(idx), this.schema.commandBlock.start, name, index);
+    }
+
+    private _decodeField(block: Uint8Array, blockStart: number, name: string, index: number): number {
+        const def = this.schema.fields[name];
+        if (def === undefined) {
+            throw new Error(`Unknown field "${name}"`);
+        }
+
+        const offset = def.offset - blockStart;
+        switch (def.type) {
+            case "UINT16_T":
+            case "INT16_T": {
+                const value = block[offset + (index * 2)] | (block[offset + (index * 2) + 1] << 8);
+                return (def.type === "INT16_T" && value > 0x7FFF) ? value - 0x10000 : value;
+            }
+            case "INT8_T":
+                return block[offset + index] > 0x7F ? block[offset + index] - 0x100 : block[offset + index];
+            default:
+                return block[offset + index];
+        }
+    }
+}
+
+function isTelemetryError(kind: I2CErrorKind): boolean {
+    return kind === I2CErrorKind.TELEMETRY_CRC || kind === I2CErrorKind.TELEMETRY_SNAPSHOT;
+}
@@ -0,0 +1,450 @@
+import { performance } from "perf_hooks";
+import { DigitalChannelMode } from "@wpilib/wpilib-ws-robot";
+import LogUtil from "../../utils/logging/log-util";
+import RomiRobot from "../../robot/romi-robot";
+import RomiConfiguration from "../../robot/romi-config";
+import RomiDataBuffer from "../../robot/romi-shmem-buffer";
+import { ANALOG_FULL_SCALE } from "../../robot/romi-shmem-protocol";
+import QueuedI2CBus from "../../device-interfaces/i2c/queued-i2c-bus";
+import ReplayI2C from "../../device-interfaces/i2c/replay-i2c";
+import ReplayRomiI2C from "../../__mocks__/replay-romi";
+import ReplayRomiImu from "../../__mocks__/replay-imu";
+import RecordedSession, { TELEMETRY_EVENT_BLOCK } from "./recorded-session";
+
+const logger = LogUtil.getLogger("SVC-REPLAY");
+
+const ROMI_ADDRESS: number = 0x14;
+const IMU_ADDRESS: number = 0x6B;
+
+// Keep going for a bit after the last record, so the robot's response
+// to it gets out
+const SETTLE_MS: number = 100;
+
+const DEFAULT_MAX_COMMAND_LAG_MS: number = 50;
+const MAX_REPORTED_MISMATCHES: number = 20;
+
+// Encoder channels the replay registers, as a robot program would
+const LEFT_ENCODER_CHANNEL: number = 0;
+const RIGHT_ENCODER_CHANNEL: number = 1;
+
+// How far the robot's value for each telemetry field can be from the one
+// worked out from the recorded block before it counts as a mismatch
+const TELEMETRY_TOLERANCES: { [field: string]: number } = {
+    batteryMillivolts: 0,
+    leftEncoder: 0,
+    rightEncoder: 0,
+    builtinDioInputs: 0,
+
+    // Volts. Only there to absorb floating point differences
+    analog: 1e-6
+};
+
+// Fields the replay reads out of the recorded blocks
+const CHECKED_FIELDS: string[] = [
+    "leftMotor", "rightMotor", "commandSeq", "commandAck",
+    "batteryMillivolts", "leftEncoder", "rightEncoder", "builtinDioInputs", "analog"
+];
+
+export interface ReplayOptions {
+    // Speed relative to the recording. 1 keeps the original timing, 2 runs
+    // at double speed and so on. 0 (the default) runs as fast as possible
+    speed?: number;
+
+    // How far a replayed motor command can trail the recorded one before
+    // it counts as a mismatch
+    maxCommandLagMs?: number;
+
+    // Called after every tick, with the replay time (ms since the session
+    // started)
+    onStep?: (timeMs: number, robot: RomiRobot) => void;
+}
+
+export interface ReplayMismatch {
+    timeMs: number;
+    field: string;
+    expected: number;
+    actual: number;
+}
+
+export interface ReplayCommandStats {
+    // Changes in motor output, in the recording and in the replay
+    recorded: number;
+    replayed: number;
+
+    // How long after the recorded change the replayed one went out
+    maxLagMs: number;
+    avgLagMs: number;
+}
+
+export interface ReplayReport {
+    // Length of the session, and how long the replay took
+    durationMs: number;
+    wallTimeMs: number;
+
+    // Session time per unit of wall time
+    speedup: number;
+
+    ticks: number;
+    telemetryEvents: number;
+    imuFrames: number;
+    commands: ReplayCommandStats;
+
+    mismatchCount: number;
+
+    // The first few mismatches
+    mismatches: ReplayMismatch[];
+}
+
+interface MotorChange {
+    timeMs: number;
+    left: number;
+    right: number;
+}
+
+/**
+ * Inverse of the conversion in RomiRobot.setPWMValue(), so that the
+ * value going back in comes out as the same motor command
+ */
+function motorCommandToPWM(romiValue: number): number {
+    return ((romiValue + 400.5) / 800) * 255;
+}
+
+/**
+ * Replays a recorded session through a RomiRobot, end to end
+ *
+ * The robot runs on a ReplayI2C bus, with a ReplayRomiI2C serving the
+ * recorded telemetry and a ReplayRomiImu serving the recorded IMU frames.
+ * Nothing runs off the robot's own timers: the scheduler and the IMU
+ * FIFO loop are stopped, and the replay ticks them on a virtual clock
+ * instead, so the same session always plays out the same way, at any
+ * speed.
+ *
+ * The motor outputs from the recording are applied again (through
+ * setPWMValue(), like a robot program would) at the times they were
+ * recorded. What the robot then writes to the Romi, and what it makes of
+ * the recorded telemetry (battery, wheel encoders, button A and the
+ * external analog inputs), is diffed against the recording
+ */
+export default class SessionReplay {
+    private _session: RecordedSession;
+    private _bus: ReplayI2C;
+    private _romi: ReplayRomiI2C;
+    private _imu: ReplayRomiImu;
+    private _robot: RomiRobot;
+
+    private _replayedChanges: MotorChange[] = [];
+
+    // Channels whose values are checked against the recorded telemetry
+    private _buttonAChannel: number = -1;
+    private _analogChannels: { channel: number, port: number }[] = [];
+
+    private _mismatchCount: number = 0;
+    private _mismatches: ReplayMismatch[] = [];
+
+    /**
+     * @param romiConfig Configuration for the replaying robot. This should
+     * match the one the session was recorded with. Gyro bias tracking is
+     * turned off, since the recorded frames already include its corrections
+     */
+    constructor(session: RecordedSession, romiConfig?: RomiConfiguration) {
+        this._session = session;
+        this._checkLayout();
+
+        this._bus = new ReplayI2C(1);
+        this._romi = new ReplayRomiI2C(ROMI_ADDRESS, session);
+        this._imu = new ReplayRomiImu(IMU_ADDRESS, session);
+        this._bus.addDeviceToBus(this._romi);
+        this._bus.addDeviceToBus(this._imu);
+
+        const config = romiConfig || new RomiConfiguration();
+        config.gyroBiasTracking = false;
+
+        this._robot = new RomiRobot(new QueuedI2CBus(this._bus), ROMI_ADDRESS, config);
+
+        // Recorded frames have the offset applied already
+        this._robot.getIMU().gyroOffset = { x: 0, y: 0, z: 0 };
+
+        this._romi.addCommandListener((block, timeMs) => {
+            this._onCommand(block, timeMs);
+        });
+    }
+
+    public get robot(): RomiRobot {
+        return this._robot;
+    }
+
+    public async run(options?: ReplayOptions): Promise<ReplayReport> {
+        const speed = options?.speed !== undefined ? Math.max(0, options.speed) : 0;
+        const maxCommandLagMs = options?.maxCommandLagMs !== undefined ? options.maxCommandLagMs : DEFAULT_MAX_COMMAND_LAG_MS;
+        const session = this._session;
+
+        await this._robot.readyP();
+
+        // Take over from the robot's timers
+        const scheduler = this._robot.scheduler;
+        const lsm6 = this._robot.getIMU();
+        scheduler.stop();
+        lsm6.fifoStop();
+
+        const leftChannel = this._findMotorChannel(0);
+        const rightChannel = this._findMotorChannel(1);
+        this._setUpTelemetryChecks();
+
+        const recordedChanges: MotorChange[] = [];
+        let commandIdx = 0;
+        let lastLeft = 0;
+        let lastRight = 0;
+
+        let telemetryTransfers = this._robot.shmemStats.telemetry.transfers;
+
+        const stepMs = scheduler.tickMs;
+        const endMs = session.durationMs + SETTLE_MS;
+        const startTime = performance.now();
+        let ticks = 0;
+
+        logger.info(`Replaying ${(session.durationMs / 1000).toFixed(1)}s session ${speed > 0 ? "at " + speed + "x" : "as fast as possible"}`);
+
+        for (let timeMs = 0; timeMs <= endMs; timeMs += stepMs) {
+            if (this._romi.setTime(timeMs)) {
+                await this._bus.samplePeriodicReads();
+            }
+
+            this._imu.setTime(timeMs);
+            if (this._imu.pendingFrames > 0) {
+                await lsm6.pollFIFO();
+            }
+
+            // Apply the recorded motor outputs again
+            while (commandIdx < session.commandCount && session.commandTimes[commandIdx] <= timeMs) {
+                const left = session.commandField(commandIdx, "leftMotor");
+                const right = session.commandField(commandIdx, "rightMotor");
+
+                if (left !== lastLeft || right !== lastRight) {
+                    recordedChanges.push({ timeMs: session.commandTimes[commandIdx], left, right });
+
+                    if (left !== lastLeft) {
+                        this._robot.setPWMValue(leftChannel, motorCommandToPWM(left));
+                    }
+                    if (right !== lastRight) {
+                        this._robot.setPWMValue(rightChannel, motorCommandToPWM(right));
+                    }
+
+                    lastLeft = left;
+                    lastRight = right;
+                }
+
+                commandIdx++;
+            }
+
+            scheduler.tick(startTime + timeMs);
+            ticks++;
+
+            // Let the writes queued up by the tick go out
+            await new Promise(resolve => setImmediate(resolve));
+
+            // Check what the robot made of the latest telemetry block, once
+            // it has picked it up
+            const transfers = this._robot.shmemStats.telemetry.transfers;
+            if (transfers !== telemetryTransfers) {
+                telemetryTransfers = transfers;
+                this._checkTelemetry(timeMs);
+            }
+
+            if (options?.onStep) {
+                options.onStep(timeMs, this._robot);
+            }
+
+            if (speed > 0) {
+                const aheadMs = (timeMs / speed) - (performance.now() - startTime);
+                if (aheadMs >= 1) {
+                    await new Promise(resolve => setTimeout(resolve, aheadMs));
+                }
+            }
+        }
+
+        const wallTimeMs = performance.now() - startTime;
+        const commands = this._diffCommands(recordedChanges, maxCommandLagMs);
+
+        logger.info(`Replay done in ${wallTimeMs.toFixed(0)}ms, ${this._mismatchCount} mismatches`);
+
+        return {
+            durationMs: session.durationMs,
+            wallTimeMs,
+            speedup: wallTimeMs > 0 ? session.durationMs / wallTimeMs : 0,
+            ticks,
+            telemetryEvents: this._romi.telemetryIndex + 1,
+            imuFrames: this._imu.framesRead,
+            commands,
+            mismatchCount: this._mismatchCount,
+            mismatches: this._mismatches
+        };
+    }
+
+    /**
+     * Logs record raw blocks of the shared buffer, so they can only be
+     * replayed against the same layout
+     */
+    private _checkLayout(): void {
+        const schema = this._session.schema;
+        const telemetryStart = RomiDataBuffer.telemetryCrc.crcStart;
+        const commandStart = RomiDataBuffer.commandCrc.crcStart;
+
+        if (schema.telemetryBlock.start !== telemetryStart ||
+            schema.telemetryBlock.length !== RomiDataBuffer.telemetryCrc.crcLength + 1 ||
+            schema.commandBlock.start !== commandStart ||
+            schema.commandBlock.length !== RomiDataBuffer.commandCrc.crcLength + 1 ||
+            CHECKED_FIELDS.some(name => {
+                return schema.fields[name] === undefined || schema.fields[name].offset !== RomiDataBuffer[name].offset;
+            })) {
+            throw new Error(`Session was recorded with a different shared buffer layout (firmware ${schema.firmwareIdent})`);
+        }
+    }
+
+    private _findMotorChannel(port: number): number {
+        const channel = this._robot.ioChannelInfo.pwm.findIndex(info => {
+            return info.deviceName === "romi-onboard" && info.port === port;
+        });
+
+        if (channel < 0) {
+            throw new Error(`No PWM channel for onboard motor ${port}`);
+        }
+
+        return channel;
+    }
+
+    /**
+     * Start tracking the robot's view of the inputs carried in the
+     * telemetry block. The encoders start from 0, so their counts should
+     * follow the recorded raw counts exactly
+     */
+    private _setUpTelemetryChecks(): void {
+        this._robot.registerEncoder(LEFT_ENCODER_CHANNEL, 4, 5);
+        this._robot.registerEncoder(RIGHT_ENCODER_CHANNEL, 6, 7);
+
+        const ioInfo = this._robot.ioChannelInfo;
+
+        // Button A is input only, so this doesn't write anything
+        this._buttonAChannel = ioInfo.dio.findIndex(info => {
+            return info.deviceName === "romi-onboard" && info.port === 0;
+        });
+        if (this._buttonAChannel >= 0) {
+            this._robot.setDigitalChannelMode(this._buttonAChannel, DigitalChannelMode.INPUT);
+        }
+
+        this._analogChannels = [];
+        ioInfo.analogIn.forEach((info, channel) => {
+            if (info.deviceName === "romi-external") {
+                this._analogChannels.push({ channel, port: info.port });
+            }
+        });
+    }
+
+    private _onCommand(block: Uint8Array, timeMs: number): void {
+        const commandStart = RomiDataBuffer.commandCrc.crcStart;
+        const data = Buffer.from(block.buffer, block.byteOffset, block.length);
+        const left = data.readInt16LE(RomiDataBuffer.leftMotor.offset - commandStart);
+        const right = data.readInt16LE(RomiDataBuffer.rightMotor.offset - commandStart);
+
+        const last = this._replayedChanges[this._replayedChanges.length - 1];
+        if (last ? (left !== last.left || right !== last.right) : (left !== 0 || right !== 0)) {
+            this._replayedChanges.push({ timeMs, left, right });
+        }
+    }
+
+    private _checkTelemetry(timeMs: number): void {
+        const idx = this._romi.telemetryIndex;
+        if (idx < 0 || this._session.telemetryEvents[idx] !== TELEMETRY_EVENT_BLOCK) {
+            return;
+        }
+
+        const session = this._session;
+        const robot = this._robot;
+
+        this._checkValue(timeMs, "batteryMillivolts", "batteryMillivolts",
+                         session.telemetryField(idx, "batteryMillivolts"),
+                         Math.round(robot.getBatteryPercentage() * 9000));
+
+        this._checkValue(timeMs, "leftEncoder", "leftEncoder",
+                         session.telemetryField(idx, "leftEncoder"),
+                         robot.getEncoderCount(LEFT_ENCODER_CHANNEL));
+        this._checkValue(timeMs, "rightEncoder", "rightEncoder",
+                         session.telemetryField(idx, "rightEncoder"),
+                         robot.getEncoderCount(RIGHT_ENCODER_CHANNEL));
+
+        if (this._buttonAChannel >= 0) {
+            this._checkValue(timeMs, "builtinDioInputs", "buttonA",
+                             session.telemetryField(idx, "builtinDioInputs") & 0x1,
+                             robot.getDIOValue(this._buttonAChannel) ? 1 : 0);
+        }
+
+        for (let i = 0; i < this._analogChannels.length; i++) {
+            const { channel, port } = this._analogChannels[i];
+            this._checkValue(timeMs, "analog", `analog[${port}]`,
+                             (session.telemetryField(idx, "analog", port) / ANALOG_FULL_SCALE) * 5.0,
+                             robot.getAnalogInVoltage(channel));
+        }
+    }
+
+    /**
+     * @param field Telemetry field, for the tolerance
+     * @param name What to call the value in the report
+     */
+    private _checkValue(timeMs: number, field: string, name: string, expected: number, actual: number): void {
+        if (Math.abs(actual - expected) > TELEMETRY_TOLERANCES[field]) {
+            this._addMismatch(timeMs, name, expected, actual);
+        }
+    }
+
+    /**
+     * Line up the motor output changes in the recording with those in the
+     * replay, one for one
+     */
+    private _diffCommands(recorded: MotorChange[], maxLagMs: number): ReplayCommandStats {
+        const replayed = this._replayedChanges;
+        const numChanges = Math.max(recorded.length, replayed.length);
+        let maxLag = 0;
+        let totalLag = 0;
+        let numMatched = 0;
+
+        for (let i = 0; i < numChanges; i++) {
+            const expected = recorded[i];
+            const actual = replayed[i];
+
+            if (!expected || !actual) {
+                const timeMs = expected ? expected.timeMs : actual.timeMs;
+                this._addMismatch(timeMs, "motorChanges", recorded.length, replayed.length);
+                break;
+            }
+
+            if (actual.left !== expected.left) {
+                this._addMismatch(expected.timeMs, "leftMotor", expected.left, actual.left);
+            }
+            if (actual.right !== expected.right) {
+                this._addMismatch(expected.timeMs, "rightMotor", expected.right, actual.right);
+            }
+
+            const lag = actual.timeMs - expected.timeMs;
+            if (lag > maxLagMs) {
+                this._addMismatch(expected.timeMs, "commandLagMs", maxLagMs, lag);
+            }
+
+            maxLag = Math.max(maxLag, lag);
+            totalLag += lag;
+            numMatched++;
+        }
+
+        return {
+            recorded: recorded.length,
+            replayed: replayed.length,
+            maxLagMs: maxLag,
+            avgLagMs: numMatched > 0 ? totalLag / numMatched : 0
+        };
+    }
+
+    private _addMismatch(timeMs: number, field: string, expected: number, actual: number): void {
+        this._mismatchCount++;
+        if (this._mismatches.length < MAX_REPORTED_MISMATCHES) {
+            this._mismatches.push({ timeMs, field, expected, actual });
+        }
+    }
+}
@@ -0,0 +1,25 @@
+// CRC-8 with polynomial 0x07 and an initial value of 0. This matches
+// _crc8_ccitt_update() from avr-libc, which the Romi firmware uses to
+// protect the command and telemetry blocks of the shared buffer
+
+const CRC8_TABLE: Uint8Array = new Uint8Array(256);
+
+for (let i = 0; i < 256; i++) {
+    let crc = i;
+    for (let bit = 0; bit < 8; bit++) {
+        crc = (crc & 0x80) ? ((crc << 1) ^ 0x07) & 0xFF : (crc << 1) & 0xFF;
+    }
+    CRC8_TABLE[i] = crc;
+}
+
+/**
+ * Compute the CRC-8 of data[start, end)
+ */
+export function crc8(data: Uint8Array, start: number = 0, end: number = data.length): number {
+    let crc = 0;
+    for (let i = start; i < end; i++) {
+        crc = CRC8_TABLE[crc ^ data[i]];
+    }
+
+    return crc;
+}
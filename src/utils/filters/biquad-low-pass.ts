@@ -0,0 +1,102 @@
+import StreamFilter from "./stream-filter";
+
+// Gives a maximally flat (Butterworth) response
+export const BUTTERWORTH_Q: number = Math.SQRT1_2;
+
+/**
+ * Second order IIR low pass filter
+ *
+ * Coefficients follow the RBJ Audio EQ Cookbook, and the filter runs in
+ * transposed direct form II, which only needs two values of state
+ */
+export default class BiquadLowPass implements StreamFilter {
+    private _b0: number;
+    private _b1: number;
+    private _b2: number;
+    private _a1: number;
+    private _a2: number;
+
+    private _z1: number = 0;
+    private _z2: number = 0;
+    private _initialized: boolean = false;
+
+    /**
+     * @param cutoffHz Corner frequency. This must be below half the sample rate
+     * @param sampleRateHz Rate that values are fed in at
+     * @param q Quality factor
+     */
+    constructor(cutoffHz: number, sampleRateHz: number, q: number = BUTTERWORTH_Q) {
+        if (cutoffHz <= 0 || cutoffHz >= sampleRateHz / 2) {
+            throw new Error(`Cutoff ${cutoffHz}Hz must be between 0 and half the sample rate (${sampleRateHz}Hz)`);
+        }
+
+        const w0 = (2 * Math.PI * cutoffHz) / sampleRateHz;
+        const cosW0 = Math.cos(w0);
+        const alpha = Math.sin(w0) / (2 * q);
+        const a0 = 1 + alpha;
+
+        this._b0 = ((1 - cosW0) / 2) / a0;
+        this._b1 = (1 - cosW0) / a0;
+        this._b2 = this._b0;
+        this._a1 = (-2 * cosW0) / a0;
+        this._a2 = (1 - alpha) / a0;
+    }
+
+    public getValue(nextVal: number): number {
+        if (!this._initialized) {
+            this._settle(nextVal);
+        }
+
+        const out = (this._b0 * nextVal) + this._z1;
+        this._z1 = (this._b1 * nextVal) - (this._a1 * out) + this._z2;
+        this._z2 = (this._b2 * nextVal) - (this._a2 * out);
+
+        return out;
+    }
+
+    public processFrames(values: Float64Array, length: number = values.length): void {
+        if (length === 0) {
+            return;
+        }
+
+        if (!this._initialized) {
+            this._settle(values[0]);
+        }
+
+        const b0 = this._b0;
+        const b1 = this._b1;
+        const b2 = this._b2;
+        const a1 = this._a1;
+        const a2 = this._a2;
+        let z1 = this._z1;
+        let z2 = this._z2;
+
+        for (let i = 0; i < length; i++) {
+            const x = values[i];
+            const out = (b0 * x) + z1;
+            z1 = (b1 * x) - (a1 * out) + z2;
+            z2 = (b2 * x) - (a2 * out);
+            values[i] = out;
+        }
+
+        this._z1 = z1;
+        this._z2 = z2;
+    }
+
+    public reset(): void {
+        this._z1 = 0;
+        this._z2 = 0;
+        this._initialized = false;
+    }
+
+    /**
+     * Set up the state as if the filter had been fed this value forever,
+     * so it doesn't ring when it starts up away from 0
+     */
+    private _settle(value: number): void {
+        // With a unity DC gain, the steady state output equals the input
+        this._z2 = (this._b2 * value) - (this._a2 * value);
+        this._z1 = (this._b1 * value) - (this._a1 * value) + this._z2;
+        this._initialized = true;
+    }
+}
@@ -0,0 +1,66 @@
+import StreamFilter from "./stream-filter";
+
+/**
+ * First order IIR low pass filter
+ *
+ * Each new value moves the output alpha of the way towards it, so smaller
+ * values of alpha give more smoothing (and more lag)
+ */
+export default class ExponentialMovingAverage implements StreamFilter {
+    private _alpha: number;
+    private _value: number = 0;
+    private _initialized: boolean = false;
+
+    /**
+     * @param alpha Smoothing factor, between 0 (exclusive) and 1
+     */
+    constructor(alpha: number) {
+        this._alpha = Math.min(Math.max(alpha, Number.EPSILON), 1);
+    }
+
+    /**
+     * Smoothing factor that gives roughly the same lag as a simple moving
+     * average over windowSize values
+     */
+    public static alphaForWindow(windowSize: number): number {
+        return 2 / (Math.max(windowSize, 1) + 1);
+    }
+
+    public getValue(nextVal: number): number {
+        if (!this._initialized) {
+            // Start from the first value, rather than ramping up from 0
+            this._value = nextVal;
+            this._initialized = true;
+        }
+        else {
+            this._value += this._alpha * (nextVal - this._value);
+        }
+
+        return this._value;
+    }
+
+    public processFrames(values: Float64Array, length: number = values.length): void {
+        if (length === 0) {
+            return;
+        }
+
+        let start = 0;
+        if (!this._initialized) {
+            this.getValue(values[0]);
+            start = 1;
+        }
+
+        const alpha = this._alpha;
+        let value = this._value;
+        for (let i = start; i < length; i++) {
+            value += alpha * (values[i] - value);
+            values[i] = value;
+        }
+        this._value = value;
+    }
+
+    public reset(): void {
+        this._value = 0;
+        this._initialized = false;
+    }
+}
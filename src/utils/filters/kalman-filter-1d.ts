@@ -0,0 +1,87 @@
+import StreamFilter from "./stream-filter";
+
+/**
+ * Scalar Kalman filter for a slowly varying value observed through noise
+ *
+ * The value is modelled as a random walk, so this behaves like an
+ * exponential moving average whose smoothing adapts to how certain the
+ * estimate is: it follows the first few values closely, then settles to a
+ * steady gain set by the ratio of the two noise terms
+ */
+export default class KalmanFilter1D implements StreamFilter {
+    private _processNoise: number;
+    private _measurementNoise: number;
+
+    private _estimate: number = 0;
+    private _errorCovariance: number = 0;
+    private _initialized: boolean = false;
+
+    /**
+     * @param processNoise Variance of the change in the true value between samples
+     * @param measurementNoise Variance of the noise on each sample
+     */
+    constructor(processNoise: number, measurementNoise: number) {
+        if (processNoise < 0 || measurementNoise <= 0) {
+            throw new Error("Kalman filter noise variances must be positive");
+        }
+
+        this._processNoise = processNoise;
+        this._measurementNoise = measurementNoise;
+    }
+
+    public get errorCovariance(): number {
+        return this._errorCovariance;
+    }
+
+    public getValue(nextVal: number): number {
+        if (!this._initialized) {
+            this._estimate = nextVal;
+            this._errorCovariance = this._measurementNoise;
+            this._initialized = true;
+            return this._estimate;
+        }
+
+        // Predict, then correct
+        const predictedCovariance = this._errorCovariance + this._processNoise;
+        const gain = predictedCovariance / (predictedCovariance + this._measurementNoise);
+
+        this._estimate += gain * (nextVal - this._estimate);
+        this._errorCovariance = (1 - gain) * predictedCovariance;
+
+        return this._estimate;
+    }
+
+    public processFrames(values: Float64Array, length: number = values.length): void {
+        if (length === 0) {
+            return;
+        }
+
+        let start = 0;
+        if (!this._initialized) {
+            values[0] = this.getValue(values[0]);
+            start = 1;
+        }
+
+        const q = this._processNoise;
+        const r = this._measurementNoise;
+        let estimate = this._estimate;
+        let p = this._errorCovariance;
+
+        for (let i = start; i < length; i++) {
+            const predicted = p + q;
+            const gain = predicted / (predicted + r);
+            estimate += gain * (values[i] - estimate);
+            p = (1 - gain) * predicted;
+            values[i] = estimate;
+        }
+
+        this._estimate = estimate;
+        this._errorCovariance = p;
+    }
+
+    public reset(): void {
+        this._estimate = 0;
+        this._errorCovariance = 0;
+        this._initialized = false;
+    }
+}
@@ -0,0 +1,85 @@
+import StreamFilter from "./stream-filter";
+
+/**
+ * Median of the last windowSize values
+ *
+ * Good at rejecting single sample spikes, which an average would smear
+ * out. Alongside the ring of recent values, a sorted copy of the window is
+ * kept up to date, so each new value costs one removal and one insertion
+ * (O(windowSize), with no allocation) rather than a full sort
+ */
+export default class MedianFilter implements StreamFilter {
+    private _windowSize: number;
+    private _ring: Float64Array;
+    private _sorted: Float64Array;
+
+    private _head: number = 0;
+    private _count: number = 0;
+
+    constructor(windowSize: number) {
+        this._windowSize = Math.max(1, Math.floor(windowSize));
+        this._ring = new Float64Array(this._windowSize);
+        this._sorted = new Float64Array(this._windowSize);
+    }
+
+    public getValue(nextVal: number): number {
+        const sorted = this._sorted;
+        let count = this._count;
+
+        if (count === this._windowSize) {
+            // Drop the oldest value from the sorted window
+            const oldest = this._ring[this._head];
+            let idx = this._indexOf(oldest);
+            for (; idx < count - 1; idx++) {
+                sorted[idx] = sorted[idx + 1];
+            }
+            count--;
+        }
+
+        // Insert the new one in order
+        let idx = count;
+        while (idx > 0 && sorted[idx - 1] > nextVal) {
+            sorted[idx] = sorted[idx - 1];
+            idx--;
+        }
+        sorted[idx] = nextVal;
+        count++;
+
+        this._ring[this._head] = nextVal;
+        this._head = (this._head + 1) % this._windowSize;
+        this._count = count;
+
+        const mid = count >> 1;
+        return (count & 1) ? sorted[mid] : (sorted[mid - 1] + sorted[mid]) / 2;
+    }
+
+    public processFrames(values: Float64Array, length: number = values.length): void {
+        for (let i = 0; i < length; i++) {
+            values[i] = this.getValue(values[i]);
+        }
+    }
+
+    public reset(): void {
+        this._ring.fill(0);
+        this._sorted.fill(0);
+        this._head = 0;
+        this._count = 0;
+    }
+
+    private _indexOf(value: number): number {
+        // Binary search for the first element >= value
+        let low = 0;
+        let high = this._count - 1;
+        while (low < high) {
+            const mid = (low + high) >> 1;
+            if (this._sorted[mid] < value) {
+                low = mid + 1;
+            }
+            else {
+                high = mid;
+            }
+        }
+
+        return low;
+    }
+}
@@ -4,4 +4,12 @@ export default class PassThroughFilter implements StreamFilter {
     public getValue(nextVal: number): number {
         return nextVal;
     }
+
+    public processFrames(values: Float64Array, length: number = values.length): void {
+        // Nothing to do
+    }
+
+    public reset(): void {
+        // No state to reset
+    }
 }
@@ -1,27 +1,56 @@
 import StreamFilter from "./stream-filter";
 
 export default class SimpleMovingAverage implements StreamFilter {
-    private _window: number[];
+    private _window: Float64Array;
     private _windowSize: number = 0;
     private _total: number = 0;
 
+    // Next slot to write in the ring, and how many slots are filled
+    private _head: number = 0;
+    private _count: number = 0;
+
     constructor(windowSize: number) {
-        this._windowSize = windowSize;
-        this._window = [];
-        this._total = 0;
+        this._windowSize = Math.max(1, Math.floor(windowSize));
+        this._window = new Float64Array(this._windowSize);
     }
 
     public getValue(nextVal: number): number {
-        if (this._window.length < this._windowSize) {
-            this._window.push(nextVal);
-            this._total += nextVal;
+        if (this._count < this._windowSize) {
+            this._count++;
         }
         else {
-            this._total -= this._window.shift();
-            this._window.push(nextVal);
-            this._total += nextVal;
+            this._total -= this._window[this._head];
+        }
+
+        this._window[this._head] = nextVal;
+        this._total += nextVal;
+
+        this._head++;
+        if (this._head === this._windowSize) {
+            this._head = 0;
+
+            // Adding and subtracting every sample slowly accumulates
+            // rounding error, so start again from an exact sum once per
+            // trip around the ring
+            this._total = 0;
+            for (let i = 0; i < this._count; i++) {
+                this._total += this._window[i];
+            }
         }
 
-        return this._total / this._window.length;
+        return this._total / this._count;
+    }
+
+    public processFrames(values: Float64Array, length: number = values.length): void {
+        for (let i = 0; i < length; i++) {
+            values[i] = this.getValue(values[i]);
+        }
+    }
+
+    public reset(): void {
+        this._window.fill(0);
+        this._total = 0;
+        this._head = 0;
+        this._count = 0;
     }
 }
@@ -3,4 +3,17 @@ export default interface StreamFilter {
      * Given the next value in a stream, return the current filter value
      */
     getValue: (nextValue: number) => number;
+
+    /**
+     * Filter a run of values (e.g. one axis of a FIFO drain) in place.
+     * This gives the same results as calling getValue() on each value in
+     * turn, without the per-value call overhead
+     * @param length Number of values to filter, from the start of values
+     */
+    processFrames: (values: Float64Array, length?: number) => void;
+
+    /**
+     * Forget all history, as if no values had been seen
+     */
+    reset: () => void;
 }
@@ -0,0 +1,210 @@
+// Default filter gain. Larger values trust the accelerometer more,
+// correcting tilt faster at the cost of more noise
+export const DEFAULT_MADGWICK_BETA: number = 0.033;
+
+// Accelerometer readings further than this from 1G mean the sensor is
+// being shaken or accelerated, so they aren't used to correct tilt
+const ACCEL_REJECT_THRESHOLD_G: number = 0.25;
+
+const RAD_TO_DEG: number = 180 / Math.PI;
+
+/**
+ * Madgwick's gradient descent orientation filter, IMU (gyro and
+ * accelerometer only) version
+ *
+ * Gyro rates are integrated as a quaternion, so heading stays right when
+ * the sensor is tilted, while gravity (as seen by the accelerometer)
+ * pulls roll and pitch back towards the truth. Without a magnetometer,
+ * yaw can only come from the gyro, so it still drifts with any gyro bias.
+ *
+ * Angles follow the sensor's own right handed axes, with yaw measured
+ * about the axis that points up when the sensor is level
+ *
+ * See https://x-io.co.uk/open-source-imu-and-ahrs-algorithms/
+ */
+export default class MadgwickAHRS {
+    private _beta: number;
+
+    // Orientation of the sensor relative to the earth
+    private _q0: number = 1;
+    private _q1: number = 0;
+    private _q2: number = 0;
+    private _q3: number = 0;
+
+    private _initialized: boolean = false;
+
+    constructor(beta: number = DEFAULT_MADGWICK_BETA) {
+        this._beta = beta;
+    }
+
+    public get beta(): number {
+        return this._beta;
+    }
+
+    public set beta(val: number) {
+        this._beta = Math.max(val, 0);
+    }
+
+    public get qw(): number {
+        return this._q0;
+    }
+
+    public get qx(): number {
+        return this._q1;
+    }
+
+    public get qy(): number {
+        return this._q2;
+    }
+
+    public get qz(): number {
+        return this._q3;
+    }
+
+    /**
+     * Rotation about the up axis, in degrees (-180 to 180)
+     */
+    public get yaw(): number {
+        const q0 = this._q0, q1 = this._q1, q2 = this._q2, q3 = this._q3;
+        return Math.atan2((q1 * q2) + (q0 * q3), 0.5 - (q2 * q2) - (q3 * q3)) * RAD_TO_DEG;
+    }
+
+    /**
+     * Rotation about the sensor's Y axis, in degrees (-90 to 90)
+     */
+    public get pitch(): number {
+        const sinPitch = -2 * ((this._q1 * this._q3) - (this._q0 * this._q2));
+        return Math.asin(Math.min(Math.max(sinPitch, -1), 1)) * RAD_TO_DEG;
+    }
+
+    /**
+     * Rotation about the sensor's X axis, in degrees (-180 to 180)
+     */
+    public get roll(): number {
+        const q0 = this._q0, q1 = this._q1, q2 = this._q2, q3 = this._q3;
+        return Math.atan2((q0 * q1) + (q2 * q3), 0.5 - (q1 * q1) - (q2 * q2)) * RAD_TO_DEG;
+    }
+
+    /**
+     * Go back to level with zero heading. The next update snaps roll and
+     * pitch to the accelerometer reading
+     */
+    public reset(): void {
+        this._q0 = 1;
+        this._q1 = 0;
+        this._q2 = 0;
+        this._q3 = 0;
+        this._initialized = false;
+    }
+
+    /**
+     * Zero the heading, keeping the current roll and pitch
+     */
+    public resetYaw(): void {
+        // Rotate back about the earth's up axis by the current yaw
+        const halfYaw = (this.yaw / RAD_TO_DEG) / 2;
+        const c = Math.cos(halfYaw);
+        const s = -Math.sin(halfYaw);
+
+        const q0 = this._q0, q1 = this._q1, q2 = this._q2, q3 = this._q3;
+        this._q0 = (c * q0) - (s * q3);
+        this._q1 = (c * q1) - (s * q2);
+        this._q2 = (c * q2) + (s * q1);
+        this._q3 = (c * q3) + (s * q0);
+    }
+
+    /**
+     * Feed in one IMU sample
+     * @param gx Gyro rates in rad/s
+     * @param ax Accelerations, in any units (only the direction is used)
+     * @param dt Time since the previous sample, in seconds
+     */
+    public update(gx: number, gy: number, gz: number, ax: number, ay: number, az: number, dt: number): void {
+        const accelNorm = Math.sqrt((ax * ax) + (ay * ay) + (az * az));
+
+        if (!this._initialized) {
+            if (accelNorm > 0) {
+                this._setTiltFromGravity(ax / accelNorm, ay / accelNorm, az / accelNorm);
+            }
+            this._initialized = true;
+        }
+
+        let q0 = this._q0, q1 = this._q1, q2 = this._q2, q3 = this._q3;
+
+        // Rate of change of the quaternion from the gyro
+        let qDot0 = 0.5 * ((-q1 * gx) - (q2 * gy) - (q3 * gz));
+        let qDot1 = 0.5 * ((q0 * gx) + (q2 * gz) - (q3 * gy));
+        let qDot2 = 0.5 * ((q0 * gy) - (q1 * gz) + (q3 * gx));
+        let qDot3 = 0.5 * ((q0 * gz) + (q1 * gy) - (q2 * gx));
+
+        // Correct towards gravity, if the accelerometer can be trusted
+        if (accelNorm > 0 && Math.abs(accelNorm - 1) < ACCEL_REJECT_THRESHOLD_G && this._beta > 0) {
+            ax /= accelNorm;
+            ay /= accelNorm;
+            az /= accelNorm;
+
+            const _2q0 = 2 * q0;
+            const _2q1 = 2 * q1;
+            const _2q2 = 2 * q2;
+            const _2q3 = 2 * q3;
+            const _4q0 = 4 * q0;
+            const _4q1 = 4 * q1;
+            const _4q2 = 4 * q2;
+            const _8q1 = 8 * q1;
+            const _8q2 = 8 * q2;
+            const q0q0 = q0 * q0;
+            const q1q1 = q1 * q1;
+            const q2q2 = q2 * q2;
+            const q3q3 = q3 * q3;
+
+            // Gradient of the error between measured and expected gravity
+            let s0 = (_4q0 * q2q2) + (_2q2 * ax) + (_4q0 * q1q1) - (_2q1 * ay);
+            let s1 = (_4q1 * q3q3) - (_2q3 * ax) + (4 * q0q0 * q1) - (_2q0 * ay) - _4q1 + (_8q1 * q1q1) + (_8q1 * q2q2) + (_4q1 * az);
+            let s2 = (4 * q0q0 * q2) + (_2q0 * ax) + (_4q2 * q3q3) - (_2q3 * ay) - _4q2 + (_8q2 * q1q1) + (_8q2 * q2q2) + (_4q2 * az);
+            let s3 = (4 * q1q1 * q3) - (_2q1 * ax) + (4 * q2q2 * q3) - (_2q2 * ay);
+
+            const sNorm = Math.sqrt((s0 * s0) + (s1 * s1) + (s2 * s2) + (s3 * s3));
+            if (sNorm > 0) {
+                s0 /= sNorm;
+                s1 /= sNorm;
+                s2 /= sNorm;
+                s3 /= sNorm;
+
+                qDot0 -= this._beta * s0;
+                qDot1 -= this._beta * s1;
+                qDot2 -= this._beta * s2;
+                qDot3 -= this._beta * s3;
+            }
+        }
+
+        q0 += qDot0 * dt;
+        q1 += qDot1 * dt;
+        q2 += qDot2 * dt;
+        q3 += qDot3 * dt;
+
+        const qNorm = Math.sqrt((q0 * q0) + (q1 * q1) + (q2 * q2) + (q3 * q3));
+        this._q0 = q0 / qNorm;
+        this._q1 = q1 / qNorm;
+        this._q2 = q2 / qNorm;
+        this._q3 = q3 / qNorm;
+    }
+
+    /**
+     * Jump straight to the roll and pitch implied by a (normalized)
+     * gravity reading, with zero heading
+     */
+    private _setTiltFromGravity(ax: number, ay: number, az: number): void {
+        const roll = Math.atan2(ay, az);
+        const pitch = Math.atan2(-ax, Math.sqrt((ay * ay) + (az * az)));
+
+        const cr = Math.cos(roll / 2);
+        const sr = Math.sin(roll / 2);
+        const cp = Math.cos(pitch / 2);
+        const sp = Math.sin(pitch / 2);
+
+        this._q0 = cr * cp;
+        this._q1 = sr * cp;
+        this._q2 = cr * sp;
+        this._q3 = -sr * sp;
+    }
+}
@@ -0,0 +1,44 @@
+/**
+ * Running mean and variance of a stream of values, using Welford's method
+ *
+ * Nothing is stored per value, and unlike summing values and their
+ * squares, the variance stays accurate when it is tiny compared to the
+ * mean (e.g. sensor noise on top of a large offset)
+ */
+export default class RunningStats {
+    private _count: number = 0;
+    private _mean: number = 0;
+    private _m2: number = 0;
+
+    public get count(): number {
+        return this._count;
+    }
+
+    public get mean(): number {
+        return this._mean;
+    }
+
+    /**
+     * Sample variance (0 until there are at least 2 values)
+     */
+    public get variance(): number {
+        return this._count > 1 ? this._m2 / (this._count - 1) : 0;
+    }
+
+    public get stdDev(): number {
+        return Math.sqrt(this.variance);
+    }
+
+    public add(value: number): void {
+        this._count++;
+        const delta = value - this._mean;
+        this._mean += delta / this._count;
+        this._m2 += delta * (value - this._mean);
+    }
+
+    public reset(): void {
+        this._count = 0;
+        this._mean = 0;
+        this._m2 = 0;
+    }
+}
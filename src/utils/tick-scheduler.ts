@@ -0,0 +1,271 @@
+import { performance } from "perf_hooks";
+
+export const DEFAULT_TICK_MS: number = 5;
+
+// Weight of the latest sample in the lag and run time averages
+const AVERAGE_WEIGHT: number = 0.1;
+
+export type TaskPeriod = number | (() => number);
+// Tasks are passed the time of the tick they run in, which saves them
+// reading the clock themselves
+export type TaskFunction = (now: number) => void | Promise<void>;
+
+export interface ScheduledTaskStats {
+    name: string;
+    periodMs: number;
+    phaseMs: number;
+    runs: number;
+
+    // Runs that were skipped, either because the task fell a whole period
+    // behind, or because the previous (async) run hadn't finished
+    overruns: number;
+    avgRunMs: number;
+    maxRunMs: number;
+}
+
+export interface TickSchedulerStats {
+    tickMs: number;
+    ticks: number;
+
+    // How late each tick fired, compared to when it was due
+    avgLagMs: number;
+    maxLagMs: number;
+    tasks: ScheduledTaskStats[];
+}
+
+export class ScheduledTask {
+    public readonly name: string;
+
+    private _period: TaskPeriod;
+    private _phaseMs: number;
+    private _fn: TaskFunction;
+
+    private _nextRunTime: number = -1;
+    private _isRunning: boolean = false;
+
+    private _runs: number = 0;
+    private _overruns: number = 0;
+    private _avgRunMs: number = 0;
+    private _maxRunMs: number = 0;
+
+    constructor(name: string, period: TaskPeriod, phaseMs: number, fn: TaskFunction) {
+        this.name = name;
+        this._period = period;
+        this._phaseMs = phaseMs;
+        this._fn = fn;
+    }
+
+    public get periodMs(): number {
+        return typeof this._period === "number" ? this._period : this._period();
+    }
+
+    public get phaseMs(): number {
+        return this._phaseMs;
+    }
+
+    public get stats(): ScheduledTaskStats {
+        return {
+            name: this.name,
+            periodMs: this.periodMs,
+            phaseMs: this._phaseMs,
+            runs: this._runs,
+            overruns: this._overruns,
+            avgRunMs: this._avgRunMs,
+            maxRunMs: this._maxRunMs
+        };
+    }
+
+    /**
+     * Run the task if it's due
+     * @param now Current time
+     * @param startTime Time the scheduler started, which phases are relative to
+     */
+    public poll(now: number, startTime: number): void {
+        const periodMs = this.periodMs;
+
+        if (this._nextRunTime < 0) {
+            // Tasks added after the scheduler started begin at their next
+            // slot, without counting the ones before they existed
+            this._nextRunTime = startTime + this._phaseMs;
+            if (now > this._nextRunTime) {
+                this._nextRunTime += Math.ceil((now - this._nextRunTime) / periodMs) * periodMs;
+            }
+        }
+
+        if (now < this._nextRunTime) {
+            return;
+        }
+
+        // Work out the next slot, keeping to the original phase. If we've
+        // missed whole periods, they're counted as overruns rather than
+        // being run back to back
+        const periodsElapsed = Math.floor((now - this._nextRunTime) / periodMs);
+        this._overruns += periodsElapsed;
+        this._nextRunTime += (periodsElapsed + 1) * periodMs;
+
+        if (this._isRunning) {
+            this._overruns++;
+            return;
+        }
+
+        this._run(now);
+    }
+
+    private _run(now: number): void {
+        const start = performance.now();
+        let result: void | Promise<void>;
+
+        try {
+            result = this._fn(now);
+        }
+        catch (err) {
+            result = undefined;
+        }
+
+        if (result instanceof Promise) {
+            this._isRunning = true;
+            result
+            .catch(() => {})
+            .then(() => {
+                this._isRunning = false;
+                this._recordRun(performance.now() - start);
+            });
+        }
+        else {
+            this._recordRun(performance.now() - start);
+        }
+    }
+
+    private _recordRun(runMs: number): void {
+        this._runs++;
+        this._maxRunMs = Math.max(this._maxRunMs, runMs);
+        this._avgRunMs += (runMs - this._avgRunMs) * AVERAGE_WEIGHT;
+    }
+}
+
+/**
+ * Cooperative scheduler for periodic work on the main thread
+ *
+ * Everything runs off a single timer that fires every tickMs. Each task
+ * has a period (which can change over time) and a phase offset, so that
+ * tasks with the same period don't all land in the same tick and hit the
+ * I2C bus at once. The scheduler also keeps track of how late ticks fire
+ * (i.e. how busy the event loop is), and of tasks that can't keep up
+ */
+export default class TickScheduler {
+    private _tickMs: number;
+    private _tasks: ScheduledTask[] = [];
+
+    private _timer: NodeJS.Timeout | null = null;
+    private _startTime: number = 0;
+    private _nextTickTime: number = 0;
+
+    private _ticks: number = 0;
+    private _avgLagMs: number = 0;
+    private _maxLagMs: number = 0;
+
+    constructor(tickMs: number = DEFAULT_TICK_MS) {
+        this._tickMs = tickMs;
+    }
+
+    public get tickMs(): number {
+        return this._tickMs;
+    }
+
+    public get stats(): TickSchedulerStats {
+        return {
+            tickMs: this._tickMs,
+            ticks: this._ticks,
+            avgLagMs: this._avgLagMs,
+            maxLagMs: this._maxLagMs,
+            tasks: this._tasks.map(task => task.stats)
+        };
+    }
+
+    /**
+     * Add a periodic task
+     * @param name Name used for reporting
+     * @param period Period in ms, or a function returning the current period
+     * @param fn Task to run. If this returns a promise, the task won't be
+     * run again until it settles
+     * @param phaseMs Offset of the task within its period. By default,
+     * each new task is placed one tick after the previous one
+     */
+    public addTask(name: string, period: TaskPeriod, fn: TaskFunction, phaseMs?: number): ScheduledTask {
+        if (phaseMs === undefined) {
+            const periodMs = typeof period === "number" ? period : period();
+            phaseMs = (this._tasks.length * this._tickMs) % Math.max(periodMs, this._tickMs);
+        }
+
+        // The list is replaced rather than modified, so that a tick already
+        // walking the old one isn't disturbed
+        const task = new ScheduledTask(name, period, phaseMs, fn);
+        this._tasks = this._tasks.concat([task]);
+        return task;
+    }
+
+    public get tasks(): ReadonlyArray<ScheduledTask> {
+        return this._tasks;
+    }
+
+    public removeTask(task: ScheduledTask): void {
+        this._tasks = this._tasks.filter(t => t !== task);
+    }
+
+    public start(): void {
+        if (this._timer !== null) {
+            return;
+        }
+
+        this._startTime = performance.now();
+        this._nextTickTime = this._startTime;
+        this._scheduleTick();
+    }
+
+    public stop(): void {
+        if (this._timer !== null) {
+            clearTimeout(this._timer);
+            this._timer = null;
+        }
+    }
+
+    /**
+     * Run any tasks that are due at the given time. This is normally
+     * called from the scheduler's own timer
+     */
+    public tick(now: number = performance.now()): void {
+        this._ticks++;
+
+        // Tasks that add or remove tasks swap in a new list, so this one
+        // can be walked as is
+        const tasks = this._tasks;
+        for (let i = 0; i < tasks.length; i++) {
+            tasks[i].poll(now, this._startTime);
+        }
+    }
+
+    private _scheduleTick(): void {
+        // Aim for fixed tick times, rather than a fixed gap between ticks,
+        // so that the schedule doesn't drift
+        const delayMs = Math.max(0, this._nextTickTime - performance.now());
+
+        this._timer = setTimeout(() => {
+            const now = performance.now();
+            // Timers can fire a fraction of a millisecond early
+            const lagMs = Math.max(0, now - this._nextTickTime);
+            this._maxLagMs = Math.max(this._maxLagMs, lagMs);
+            this._avgLagMs += (lagMs - this._avgLagMs) * AVERAGE_WEIGHT;
+
+            this.tick(now);
+
+            // If the loop was held up for more than a tick, skip ahead
+            // rather than firing a burst of catch-up ticks
+            this._nextTickTime += this._tickMs;
+            if (this._nextTickTime < now) {
+                this._nextTickTime = now + this._tickMs - ((now - this._nextTickTime) % this._tickMs);
+            }
+
+            this._scheduleTick();
+        }, delayMs);
+    }
+}